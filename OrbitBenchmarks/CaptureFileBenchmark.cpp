@@ -0,0 +1,174 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "CaptureFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Round trips a synthetic capture through CaptureFileWriter and the parallel
+// CaptureFileReader path and reports throughput.  Timers are generated one
+// thread at a time so that memory stays bounded by a single thread's timers.
+//-----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+//-----------------------------------------------------------------------------
+static double SecondsSince( Clock::time_point a_Start )
+{
+    return std::chrono::duration<double>( Clock::now() - a_Start ).count();
+}
+
+//-----------------------------------------------------------------------------
+static uint64_t NextRandom( uint64_t & a_State )
+{
+    // xorshift64*
+    a_State ^= a_State >> 12;
+    a_State ^= a_State << 25;
+    a_State ^= a_State >> 27;
+    return a_State * 2685821657736338717ull;
+}
+
+//-----------------------------------------------------------------------------
+static uint64_t Checksum( const Timer & a_Timer )
+{
+    return a_Timer.m_Start ^ ( a_Timer.m_End << 1 ) ^ a_Timer.m_FunctionAddress ^ a_Timer.m_CallstackHash ^ a_Timer.m_Depth;
+}
+
+//-----------------------------------------------------------------------------
+// Nested calls on a few hundred functions, roughly what instrumented code
+// produces.
+//-----------------------------------------------------------------------------
+static void GenerateTimers( uint32_t a_ThreadId, size_t a_NumTimers, std::vector<Timer> & o_Timers )
+{
+    const int maxDepth = 8;
+    uint64_t state = 0x9E3779B97F4A7C15ull ^ a_ThreadId;
+    TickType now = 1000000000ull;
+
+    o_Timers.resize( a_NumTimers );
+    for( size_t i = 0; i < a_NumTimers; ++i )
+    {
+        uint64_t random = NextRandom( state );
+        Timer & timer = o_Timers[i];
+        timer = Timer();
+        timer.m_TID = a_ThreadId;
+        timer.m_Depth = (uint8_t)( random % maxDepth );
+        timer.m_Type = Timer::NONE;
+        timer.m_Start = now + ( random >> 8 ) % 64;
+        timer.m_End = timer.m_Start + 100 + ( random >> 16 ) % 10000;
+        timer.m_FunctionAddress = 0x7f0000000000ull + ( ( random >> 32 ) % 512 )*64;
+        timer.m_CallstackHash = ( random & 0x30 ) ? 0 : NextRandom( state );
+        now = timer.m_Start + 50;
+    }
+}
+
+//-----------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+    size_t numTimers = argc > 1 ? (size_t)strtoull( argv[1], nullptr, 10 ) : 100*1000*1000;
+    uint32_t numThreads = argc > 2 ? (uint32_t)atoi( argv[2] ) : 16;
+    std::string fileName = argc > 3 ? argv[3] : "CaptureFileBenchmark.orbit";
+
+    if( numTimers == 0 || numThreads == 0 )
+    {
+        printf( "usage: CaptureFileBenchmark [numTimers] [numThreads] [fileName]\n" );
+        return 1;
+    }
+
+    const double rawMB = double( numTimers*sizeof( Timer ) ) / ( 1024*1024 );
+    printf( "%zu timers on %u threads (%.0f MB), %u cores\n", numTimers, numThreads, rawMB, std::thread::hardware_concurrency() );
+
+    // Save
+    uint64_t checksum = 0;
+    double generateSeconds = 0;
+    Clock::time_point saveStart = Clock::now();
+    CaptureFileWriter writer;
+    if( !writer.Open( fileName ) )
+    {
+        printf( "Could not open %s\n", fileName.c_str() );
+        return 1;
+    }
+
+    std::vector<Timer> timers;
+    for( uint32_t i = 0; i < numThreads; ++i )
+    {
+        size_t begin = numTimers*i/numThreads;
+        size_t end = numTimers*( i + 1 )/numThreads;
+
+        Clock::time_point generateStart = Clock::now();
+        GenerateTimers( 1000 + i, end - begin, timers );
+        for( const Timer & timer : timers )
+        {
+            checksum += Checksum( timer );
+        }
+        generateSeconds += SecondsSince( generateStart );
+
+        writer.WriteTimers( 1000 + i, timers.data(), timers.size() );
+    }
+
+    writer.WriteMetadata( std::string( "CaptureFileBenchmark" ) );
+    if( !writer.Close() )
+    {
+        printf( "Could not write %s\n", fileName.c_str() );
+        return 1;
+    }
+
+    double saveSeconds = SecondsSince( saveStart ) - generateSeconds;
+    timers = std::vector<Timer>();
+    printf( "save: %.2f s, %.0f MB/s, file is %.0f MB (%.1fx)\n", saveSeconds, rawMB/saveSeconds
+          , double( writer.GetSize() ) / ( 1024*1024 ), rawMB*1024*1024/double( writer.GetSize() ) );
+
+    // Load
+    Clock::time_point loadStart = Clock::now();
+    CaptureFileReader reader;
+    if( !reader.Open( fileName ) )
+    {
+        printf( "Could not read %s\n", fileName.c_str() );
+        return 1;
+    }
+
+    uint32_t numWorkers = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector<uint64_t> workerChecksums( numWorkers, 0 );
+    std::vector<uint64_t> workerCounts( numWorkers, 0 );
+    bool success = reader.ReadTimersParallel( [&]( const CaptureChunk & a_Chunk, const std::vector<Timer> & a_Timers, uint32_t a_Worker )
+    {
+        uint64_t sum = 0;
+        for( const Timer & timer : a_Timers )
+        {
+            sum += Checksum( timer );
+        }
+        workerChecksums[a_Worker] += sum;
+        workerCounts[a_Worker] += a_Timers.size();
+        reader.ReleaseChunk( a_Chunk );
+    }, numWorkers );
+
+    double loadSeconds = SecondsSince( loadStart );
+
+    uint64_t loadedChecksum = 0;
+    uint64_t loadedCount = 0;
+    for( uint32_t i = 0; i < numWorkers; ++i )
+    {
+        loadedChecksum += workerChecksums[i];
+        loadedCount += workerCounts[i];
+    }
+
+    printf( "load: %.2f s, %.0f MB/s on %u workers\n", loadSeconds, rawMB/loadSeconds, numWorkers );
+    reader.Close();
+    remove( fileName.c_str() );
+
+    if( !success || loadedCount != numTimers || loadedChecksum != checksum )
+    {
+        printf( "round trip FAILED: %llu/%zu timers\n", (unsigned long long)loadedCount, numTimers );
+        return 1;
+    }
+
+    printf( "round trip ok\n" );
+    return 0;
+}
@@ -12,9 +12,9 @@
 //-----------------------------------------------------------------------------
 BpfTrace::BpfTrace(Callback a_Callback)
 {
-    m_Callback = a_Callback ? a_Callback : [this](const std::string& a_Buffer)
+    m_Callback = a_Callback ? a_Callback : [this](const char* a_Data, size_t a_Size)
     {
-        CommandCallback(a_Buffer);
+        CommandCallback(a_Data, a_Size);
     };
 }
 
@@ -22,9 +22,11 @@ BpfTrace::BpfTrace(Callback a_Callback)
 void BpfTrace::Start()
 {
     m_ExitRequested = false;
-    m_BpfCommand = std::string("bpftrace ") + WriteBpfScript();
+    m_TimerStacks.Clear();
+    m_Buffer.clear();
+    m_BpfCommand = std::string("bpftrace -B full ") + WriteBpfScript();
     m_Thread = std::make_shared<std::thread>
-        ( &LinuxUtils::StreamCommandOutput
+        ( &LinuxUtils::StreamCommandOutputRaw
         , m_BpfCommand.c_str()
         , m_Callback
         , &m_ExitRequested );
@@ -44,14 +46,18 @@ std::string BpfTrace::WriteBpfScript()
     std::ofstream outFile;
     
     outFile.open(filePath);
+    m_FunctionAddresses.clear();
     for (Function *func : Capture::GTargetProcess->GetFunctions())
     {
         if (func->IsSelected())
         {
             Capture::GSelectedFunctionsMap[func->m_Address] = func;
 
-            outFile << "   uprobe:" << func->m_Probe << R"({ printf("b )" << std::to_string((uint64_t)func->GetVirtualAddress()) << R"( %u %lld\n", tid, nsecs); })" << std::endl;
-            outFile << "uretprobe:" << func->m_Probe << R"({ printf("e )" << std::to_string((uint64_t)func->GetVirtualAddress()) << R"( %u %lld\n", tid, nsecs); })" << std::endl;
+            std::string index = Format("%08x", (uint32_t)m_FunctionAddresses.size());
+            m_FunctionAddresses.push_back((uint64_t)func->GetVirtualAddress());
+
+            outFile << "   uprobe:" << func->m_Probe << R"({ printf("b)" << index << R"(%08x%016llx\n", tid, nsecs); })" << std::endl;
+            outFile << "uretprobe:" << func->m_Probe << R"({ printf("e)" << index << R"(%08x%016llx\n", tid, nsecs); })" << std::endl;
         }
     }
     outFile.close();
@@ -73,38 +79,93 @@ uint64_t BpfTrace::ProcessString(const std::string& a_String)
 }
 
 //-----------------------------------------------------------------------------
-void BpfTrace::CommandCallback(const std::string& a_Line)
+static inline bool ParseHex(const char* a_Data, size_t a_NumChars, uint64_t& o_Value)
 {
-    auto tokens = Tokenize(a_Line);
-    const std::string& mode             = tokens[0];
-    const std::string& functionAddress  = tokens[1];
-    const std::string& threadName       = tokens[2];
-    const std::string& timestamp        = tokens[3];
+    uint64_t value = 0;
+    for (size_t i = 0; i < a_NumChars; ++i)
+    {
+        char c = a_Data[i];
+        uint64_t digit;
+        if      (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else return false;
+        value = (value << 4) | digit;
+    }
+
+    o_Value = value;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void BpfTrace::CommandCallback(const char* a_Data, size_t a_Size)
+{
+    // Records can be split across reads, keep the tail for the next call.
+    m_Buffer.insert(m_Buffer.end(), a_Data, a_Data + a_Size);
+
+    const char* data = m_Buffer.data();
+    size_t size = m_Buffer.size();
+    size_t pos = 0;
+    while (pos < size)
+    {
+        const char* record = data + pos;
+        if ((record[0] == 'b' || record[0] == 'e'))
+        {
+            if (size - pos < RecordSize)
+            {
+                break;
+            }
+
+            if (record[RecordSize - 1] == '\n')
+            {
+                ProcessRecord(record);
+                pos += RecordSize;
+                continue;
+            }
+        }
 
-    bool isBegin = mode == "b";
-    bool isEnd   = !isBegin;
+        // Anything else is bpftrace chatter such as "Attaching N probes...",
+        // skip to the next line.
+        const char* newLine = (const char*)memchr(record, '\n', size - pos);
+        if (newLine == nullptr)
+        {
+            break;
+        }
+        pos = newLine + 1 - data;
+    }
 
-    if (isBegin)
+    m_Buffer.erase(m_Buffer.begin(), m_Buffer.begin() + pos);
+}
+
+//-----------------------------------------------------------------------------
+void BpfTrace::ProcessRecord(const char* a_Record)
+{
+    uint64_t functionIndex;
+    uint64_t threadId;
+    uint64_t nanos;
+    if (!ParseHex(a_Record + 1, 8, functionIndex) ||
+        !ParseHex(a_Record + 9, 8, threadId) ||
+        !ParseHex(a_Record + 17, 16, nanos) ||
+        functionIndex >= m_FunctionAddresses.size())
+    {
+        return;
+    }
+
+    std::vector<Timer>& timers = m_TimerStacks[(uint32_t)threadId];
+    if (a_Record[0] == 'b')
     {
         Timer timer;
-        timer.m_TID = atoi(threadName.c_str());
-        uint64_t nanos = std::stoull(timestamp);
+        timer.m_TID = (uint32_t)threadId;
         timer.m_Start = nanos;
-        timer.m_Depth = (uint8_t)m_TimerStacks[threadName].size();
-        timer.m_FunctionAddress = std::stoull(functionAddress);
-        m_TimerStacks[threadName].push_back(timer);
+        timer.m_Depth = (uint8_t)timers.size();
+        timer.m_FunctionAddress = m_FunctionAddresses[functionIndex];
+        timers.push_back(timer);
     }
-
-    if (isEnd)
+    else if (timers.size())
     {
-        std::vector<Timer>& timers = m_TimerStacks[threadName];
-        if (timers.size())
-        {
-            Timer& timer = timers.back();
-            uint64_t nanos = std::stoull(timestamp);
-            timer.m_End = nanos;
-            GCoreApp->ProcessTimer(&timer, functionAddress);
-            timers.pop_back();
-        }
+        static const std::string emptyName;
+        Timer& timer = timers.back();
+        timer.m_End = nanos;
+        GCoreApp->ProcessTimer(&timer, emptyName);
+        timers.pop_back();
     }
 }
@@ -6,6 +6,7 @@
 #include "Core.h"
 #include "ScopeTimer.h"
 #include "OrbitFunction.h"
+#include "FlatHashMap.h"
 #include <vector>
 #include <string>
 #include <map>
@@ -14,7 +15,7 @@
 class BpfTrace
 {
 public:
-    typedef std::function<void(const std::string& a_Data)> Callback;
+    typedef std::function<void(const char* a_Data, size_t a_Size)> Callback;
     BpfTrace(Callback a_Callback = nullptr);
     
     void Start();
@@ -24,11 +25,18 @@ public:
 
 protected:
     uint64_t ProcessString(const std::string& a_String);
-    void CommandCallback(const std::string& a_Line);
+    void CommandCallback(const char* a_Data, size_t a_Size);
+    void ProcessRecord(const char* a_Record);
     std::string WriteBpfScript();
 
+    // Every probe prints a fixed size record: 'b' or 'e', the function
+    // index, the thread id and the timestamp in fixed width hex.
+    static const size_t RecordSize = 1 + 8 + 8 + 16 + 1;
+
 private:    
-    std::map<std::string, std::vector<Timer>> m_TimerStacks;
+    FlatHashMap<uint32_t, std::vector<Timer>> m_TimerStacks;
+    std::vector<uint64_t>                     m_FunctionAddresses;
+    std::vector<char>                         m_Buffer;
     std::unordered_map<uint64_t, std::string> m_StringMap;
     std::string                               m_BpfCommand;
 
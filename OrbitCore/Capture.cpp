@@ -21,6 +21,8 @@
 #include "Params.h"
 #include "OrbitRule.h"
 #include "CoreApp.h"
+#include "CaptureStream.h"
+#include "HookOverhead.h"
 #include <fstream>
 #include <ostream>
 
@@ -42,6 +44,7 @@ uint32_t    Capture::GNumSamplingTicks = 0;
 uint32_t    Capture::GFunctionIndex = -1;
 uint32_t    Capture::GNumInstalledHooks;
 bool        Capture::GHasContextSwitches;
+bool        Capture::GHasMemoryEvents;
 Timer       Capture::GTestTimer;
 ULONG64     Capture::GMainFrameFunction;
 ULONG64     Capture::GNumContextSwitches;
@@ -71,6 +74,7 @@ std::shared_ptr<Session>          Capture::GSessionPresets   = nullptr;
 
 void(*Capture::GClearCaptureDataFunc)();
 void(*Capture::GSamplingDoneCallback)( std::shared_ptr<SamplingProfiler> & a_SamplingProfiler );
+void(*Capture::GUnhookFunctionsFunc)( const std::vector<ULONG64> & a_Addresses );
 std::vector< std::shared_ptr<SamplingProfiler> > GOldSamplingProfilers;
 bool Capture::GUnrealSupported = false;
 
@@ -192,7 +196,30 @@ bool Capture::StartCapture()
 
     GInjected = true;
     ++Message::GSessionID;
-    GTcpServer->Send( Msg_NewSession );
+    // Session and capture control go to every connected target, hooking
+    // stays with the primary one since addresses are per process.
+    GTcpServer->SendTo( TcpPacket::Broadcast, Msg_NewSession );
+
+    // Targets that don't know about it keep sending raw timers.
+    GTcpServer->SendTo( TcpPacket::Broadcast, Msg_TimerEncoding, (uint32_t)TimerEncoding_Compact );
+
+    for( uint32_t sourceId : GTcpServer->GetLocalSourceIds() )
+    {
+        GTcpServer->StartSharedMemoryTransport( sourceId );
+    }
+
+    TimerQueuePolicy queuePolicy;
+    queuePolicy.m_OverflowPolicy = (uint32_t)GParams.m_TimerOverflowPolicy;
+    queuePolicy.m_MaxQueuedTimers = (uint32_t)GParams.m_MaxQueuedTimers;
+    queuePolicy.m_SampleRate = 8;
+    GTcpServer->SendTo( TcpPacket::Broadcast, Msg_TimerQueuePolicy, queuePolicy );
+
+    if( GParams.m_StreamCaptureToDisk )
+    {
+        std::wstring fileName = Path::GetCapturePath() + Path::StripExtension( GTargetProcess->GetName() ) + L"_" + OrbitUtils::GetTimeStampW() + L".orbit";
+        GCaptureStream.Open( ws2s( fileName ) );
+    }
+
     GTimerManager->StartRecording();
     
     ClearCaptureData();
@@ -230,7 +257,7 @@ void Capture::StopCapture()
         return;
     }
 
-    GTcpServer->Send( Msg_StopCapture );
+    GTcpServer->SendTo( TcpPacket::Broadcast, Msg_StopCapture );
     GTimerManager->StopRecording();
 }
 
@@ -258,6 +285,7 @@ void Capture::ClearCaptureData()
     GTcpServer->ResetStats();
     GOrbitUnreal.NewSession();
     GHasContextSwitches = false;
+    GHasMemoryEvents = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -329,6 +357,8 @@ void Capture::SendFunctionHooks()
         }
     }
 
+    GHookOverhead.Reset();
+
     GVisibleFunctionsMap = GSelectedFunctionsMap;
 
     if( GClearCaptureDataFunc )
@@ -336,7 +366,7 @@ void Capture::SendFunctionHooks()
         GClearCaptureDataFunc();
     }
 
-    GTcpServer->Send( Msg_StartCapture );
+    GTcpServer->SendTo( TcpPacket::Broadcast, Msg_StartCapture );
 
     // Unreal
     if( Capture::GUnrealSupported )
@@ -360,6 +390,21 @@ void Capture::SendFunctionHooks()
     }
 }
 
+//-----------------------------------------------------------------------------
+void Capture::UnhookFunctions( const std::vector<ULONG64> & a_Addresses )
+{
+    if( GInjected )
+    {
+        GTcpServer->Send( Msg_FunctionUnhook, a_Addresses );
+    }
+
+    // Hooks that don't live in the target, uprobes for instance.
+    if( GUnhookFunctionsFunc )
+    {
+        GUnhookFunctionsFunc( a_Addresses );
+    }
+}
+
 //-----------------------------------------------------------------------------
 void Capture::SendDataTrackingInfo()
 {
@@ -474,6 +519,11 @@ void Capture::Update()
         GPdbDbg->Update();
     }
 
+    if( IsCapturing() )
+    {
+        GHookOverhead.Update();
+    }
+
 #ifdef WIN32
     if( GInjected && !GTcpServer->HasConnection() )
     {
@@ -625,6 +675,8 @@ void Capture::RegisterZoneName( DWORD64 a_ID, char* a_Name )
 //-----------------------------------------------------------------------------
 void Capture::AddCallstack( CallStack & a_CallStack )
 {
+    GCaptureStream.AddCallstack( a_CallStack );
+
     ScopeLock lock( GCallstackMutex );
     Capture::GCallstacks[a_CallStack.m_Hash] = std::make_shared<CallStack>(a_CallStack);
 }
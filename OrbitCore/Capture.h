@@ -29,6 +29,7 @@ struct Capture
     static void PreFunctionHooks();
     static void SendFunctionHooks();
     static void SendDataTrackingInfo();
+    static void UnhookFunctions( const std::vector<ULONG64> & a_Addresses );
     static void StartSampling();
     static void StopSampling();
     static bool IsCapturing();
@@ -67,6 +68,7 @@ struct Capture
     static uint32_t     GFunctionIndex;
     static uint32_t     GNumInstalledHooks;
     static bool         GHasContextSwitches;
+    static bool         GHasMemoryEvents;
 
     static Timer        GTestTimer;
     static ULONG64      GMainFrameFunction;
@@ -78,6 +80,7 @@ struct Capture
     static std::shared_ptr<CallStack>        GSelectedCallstack;
     static void( *GClearCaptureDataFunc )( );
     static void( *GSamplingDoneCallback )( std::shared_ptr<SamplingProfiler> & a_SamplingProfiler );
+    static void( *GUnhookFunctionsFunc )( const std::vector<ULONG64> & a_Addresses );
     static std::map< ULONG64, Function* > GSelectedFunctionsMap;
     static std::map< ULONG64, Function* > GVisibleFunctionsMap;
     static std::unordered_map< ULONG64, ULONG64 > GFunctionCountMap;
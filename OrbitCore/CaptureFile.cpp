@@ -0,0 +1,687 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "CaptureFile.h"
+#include "Lz4.h"
+#include "Varint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+static const char HeaderMagic[8]  = { 'O', 'R', 'B', 'I', 'T', 'C', 'A', 'P' };
+static const char TrailerMagic[8] = { 'O', 'R', 'B', 'I', 'T', 'I', 'D', 'X' };
+
+const uint32_t CaptureFileWriter::Version;
+const size_t   CaptureFileWriter::TimersPerChunk;
+
+//-----------------------------------------------------------------------------
+// Timer chunks are stored column by column, each column holding one member
+// of all the timers of the chunk.  Times and addresses are delta encoded and
+// written as zigzag varints, similar values end up next to each other which
+// is what the compressor is good at.
+//-----------------------------------------------------------------------------
+enum TimerColumn
+{
+    COLUMN_START,
+    COLUMN_DURATION,
+    COLUMN_DEPTH,
+    COLUMN_SESSION,
+    COLUMN_TYPE,
+    COLUMN_PROCESSOR,
+    COLUMN_FUNCTION,
+    COLUMN_CALLSTACK,
+    COLUMN_USER_DATA_0,
+    COLUMN_USER_DATA_1,
+    NUM_TIMER_COLUMNS
+};
+
+//-----------------------------------------------------------------------------
+void TimerChunkCodec::Encode( const Timer* a_Timers, size_t a_NumTimers, std::string & o_Data )
+{
+    std::string columns[NUM_TIMER_COLUMNS];
+    for( std::string & column : columns )
+    {
+        column.reserve( a_NumTimers*2 );
+    }
+
+    TickType lastStart = 0;
+    uint64_t lastFunction = 0;
+
+    for( size_t i = 0; i < a_NumTimers; ++i )
+    {
+        const Timer & timer = a_Timers[i];
+        WriteVarint( columns[COLUMN_START], ZigZag( (int64_t)( timer.m_Start - lastStart ) ) );
+        WriteVarint( columns[COLUMN_DURATION], ZigZag( (int64_t)( timer.m_End - timer.m_Start ) ) );
+        columns[COLUMN_DEPTH].push_back( (char)timer.m_Depth );
+        columns[COLUMN_SESSION].push_back( (char)timer.m_SessionID );
+        columns[COLUMN_TYPE].push_back( (char)timer.m_Type );
+        columns[COLUMN_PROCESSOR].push_back( (char)timer.m_Processor );
+        WriteVarint( columns[COLUMN_FUNCTION], ZigZag( (int64_t)( timer.m_FunctionAddress - lastFunction ) ) );
+        columns[COLUMN_CALLSTACK].append( (const char*)&timer.m_CallstackHash, sizeof( timer.m_CallstackHash ) );
+        WriteVarint( columns[COLUMN_USER_DATA_0], ZigZag( (int64_t)timer.m_UserData[0] ) );
+        WriteVarint( columns[COLUMN_USER_DATA_1], ZigZag( (int64_t)timer.m_UserData[1] ) );
+
+        lastStart = timer.m_Start;
+        lastFunction = timer.m_FunctionAddress;
+    }
+
+    uint32_t header[NUM_TIMER_COLUMNS + 1];
+    header[0] = NUM_TIMER_COLUMNS;
+    size_t totalSize = sizeof( header );
+    for( int i = 0; i < NUM_TIMER_COLUMNS; ++i )
+    {
+        header[i + 1] = (uint32_t)columns[i].size();
+        totalSize += columns[i].size();
+    }
+
+    o_Data.clear();
+    o_Data.reserve( totalSize );
+    o_Data.append( (const char*)header, sizeof( header ) );
+    for( const std::string & column : columns )
+    {
+        o_Data += column;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool TimerChunkCodec::Decode( const char* a_Data, size_t a_Size, const CaptureChunk & a_Chunk, std::vector<Timer> & o_Timers )
+{
+    uint32_t header[NUM_TIMER_COLUMNS + 1];
+    if( a_Size < sizeof( header ) )
+        return false;
+
+    memcpy( header, a_Data, sizeof( header ) );
+    if( header[0] != NUM_TIMER_COLUMNS )
+        return false;
+
+    const uint8_t* columns[NUM_TIMER_COLUMNS];
+    const uint8_t* columnEnds[NUM_TIMER_COLUMNS];
+    size_t offset = sizeof( header );
+    for( int i = 0; i < NUM_TIMER_COLUMNS; ++i )
+    {
+        if( header[i + 1] > a_Size - offset )
+            return false;
+        columns[i] = (const uint8_t*)a_Data + offset;
+        offset += header[i + 1];
+        columnEnds[i] = (const uint8_t*)a_Data + offset;
+    }
+
+    const size_t numTimers = (size_t)a_Chunk.m_NumItems;
+    if( header[COLUMN_DEPTH + 1] != numTimers || header[COLUMN_SESSION + 1] != numTimers ||
+        header[COLUMN_TYPE + 1] != numTimers || header[COLUMN_PROCESSOR + 1] != numTimers ||
+        header[COLUMN_CALLSTACK + 1] != numTimers*sizeof( uint64_t ) )
+    {
+        return false;
+    }
+
+    size_t first = o_Timers.size();
+    o_Timers.resize( first + numTimers );
+
+    TickType lastStart = 0;
+    uint64_t lastFunction = 0;
+    uint64_t value;
+
+    for( size_t i = 0; i < numTimers; ++i )
+    {
+        Timer & timer = o_Timers[first + i];
+        timer.m_TID = a_Chunk.m_ThreadId;
+
+        if( !ReadVarint( columns[COLUMN_START], columnEnds[COLUMN_START], value ) )
+            return false;
+        timer.m_Start = lastStart + UnZigZag( value );
+
+        if( !ReadVarint( columns[COLUMN_DURATION], columnEnds[COLUMN_DURATION], value ) )
+            return false;
+        timer.m_End = timer.m_Start + UnZigZag( value );
+
+        timer.m_Depth = columns[COLUMN_DEPTH][i];
+        timer.m_SessionID = columns[COLUMN_SESSION][i];
+        timer.m_Type = (Timer::Type)columns[COLUMN_TYPE][i];
+        timer.m_Processor = columns[COLUMN_PROCESSOR][i];
+
+        if( !ReadVarint( columns[COLUMN_FUNCTION], columnEnds[COLUMN_FUNCTION], value ) )
+            return false;
+        timer.m_FunctionAddress = lastFunction + UnZigZag( value );
+
+        memcpy( &timer.m_CallstackHash, columns[COLUMN_CALLSTACK] + i*sizeof( uint64_t ), sizeof( uint64_t ) );
+
+        if( !ReadVarint( columns[COLUMN_USER_DATA_0], columnEnds[COLUMN_USER_DATA_0], value ) )
+            return false;
+        timer.m_UserData[0] = UnZigZag( value );
+
+        if( !ReadVarint( columns[COLUMN_USER_DATA_1], columnEnds[COLUMN_USER_DATA_1], value ) )
+            return false;
+        timer.m_UserData[1] = UnZigZag( value );
+
+        lastStart = timer.m_Start;
+        lastFunction = timer.m_FunctionAddress;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+CaptureFileWriter::CaptureFileWriter()
+{
+}
+
+//-----------------------------------------------------------------------------
+CaptureFileWriter::~CaptureFileWriter()
+{
+    if( m_File.is_open() )
+    {
+        Close();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileWriter::Open( const std::string & a_FileName )
+{
+    m_File.open( a_FileName, std::ios::binary | std::ios::trunc );
+    if( m_File.fail() )
+        return false;
+
+    CaptureFileHeader header;
+    memcpy( header.m_Magic, HeaderMagic, sizeof( HeaderMagic ) );
+    header.m_Version = Version;
+    header.m_Reserved = 0;
+
+    m_File.write( (const char*)&header, sizeof( header ) );
+    m_Offset = sizeof( header );
+    m_Chunks.clear();
+    m_NumIndexedChunks = 0;
+    m_LastIndexOffset = 0;
+    m_LastIndexSize = 0;
+    return m_File.good();
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileWriter::Close()
+{
+    WriteIndex();
+
+    bool success = m_File.good();
+    m_File.close();
+    return success;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileWriter::Checkpoint()
+{
+    if( m_Chunks.size() == m_NumIndexedChunks )
+        return m_File.good();
+
+    WriteIndex();
+    m_File.flush();
+    return m_File.good();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::WriteIndex()
+{
+    // Each index segment lists the chunks written since the previous one,
+    // which it links to through an INDEX entry.  A file that is only closed
+    // has a single segment.
+    std::vector<CaptureChunk> segment;
+    if( m_NumIndexedChunks > 0 )
+    {
+        CaptureChunk link = {};
+        link.m_Type = CaptureChunk::INDEX;
+        link.m_Offset = m_LastIndexOffset;
+        link.m_NumItems = m_LastIndexSize;
+        segment.push_back( link );
+    }
+    segment.insert( segment.end(), m_Chunks.begin() + m_NumIndexedChunks, m_Chunks.end() );
+
+    CaptureFileTrailer trailer;
+    trailer.m_IndexOffset = m_Offset;
+    trailer.m_NumChunks = segment.size();
+    memcpy( trailer.m_Magic, TrailerMagic, sizeof( TrailerMagic ) );
+
+    m_File.write( (const char*)segment.data(), segment.size()*sizeof( CaptureChunk ) );
+    m_File.write( (const char*)&trailer, sizeof( trailer ) );
+    m_Offset += segment.size()*sizeof( CaptureChunk ) + sizeof( trailer );
+
+    m_LastIndexOffset = trailer.m_IndexOffset;
+    m_LastIndexSize = trailer.m_NumChunks;
+    m_NumIndexedChunks = m_Chunks.size();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::Compress( EncodedChunk & a_Chunk )
+{
+    const std::string & raw = a_Chunk.m_RawData;
+    a_Chunk.m_Compressed.resize( Lz4::CompressBound( raw.size() ) );
+    a_Chunk.m_CompressedSize = Lz4::Compress( raw.data(), raw.size(), a_Chunk.m_Compressed.data() );
+    a_Chunk.m_Chunk.m_RawSize = raw.size();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::Append( EncodedChunk & a_Chunk )
+{
+    // Incompressible chunks are stored as is, m_Size == m_RawSize.
+    const char* data = a_Chunk.m_Compressed.data();
+    size_t size = a_Chunk.m_CompressedSize;
+    if( size >= a_Chunk.m_RawData.size() )
+    {
+        size = a_Chunk.m_RawData.size();
+        data = a_Chunk.m_RawData.data();
+    }
+
+    a_Chunk.m_Chunk.m_Offset = m_Offset;
+    a_Chunk.m_Chunk.m_Size = size;
+
+    m_File.write( data, size );
+    m_Offset += size;
+    m_Chunks.push_back( a_Chunk.m_Chunk );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::WriteChunk( CaptureChunk & a_Chunk, const std::string & a_RawData )
+{
+    m_Scratch.m_Chunk = a_Chunk;
+    m_Scratch.m_RawData = a_RawData;
+    Compress( m_Scratch );
+    Append( m_Scratch );
+    a_Chunk = m_Scratch.m_Chunk;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::WriteMetadata( const std::string & a_Data )
+{
+    CaptureChunk chunk = {};
+    chunk.m_Type = CaptureChunk::METADATA;
+    chunk.m_NumItems = 1;
+    WriteChunk( chunk, a_Data );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::EncodeTimers( uint32_t a_ThreadId, const Timer* a_Timers, size_t a_NumTimers, EncodedChunk & o_Chunk )
+{
+    CaptureChunk & chunk = o_Chunk.m_Chunk;
+    chunk = CaptureChunk();
+    chunk.m_Type = CaptureChunk::TIMERS;
+    chunk.m_ThreadId = a_ThreadId;
+    chunk.m_NumItems = a_NumTimers;
+    chunk.m_MinTime = a_Timers[0].m_Start;
+    chunk.m_MaxTime = a_Timers[0].m_End;
+    for( size_t i = 0; i < a_NumTimers; ++i )
+    {
+        chunk.m_MinTime = std::min( chunk.m_MinTime, a_Timers[i].m_Start );
+        chunk.m_MaxTime = std::max( chunk.m_MaxTime, a_Timers[i].m_End );
+        chunk.m_MaxDepth = std::max( chunk.m_MaxDepth, (uint32_t)a_Timers[i].m_Depth );
+    }
+
+    TimerChunkCodec::Encode( a_Timers, a_NumTimers, o_Chunk.m_RawData );
+    Compress( o_Chunk );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileWriter::WriteTimers( uint32_t a_ThreadId, const Timer* a_Timers, size_t a_NumTimers )
+{
+    const size_t numChunks = ( a_NumTimers + TimersPerChunk - 1 ) / TimersPerChunk;
+    const size_t numWorkers = std::min<size_t>( numChunks, m_NumWorkers ? m_NumWorkers : std::thread::hardware_concurrency() );
+
+    if( numWorkers <= 1 )
+    {
+        for( size_t begin = 0; begin < a_NumTimers; begin += TimersPerChunk )
+        {
+            EncodeTimers( a_ThreadId, a_Timers + begin, std::min( TimersPerChunk, a_NumTimers - begin ), m_Scratch );
+            Append( m_Scratch );
+        }
+        return;
+    }
+
+    // Workers encode and compress chunks into a ring of slots while this
+    // thread appends them to the file in order.  The ring bounds the amount
+    // of encoded data in flight.
+    const size_t numSlots = 2*numWorkers;
+    std::vector<EncodedChunk> slots( numSlots );
+    std::vector<char> ready( numSlots, 0 );
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::atomic<size_t> nextChunk( 0 );
+    size_t numWritten = 0;
+
+    auto worker = [&]()
+    {
+        for( size_t i = nextChunk++; i < numChunks; i = nextChunk++ )
+        {
+            {
+                std::unique_lock<std::mutex> lock( mutex );
+                cond.wait( lock, [&](){ return i < numWritten + numSlots; } );
+            }
+
+            size_t begin = i*TimersPerChunk;
+            EncodeTimers( a_ThreadId, a_Timers + begin, std::min( TimersPerChunk, a_NumTimers - begin ), slots[i % numSlots] );
+
+            std::lock_guard<std::mutex> lock( mutex );
+            ready[i % numSlots] = 1;
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( size_t i = 0; i < numWorkers; ++i )
+    {
+        threads.emplace_back( worker );
+    }
+
+    for( size_t i = 0; i < numChunks; ++i )
+    {
+        size_t slot = i % numSlots;
+        {
+            std::unique_lock<std::mutex> lock( mutex );
+            cond.wait( lock, [&](){ return ready[slot] != 0; } );
+        }
+
+        Append( slots[slot] );
+
+        std::lock_guard<std::mutex> lock( mutex );
+        ready[slot] = 0;
+        numWritten = i + 1;
+        cond.notify_all();
+    }
+
+    for( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileReader::IsCaptureFile( const std::string & a_FileName )
+{
+    std::ifstream file( a_FileName, std::ios::binary );
+    char magic[sizeof( HeaderMagic )];
+    return file.read( magic, sizeof( magic ) ) && memcmp( magic, HeaderMagic, sizeof( magic ) ) == 0;
+}
+
+//-----------------------------------------------------------------------------
+static bool FitsBefore( uint64_t a_Offset, uint64_t a_Size, uint64_t a_End )
+{
+    // Offsets and sizes come from the file, the sum can overflow.
+    return a_Offset <= a_End && a_Size <= a_End - a_Offset;
+}
+
+//-----------------------------------------------------------------------------
+// Index entry of version 1 files, which had no max depth.
+struct CaptureChunkV1
+{
+    uint32_t m_Type;
+    uint32_t m_ThreadId;
+    uint64_t m_Offset;
+    uint64_t m_Size;
+    uint64_t m_RawSize;
+    uint64_t m_NumItems;
+    TickType m_MinTime;
+    TickType m_MaxTime;
+};
+
+//-----------------------------------------------------------------------------
+static uint64_t GetIndexEntrySize( uint32_t a_Version )
+{
+    return a_Version < 2 ? sizeof( CaptureChunkV1 ) : sizeof( CaptureChunk );
+}
+
+//-----------------------------------------------------------------------------
+static void ReadIndex( const char* a_Data, uint32_t a_Version, std::vector<CaptureChunk> & o_Chunks )
+{
+    if( a_Version >= 2 )
+    {
+        memcpy( o_Chunks.data(), a_Data, o_Chunks.size()*sizeof( CaptureChunk ) );
+        return;
+    }
+
+    for( size_t i = 0; i < o_Chunks.size(); ++i )
+    {
+        CaptureChunkV1 entry;
+        memcpy( &entry, a_Data + i*sizeof( entry ), sizeof( entry ) );
+
+        CaptureChunk & chunk = o_Chunks[i];
+        chunk = CaptureChunk();
+        chunk.m_Type = entry.m_Type;
+        chunk.m_ThreadId = entry.m_ThreadId;
+        chunk.m_Offset = entry.m_Offset;
+        chunk.m_Size = entry.m_Size;
+        chunk.m_RawSize = entry.m_RawSize;
+        chunk.m_NumItems = entry.m_NumItems;
+        chunk.m_MinTime = entry.m_MinTime;
+        chunk.m_MaxTime = entry.m_MaxTime;
+    }
+}
+
+//-----------------------------------------------------------------------------
+static bool IsValidTrailer( const CaptureFileTrailer & a_Trailer, uint64_t a_TrailerOffset, uint64_t a_EntrySize )
+{
+    return memcmp( a_Trailer.m_Magic, TrailerMagic, sizeof( TrailerMagic ) ) == 0 &&
+           a_Trailer.m_IndexOffset >= sizeof( CaptureFileHeader ) &&
+           a_Trailer.m_NumChunks <= a_TrailerOffset / a_EntrySize &&
+           FitsBefore( a_Trailer.m_IndexOffset, a_Trailer.m_NumChunks*a_EntrySize, a_TrailerOffset ) &&
+           a_Trailer.m_IndexOffset + a_Trailer.m_NumChunks*a_EntrySize == a_TrailerOffset;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileReader::FindTrailer( CaptureFileTrailer & o_Trailer, uint64_t & o_TrailerOffset ) const
+{
+    const uint64_t entrySize = GetIndexEntrySize( m_Version );
+    const char* data = m_File.GetData();
+    const uint64_t fileSize = m_File.GetSize();
+
+    o_TrailerOffset = fileSize - sizeof( CaptureFileTrailer );
+    memcpy( &o_Trailer, data + o_TrailerOffset, sizeof( o_Trailer ) );
+    if( IsValidTrailer( o_Trailer, o_TrailerOffset, entrySize ) )
+        return true;
+
+    // The file was not closed, a streamed capture that was interrupted.  Use
+    // the last index checkpoint, chunks written after it are lost.
+    const uint64_t magicOffset = offsetof( CaptureFileTrailer, m_Magic );
+    for( uint64_t offset = o_TrailerOffset; offset > sizeof( CaptureFileHeader ); --offset )
+    {
+        if( data[offset + magicOffset] == TrailerMagic[0] &&
+            memcmp( data + offset + magicOffset, TrailerMagic, sizeof( TrailerMagic ) ) == 0 )
+        {
+            memcpy( &o_Trailer, data + offset, sizeof( o_Trailer ) );
+            if( IsValidTrailer( o_Trailer, offset, entrySize ) )
+            {
+                o_TrailerOffset = offset;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileReader::Open( const std::string & a_FileName )
+{
+    m_Chunks.clear();
+    if( !m_File.Open( a_FileName ) )
+        return false;
+
+    const char* data = m_File.GetData();
+    const uint64_t fileSize = m_File.GetSize();
+
+    CaptureFileHeader header;
+    CaptureFileTrailer trailer;
+    uint64_t trailerOffset = 0;
+    if( fileSize < sizeof( header ) + sizeof( trailer ) )
+    {
+        Close();
+        return false;
+    }
+
+    memcpy( &header, data, sizeof( header ) );
+    m_Version = header.m_Version;
+    if( memcmp( header.m_Magic, HeaderMagic, sizeof( HeaderMagic ) ) != 0 ||
+        header.m_Version < 1 || header.m_Version > CaptureFileWriter::Version ||
+        !FindTrailer( trailer, trailerOffset ) )
+    {
+        Close();
+        return false;
+    }
+
+    // Walk index segments from the last one, each one precedes the next in
+    // the file.
+    const uint64_t entrySize = GetIndexEntrySize( m_Version );
+    std::vector< std::vector<CaptureChunk> > segments;
+    uint64_t indexOffset = trailer.m_IndexOffset;
+    uint64_t indexSize = trailer.m_NumChunks;
+    uint64_t indexEnd = trailerOffset;
+    bool valid = true;
+    while( valid )
+    {
+        segments.emplace_back( (size_t)indexSize );
+        std::vector<CaptureChunk> & segment = segments.back();
+        ReadIndex( data + indexOffset, m_Version, segment );
+
+        if( segment.empty() || segment[0].m_Type != CaptureChunk::INDEX )
+            break;
+
+        indexEnd = indexOffset;
+        indexOffset = segment[0].m_Offset;
+        indexSize = segment[0].m_NumItems;
+        segment.erase( segment.begin() );
+        valid = indexOffset >= sizeof( header ) && indexSize <= indexEnd / entrySize &&
+                FitsBefore( indexOffset, indexSize*entrySize, indexEnd );
+    }
+
+    for( auto it = segments.rbegin(); it != segments.rend(); ++it )
+    {
+        m_Chunks.insert( m_Chunks.end(), it->begin(), it->end() );
+    }
+
+    for( const CaptureChunk & chunk : m_Chunks )
+    {
+        if( !FitsBefore( chunk.m_Offset, chunk.m_Size, trailerOffset ) || chunk.m_Size > chunk.m_RawSize || chunk.m_Type == CaptureChunk::INDEX )
+        {
+            valid = false;
+        }
+    }
+
+    if( !valid )
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileReader::Close()
+{
+    m_Chunks.clear();
+    m_File.Close();
+}
+
+//-----------------------------------------------------------------------------
+const CaptureChunk* CaptureFileReader::FindChunk( CaptureChunk::Type a_Type ) const
+{
+    for( const CaptureChunk & chunk : m_Chunks )
+    {
+        if( chunk.m_Type == a_Type )
+            return &chunk;
+    }
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileReader::ReadChunk( const CaptureChunk & a_Chunk, std::string & o_RawData ) const
+{
+    const char* data = m_File.GetData() + a_Chunk.m_Offset;
+    o_RawData.resize( (size_t)a_Chunk.m_RawSize );
+    if( o_RawData.empty() )
+        return true;
+
+    if( a_Chunk.m_Size == a_Chunk.m_RawSize )
+    {
+        memcpy( &o_RawData[0], data, o_RawData.size() );
+        return true;
+    }
+
+    return Lz4::Decompress( data, (size_t)a_Chunk.m_Size, &o_RawData[0], o_RawData.size() );
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileReader::ReadTimers( const CaptureChunk & a_Chunk, std::vector<Timer> & o_Timers ) const
+{
+    thread_local std::string rawData;
+    return a_Chunk.m_Type == CaptureChunk::TIMERS &&
+           ReadChunk( a_Chunk, rawData ) &&
+           TimerChunkCodec::Decode( rawData.data(), rawData.size(), a_Chunk, o_Timers );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureFileReader::ReleaseChunk( const CaptureChunk & a_Chunk ) const
+{
+    m_File.Release( a_Chunk.m_Offset, a_Chunk.m_Size );
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureFileReader::ReadTimersParallel( const TimersCallback & a_Callback, uint32_t a_NumWorkers ) const
+{
+    // Chunks of a thread are handed to the same worker, in file order.
+    std::map<uint32_t, std::vector<const CaptureChunk*>> threadChunks;
+    for( const CaptureChunk & chunk : m_Chunks )
+    {
+        if( chunk.m_Type == CaptureChunk::TIMERS )
+        {
+            threadChunks[chunk.m_ThreadId].push_back( &chunk );
+        }
+    }
+
+    // Biggest threads first so that they don't end up last on a busy worker.
+    std::vector<const std::vector<const CaptureChunk*>*> jobs;
+    for( auto & pair : threadChunks )
+    {
+        jobs.push_back( &pair.second );
+    }
+    std::sort( jobs.begin(), jobs.end(), []( const std::vector<const CaptureChunk*>* a, const std::vector<const CaptureChunk*>* b ){ return a->size() > b->size(); } );
+
+    uint32_t numWorkers = a_NumWorkers ? a_NumWorkers : std::thread::hardware_concurrency();
+    numWorkers = std::max<uint32_t>( 1, std::min<uint32_t>( numWorkers, (uint32_t)jobs.size() ) );
+
+    std::atomic<size_t> nextJob( 0 );
+    std::atomic<bool> success( true );
+
+    auto worker = [&]( uint32_t a_Worker )
+    {
+        std::vector<Timer> timers;
+        for( size_t i = nextJob++; i < jobs.size() && success; i = nextJob++ )
+        {
+            for( const CaptureChunk* chunk : *jobs[i] )
+            {
+                timers.clear();
+                if( !ReadTimers( *chunk, timers ) )
+                {
+                    success = false;
+                    return;
+                }
+
+                a_Callback( *chunk, timers, a_Worker );
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( uint32_t i = 1; i < numWorkers; ++i )
+    {
+        threads.emplace_back( worker, i );
+    }
+    worker( 0 );
+
+    for( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+
+    return success;
+}
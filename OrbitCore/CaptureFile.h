@@ -0,0 +1,169 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "ScopeTimer.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Capture file layout:
+//
+//   CaptureFileHeader
+//   chunk data...           each chunk compressed independently
+//   CaptureChunk[]          index of all chunks
+//   CaptureFileTrailer      locates the index, last bytes of the file
+//
+// Streamed captures interleave chunk data with index checkpoints, each one
+// linking to the previous one.  If the file is not closed properly it is
+// read up to its last checkpoint.
+//
+// Timers are stored in per-thread, time ordered chunks so that any time
+// range of any thread can be decoded without touching the rest of the file.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+struct CaptureFileHeader
+{
+    char     m_Magic[8];
+    uint32_t m_Version;
+    uint32_t m_Reserved;
+};
+
+//-----------------------------------------------------------------------------
+struct CaptureChunk
+{
+    enum Type : uint32_t
+    {
+        METADATA,   // cereal archive of everything but the timers
+        TIMERS,
+        INDEX,      // previous index segment, see CaptureFileWriter::Checkpoint
+        CALLSTACKS, // callstack definitions of a streamed capture
+        SAMPLES     // sampled callstack events of a streamed capture
+    };
+
+    uint32_t m_Type;
+    uint32_t m_ThreadId;
+    uint32_t m_MaxDepth;
+    uint32_t m_Reserved;
+    uint64_t m_Offset;
+    uint64_t m_Size;     // compressed
+    uint64_t m_RawSize;
+    uint64_t m_NumItems;
+    TickType m_MinTime;
+    TickType m_MaxTime;
+};
+
+//-----------------------------------------------------------------------------
+struct CaptureFileTrailer
+{
+    uint64_t m_IndexOffset;
+    uint64_t m_NumChunks;
+    char     m_Magic[8];
+};
+
+//-----------------------------------------------------------------------------
+class TimerChunkCodec
+{
+public:
+    // a_Timers must all belong to the same thread.  They compress best sorted by
+    // start time but any order round trips.
+    static void Encode( const Timer* a_Timers, size_t a_NumTimers, std::string & o_Data );
+    static bool Decode( const char* a_Data, size_t a_Size, const CaptureChunk & a_Chunk, std::vector<Timer> & o_Timers );
+};
+
+//-----------------------------------------------------------------------------
+class CaptureFileWriter
+{
+public:
+    CaptureFileWriter();
+    ~CaptureFileWriter();
+
+    bool Open( const std::string & a_FileName );
+    bool Close();
+
+    // Makes everything written so far readable even if Close is never called.
+    // Only the chunks written since the previous checkpoint are indexed.
+    bool Checkpoint();
+
+    // Number of threads encoding timer chunks, 0 uses all cores.
+    void SetNumWorkers( uint32_t a_NumWorkers ) { m_NumWorkers = a_NumWorkers; }
+
+    void WriteMetadata( const std::string & a_Data );
+    // Splits a_Timers in chunks of TimersPerChunk, encoded and compressed in
+    // parallel and appended in order.
+    void WriteTimers( uint32_t a_ThreadId, const Timer* a_Timers, size_t a_NumTimers );
+    void WriteChunk( CaptureChunk & a_Chunk, const std::string & a_RawData );
+
+    uint64_t GetSize() const { return m_Offset; }
+
+    static const uint32_t Version = 3;
+    static const size_t   TimersPerChunk = 64*1024;
+
+protected:
+    struct EncodedChunk
+    {
+        CaptureChunk      m_Chunk;
+        std::string       m_RawData;
+        std::vector<char> m_Compressed;
+        size_t            m_CompressedSize = 0;
+    };
+
+    static void EncodeTimers( uint32_t a_ThreadId, const Timer* a_Timers, size_t a_NumTimers, EncodedChunk & o_Chunk );
+    static void Compress( EncodedChunk & a_Chunk );
+    void Append( EncodedChunk & a_Chunk );
+    void WriteIndex();
+
+protected:
+    std::ofstream             m_File;
+    std::vector<CaptureChunk> m_Chunks;
+    uint64_t                  m_Offset = 0;
+    uint32_t                  m_NumWorkers = 0;
+    EncodedChunk              m_Scratch;
+    size_t                    m_NumIndexedChunks = 0;
+    uint64_t                  m_LastIndexOffset = 0;
+    uint64_t                  m_LastIndexSize = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Maps the capture file and only reads the chunk index up front, chunks are
+// decompressed straight from the mapping when requested.  Reading chunks is
+// thread safe.
+//-----------------------------------------------------------------------------
+class CaptureFileReader
+{
+public:
+    bool Open( const std::string & a_FileName );
+    void Close();
+
+    const std::vector<CaptureChunk> & GetChunks() const { return m_Chunks; }
+    const CaptureChunk* FindChunk( CaptureChunk::Type a_Type ) const;
+
+    // Version 1 chunks have no max depth, they can't be drawn before decoding.
+    uint32_t GetVersion() const { return m_Version; }
+
+    bool ReadChunk( const CaptureChunk & a_Chunk, std::string & o_RawData ) const;
+    bool ReadTimers( const CaptureChunk & a_Chunk, std::vector<Timer> & o_Timers ) const;
+
+    // Decodes all timer chunks on a_NumWorkers threads (0 uses all cores).
+    // The chunks of a thread are decoded in order by the same worker, so the
+    // callback is never called concurrently for the same thread id.
+    typedef std::function<void( const CaptureChunk & a_Chunk, const std::vector<Timer> & a_Timers, uint32_t a_Worker )> TimersCallback;
+    bool ReadTimersParallel( const TimersCallback & a_Callback, uint32_t a_NumWorkers = 0 ) const;
+    void ReleaseChunk( const CaptureChunk & a_Chunk ) const;
+
+    static bool IsCaptureFile( const std::string & a_FileName );
+
+protected:
+    bool FindTrailer( CaptureFileTrailer & o_Trailer, uint64_t & o_TrailerOffset ) const;
+
+protected:
+    MappedFile                m_File;
+    std::vector<CaptureChunk> m_Chunks;
+    uint32_t                  m_Version = 0;
+};
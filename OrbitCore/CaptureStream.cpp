@@ -0,0 +1,408 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "Core.h"
+#include "CaptureStream.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+
+CaptureStream GCaptureStream;
+
+const uint32_t CaptureStream::CheckpointIntervalMs;
+const size_t   CaptureStream::CallstackBatchSize;
+const size_t   CaptureStream::SampleBatchSize;
+
+//-----------------------------------------------------------------------------
+template< class T >
+inline void AppendValue( std::string & a_Data, const T & a_Value )
+{
+    a_Data.append( (const char*)&a_Value, sizeof( T ) );
+}
+
+//-----------------------------------------------------------------------------
+template< class T >
+inline bool ReadValue( const char* & a_Data, const char* a_End, T & o_Value )
+{
+    if( a_End - a_Data < (ptrdiff_t)sizeof( T ) )
+        return false;
+    memcpy( &o_Value, a_Data, sizeof( T ) );
+    a_Data += sizeof( T );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+CaptureStream::CaptureStream() : m_IsOpen( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+CaptureStream::~CaptureStream()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureStream::Open( const std::string & a_FileName )
+{
+    Close();
+
+    ScopeLock lock( m_Mutex );
+    if( !m_Writer.Open( a_FileName ) )
+    {
+        ORBIT_LOG( Format( "Could not open %s for streaming", a_FileName.c_str() ) );
+        return false;
+    }
+
+    // Leave the cores to the capture, chunks are compressed as they come.
+    m_Writer.SetNumWorkers( 1 );
+    m_FileName = a_FileName;
+    m_ExitRequested = false;
+    m_IsOpen = true;
+    m_WriterThread = std::thread( &CaptureStream::WriterThread, this );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::Close( const std::string & a_Metadata )
+{
+    {
+        ScopeLock lock( m_Mutex );
+        if( !m_IsOpen )
+            return;
+
+        m_IsOpen = false;
+        m_ExitRequested = true;
+    }
+
+    m_WriterCondition.notify_one();
+    if( m_WriterThread.joinable() )
+    {
+        m_WriterThread.join();
+    }
+
+    {
+        // Producers are out, whatever is left is written from here.
+        ScopeLock lock( m_Mutex );
+        QueueAll();
+        WritePending();
+        if( !a_Metadata.empty() )
+        {
+            m_Writer.WriteMetadata( a_Metadata );
+        }
+        m_Writer.Close();
+
+        m_ThreadTimers.clear();
+        m_WrittenCallstacks.clear();
+    }
+
+    NotifyCheckpoint();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::SetCheckpointCallback( const CheckpointCallback & a_Callback )
+{
+    ScopeLock lock( m_Mutex );
+    m_CheckpointCallback = a_Callback;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::NotifyCheckpoint()
+{
+    CheckpointCallback callback;
+    std::string fileName;
+    {
+        ScopeLock lock( m_Mutex );
+        callback = m_CheckpointCallback;
+        fileName = m_FileName;
+    }
+
+    if( !callback )
+        return;
+
+    std::shared_ptr<CaptureFileReader> reader = std::make_shared<CaptureFileReader>();
+    if( reader->Open( fileName ) )
+    {
+        callback( reader );
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::string CaptureStream::GetFileName() const
+{
+    ScopeLock lock( m_Mutex );
+    return m_FileName;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::AddTimer( const Timer & a_Timer )
+{
+    // Same timers as a saved capture, the ones that end up in thread tracks.
+    switch( a_Timer.m_Type )
+    {
+    case Timer::ALLOC:
+    case Timer::FREE:
+    case Timer::CORE_ACTIVITY:
+    case Timer::THREAD_ACTIVITY:
+        return;
+    default:
+        break;
+    }
+
+    if( !m_IsOpen )
+        return;
+
+    ScopeLock lock( m_Mutex );
+    if( !m_IsOpen )
+        return;
+
+    std::vector<Timer> & timers = m_ThreadTimers[a_Timer.m_TID];
+    timers.push_back( a_Timer );
+    if( timers.size() >= CaptureFileWriter::TimersPerChunk )
+    {
+        QueueThread( a_Timer.m_TID, timers );
+        m_WriterCondition.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::AddCallstack( const CallStack & a_CallStack )
+{
+    if( !m_IsOpen )
+        return;
+
+    ScopeLock lock( m_Mutex );
+    if( m_IsOpen )
+    {
+        AddCallstackLocked( a_CallStack );
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::AddSample( long long a_Time, const CallStack & a_CallStack )
+{
+    if( !m_IsOpen )
+        return;
+
+    ScopeLock lock( m_Mutex );
+    if( !m_IsOpen )
+        return;
+
+    AddCallstackLocked( a_CallStack );
+    m_Samples.push_back( CallstackEvent( a_Time, a_CallStack.m_Hash, a_CallStack.m_ThreadId ) );
+    if( m_Samples.size() >= SampleBatchSize )
+    {
+        QueueSamples();
+        m_WriterCondition.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::AddCallstackLocked( const CallStack & a_CallStack )
+{
+    if( !m_WrittenCallstacks.insert( a_CallStack.m_Hash ).second )
+        return;
+
+    uint32_t depth = (uint32_t)a_CallStack.m_Depth;
+    AppendValue( m_Callstacks, a_CallStack.m_Hash );
+    AppendValue( m_Callstacks, a_CallStack.m_ThreadId );
+    AppendValue( m_Callstacks, depth );
+    m_Callstacks.append( (const char*)a_CallStack.m_Data.data(), depth*sizeof( DWORD64 ) );
+    ++m_NumCallstacks;
+
+    if( m_Callstacks.size() >= CallstackBatchSize )
+    {
+        QueueCallstacks();
+        m_WriterCondition.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::QueueThread( ThreadID a_TID, std::vector<Timer> & a_Timers )
+{
+    if( a_Timers.empty() )
+        return;
+
+    m_PendingTimers.push_back( PendingTimers() );
+    m_PendingTimers.back().m_TID = a_TID;
+    m_PendingTimers.back().m_Timers.swap( a_Timers );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::QueueCallstacks()
+{
+    if( m_NumCallstacks == 0 )
+        return;
+
+    m_PendingCallstacks.push_back( PendingCallstacks() );
+    m_PendingCallstacks.back().m_Data.swap( m_Callstacks );
+    m_PendingCallstacks.back().m_NumCallstacks = m_NumCallstacks;
+    m_NumCallstacks = 0;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::QueueSamples()
+{
+    if( m_Samples.empty() )
+        return;
+
+    m_PendingSamples.push_back( std::vector<CallstackEvent>() );
+    m_PendingSamples.back().swap( m_Samples );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::QueueAll()
+{
+    for( auto & pair : m_ThreadTimers )
+    {
+        QueueThread( pair.first, pair.second );
+    }
+
+    QueueCallstacks();
+    QueueSamples();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::WriterThread()
+{
+    SetCurrentThreadName( L"CaptureStream" );
+
+    // Checkpoints are driven by the clock, not by the amount of data, so a
+    // quiet capture is just as durable as a busy one.
+    Timer lastCheckpoint;
+    lastCheckpoint.Start();
+
+    UniqueLock lock( m_Mutex );
+    while( !m_ExitRequested )
+    {
+        uint32_t elapsedMs = (uint32_t)lastCheckpoint.QueryMillis();
+        uint32_t waitMs = elapsedMs < CheckpointIntervalMs ? CheckpointIntervalMs - elapsedMs : 0;
+        m_WriterCondition.wait_for( lock, std::chrono::milliseconds( waitMs ), [this]()
+        {
+            return m_ExitRequested || !m_PendingTimers.empty() || !m_PendingCallstacks.empty() || !m_PendingSamples.empty();
+        } );
+
+        if( m_ExitRequested )
+            break;
+
+        bool checkpoint = lastCheckpoint.QueryMillis() >= CheckpointIntervalMs;
+        if( checkpoint )
+        {
+            QueueAll();
+        }
+
+        WritePending();
+
+        if( checkpoint )
+        {
+            lock.unlock();
+            m_Writer.Checkpoint();
+            NotifyCheckpoint();
+            lock.lock();
+            lastCheckpoint.Start();
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CaptureStream::WritePending()
+{
+    // Called with m_Mutex held, released while compressing and writing.
+    std::vector< PendingTimers > timers;
+    std::vector< PendingCallstacks > callstacks;
+    std::vector< std::vector<CallstackEvent> > samples;
+    timers.swap( m_PendingTimers );
+    callstacks.swap( m_PendingCallstacks );
+    samples.swap( m_PendingSamples );
+
+    if( timers.empty() && callstacks.empty() && samples.empty() )
+        return;
+
+    m_Mutex.unlock();
+
+    for( PendingTimers & pending : timers )
+    {
+        m_Writer.WriteTimers( pending.m_TID, pending.m_Timers.data(), pending.m_Timers.size() );
+    }
+
+    for( PendingCallstacks & pending : callstacks )
+    {
+        CaptureChunk chunk = {};
+        chunk.m_Type = CaptureChunk::CALLSTACKS;
+        chunk.m_NumItems = pending.m_NumCallstacks;
+        m_Writer.WriteChunk( chunk, pending.m_Data );
+    }
+
+    for( std::vector<CallstackEvent> & pending : samples )
+    {
+        CaptureChunk chunk = {};
+        chunk.m_Type = CaptureChunk::SAMPLES;
+        chunk.m_NumItems = pending.size();
+        chunk.m_MinTime = pending[0].m_Time;
+        chunk.m_MaxTime = pending[0].m_Time;
+
+        std::string data;
+        data.reserve( pending.size()*( sizeof( long long ) + sizeof( CallstackID ) + sizeof( ThreadID ) ) );
+        for( const CallstackEvent & sample : pending )
+        {
+            AppendValue( data, sample.m_Time );
+            AppendValue( data, sample.m_Id );
+            AppendValue( data, sample.m_TID );
+            chunk.m_MinTime = std::min( chunk.m_MinTime, (TickType)sample.m_Time );
+            chunk.m_MaxTime = std::max( chunk.m_MaxTime, (TickType)sample.m_Time );
+        }
+
+        m_Writer.WriteChunk( chunk, data );
+    }
+
+    m_Mutex.lock();
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureStream::DecodeCallstacks( const std::string & a_Data, std::vector<CallStack> & o_CallStacks )
+{
+    const char* data = a_Data.data();
+    const char* end = data + a_Data.size();
+    while( data < end )
+    {
+        CallStack callstack;
+        uint32_t depth = 0;
+        if( !ReadValue( data, end, callstack.m_Hash ) ||
+            !ReadValue( data, end, callstack.m_ThreadId ) ||
+            !ReadValue( data, end, depth ) ||
+            (size_t)( end - data ) < depth*sizeof( DWORD64 ) )
+        {
+            return false;
+        }
+
+        callstack.m_Depth = (int)depth;
+        callstack.m_Data.resize( depth );
+        memcpy( callstack.m_Data.data(), data, depth*sizeof( DWORD64 ) );
+        data += depth*sizeof( DWORD64 );
+        o_CallStacks.push_back( callstack );
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool CaptureStream::DecodeSamples( const std::string & a_Data, std::vector<CallstackEvent> & o_Samples )
+{
+    const char* data = a_Data.data();
+    const char* end = data + a_Data.size();
+    while( data < end )
+    {
+        CallstackEvent sample;
+        if( !ReadValue( data, end, sample.m_Time ) ||
+            !ReadValue( data, end, sample.m_Id ) ||
+            !ReadValue( data, end, sample.m_TID ) )
+        {
+            return false;
+        }
+        o_Samples.push_back( sample );
+    }
+
+    return true;
+}
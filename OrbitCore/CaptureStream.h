@@ -0,0 +1,101 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "CaptureFile.h"
+#include "Callstack.h"
+#include "EventBuffer.h"
+#include "Threading.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Appends capture data to a capture file while recording so that nothing is
+// lost if Orbit goes down mid-capture.  Timers are buffered per thread and
+// written a chunk at a time, callstack definitions and samples in batches.
+// Full batches are compressed and written by a writer thread, which also
+// checkpoints the index every CheckpointIntervalMs.  An interrupted file
+// opens up to its last checkpoint.  Metadata is only written on Close.
+//-----------------------------------------------------------------------------
+class CaptureStream
+{
+public:
+    CaptureStream();
+    ~CaptureStream();
+
+    bool Open( const std::string & a_FileName );
+    // a_Metadata is the cereal archive CaptureSerializer would save, if any.
+    void Close( const std::string & a_Metadata = std::string() );
+    bool IsOpen() const { return m_IsOpen; }
+    std::string GetFileName() const;
+
+    // Called from the writer thread with the file as of each checkpoint, and
+    // once more when the stream is closed.
+    typedef std::function< void( const std::shared_ptr<CaptureFileReader> & a_Reader ) > CheckpointCallback;
+    void SetCheckpointCallback( const CheckpointCallback & a_Callback );
+
+    void AddTimer( const Timer & a_Timer );
+    void AddCallstack( const CallStack & a_CallStack );
+    void AddSample( long long a_Time, const CallStack & a_CallStack );
+
+    static bool DecodeCallstacks( const std::string & a_Data, std::vector<CallStack> & o_CallStacks );
+    static bool DecodeSamples( const std::string & a_Data, std::vector<CallstackEvent> & o_Samples );
+
+    static const uint32_t CheckpointIntervalMs = 2000;
+    static const size_t   CallstackBatchSize = 1024*1024;
+    static const size_t   SampleBatchSize = 64*1024;
+
+protected:
+    struct PendingTimers
+    {
+        ThreadID           m_TID;
+        std::vector<Timer> m_Timers;
+    };
+
+    struct PendingCallstacks
+    {
+        std::string m_Data;
+        uint32_t    m_NumCallstacks;
+    };
+
+    void AddCallstackLocked( const CallStack & a_CallStack );
+    void QueueThread( ThreadID a_TID, std::vector<Timer> & a_Timers );
+    void QueueCallstacks();
+    void QueueSamples();
+    void QueueAll();
+    void WriterThread();
+    void WritePending();
+    void NotifyCheckpoint();
+
+protected:
+    std::atomic<bool>                                  m_IsOpen;
+    mutable Mutex                                      m_Mutex;
+    std::condition_variable_any                        m_WriterCondition;
+    std::thread                                        m_WriterThread;
+    bool                                               m_ExitRequested = false;
+    CaptureFileWriter                                  m_Writer;  // writer thread only while open
+    std::string                                        m_FileName;
+    CheckpointCallback                                 m_CheckpointCallback;
+    std::unordered_map< ThreadID, std::vector<Timer> > m_ThreadTimers;
+    std::unordered_set< CallstackID >                  m_WrittenCallstacks;
+    std::string                                        m_Callstacks;
+    uint32_t                                           m_NumCallstacks = 0;
+    std::vector< CallstackEvent >                      m_Samples;
+
+    // Full batches handed to the writer thread.
+    std::vector< PendingTimers >                       m_PendingTimers;
+    std::vector< PendingCallstacks >                   m_PendingCallstacks;
+    std::vector< std::vector<CallstackEvent> >         m_PendingSamples;
+};
+
+extern CaptureStream GCaptureStream;
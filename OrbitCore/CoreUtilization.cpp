@@ -0,0 +1,129 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "CoreUtilization.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+void CoreUtilization::Clear()
+{
+    // Timelines are kept alive, other threads may hold on to them.
+    ScopeLock lock( m_Mutex );
+    for( auto & timeline : m_Cores )
+    {
+        ScopeLock timelineLock( timeline->m_Mutex );
+        timeline->m_Intervals.clear();
+        timeline->m_HasIn = false;
+    }
+    m_MinTime = LLONG_MAX;
+    m_MaxTime = 0;
+    m_NumIntervals = 0;
+}
+
+//-----------------------------------------------------------------------------
+CoreUtilization::CoreTimeline & CoreUtilization::GetCore( uint32_t a_Core )
+{
+    ScopeLock lock( m_Mutex );
+    while( m_Cores.size() <= a_Core )
+    {
+        m_Cores.push_back( std::unique_ptr<CoreTimeline>( new CoreTimeline() ) );
+    }
+    return *m_Cores[a_Core];
+}
+
+//-----------------------------------------------------------------------------
+uint32_t CoreUtilization::GetNumCores() const
+{
+    ScopeLock lock( m_Mutex );
+    return (uint32_t)m_Cores.size();
+}
+
+//-----------------------------------------------------------------------------
+void CoreUtilization::Add( const ContextSwitch & a_CS )
+{
+    CoreTimeline & timeline = GetCore( a_CS.m_ProcessorIndex );
+    ScopeLock lock( timeline.m_Mutex );
+
+    if( a_CS.m_Type == ContextSwitch::In )
+    {
+        timeline.m_InTime = a_CS.m_Time;
+        timeline.m_InThread = a_CS.m_ThreadId;
+        timeline.m_HasIn = true;
+    }
+    else if( a_CS.m_Type == ContextSwitch::Out && timeline.m_HasIn )
+    {
+        if( a_CS.m_Time >= (long long)timeline.m_InTime )
+        {
+            Interval interval = { timeline.m_InTime, (TickType)a_CS.m_Time, (ThreadID)a_CS.m_ThreadId };
+            Insert( timeline, interval );
+        }
+        timeline.m_HasIn = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CoreUtilization::AddInterval( uint32_t a_Core, TickType a_Start, TickType a_End, ThreadID a_TID )
+{
+    CoreTimeline & timeline = GetCore( a_Core );
+    ScopeLock lock( timeline.m_Mutex );
+    Interval interval = { a_Start, a_End, a_TID };
+    Insert( timeline, interval );
+}
+
+//-----------------------------------------------------------------------------
+void CoreUtilization::Insert( CoreTimeline & a_Timeline, const Interval & a_Interval )
+{
+    std::vector<Interval> & intervals = a_Timeline.m_Intervals;
+    if( intervals.empty() || intervals.back().m_Start <= a_Interval.m_Start )
+    {
+        intervals.push_back( a_Interval );
+    }
+    else
+    {
+        // Rare, e.g. intervals of a loaded capture in arbitrary order.
+        auto it = std::upper_bound( intervals.begin(), intervals.end(), a_Interval,
+                                    []( const Interval & a, const Interval & b ){ return a.m_Start < b.m_Start; } );
+        intervals.insert( it, a_Interval );
+    }
+
+    ++m_NumIntervals;
+
+    // Cores insert concurrently, only their own timeline lock is held.
+    TickType minTime = m_MinTime;
+    while( a_Interval.m_Start < minTime && !m_MinTime.compare_exchange_weak( minTime, a_Interval.m_Start ) ) {}
+    TickType maxTime = m_MaxTime;
+    while( a_Interval.m_End > maxTime && !m_MaxTime.compare_exchange_weak( maxTime, a_Interval.m_End ) ) {}
+}
+
+//-----------------------------------------------------------------------------
+void CoreUtilization::ForEachInterval( uint32_t a_Core, TickType a_Min, TickType a_Max, const std::function<void(const Interval&)> & a_Callback ) const
+{
+    const CoreTimeline* timeline = nullptr;
+    {
+        ScopeLock lock( m_Mutex );
+        if( a_Core >= m_Cores.size() )
+            return;
+        timeline = m_Cores[a_Core].get();
+    }
+
+    // Copy the range so that the core's context switches aren't held up by
+    // the callback.
+    std::vector<Interval> visible;
+    {
+        ScopeLock lock( timeline->m_Mutex );
+        const std::vector<Interval> & intervals = timeline->m_Intervals;
+
+        // Intervals of a core don't overlap, their ends are sorted as well.
+        auto begin = std::lower_bound( intervals.begin(), intervals.end(), a_Min,
+                                       []( const Interval & a, TickType b ){ return a.m_End < b; } );
+        auto end = std::upper_bound( begin, intervals.end(), a_Max,
+                                     []( TickType a, const Interval & b ){ return a < b.m_Start; } );
+        visible.assign( begin, end );
+    }
+
+    for( const Interval & interval : visible )
+    {
+        a_Callback( interval );
+    }
+}
@@ -0,0 +1,62 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "Core.h"
+#include "CallstackTypes.h"
+#include "ContextSwitch.h"
+#include "ScopeTimer.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Per core timelines of which thread was running when, built directly from
+// context switches. Switches of a core arrive in time order, so intervals
+// are appended and range queries are binary searches.
+class CoreUtilization
+{
+public:
+    struct Interval
+    {
+        TickType m_Start;
+        TickType m_End;
+        ThreadID m_TID;
+    };
+
+    CoreUtilization() : m_MinTime( LLONG_MAX ), m_MaxTime( 0 ), m_NumIntervals( 0 ) {}
+
+    void Clear();
+    void Add( const ContextSwitch & a_CS );
+    void AddInterval( uint32_t a_Core, TickType a_Start, TickType a_End, ThreadID a_TID );
+
+    // Calls a_Callback on the intervals of a_Core overlapping [a_Min, a_Max].
+    void ForEachInterval( uint32_t a_Core, TickType a_Min, TickType a_Max, const std::function<void(const Interval&)> & a_Callback ) const;
+
+    uint32_t GetNumCores() const;
+    uint64_t GetNumIntervals() const { return m_NumIntervals; }
+    bool     IsEmpty() const { return m_NumIntervals == 0; }
+    TickType GetMinTime() const { return m_MinTime; }
+    TickType GetMaxTime() const { return m_MaxTime; }
+
+protected:
+    struct CoreTimeline
+    {
+        mutable Mutex         m_Mutex;
+        std::vector<Interval> m_Intervals;
+        TickType              m_InTime = 0;
+        ThreadID              m_InThread = 0;
+        bool                  m_HasIn = false;
+    };
+
+    CoreTimeline & GetCore( uint32_t a_Core );
+    void Insert( CoreTimeline & a_Timeline, const Interval & a_Interval );
+
+private:
+    mutable Mutex                                m_Mutex;
+    std::vector< std::unique_ptr<CoreTimeline> > m_Cores;
+    std::atomic<TickType>                        m_MinTime;
+    std::atomic<TickType>                        m_MaxTime;
+    std::atomic<uint64_t>                        m_NumIntervals;
+};
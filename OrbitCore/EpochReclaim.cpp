@@ -0,0 +1,96 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "EpochReclaim.h"
+
+// Epochs start at 1, a slot at 0 has no reader in flight.
+static std::atomic<uint64_t> GEpoch( 1 );
+
+//-----------------------------------------------------------------------------
+struct alignas(64) EpochSlot
+{
+    std::atomic<uint64_t> m_Epoch;
+    std::atomic<bool>     m_InUse;
+    EpochSlot*            m_Next;
+};
+
+// Slots are never freed, a thread that exits hands its slot over to the
+// next thread that reads.
+static std::atomic<EpochSlot*> GEpochSlots( nullptr );
+
+//-----------------------------------------------------------------------------
+static EpochSlot* AcquireSlot()
+{
+    for( EpochSlot* slot = GEpochSlots.load(); slot; slot = slot->m_Next )
+    {
+        bool inUse = false;
+        if( !slot->m_InUse && slot->m_InUse.compare_exchange_strong( inUse, true ) )
+            return slot;
+    }
+
+    EpochSlot* slot = new EpochSlot();
+    slot->m_Epoch = 0;
+    slot->m_InUse = true;
+    slot->m_Next = GEpochSlots.load();
+    while( !GEpochSlots.compare_exchange_weak( slot->m_Next, slot ) ) {}
+    return slot;
+}
+
+//-----------------------------------------------------------------------------
+struct ThreadEpoch
+{
+    ThreadEpoch() : m_Slot( AcquireSlot() ), m_Depth( 0 ) {}
+    ~ThreadEpoch()
+    {
+        m_Slot->m_Epoch = 0;
+        m_Slot->m_InUse = false;
+    }
+
+    EpochSlot* m_Slot;
+    uint32_t   m_Depth;
+};
+
+static thread_local ThreadEpoch GThreadEpoch;
+
+//-----------------------------------------------------------------------------
+EpochReclaim::ReadScope::ReadScope()
+{
+    // Sequentially consistent, the slot is visible to writers before the
+    // reader loads the data.
+    ThreadEpoch & thread = GThreadEpoch;
+    if( thread.m_Depth++ == 0 )
+    {
+        thread.m_Slot->m_Epoch.store( GEpoch.load() );
+    }
+}
+
+//-----------------------------------------------------------------------------
+EpochReclaim::ReadScope::~ReadScope()
+{
+    ThreadEpoch & thread = GThreadEpoch;
+    if( --thread.m_Depth == 0 )
+    {
+        thread.m_Slot->m_Epoch.store( 0, std::memory_order_release );
+    }
+}
+
+//-----------------------------------------------------------------------------
+uint64_t EpochReclaim::Retire()
+{
+    // Readers entering from now on only see the replacement.
+    return GEpoch.fetch_add( 1 );
+}
+
+//-----------------------------------------------------------------------------
+uint64_t EpochReclaim::GetMinActiveEpoch()
+{
+    uint64_t minEpoch = ~0ull;
+    for( EpochSlot* slot = GEpochSlots.load(); slot; slot = slot->m_Next )
+    {
+        uint64_t epoch = slot->m_Epoch.load();
+        if( epoch != 0 && epoch < minEpoch )
+            minEpoch = epoch;
+    }
+    return minEpoch;
+}
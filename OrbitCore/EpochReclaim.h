@@ -0,0 +1,33 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Epoch based reclamation of immutable data read without locks.  Each reader
+// thread announces the epoch it entered at in a slot of its own, so readers
+// never write to a shared cache line.  Writers replace the data, retire the
+// old version with Retire and free it once GetMinActiveEpoch is past that
+// epoch.  Readers that stay in flight only hold back what was retired before
+// they entered.
+//-----------------------------------------------------------------------------
+class EpochReclaim
+{
+public:
+    // Scopes can be nested, only the outermost one announces its epoch.
+    struct ReadScope
+    {
+        ReadScope();
+        ~ReadScope();
+    };
+
+    // Call after the replacement is published, the returned epoch tags the
+    // retired data.
+    static uint64_t Retire();
+
+    // Data retired at an epoch lower than this can be freed.
+    static uint64_t GetMinActiveEpoch();
+};
@@ -6,6 +6,7 @@
 #include "Serialization.h"
 #include "Capture.h"
 #include "SamplingProfiler.h"
+#include "OrbitProcess.h"
 
 #ifdef __linux
 EventTracer GEventTracer;
@@ -91,6 +92,10 @@ void EventTracer::Start( uint32_t a_PID )
     Capture::NewSamplingProfiler();
     Capture::GSamplingProfiler->StartCapture();
 
+    Capture::GTargetProcess->GetModuleTimeline().Clear();
+    m_ModuleTracker = std::make_shared<LinuxModuleTracker>(a_PID, Capture::GTargetProcess->GetModuleTimeline());
+    m_ModuleTracker->Start();
+
     m_Perf = std::make_shared<LinuxPerf>(a_PID);
     m_Perf->Start();
 }
@@ -98,6 +103,11 @@ void EventTracer::Start( uint32_t a_PID )
 //-----------------------------------------------------------------------------
 void EventTracer::Stop()
 {
+    if( m_ModuleTracker )
+    {
+        m_ModuleTracker->Stop();
+    }
+
     if( m_Perf )
     {
         m_Perf->Stop();
@@ -81,6 +81,7 @@ struct EventTracer
     void Start(uint32_t a_PID);
     void Stop();
     std::shared_ptr<LinuxPerf> m_Perf;
+    std::shared_ptr<LinuxModuleTracker> m_ModuleTracker;
 };
 
 extern EventTracer GEventTracer;
@@ -13,6 +13,7 @@
 #include "OrbitProcess.h"
 #include "SamplingProfiler.h"
 #include "TimerManager.h"
+#include "CaptureStream.h"
 
 #include "evntcons.h"
 
@@ -261,8 +262,9 @@ void EventTracing::CallbackStackWalk( PEVENT_RECORD a_EventRecord, UCHAR a_Opcod
             CS.m_Data.resize(stackDepth);
             memcpy(CS.m_Data.data(), &event->Stack1, numBytes );
 
-            Capture::GSamplingProfiler->AddCallStack( CS );
+            Capture::GSamplingProfiler->AddCallStack( CS, a_EventRecord->EventHeader.TimeStamp.QuadPart );
             GEventTracer.GetEventBuffer().AddCallstackEvent( a_EventRecord->EventHeader.TimeStamp.QuadPart, CS );
+            GCaptureStream.AddSample( a_EventRecord->EventHeader.TimeStamp.QuadPart, CS );
         }
     }
 }
@@ -0,0 +1,172 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Open addressing hash map for integer keys. Keys and values live in two flat
+// arrays, lookups are linear probes and erasing shifts the following entries
+// back so no tombstones are left behind. a_EmptyKey can't be used as a key.
+//-----------------------------------------------------------------------------
+template< class Key, class Value, Key a_EmptyKey = Key(0) >
+class FlatHashMap
+{
+public:
+    FlatHashMap( size_t a_Capacity = 16 ) : m_Size(0) { Allocate( a_Capacity ); }
+
+    size_t Size() const     { return m_Size; }
+    size_t Capacity() const { return m_Keys.size(); }
+
+    //-------------------------------------------------------------------------
+    Value* Find( Key a_Key )
+    {
+        for( size_t i = Home( a_Key );; i = ( i + 1 ) & m_Mask )
+        {
+            if( m_Keys[i] == a_Key )     return &m_Values[i];
+            if( m_Keys[i] == a_EmptyKey ) return nullptr;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    Value& operator[]( Key a_Key )
+    {
+        if( ( m_Size + 1 ) * 4 > Capacity() * 3 )
+        {
+            Rehash( Capacity() * 2 );
+        }
+
+        size_t i = Home( a_Key );
+        for( ; m_Keys[i] != a_EmptyKey; i = ( i + 1 ) & m_Mask )
+        {
+            if( m_Keys[i] == a_Key )
+            {
+                return m_Values[i];
+            }
+        }
+
+        m_Keys[i] = a_Key;
+        ++m_Size;
+        return m_Values[i];
+    }
+
+    //-------------------------------------------------------------------------
+    bool Erase( Key a_Key )
+    {
+        size_t i = Home( a_Key );
+        for( ; m_Keys[i] != a_Key; i = ( i + 1 ) & m_Mask )
+        {
+            if( m_Keys[i] == a_EmptyKey )
+            {
+                return false;
+            }
+        }
+
+        // Move back every entry of the probe run that would otherwise become
+        // unreachable through the hole.
+        for( size_t j = ( i + 1 ) & m_Mask; m_Keys[j] != a_EmptyKey; j = ( j + 1 ) & m_Mask )
+        {
+            size_t home = Home( m_Keys[j] );
+            bool inRange = i <= j ? ( i < home && home <= j ) : ( i < home || home <= j );
+            if( !inRange )
+            {
+                m_Keys[i] = m_Keys[j];
+                m_Values[i] = std::move( m_Values[j] );
+                i = j;
+            }
+        }
+
+        m_Keys[i] = a_EmptyKey;
+        m_Values[i] = Value();
+        --m_Size;
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    void Clear()
+    {
+        size_t capacity = Capacity();
+        m_Keys.clear();
+        m_Values.clear();
+        m_Size = 0;
+        Allocate( capacity );
+    }
+
+    //-------------------------------------------------------------------------
+    template< class Func > void ForEach( Func a_Func )
+    {
+        for( size_t i = 0; i < m_Keys.size(); ++i )
+        {
+            if( m_Keys[i] != a_EmptyKey )
+            {
+                a_Func( m_Keys[i], m_Values[i] );
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    template< class Func > void ForEach( Func a_Func ) const
+    {
+        for( size_t i = 0; i < m_Keys.size(); ++i )
+        {
+            if( m_Keys[i] != a_EmptyKey )
+            {
+                a_Func( m_Keys[i], m_Values[i] );
+            }
+        }
+    }
+
+protected:
+    //-------------------------------------------------------------------------
+    size_t Home( Key a_Key ) const
+    {
+        // Fibonacci hashing, spreads sequential ids and aligned addresses.
+        return (size_t)( ( (uint64_t)a_Key * 0x9E3779B97F4A7C15ull ) >> m_Shift );
+    }
+
+    //-------------------------------------------------------------------------
+    void Allocate( size_t a_Capacity )
+    {
+        size_t capacity = 16;
+        m_Shift = 60;
+        while( capacity < a_Capacity )
+        {
+            capacity *= 2;
+            --m_Shift;
+        }
+
+        m_Mask = capacity - 1;
+        m_Keys.assign( capacity, a_EmptyKey );
+        m_Values.resize( capacity );
+    }
+
+    //-------------------------------------------------------------------------
+    void Rehash( size_t a_Capacity )
+    {
+        std::vector<Key> keys;
+        std::vector<Value> values;
+        keys.swap( m_Keys );
+        values.swap( m_Values );
+
+        m_Size = 0;
+        Allocate( a_Capacity );
+        for( size_t i = 0; i < keys.size(); ++i )
+        {
+            if( keys[i] != a_EmptyKey )
+            {
+                (*this)[keys[i]] = std::move( values[i] );
+            }
+        }
+    }
+
+private:
+    std::vector<Key>   m_Keys;
+    std::vector<Value> m_Values;
+    size_t             m_Size;
+    size_t             m_Mask;
+    uint32_t           m_Shift;
+};
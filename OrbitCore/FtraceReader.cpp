@@ -0,0 +1,654 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "FtraceReader.h"
+#include "Core.h"
+#include "Capture.h"
+#include "LinuxUtils.h"
+#include "MappedFile.h"
+#include "Profiling.h"
+#include "TimerManager.h"
+#include "Log.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+// Ring buffer event header: 5 bits of type_len and 27 bits of time delta.
+enum RingBufferType
+{
+    RingBufferTypeDataMax    = 28,
+    RingBufferTypePadding    = 29,
+    RingBufferTypeTimeExtend = 30,
+    RingBufferTypeTimeStamp  = 31,
+};
+
+//-----------------------------------------------------------------------------
+template< class T > inline T ReadAs( const char* a_Data )
+{
+    T value;
+    memcpy( &value, a_Data, sizeof(T) );
+    return value;
+}
+
+//-----------------------------------------------------------------------------
+static bool ReadTextFile( const std::string & a_Path, std::string & o_Text )
+{
+    std::ifstream file( a_Path );
+    if( !file.good() )
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    o_Text = buffer.str();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+static bool WriteTextFile( const std::string & a_Path, const std::string & a_Text )
+{
+    std::ofstream file( a_Path, std::ios::trunc );
+    if( !file.good() )
+        return false;
+    file << a_Text;
+    return file.good();
+}
+
+//-----------------------------------------------------------------------------
+FtraceReader::FtraceReader( uint32_t a_PID ) : m_PID( a_PID )
+                                             , m_StartTime( 0 )
+                                             , m_PageSize( 4096 )
+                                             , m_SwitchId( -1 )
+                                             , m_ExitRequested( true )
+                                             , m_NumSwitches( 0 )
+                                             , m_NumWakeups( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+FtraceReader::~FtraceReader()
+{
+    Stop();
+}
+
+//-----------------------------------------------------------------------------
+// "\tfield:pid_t prev_pid;\toffset:24;\tsize:4;\tsigned:1;" lines and "ID: 316".
+void FtraceReader::ParseFormat( const std::string & a_Format, std::unordered_map<std::string, Field> & o_Fields, int & o_Id )
+{
+    std::istringstream stream( a_Format );
+    std::string line;
+    while( std::getline( stream, line ) )
+    {
+        if( StartsWith( line, "ID:" ) )
+        {
+            o_Id = atoi( line.c_str() + 3 );
+            continue;
+        }
+
+        size_t fieldPos = line.find( "field:" );
+        size_t endPos = line.find( ';', fieldPos );
+        size_t offsetPos = line.find( "offset:" );
+        size_t sizePos = line.find( "size:" );
+        if( fieldPos == std::string::npos || endPos == std::string::npos ||
+            offsetPos == std::string::npos || sizePos == std::string::npos )
+        {
+            continue;
+        }
+
+        std::string declaration = line.substr( fieldPos + 6, endPos - fieldPos - 6 );
+        size_t arrayPos = declaration.find( '[' );
+        if( arrayPos != std::string::npos )
+            declaration.resize( arrayPos );
+        size_t namePos = declaration.find_last_of( " \t" );
+        std::string name = namePos == std::string::npos ? declaration : declaration.substr( namePos + 1 );
+
+        Field & field = o_Fields[name];
+        field.m_Offset = (uint32_t)atoi( line.c_str() + offsetPos + 7 );
+        field.m_Size = (uint32_t)atoi( line.c_str() + sizePos + 5 );
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool FtraceReader::ParseHeaderPage( const std::string & a_Format )
+{
+    std::unordered_map<std::string, Field> fields;
+    int id = -1;
+    ParseFormat( a_Format, fields, id );
+    if( !fields.count( "timestamp" ) || !fields.count( "commit" ) || !fields.count( "data" ) )
+    {
+        return false;
+    }
+
+    m_PageTimestamp = fields["timestamp"];
+    m_PageCommit = fields["commit"];
+    m_PageData = fields["data"];
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool FtraceReader::ParseEventFormat( const std::string & a_Format )
+{
+    std::unordered_map<std::string, Field> fields;
+    int id = -1;
+    ParseFormat( a_Format, fields, id );
+    if( id < 0 || !fields.count( "common_type" ) )
+    {
+        return false;
+    }
+    m_CommonType = fields["common_type"];
+
+    if( a_Format.find( "name: sched_switch" ) != std::string::npos )
+    {
+        if( !fields.count( "prev_pid" ) || !fields.count( "next_pid" ) )
+            return false;
+        m_SwitchId = id;
+        m_PrevPid = fields["prev_pid"];
+        m_NextPid = fields["next_pid"];
+    }
+    else if( a_Format.find( "name: sched_wakeup" ) != std::string::npos )
+    {
+        m_WakeupIds.push_back( id );
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::DecodePage( const char* a_Page, size_t a_Size, uint16_t a_Cpu, std::vector<SchedSwitch> & o_Switches )
+{
+    if( a_Size < m_PageData.m_Offset )
+        return;
+
+    uint64_t time = ReadAs<uint64_t>( a_Page + m_PageTimestamp.m_Offset );
+    uint64_t commit = m_PageCommit.m_Size == 8 ? ReadAs<uint64_t>( a_Page + m_PageCommit.m_Offset )
+                                               : ReadAs<uint32_t>( a_Page + m_PageCommit.m_Offset );
+
+    // The top bits flag missed events.
+    commit &= ( 1ull << 30 ) - 1;
+
+    const char* data = a_Page + m_PageData.m_Offset;
+    const char* end = data + std::min<uint64_t>( commit, a_Size - m_PageData.m_Offset );
+    while( data + sizeof(uint32_t) <= end )
+    {
+        uint32_t header = ReadAs<uint32_t>( data );
+        uint32_t typeLen = header & 0x1F;
+        uint32_t delta = header >> 5;
+        uint32_t array0 = data + 2*sizeof(uint32_t) <= end ? ReadAs<uint32_t>( data + 4 ) : 0;
+
+        switch( typeLen )
+        {
+        case RingBufferTypePadding:
+            if( delta == 0 )
+                return;  // rest of the page is unused
+            data += 4 + array0;
+            break;
+        case RingBufferTypeTimeExtend:
+            time += delta + ( (uint64_t)array0 << 27 );
+            data += 8;
+            break;
+        case RingBufferTypeTimeStamp:
+            time = delta + ( (uint64_t)array0 << 27 );
+            data += 8;
+            break;
+        case 0:
+            // Large event, array[0] holds its length including itself.
+            time += delta;
+            if( array0 < 4 || data + 4 + array0 > end )
+                return;
+            DecodeEvent( data + 8, array0 - 4, time, a_Cpu, o_Switches );
+            data += 4 + array0;
+            break;
+        default:
+            time += delta;
+            if( data + 4 + typeLen*4 > end )
+                return;
+            DecodeEvent( data + 4, typeLen*4, time, a_Cpu, o_Switches );
+            data += 4 + typeLen*4;
+            break;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::DecodeEvent( const char* a_Data, size_t a_Size, uint64_t a_Time, uint16_t a_Cpu, std::vector<SchedSwitch> & o_Switches )
+{
+    if( a_Size < m_CommonType.m_Offset + sizeof(uint16_t) )
+        return;
+
+    int type = ReadAs<uint16_t>( a_Data + m_CommonType.m_Offset );
+    if( type == m_SwitchId )
+    {
+        if( a_Size < m_PrevPid.m_Offset + 4 || a_Size < m_NextPid.m_Offset + 4 )
+            return;
+
+        SchedSwitch sched;
+        sched.m_Time = a_Time;
+        sched.m_PrevTid = ReadAs<uint32_t>( a_Data + m_PrevPid.m_Offset );
+        sched.m_NextTid = ReadAs<uint32_t>( a_Data + m_NextPid.m_Offset );
+        sched.m_Cpu = a_Cpu;
+        o_Switches.push_back( sched );
+        ++m_NumSwitches;
+    }
+    else if( std::find( m_WakeupIds.begin(), m_WakeupIds.end(), type ) != m_WakeupIds.end() )
+    {
+        // ContextSwitch has no wakeup record yet, only count them.
+        ++m_NumWakeups;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::ToContextSwitches( const SchedSwitch & a_Switch, bool a_FilterThreads, std::vector<ContextSwitch> & o_Switches )
+{
+    // Tid 0 is the idle task.
+    auto keep = [&]( uint32_t a_Tid ){ return a_Tid != 0 && ( !a_FilterThreads || m_TargetThreads.count( a_Tid ) ); };
+
+    if( keep( a_Switch.m_PrevTid ) )
+    {
+        ContextSwitch cs( ContextSwitch::Out );
+        cs.m_ThreadId = a_Switch.m_PrevTid;
+        cs.m_Time = (long long)a_Switch.m_Time;
+        cs.m_ProcessorIndex = a_Switch.m_Cpu;
+        cs.m_ProcessorNumber = (unsigned char)a_Switch.m_Cpu;
+        o_Switches.push_back( cs );
+    }
+
+    if( keep( a_Switch.m_NextTid ) )
+    {
+        ContextSwitch cs( ContextSwitch::In );
+        cs.m_ThreadId = a_Switch.m_NextTid;
+        cs.m_Time = (long long)a_Switch.m_Time;
+        cs.m_ProcessorIndex = a_Switch.m_Cpu;
+        cs.m_ProcessorNumber = (unsigned char)a_Switch.m_Cpu;
+        o_Switches.push_back( cs );
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool FtraceReader::Start()
+{
+    m_TracingPath = access( "/sys/kernel/tracing/trace_pipe", F_OK ) == 0 ? "/sys/kernel/tracing/" : "/sys/kernel/debug/tracing/";
+
+    std::string format;
+    if( !ReadTextFile( m_TracingPath + "events/header_page", format ) || !ParseHeaderPage( format ) )
+    {
+        ORBIT_LOG( Format( "Can't read ftrace page header from %s", m_TracingPath.c_str() ) );
+        return false;
+    }
+
+    m_WakeupIds.clear();
+    if( !ReadTextFile( m_TracingPath + "events/sched/sched_switch/format", format ) || !ParseEventFormat( format ) )
+    {
+        ORBIT_LOG( "Can't read the sched_switch format" );
+        return false;
+    }
+    if( ReadTextFile( m_TracingPath + "events/sched/sched_wakeup/format", format ) )
+        ParseEventFormat( format );
+    if( ReadTextFile( m_TracingPath + "events/sched/sched_wakeup_new/format", format ) )
+        ParseEventFormat( format );
+
+    // Timestamps must match the CLOCK_MONOTONIC ticks of the timers.
+    // Ftrace settings are global, they are restored by Stop.
+    std::string clocks;
+    ReadTextFile( m_TracingPath + "trace_clock", clocks );
+    size_t clockBegin = clocks.find( '[' );
+    size_t clockEnd = clocks.find( ']' );
+    m_PreviousClock = clockBegin != std::string::npos && clockEnd > clockBegin ? clocks.substr( clockBegin + 1, clockEnd - clockBegin - 1 ) : "local";
+    ReadTextFile( m_TracingPath + "tracing_on", m_PreviousTracingOn );
+    ReadTextFile( m_TracingPath + "events/sched/sched_switch/enable", m_PreviousSwitchEnable );
+    ReadTextFile( m_TracingPath + "events/sched/sched_wakeup/enable", m_PreviousWakeupEnable );
+
+    // Changing the clock resets the ring buffers, events that were already
+    // buffered with the same clock are skipped by time.  The trace of other
+    // users is left alone.
+    if( !WriteTextFile( m_TracingPath + "trace_clock", "mono" ) ||
+        !WriteTextFile( m_TracingPath + "events/sched/sched_switch/enable", "1" ) )
+    {
+        ORBIT_LOG( "Can't configure ftrace, context switches need root" );
+        RestoreTracing();
+        return false;
+    }
+    WriteTextFile( m_TracingPath + "events/sched/sched_wakeup/enable", "1" );
+    WriteTextFile( m_TracingPath + "tracing_on", "1" );
+
+    m_StartTime = OrbitTicks( CLOCK_MONOTONIC );
+    m_PageSize = (uint32_t)getpagesize();
+    RefreshThreads();
+    m_ExitRequested = false;
+
+    int numCpus = (int)sysconf( _SC_NPROCESSORS_CONF );
+    for( int cpu = 0; cpu < numCpus; ++cpu )
+    {
+        std::string path = m_TracingPath + Format( "per_cpu/cpu%d/trace_pipe_raw", cpu );
+        int fd = open( path.c_str(), O_RDONLY | O_NONBLOCK );
+        if( fd < 0 )
+            continue;
+
+        std::unique_ptr<CpuStream> stream( new CpuStream() );
+        stream->m_Fd = fd;
+        stream->m_Cpu = (uint16_t)cpu;
+        stream->m_Watermark = 0;
+        m_Streams.push_back( std::move( stream ) );
+    }
+
+    for( auto & stream : m_Streams )
+    {
+        CpuStream* cpuStream = stream.get();
+        stream->m_Thread = std::thread( [this, cpuStream](){ ReadCpu( *cpuStream ); } );
+    }
+    m_DispatchThread = std::thread( &FtraceReader::Dispatch, this );
+
+    return !m_Streams.empty();
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::Stop()
+{
+    if( m_ExitRequested )
+        return;
+
+    m_ExitRequested = true;
+    for( auto & stream : m_Streams )
+    {
+        if( stream->m_Thread.joinable() )
+            stream->m_Thread.join();
+    }
+
+    if( m_DispatchThread.joinable() )
+        m_DispatchThread.join();
+
+    for( auto & stream : m_Streams )
+    {
+        close( stream->m_Fd );
+    }
+    m_Streams.clear();
+
+    RestoreTracing();
+
+    ORBIT_LOG( Format( "Ftrace read %llu context switches and %llu wakeups", (unsigned long long)m_NumSwitches, (unsigned long long)m_NumWakeups ) );
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::RestoreTracing()
+{
+    // Settings that couldn't be read are left as they are.
+    auto restore = [this]( const char* a_File, const std::string & a_Value )
+    {
+        if( !a_Value.empty() )
+            WriteTextFile( m_TracingPath + a_File, a_Value );
+    };
+
+    restore( "events/sched/sched_switch/enable", m_PreviousSwitchEnable );
+    restore( "events/sched/sched_wakeup/enable", m_PreviousWakeupEnable );
+    restore( "tracing_on", m_PreviousTracingOn );
+    restore( "trace_clock", m_PreviousClock );
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::ReadCpu( CpuStream & a_Stream )
+{
+    SetCurrentThreadName( Format( L"Ftrace cpu %u", a_Stream.m_Cpu ).c_str() );
+
+    std::vector<char> page( m_PageSize );
+    std::vector<SchedSwitch> switches;
+    while( !m_ExitRequested )
+    {
+        uint64_t now = OrbitTicks( CLOCK_MONOTONIC );
+        ssize_t numBytes = read( a_Stream.m_Fd, page.data(), page.size() );
+        if( numBytes <= 0 )
+        {
+            // Nothing buffered, whatever comes next is newer than now.
+            a_Stream.m_Watermark = now;
+            Sleep( 1 );
+            continue;
+        }
+
+        switches.clear();
+        DecodePage( page.data(), (size_t)numBytes, a_Stream.m_Cpu, switches );
+        switches.erase( switches.begin(), std::lower_bound( switches.begin(), switches.end(), SchedSwitch{ m_StartTime, 0, 0, 0 } ) );
+        if( switches.empty() )
+            continue;
+
+        ScopeLock lock( a_Stream.m_Mutex );
+        a_Stream.m_Pending.insert( a_Stream.m_Pending.end(), switches.begin(), switches.end() );
+        a_Stream.m_Watermark = switches.back().m_Time;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::RefreshThreads()
+{
+    if( m_PID == 0 )
+        return;
+
+    std::vector<uint32_t> threads = LinuxUtils::ListThreads( m_PID );
+    m_TargetThreads.insert( threads.begin(), threads.end() );
+}
+
+//-----------------------------------------------------------------------------
+void FtraceReader::Dispatch()
+{
+    SetCurrentThreadName( L"FtraceDispatch" );
+
+    std::vector<SchedSwitch> ready;
+    std::vector<ContextSwitch> contextSwitches;
+    uint64_t lastRefresh = 0;
+    bool exiting = false;
+    while( !exiting )
+    {
+        exiting = m_ExitRequested;
+        if( !exiting )
+            Sleep( 10 );
+
+        uint64_t now = OrbitTicks( CLOCK_MONOTONIC );
+        if( now - lastRefresh > 500000000ull )
+        {
+            RefreshThreads();
+            lastRefresh = now;
+        }
+
+        // Each cpu stream is already ordered, everything up to the oldest
+        // watermark can be merged and sent. Flush all on exit.
+        uint64_t watermark = exiting ? ~0ull : now;
+        for( auto & stream : m_Streams )
+        {
+            watermark = std::min<uint64_t>( watermark, stream->m_Watermark );
+        }
+
+        ready.clear();
+        for( auto & stream : m_Streams )
+        {
+            ScopeLock lock( stream->m_Mutex );
+            std::vector<SchedSwitch> & pending = stream->m_Pending;
+            auto last = std::upper_bound( pending.begin(), pending.end(), SchedSwitch{ watermark, 0, 0, 0 } );
+            size_t readyBegin = ready.size();
+            ready.insert( ready.end(), pending.begin(), last );
+            pending.erase( pending.begin(), last );
+            std::inplace_merge( ready.begin(), ready.begin() + readyBegin, ready.end() );
+        }
+
+        contextSwitches.clear();
+        for( const SchedSwitch & sched : ready )
+        {
+            ToContextSwitches( sched, m_PID != 0, contextSwitches );
+        }
+
+        for( const ContextSwitch & cs : contextSwitches )
+        {
+            ++Capture::GNumContextSwitches;
+            GTimerManager->Add( cs );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool FtraceReader::LoadTraceDat( const std::string & a_FileName, std::vector<ContextSwitch> & o_Switches )
+{
+    SCOPE_TIMER_LOG( s2ws( "LoadTraceDat " + a_FileName ) );
+
+    MappedFile file;
+    if( !file.Open( a_FileName ) )
+    {
+        ORBIT_LOG( Format( "Can't open %s", a_FileName.c_str() ) );
+        return false;
+    }
+
+    const char* data = file.GetData();
+    const char* end = data + file.GetSize();
+    bool valid = true;
+
+    auto need = [&]( size_t a_Size ){ valid = valid && (size_t)( end - data ) >= a_Size; return valid; };
+    auto readString = [&]()
+    {
+        const char* stringEnd = valid ? (const char*)memchr( data, 0, end - data ) : nullptr;
+        if( stringEnd == nullptr ) { valid = false; return std::string(); }
+        std::string text( data, stringEnd );
+        data = stringEnd + 1;
+        return text;
+    };
+    auto read32 = [&](){ if( !need( 4 ) ) return 0u; uint32_t value = ReadAs<uint32_t>( data ); data += 4; return value; };
+    auto read64 = [&](){ if( !need( 8 ) ) return 0ull; uint64_t value = ReadAs<uint64_t>( data ); data += 8; return (unsigned long long)value; };
+    auto readBlock = [&]( uint64_t a_Size ){ if( !need( a_Size ) ) return std::string(); std::string text( data, (size_t)a_Size ); data += a_Size; return text; };
+
+    // "\x17\x08\x44tracing", version, endianness, sizeof(long), page size.
+    static const char magic[] = { 0x17, 0x08, 0x44, 't', 'r', 'a', 'c', 'i', 'n', 'g' };
+    if( !need( sizeof(magic) ) || memcmp( data, magic, sizeof(magic) ) != 0 )
+    {
+        ORBIT_LOG( "Not a trace.dat file" );
+        return false;
+    }
+    data += sizeof(magic);
+
+    int version = atoi( readString().c_str() );
+    if( !need( 2 ) || version != 6 || data[0] != 0 )
+    {
+        ORBIT_LOG( Format( "Unsupported trace.dat version %d", version ) );
+        return false;
+    }
+    data += 2;
+    m_PageSize = read32();
+    if( !valid || m_PageSize == 0 || m_PageSize > MaxPageSize )
+    {
+        ORBIT_LOG( Format( "Invalid trace.dat page size %u", m_PageSize ) );
+        return false;
+    }
+
+    // Page header and event header formats.
+    if( readString() != "header_page" || !ParseHeaderPage( readBlock( read64() ) ) )
+        return false;
+    if( readString() != "header_event" )
+        return false;
+    readBlock( read64() );
+
+    // Ftrace internal event formats, then the event systems.
+    uint32_t numFormats = read32();
+    for( uint32_t i = 0; i < numFormats && valid; ++i )
+        readBlock( read64() );
+
+    m_WakeupIds.clear();
+    m_SwitchId = -1;
+    uint32_t numSystems = read32();
+    for( uint32_t i = 0; i < numSystems && valid; ++i )
+    {
+        std::string system = readString();
+        uint32_t numEvents = read32();
+        for( uint32_t j = 0; j < numEvents && valid; ++j )
+        {
+            std::string format = readBlock( read64() );
+            if( system == "sched" )
+                ParseEventFormat( format );
+        }
+    }
+
+    readBlock( read32() );  // kallsyms
+    readBlock( read32() );  // printk formats
+    readBlock( read64() );  // cmdlines
+    uint32_t numCpus = read32();
+
+    // Options come before the per cpu data of flyrecord files.
+    std::string section = readBlock( 10 );
+    if( section.compare( 0, 7, "options" ) == 0 )
+    {
+        while( valid )
+        {
+            if( !need( 2 ) ) break;
+            uint16_t option = ReadAs<uint16_t>( data );
+            data += 2;
+            if( option == 0 )
+                break;
+            readBlock( read32() );
+        }
+        section = readBlock( 10 );
+    }
+
+    if( !valid || section.compare( 0, 9, "flyrecord" ) != 0 || m_SwitchId < 0 )
+    {
+        ORBIT_LOG( "trace.dat has no flyrecord sched_switch data" );
+        return false;
+    }
+
+    // Each cpu has an offset and a size, don't trust the count before
+    // checking that they fit.
+    if( numCpus > MaxCpus || numCpus > (size_t)( end - data )/16 )
+    {
+        ORBIT_LOG( Format( "Invalid trace.dat cpu count %u", numCpus ) );
+        return false;
+    }
+
+    std::vector< std::pair<uint64_t, uint64_t> > cpuData( numCpus );
+    for( auto & range : cpuData )
+    {
+        range.first = read64();
+        range.second = read64();
+    }
+
+    if( !valid )
+        return false;
+
+    // Cpus are decoded in parallel, each one is time ordered so merging
+    // them is enough.
+    std::vector< std::vector<SchedSwitch> > switches( numCpus );
+    std::atomic<uint32_t> nextCpu( 0 );
+    uint32_t numThreads = std::min<uint32_t>( numCpus, std::max( 1u, std::thread::hardware_concurrency() ) );
+    std::vector<std::thread> threads;
+    for( uint32_t i = 0; i < numThreads; ++i )
+    {
+        threads.emplace_back( [&]()
+        {
+            for( uint32_t cpu = nextCpu++; cpu < numCpus; cpu = nextCpu++ )
+            {
+                uint64_t offset = cpuData[cpu].first;
+                uint64_t size = cpuData[cpu].second;
+                if( offset > file.GetSize() || size > file.GetSize() - offset )
+                    continue;
+                for( uint64_t page = 0; page + m_PageSize <= size; page += m_PageSize )
+                {
+                    DecodePage( file.GetData() + offset + page, m_PageSize, (uint16_t)cpu, switches[cpu] );
+                }
+            }
+        } );
+    }
+
+    for( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+
+    std::vector<SchedSwitch> merged;
+    for( std::vector<SchedSwitch> & cpuSwitches : switches )
+    {
+        size_t middle = merged.size();
+        merged.insert( merged.end(), cpuSwitches.begin(), cpuSwitches.end() );
+        std::inplace_merge( merged.begin(), merged.begin() + middle, merged.end() );
+    }
+
+    // The threads of a live process say nothing about a recorded file.
+    for( const SchedSwitch & sched : merged )
+    {
+        ToContextSwitches( sched, false, o_Switches );
+    }
+
+    return true;
+}
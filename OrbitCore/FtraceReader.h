@@ -0,0 +1,105 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "ContextSwitch.h"
+#include "Threading.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Decodes the binary ftrace ring buffer pages of sched_switch events into
+// ContextSwitch records. Live captures read the per cpu trace_pipe_raw files
+// on one thread per cpu and merge them in time order. Offline, trace.dat
+// files written by trace-cmd are decoded one thread per cpu as well.
+class FtraceReader
+{
+public:
+    FtraceReader( uint32_t a_PID = 0 );  // 0 keeps the switches of all threads of live captures
+    ~FtraceReader();
+
+    // Live capture, switches go to GTimerManager.
+    bool Start();
+    void Stop();
+
+    // Keeps the switches of all threads of the file.
+    bool LoadTraceDat( const std::string & a_FileName, std::vector<ContextSwitch> & o_Switches );
+
+    static const uint32_t MaxCpus = 4096;
+    static const uint32_t MaxPageSize = 1024*1024;
+
+    uint64_t GetNumSwitches() const { return m_NumSwitches; }
+    uint64_t GetNumWakeups() const  { return m_NumWakeups; }
+
+protected:
+    struct Field
+    {
+        uint32_t m_Offset = 0;
+        uint32_t m_Size = 0;
+    };
+
+    struct SchedSwitch
+    {
+        uint64_t m_Time;
+        uint32_t m_PrevTid;
+        uint32_t m_NextTid;
+        uint16_t m_Cpu;
+        bool operator<( const SchedSwitch & a_Other ) const { return m_Time < a_Other.m_Time; }
+    };
+
+    struct CpuStream
+    {
+        int                      m_Fd = -1;
+        uint16_t                 m_Cpu = 0;
+        Mutex                    m_Mutex;
+        std::vector<SchedSwitch> m_Pending;
+        std::atomic<uint64_t>    m_Watermark;
+        std::thread              m_Thread;
+    };
+
+    static void ParseFormat( const std::string & a_Format, std::unordered_map<std::string, Field> & o_Fields, int & o_Id );
+    bool ParseHeaderPage( const std::string & a_Format );
+    bool ParseEventFormat( const std::string & a_Format );
+    void DecodePage( const char* a_Page, size_t a_Size, uint16_t a_Cpu, std::vector<SchedSwitch> & o_Switches );
+    void DecodeEvent( const char* a_Data, size_t a_Size, uint64_t a_Time, uint16_t a_Cpu, std::vector<SchedSwitch> & o_Switches );
+    void ToContextSwitches( const SchedSwitch & a_Switch, bool a_FilterThreads, std::vector<ContextSwitch> & o_Switches );
+    void RestoreTracing();
+
+    void ReadCpu( CpuStream & a_Stream );
+    void Dispatch();
+    void RefreshThreads();
+
+private:
+    uint32_t                                m_PID;
+    std::string                             m_TracingPath;
+    std::string                             m_PreviousClock;
+    std::string                             m_PreviousTracingOn;
+    std::string                             m_PreviousSwitchEnable;
+    std::string                             m_PreviousWakeupEnable;
+    uint64_t                                m_StartTime;
+    uint32_t                                m_PageSize;
+
+    // Page and event layouts, read from the format descriptions.
+    Field                                   m_PageTimestamp;
+    Field                                   m_PageCommit;
+    Field                                   m_PageData;
+    Field                                   m_CommonType;
+    Field                                   m_PrevPid;
+    Field                                   m_NextPid;
+    int                                     m_SwitchId;
+    std::vector<int>                        m_WakeupIds;
+
+    std::vector< std::unique_ptr<CpuStream> > m_Streams;
+    std::thread                             m_DispatchThread;
+    std::atomic<bool>                       m_ExitRequested;
+    std::unordered_set<uint32_t>            m_TargetThreads;
+
+    std::atomic<uint64_t>                   m_NumSwitches;
+    std::atomic<uint64_t>                   m_NumWakeups;
+};
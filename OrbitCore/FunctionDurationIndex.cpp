@@ -0,0 +1,375 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "FunctionDurationIndex.h"
+#include "CaptureFile.h"
+#include "Profiling.h"
+#include "Utils.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+FunctionDurationIndex::FunctionDurationIndex() : m_ChunkExitRequested( false ), m_ChunkStatsReady( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+FunctionDurationIndex::~FunctionDurationIndex()
+{
+    StopChunkThread();
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::Clear()
+{
+    StopChunkThread();
+
+    ScopeLock lock( m_Mutex );
+    m_Functions.clear();
+    PendingRecord record;
+    while( m_Pending.try_dequeue( record ) ) {}
+}
+
+//-----------------------------------------------------------------------------
+uint32_t FunctionDurationIndex::GetBin( uint64_t a_DurationNs )
+{
+    uint32_t bin = 64 - CountLeadingZeros( a_DurationNs );
+    return std::min( bin, NumBins - 1 );
+}
+
+//-----------------------------------------------------------------------------
+FunctionDurationIndex::PendingRecord FunctionDurationIndex::MakeRecord( const Timer & a_Timer )
+{
+    PendingRecord record;
+    record.m_Function = a_Timer.m_FunctionAddress;
+    record.m_Record.m_Start = a_Timer.m_Start;
+    record.m_Record.m_DurationNs = (uint64_t)( a_Timer.ElapsedMicros() * 1000.0 );
+    return record;
+}
+
+//-----------------------------------------------------------------------------
+FunctionDurationIndex::Instance FunctionDurationIndex::MakeInstance( const Record & a_Record )
+{
+    Instance instance;
+    instance.m_Start = a_Record.m_Start;
+    instance.m_End = a_Record.m_Start + TicksFromMicroseconds( a_Record.m_DurationNs * 0.001 );
+    instance.m_DurationNs = a_Record.m_DurationNs;
+    return instance;
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::Add( const Timer & a_Timer )
+{
+    if( a_Timer.m_FunctionAddress == 0 )
+        return;
+
+    m_Pending.enqueue( MakeRecord( a_Timer ) );
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::Add( const std::vector<Timer> & a_Timers )
+{
+    std::vector<PendingRecord> records;
+    records.reserve( a_Timers.size() );
+    for( const Timer & timer : a_Timers )
+    {
+        if( timer.m_FunctionAddress != 0 )
+            records.push_back( MakeRecord( timer ) );
+    }
+
+    m_Pending.enqueue_bulk( records.data(), records.size() );
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::AddChunks( std::shared_ptr<CaptureFileReader> a_Reader, const StatsCallback & a_OnStats )
+{
+    StopChunkThread();
+    m_ChunkExitRequested = false;
+    m_ChunkStatsCallback = a_OnStats;
+
+    // Only the chunk index of the capture is in memory, timers are decoded
+    // one chunk at a time and their pages released right after.
+    m_ChunkThread = std::make_shared<std::thread>( [this, a_Reader]()
+    {
+        SetCurrentThreadName( L"DurationIndex" );
+        std::vector<Timer> timers;
+        std::unordered_map<DWORD64, FunctionStats> stats;
+        for( const CaptureChunk & chunk : a_Reader->GetChunks() )
+        {
+            if( m_ChunkExitRequested )
+                return;
+
+            if( chunk.m_Type != CaptureChunk::TIMERS )
+                continue;
+
+            timers.clear();
+            if( a_Reader->ReadTimers( chunk, timers ) )
+            {
+                Add( timers );
+                for( const Timer & timer : timers )
+                {
+                    if( timer.m_FunctionAddress != 0 )
+                        stats[timer.m_FunctionAddress].Update( timer );
+                }
+            }
+            a_Reader->ReleaseChunk( chunk );
+        }
+
+        ScopeLock lock( m_Mutex );
+        m_ChunkStats.swap( stats );
+        m_ChunkStatsReady = true;
+    } );
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::StopChunkThread()
+{
+    if( m_ChunkThread )
+    {
+        m_ChunkExitRequested = true;
+        m_ChunkThread->join();
+        m_ChunkThread = nullptr;
+    }
+
+    ScopeLock lock( m_Mutex );
+    m_ChunkStats.clear();
+    m_ChunkStatsReady = false;
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::Update()
+{
+    std::unordered_map<DWORD64, FunctionStats> stats;
+    {
+        // Only what is queued now, producers can keep the queue busy.
+        ScopeLock lock( m_Mutex );
+        MergePending( m_Pending.size_approx() );
+
+        if( m_ChunkStatsReady.exchange( false ) )
+            stats.swap( m_ChunkStats );
+    }
+
+    // On the caller's thread, outside of the lock.
+    if( !stats.empty() && m_ChunkStatsCallback )
+    {
+        m_ChunkStatsCallback( stats );
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::RemoveEndingBefore( TickType a_Time )
+{
+    ScopeLock lock( m_Mutex );
+    MergePending();
+
+    auto endsBefore = [a_Time]( const Record & a_Record ){ return MakeInstance( a_Record ).m_End < a_Time; };
+    for( auto & pair : m_Functions )
+    {
+        Function & function = *pair.second;
+        std::vector<Record> & records = function.m_Records;
+
+        // Sorted records starting after a_Time can't end before it.
+        auto sortedEnd = records.begin() + function.m_NumSorted;
+        auto candidatesEnd = std::lower_bound( records.begin(), sortedEnd, a_Time, []( const Record & a, TickType b ){ return a.m_Start < b; } );
+        auto firstRemoved = std::find_if( records.begin(), candidatesEnd, endsBefore );
+        if( firstRemoved == candidatesEnd && std::none_of( sortedEnd, records.end(), endsBefore ) )
+            continue;
+
+        size_t numSortedKept = std::count_if( firstRemoved, sortedEnd, [&]( const Record & a_Record ){ return !endsBefore( a_Record ); } );
+        size_t firstChanged = firstRemoved - records.begin();
+        records.erase( std::remove_if( firstRemoved, records.end(), endsBefore ), records.end() );
+        function.m_NumSorted = firstChanged + numSortedKept;
+        UpdateBlocks( function, firstChanged / BlockSize );
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::MergePending( size_t a_MaxRecords )
+{
+    const size_t maxRecords = 4096;
+    m_MergeBuffer.resize( maxRecords );
+
+    size_t numDequeued = 0;
+    while( a_MaxRecords > 0 && ( numDequeued = m_Pending.try_dequeue_bulk( m_MergeBuffer.data(), std::min( maxRecords, a_MaxRecords ) ) ) > 0 )
+    {
+        a_MaxRecords -= numDequeued;
+        for( size_t i = 0; i < numDequeued; ++i )
+        {
+            std::unique_ptr<Function> & function = m_Functions[m_MergeBuffer[i].m_Function];
+            if( function == nullptr )
+            {
+                function.reset( new Function() );
+            }
+            function->m_Records.push_back( m_MergeBuffer[i].m_Record );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+FunctionDurationIndex::Function* FunctionDurationIndex::GetSortedFunction( DWORD64 a_Function )
+{
+    MergePending();
+
+    auto it = m_Functions.find( a_Function );
+    if( it == m_Functions.end() )
+        return nullptr;
+
+    Function & function = *it->second;
+    std::vector<Record> & records = function.m_Records;
+    if( function.m_NumSorted == records.size() )
+        return &function;
+
+    // Timers of different threads arrive out of order, sort what was added
+    // since the last query and merge it, only blocks after the first moved
+    // instance need to be summarized again.
+    auto byStart = []( const Record & a, const Record & b ){ return a.m_Start < b.m_Start; };
+    auto middle = records.begin() + function.m_NumSorted;
+    std::sort( middle, records.end(), byStart );
+    size_t firstChanged = std::upper_bound( records.begin(), middle, *middle, byStart ) - records.begin();
+    std::inplace_merge( records.begin(), middle, records.end(), byStart );
+    function.m_NumSorted = records.size();
+
+    UpdateBlocks( function, firstChanged / BlockSize );
+    return &function;
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::UpdateBlocks( Function & a_Function, size_t a_FirstBlock )
+{
+    const std::vector<Record> & records = a_Function.m_Records;
+    size_t numBlocks = ( records.size() + BlockSize - 1 ) / BlockSize;
+    a_Function.m_Blocks.resize( numBlocks );
+
+    for( size_t blockIndex = a_FirstBlock; blockIndex < numBlocks; ++blockIndex )
+    {
+        Block & block = a_Function.m_Blocks[blockIndex];
+        memset( block.m_Counts, 0, sizeof(block.m_Counts) );
+
+        size_t begin = blockIndex * BlockSize;
+        size_t end = std::min( begin + BlockSize, records.size() );
+        block.m_Slowest = (uint32_t)begin;
+        for( size_t i = begin; i < end; ++i )
+        {
+            ++block.m_Counts[GetBin( records[i].m_DurationNs )];
+            if( records[i].m_DurationNs > records[block.m_Slowest].m_DurationNs )
+                block.m_Slowest = (uint32_t)i;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FunctionDurationIndex::GetRange( const Function & a_Function, TickType a_Min, TickType a_Max, size_t & o_Begin, size_t & o_End ) const
+{
+    const std::vector<Record> & records = a_Function.m_Records;
+    o_Begin = std::lower_bound( records.begin(), records.end(), a_Min, []( const Record & a, TickType b ){ return a.m_Start < b; } ) - records.begin();
+    o_End = std::upper_bound( records.begin(), records.end(), a_Max, []( TickType a, const Record & b ){ return a < b.m_Start; } ) - records.begin();
+}
+
+//-----------------------------------------------------------------------------
+bool FunctionDurationIndex::GetHistogram( DWORD64 a_Function, TickType a_Min, TickType a_Max, Histogram & o_Histogram )
+{
+    ScopeLock lock( m_Mutex );
+    o_Histogram = Histogram();
+
+    Function* function = GetSortedFunction( a_Function );
+    if( function == nullptr )
+        return false;
+
+    size_t begin, end;
+    GetRange( *function, a_Min, a_Max, begin, end );
+
+    const std::vector<Record> & records = function->m_Records;
+    size_t i = begin;
+    while( i < end )
+    {
+        if( i % BlockSize == 0 && i + BlockSize <= end )
+        {
+            const Block & block = function->m_Blocks[i / BlockSize];
+            for( uint32_t bin = 0; bin < NumBins; ++bin )
+            {
+                o_Histogram.m_Counts[bin] += block.m_Counts[bin];
+            }
+            i += BlockSize;
+        }
+        else
+        {
+            ++o_Histogram.m_Counts[GetBin( records[i].m_DurationNs )];
+            ++i;
+        }
+    }
+
+    o_Histogram.m_Total = end - begin;
+    return o_Histogram.m_Total > 0;
+}
+
+//-----------------------------------------------------------------------------
+bool FunctionDurationIndex::GetSlowest( DWORD64 a_Function, TickType a_Min, TickType a_Max, Instance & o_Instance )
+{
+    ScopeLock lock( m_Mutex );
+    Function* function = GetSortedFunction( a_Function );
+    if( function == nullptr )
+        return false;
+
+    size_t begin, end;
+    GetRange( *function, a_Min, a_Max, begin, end );
+    if( begin >= end )
+        return false;
+
+    const std::vector<Record> & records = function->m_Records;
+    size_t slowest = begin;
+    size_t i = begin;
+    while( i < end )
+    {
+        size_t candidate = i;
+        if( i % BlockSize == 0 && i + BlockSize <= end )
+        {
+            candidate = function->m_Blocks[i / BlockSize].m_Slowest;
+            i += BlockSize;
+        }
+        else
+        {
+            ++i;
+        }
+
+        if( records[candidate].m_DurationNs > records[slowest].m_DurationNs )
+            slowest = candidate;
+    }
+
+    o_Instance = MakeInstance( records[slowest] );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool FunctionDurationIndex::GetSlowestInBin( DWORD64 a_Function, TickType a_Min, TickType a_Max, uint32_t a_Bin, Instance & o_Instance )
+{
+    ScopeLock lock( m_Mutex );
+    Function* function = GetSortedFunction( a_Function );
+    if( function == nullptr )
+        return false;
+
+    size_t begin, end;
+    GetRange( *function, a_Min, a_Max, begin, end );
+
+    // Blocks without records in the bin are skipped.
+    const std::vector<Record> & records = function->m_Records;
+    const Record* slowest = nullptr;
+    size_t i = begin;
+    while( i < end )
+    {
+        if( i % BlockSize == 0 && i + BlockSize <= end && function->m_Blocks[i / BlockSize].m_Counts[a_Bin] == 0 )
+        {
+            i += BlockSize;
+            continue;
+        }
+
+        const Record & record = records[i++];
+        if( GetBin( record.m_DurationNs ) == a_Bin && ( slowest == nullptr || record.m_DurationNs > slowest->m_DurationNs ) )
+            slowest = &record;
+    }
+
+    if( slowest == nullptr )
+        return false;
+
+    o_Instance = MakeInstance( *slowest );
+    return true;
+}
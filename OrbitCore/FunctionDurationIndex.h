@@ -0,0 +1,119 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "Core.h"
+#include "CallstackTypes.h"
+#include "ScopeTimer.h"
+#include "Threading.h"
+#include "FunctionStats.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class CaptureFileReader;
+
+//-----------------------------------------------------------------------------
+// Per function index of timer instances used by the duration histogram. The
+// instances of a function are kept sorted by start time and split in blocks
+// of BlockSize, each block summarizing its duration histogram and slowest
+// instance. Range queries only look at the individual instances of the two
+// partial blocks at the edges, so they stay cheap on very large captures.
+//
+// Adding is lock free, records are queued and moved to their function by
+// Update, which the main loop calls so that the queue stays bounded when
+// nothing queries the index.  Sorting waits for the first query.  Lazily
+// loaded captures are indexed from their timer chunks on a background
+// thread, which also computes their function stats.
+class FunctionDurationIndex
+{
+public:
+    static const uint32_t NumBins = 48;  // powers of two of nanoseconds
+    static const uint32_t BlockSize = 4096;
+
+    struct Instance
+    {
+        TickType m_Start;
+        TickType m_End;
+        uint64_t m_DurationNs;
+    };
+
+    struct Histogram
+    {
+        Histogram() { memset( m_Counts, 0, sizeof(m_Counts) ); }
+        uint64_t m_Counts[NumBins];
+        uint64_t m_Total = 0;
+    };
+
+    FunctionDurationIndex();
+    ~FunctionDurationIndex();
+
+    void Clear();
+    void Add( const Timer & a_Timer );
+    void Add( const std::vector<Timer> & a_Timers );
+    // Function stats of the chunks are computed in the same pass and handed
+    // to a_OnStats from Update once all chunks are indexed.
+    typedef std::function< void( std::unordered_map<DWORD64, FunctionStats> & a_Stats ) > StatsCallback;
+    void AddChunks( std::shared_ptr<CaptureFileReader> a_Reader, const StatsCallback & a_OnStats = nullptr );
+    void Update();
+
+    // Drops the instances ending before a_Time, their timers were evicted.
+    void RemoveEndingBefore( TickType a_Time );
+
+    // Instances starting in [a_Min, a_Max].
+    bool GetHistogram( DWORD64 a_Function, TickType a_Min, TickType a_Max, Histogram & o_Histogram );
+    bool GetSlowest( DWORD64 a_Function, TickType a_Min, TickType a_Max, Instance & o_Instance );
+    bool GetSlowestInBin( DWORD64 a_Function, TickType a_Min, TickType a_Max, uint32_t a_Bin, Instance & o_Instance );
+
+    static uint32_t GetBin( uint64_t a_DurationNs );
+    static uint64_t GetBinMinNs( uint32_t a_Bin ) { return a_Bin == 0 ? 0 : 1ull << ( a_Bin - 1 ); }
+
+protected:
+    struct Record
+    {
+        TickType m_Start;
+        uint64_t m_DurationNs;
+    };
+
+    struct PendingRecord
+    {
+        DWORD64 m_Function;
+        Record  m_Record;
+    };
+
+    struct Block
+    {
+        uint32_t m_Counts[NumBins];
+        uint32_t m_Slowest;  // index in m_Records
+    };
+
+    struct Function
+    {
+        std::vector<Record> m_Records;
+        std::vector<Block>  m_Blocks;
+        size_t              m_NumSorted = 0;
+    };
+
+    static PendingRecord MakeRecord( const Timer & a_Timer );
+    static Instance MakeInstance( const Record & a_Record );
+    void MergePending( size_t a_MaxRecords = SIZE_MAX );
+    void StopChunkThread();
+    Function* GetSortedFunction( DWORD64 a_Function );
+    void UpdateBlocks( Function & a_Function, size_t a_FirstBlock );
+    void GetRange( const Function & a_Function, TickType a_Min, TickType a_Max, size_t & o_Begin, size_t & o_End ) const;
+
+private:
+    Mutex                                                   m_Mutex;  // queries only
+    std::unordered_map< DWORD64, std::unique_ptr<Function> > m_Functions;
+    LockFreeQueue<PendingRecord>                            m_Pending;
+    std::vector<PendingRecord>                              m_MergeBuffer;
+    std::shared_ptr<std::thread>                            m_ChunkThread;
+    std::atomic<bool>                                       m_ChunkExitRequested;
+    std::atomic<bool>                                       m_ChunkStatsReady;
+    std::unordered_map<DWORD64, FunctionStats>              m_ChunkStats;
+    StatsCallback                                           m_ChunkStatsCallback;
+};
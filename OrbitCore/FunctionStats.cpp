@@ -2,6 +2,7 @@
 #include "Core.h"
 #include "ScopeTimer.h"
 #include "Serialization.h"
+#include <cmath>
 
 //-----------------------------------------------------------------------------
 template< class T >
@@ -19,24 +20,199 @@ inline void UpdateMin( T & a_Min, T a_Value )
         a_Min = a_Value;
 }
 
+//-----------------------------------------------------------------------------
+uint32_t DurationHistogram::GetBucket( uint64_t a_Nanos )
+{
+    if( a_Nanos < SubBuckets )
+        return (uint32_t)a_Nanos;
+
+    uint32_t msb = 63 - CountLeadingZeros( a_Nanos );
+    uint32_t octave = msb - SubBucketBits + 1;
+    if( octave >= NumOctaves )
+        return NumBuckets - 1;
+
+    uint32_t subBucket = (uint32_t)( a_Nanos >> ( msb - SubBucketBits ) ) & ( SubBuckets - 1 );
+    return octave * SubBuckets + subBucket;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t DurationHistogram::GetBucketMin( uint32_t a_Bucket )
+{
+    uint32_t octave = a_Bucket / SubBuckets;
+    uint32_t subBucket = a_Bucket % SubBuckets;
+    return octave == 0 ? subBucket : (uint64_t)( SubBuckets + subBucket ) << ( octave - 1 );
+}
+
+//-----------------------------------------------------------------------------
+uint64_t DurationHistogram::GetBucketMax( uint32_t a_Bucket )
+{
+    uint32_t octave = a_Bucket / SubBuckets;
+    return GetBucketMin( a_Bucket ) + ( octave == 0 ? 0 : ( 1ull << ( octave - 1 ) ) - 1 );
+}
+
+//-----------------------------------------------------------------------------
+void DurationHistogram::Merge( const DurationHistogram & a_Other )
+{
+    for( uint32_t i = 0; i < NumBuckets; ++i )
+    {
+        m_Counts[i] += a_Other.m_Counts[i];
+    }
+}
+
+//-----------------------------------------------------------------------------
+void DurationHistogram::GetPercentiles( const double* a_Percentiles, double* o_Values, uint32_t a_NumPercentiles ) const
+{
+    uint64_t total = 0;
+    for( uint32_t count : m_Counts )
+    {
+        total += count;
+    }
+
+    uint32_t bucket = 0;
+    uint64_t cumulative = m_Counts[0];
+    for( uint32_t i = 0; i < a_NumPercentiles; ++i )
+    {
+        if( total == 0 )
+        {
+            o_Values[i] = 0;
+            continue;
+        }
+
+        // Rank of the percentile, then the bucket holding it.
+        uint64_t rank = std::max<uint64_t>( 1, (uint64_t)std::ceil( a_Percentiles[i] * 0.01 * (double)total ) );
+        while( cumulative < rank && bucket + 1 < NumBuckets )
+        {
+            cumulative += m_Counts[++bucket];
+        }
+
+        o_Values[i] = 0.5 * (double)( GetBucketMin( bucket ) + GetBucketMax( bucket ) );
+    }
+}
+
+//-----------------------------------------------------------------------------
+FunctionStats & FunctionStats::operator=( const FunctionStats & a_Other )
+{
+    if( this != &a_Other )
+    {
+        m_Address = a_Other.m_Address;
+        m_Count = a_Other.m_Count;
+        m_TotalTimeMs = a_Other.m_TotalTimeMs;
+        m_AverageTimeMs = a_Other.m_AverageTimeMs;
+        m_MinMs = a_Other.m_MinMs;
+        m_MaxMs = a_Other.m_MaxMs;
+        m_Histogram.reset( a_Other.m_Histogram ? new DurationHistogram( *a_Other.m_Histogram ) : nullptr );
+    }
+    return *this;
+}
+
+//-----------------------------------------------------------------------------
+void FunctionStats::Reset()
+{
+    m_Address = 0;
+    m_Count = 0;
+    m_TotalTimeMs = 0;
+    m_AverageTimeMs = 0;
+    m_MinMs = 0;
+    m_MaxMs = 0;
+    m_Histogram.reset();
+}
+
 //-----------------------------------------------------------------------------
 void FunctionStats::Update( const Timer & a_Timer )
 {
     ++m_Count;
-    double elapsedMillis = a_Timer.ElapsedMillis();
+    double elapsedMicros = a_Timer.ElapsedMicros();
+    double elapsedMillis = elapsedMicros * 0.001;
     m_TotalTimeMs += elapsedMillis;
-    m_AverageTimeMs = m_TotalTimeMs / (double)m_Count;
     UpdateMax( m_MaxMs, elapsedMillis );
     UpdateMin( m_MinMs, elapsedMillis );
+
+    if( !m_Histogram )
+    {
+        m_Histogram.reset( new DurationHistogram() );
+        m_Histogram->Reset();
+    }
+    m_Histogram->Add( (uint64_t)( elapsedMicros * 1000.0 ) );
 }
 
 //-----------------------------------------------------------------------------
-ORBIT_SERIALIZE( FunctionStats, 0 )
+void FunctionStats::Merge( const FunctionStats & a_Stats )
 {
+    if( a_Stats.m_Count == 0 )
+        return;
+
+    m_Count += a_Stats.m_Count;
+    m_TotalTimeMs += a_Stats.m_TotalTimeMs;
+    UpdateMax( m_MaxMs, a_Stats.m_MaxMs );
+    UpdateMin( m_MinMs, a_Stats.m_MinMs );
+
+    if( a_Stats.m_Histogram )
+    {
+        if( m_Histogram )
+            m_Histogram->Merge( *a_Stats.m_Histogram );
+        else
+            m_Histogram.reset( new DurationHistogram( *a_Stats.m_Histogram ) );
+    }
+}
+
+//-----------------------------------------------------------------------------
+double FunctionStats::GetPercentileMs( double a_Percentile ) const
+{
+    if( !m_Histogram )
+        return 0;
+
+    double nanos = 0;
+    m_Histogram->GetPercentiles( &a_Percentile, &nanos, 1 );
+
+    // Bucket midpoints can fall outside of what was actually measured.
+    return std::min( std::max( nanos * 0.000001, m_MinMs ), m_MaxMs );
+}
+
+//-----------------------------------------------------------------------------
+ORBIT_SERIALIZE( FunctionStats, 1 )
+{
+    if( Archive::is_saving::value )
+    {
+        m_AverageTimeMs = GetAverageTimeMs();
+    }
+
     ORBIT_NVP_VAL( 0, m_Address );
     ORBIT_NVP_VAL( 0, m_Count );
     ORBIT_NVP_VAL( 0, m_TotalTimeMs );
     ORBIT_NVP_VAL( 0, m_AverageTimeMs );
     ORBIT_NVP_VAL( 0, m_MinMs );
     ORBIT_NVP_VAL( 0, m_MaxMs );
+
+    // Histograms are mostly empty, only non zero buckets are stored as
+    // (bucket, count) pairs.
+    std::vector<uint32_t> buckets;
+    if( Archive::is_saving::value && m_Histogram )
+    {
+        for( uint32_t i = 0; i < DurationHistogram::NumBuckets; ++i )
+        {
+            if( m_Histogram->m_Counts[i] )
+            {
+                buckets.push_back( i );
+                buckets.push_back( m_Histogram->m_Counts[i] );
+            }
+        }
+    }
+
+    ORBIT_NVP_VAL( 1, buckets );
+
+    if( Archive::is_loading::value )
+    {
+        m_Histogram.reset();
+        if( buckets.size() >= 2 )
+        {
+            m_Histogram.reset( new DurationHistogram() );
+            m_Histogram->Reset();
+        }
+
+        for( size_t i = 0; i + 1 < buckets.size(); i += 2 )
+        {
+            if( buckets[i] < DurationHistogram::NumBuckets )
+                m_Histogram->m_Counts[buckets[i]] = buckets[i + 1];
+        }
+    }
 }
\ No newline at end of file
@@ -7,20 +7,58 @@
 #include "SerializationMacros.h"
 
 #include <memory>
+#include <string.h>
 
 //-----------------------------------------------------------------------------
+// Log-linear histogram of durations in nanoseconds, HDR histogram style.
+// Values below SubBuckets are exact, above that each power of two is split
+// in SubBuckets linear buckets, so any value is known within 1/SubBuckets.
+// Fixed size, updates are O(1) without allocation and histograms of the
+// same function can simply be added together.
+struct DurationHistogram
+{
+    static const uint32_t SubBucketBits = 5;
+    static const uint32_t SubBuckets = 1 << SubBucketBits;
+    static const uint32_t NumOctaves = 40;  // up to 2^44 ns, ~4.9 hours
+    static const uint32_t NumBuckets = NumOctaves * SubBuckets;
+
+    void Reset() { memset( m_Counts, 0, sizeof(m_Counts) ); }
+    void Add( uint64_t a_Nanos ) { ++m_Counts[GetBucket( a_Nanos )]; }
+    void Merge( const DurationHistogram & a_Other );
+
+    static uint32_t GetBucket( uint64_t a_Nanos );
+    static uint64_t GetBucketMin( uint32_t a_Bucket );
+    static uint64_t GetBucketMax( uint32_t a_Bucket );
+
+    // Values in nanoseconds for a_NumPercentiles sorted percentiles in [0, 100].
+    void GetPercentiles( const double* a_Percentiles, double* o_Values, uint32_t a_NumPercentiles ) const;
+
+    uint32_t m_Counts[NumBuckets];
+};
+
+//-----------------------------------------------------------------------------
+// The histogram is allocated on the first update, most functions of a
+// session are never called.
 struct FunctionStats
 {
     FunctionStats() { Reset(); }
-    void Reset() { memset(this, 0, sizeof(*this)); }
+    FunctionStats( const FunctionStats & a_Other ) { *this = a_Other; }
+    FunctionStats & operator=( const FunctionStats & a_Other );
+
+    void Reset();
     void Update( const class Timer & a_Timer );
-    
+    void Merge( const FunctionStats & a_Stats );
+
+    double GetAverageTimeMs() const { return m_Count ? m_TotalTimeMs / (double)m_Count : 0; }
+    double GetPercentileMs( double a_Percentile ) const;
+
     DWORD64 m_Address;
     ULONG64 m_Count;
     double m_TotalTimeMs;
-    double m_AverageTimeMs;
+    double m_AverageTimeMs;  // only up to date in saved captures, see GetAverageTimeMs
     double m_MinMs;
     double m_MaxMs;
+    std::unique_ptr<DurationHistogram> m_Histogram;
 
     ORBIT_SERIALIZABLE;
-};
\ No newline at end of file
+};
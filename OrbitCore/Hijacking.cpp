@@ -158,7 +158,11 @@ __forceinline CallstackID Hijacking::SendCallstack( void* a_OriginalFunctionAddr
         if( TlsData->m_SentCallstacks.find( cs.m_Hash ) == TlsData->m_SentCallstacks.end() )
         {
             TlsData->m_SentCallstacks.insert( cs.m_Hash );
-            GTcpClient->Send( Msg_Callstack, (void*)&cs, cs.GetSizeInBytes() );
+            Message msg( Msg_Callstack, cs.GetSizeInBytes() );
+            if( !GTcpClient->GetSharedMemory().Write( msg, &cs ) )
+            {
+                GTcpClient->Send( msg, (void*)&cs );
+            }
         }
 
         return cs.m_Hash;
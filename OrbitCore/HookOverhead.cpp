@@ -0,0 +1,157 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "Core.h"
+#include "HookOverhead.h"
+#include "Capture.h"
+#include "OrbitFunction.h"
+#include "Params.h"
+#include "Profiling.h"
+#include "Threading.h"
+#include "Log.h"
+#include <algorithm>
+#include <cfloat>
+
+HookOverhead GHookOverhead;
+
+//-----------------------------------------------------------------------------
+HookOverhead::HookOverhead() : m_TotalOverheadPercent( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+void HookOverhead::Reset()
+{
+    {
+        ScopeLock lock( m_UnhookedMutex );
+        m_Unhooked.clear();
+    }
+    m_Rates.clear();
+    m_TotalOverheadPercent = 0;
+    m_UpdateTimer.Start();
+}
+
+//-----------------------------------------------------------------------------
+double HookOverhead::Calibrate()
+{
+    // An event is what a hook does in the target: two timestamps and a timer
+    // pushed on a lock free queue. Keep the fastest of a few runs.
+    const int numEvents = 100000;
+    LockFreeQueue<Timer> queue;
+    double bestNs = DBL_MAX;
+    for( int run = 0; run < 5; ++run )
+    {
+        TickType start = OrbitTicks();
+        for( int i = 0; i < numEvents; ++i )
+        {
+            Timer timer;
+            timer.m_Start = OrbitTicks();
+            timer.m_FunctionAddress = (DWORD64)i;
+            timer.m_End = OrbitTicks();
+            queue.enqueue( timer );
+        }
+        TickType end = OrbitTicks();
+
+        Timer timer;
+        while( queue.try_dequeue( timer ) ) {}
+
+        bestNs = std::min( bestNs, 1000.0*MicroSecondsFromTicks( start, end )/numEvents );
+    }
+
+#ifdef __linux__
+    // Uprobes add a breakpoint trap and a return trip through the kernel on
+    // entry and on exit.  That part isn't measured, it is a typical figure,
+    // which is why the cost is shown as an estimate.
+    const double estimatedUprobeTrapNs = 1500.0;
+    bestNs += 2*estimatedUprobeTrapNs;
+#endif
+
+    return bestNs;
+}
+
+//-----------------------------------------------------------------------------
+double HookOverhead::GetCostPerEventNs()
+{
+    static double costNs = Calibrate();
+    return costNs;
+}
+
+//-----------------------------------------------------------------------------
+const HookOverhead::Rate* HookOverhead::GetRate( ULONG64 a_Address ) const
+{
+    auto it = m_Rates.find( a_Address );
+    return it != m_Rates.end() ? &it->second : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void HookOverhead::OnUnhooked( const std::vector<ULONG64> & a_Addresses )
+{
+    ScopeLock lock( m_UnhookedMutex );
+    m_Unhooked.insert( m_Unhooked.end(), a_Addresses.begin(), a_Addresses.end() );
+}
+
+//-----------------------------------------------------------------------------
+void HookOverhead::Update()
+{
+    std::vector<ULONG64> unhooked;
+    {
+        ScopeLock lock( m_UnhookedMutex );
+        unhooked.swap( m_Unhooked );
+    }
+
+    for( ULONG64 address : unhooked )
+    {
+        m_Rates[address].m_Unhooked = true;
+    }
+
+    double elapsedMs = m_UpdateTimer.QueryMillis();
+    if( elapsedMs < UpdatePeriodMs )
+    {
+        return;
+    }
+    m_UpdateTimer.Start();
+
+    double costNs = GetCostPerEventNs();
+    double seconds = 0.001*elapsedMs;
+    uint32_t budget = GParams.m_HookEventBudget;
+    std::vector<ULONG64> toUnhook;
+
+    // Counts come from the stats of each hooked function, the map of
+    // hooked functions doesn't change during a capture while the count map
+    // is inserted into by the timer threads.
+    m_TotalOverheadPercent = 0;
+    for( auto & pair : Capture::GSelectedFunctionsMap )
+    {
+        Function* func = pair.second;
+        if( func == nullptr || func->m_Stats == nullptr )
+            continue;
+
+        Rate & rate = m_Rates[pair.first];
+        ULONG64 count = func->m_Stats->m_Count;
+        ULONG64 numEvents = count >= rate.m_LastCount ? count - rate.m_LastCount : count;
+        rate.m_LastCount = count;
+        rate.m_EventsPerSecond = rate.m_Unhooked ? 0 : numEvents/seconds;
+        rate.m_OverheadPercent = 100.0*rate.m_EventsPerSecond*costNs*0.000000001;
+        m_TotalOverheadPercent += rate.m_OverheadPercent;
+
+        std::string name = func->PrettyNameStr();
+        if( !rate.m_Warned && rate.m_OverheadPercent > WarningOverheadPercent )
+        {
+            ORBIT_LOG( Format( "Hook on %s costs about %.1f%% of a core (%.0f events/s)", name.c_str(), rate.m_OverheadPercent, rate.m_EventsPerSecond ) );
+            rate.m_Warned = true;
+        }
+
+        if( budget > 0 && !rate.m_UnhookRequested && rate.m_EventsPerSecond > budget )
+        {
+            ORBIT_LOG( Format( "Unhooking %s, %.0f events/s is over the budget of %u", name.c_str(), rate.m_EventsPerSecond, budget ) );
+            rate.m_UnhookRequested = true;
+            toUnhook.push_back( pair.first );
+        }
+    }
+
+    if( !toUnhook.empty() )
+    {
+        Capture::UnhookFunctions( toUnhook );
+    }
+}
@@ -0,0 +1,58 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "BaseTypes.h"
+#include "ScopeTimer.h"
+#include "Threading.h"
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Estimates what the hooks of a capture cost the target from the event rate
+// of each hooked function and an estimated cost per event, only the in
+// process part of which is measured. Functions going
+// over GParams.m_HookEventBudget events per second get unhooked, they only
+// count as unhooked once the hooking backend confirms it through OnUnhooked.
+class HookOverhead
+{
+public:
+    struct Rate
+    {
+        ULONG64 m_LastCount = 0;
+        double  m_EventsPerSecond = 0;
+        double  m_OverheadPercent = 0;  // of one core
+        bool    m_Warned = false;
+        bool    m_UnhookRequested = false;
+        bool    m_Unhooked = false;
+    };
+
+    HookOverhead();
+    void Reset();
+    void Update();
+
+    // Can be called from any thread, applied on the next Update.
+    void OnUnhooked( const std::vector<ULONG64> & a_Addresses );
+
+    const Rate* GetRate( ULONG64 a_Address ) const;
+    double GetTotalOverheadPercent() const { return m_TotalOverheadPercent; }
+
+    // Estimated cost of one event (an entry and an exit), computed once.
+    static double GetCostPerEventNs();
+
+    static const int UpdatePeriodMs = 1000;
+    static constexpr double WarningOverheadPercent = 5.0;
+
+protected:
+    static double Calibrate();
+
+private:
+    std::unordered_map< ULONG64, Rate > m_Rates;
+    Mutex                               m_UnhookedMutex;
+    std::vector<ULONG64>                m_Unhooked;
+    Timer                               m_UpdateTimer;
+    double                              m_TotalOverheadPercent;
+};
+
+extern HookOverhead GHookOverhead;
@@ -14,6 +14,9 @@
 #include "Capture.h"
 #include "ScopeTimer.h"
 #include "OrbitProcess.h"
+#include "ModuleTimeline.h"
+#include "CaptureStream.h"
+#include "Log.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -33,16 +36,51 @@
 #include <cstdlib>
 #include <memory>
 #include <cxxabi.h>
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
 
 namespace LinuxUtils {
 
+//-----------------------------------------------------------------------------
+bool ReadProcFile( const char* a_Path, std::string & o_Buffer )
+{
+    o_Buffer.clear();
+    int fd = open( a_Path, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 )
+        return false;
+
+    // procfs reports a size of 0, read until EOF reusing the buffer capacity.
+    size_t size = 0;
+    if( o_Buffer.capacity() < 4096 )
+        o_Buffer.reserve( 4096 );
+
+    while( true )
+    {
+        o_Buffer.resize( o_Buffer.capacity() );
+        ssize_t numRead = read( fd, &o_Buffer[size], o_Buffer.size() - size );
+        if( numRead <= 0 )
+            break;
+
+        size += numRead;
+        if( size == o_Buffer.size() )
+            o_Buffer.reserve( 2*o_Buffer.size() );
+    }
+
+    close( fd );
+    o_Buffer.resize( size );
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 std::vector<std::string> ListModules( uint32_t a_PID )
 {
     std::vector<std::string> modules;
-    std::string result = ExecuteCommand( Format("cat /proc/%u/maps", a_PID).c_str() );
+    static thread_local std::string buffer;
+    if( !ReadProcFile( Format("/proc/%u/maps", a_PID).c_str(), buffer ) )
+        return modules;
 
-    std::stringstream ss(result);
+    std::stringstream ss(buffer);
     std::string line;
     while(std::getline(ss,line,'\n'))
     {
@@ -69,87 +107,273 @@ std::string ExecuteCommand( const char* a_Cmd )
 }
 
 //-----------------------------------------------------------------------------
-void ListModules( uint32_t a_PID, std::map< DWORD64, std::shared_ptr<Module> > & o_ModuleMap )
+// Skips a_Count whitespace separated fields, returns the start of the next one.
+static const char* SkipFields( const char* a_Pos, const char* a_End, int a_Count )
+{
+    for( int i = 0; i < a_Count; ++i )
+    {
+        while( a_Pos < a_End && *a_Pos != ' ' && *a_Pos != '\n' ) ++a_Pos;
+        while( a_Pos < a_End && *a_Pos == ' ' ) ++a_Pos;
+    }
+    return a_Pos;
+}
+
+//-----------------------------------------------------------------------------
+// Calls a_Callback( start, end, perms, name, nameLength ) for every line of
+// /proc/<pid>/maps that has a path name.
+template <class Callback>
+static bool ForEachMapping( uint32_t a_PID, Callback a_Callback )
 {
-    std::map<std::string, std::shared_ptr<Module>> modules;
-    std::vector<std::string> result = ListModules( a_PID );
-    for( const std::string& line : result )
+    static thread_local std::string buffer;
+    char path[64];
+    snprintf( path, sizeof(path), "/proc/%u/maps", a_PID );
+    if( !ReadProcFile( path, buffer ) )
+        return false;
+
+    // "start-end perms offset dev inode    pathname"
+    const char* pos = buffer.data();
+    const char* end = pos + buffer.size();
+
+    while( pos < end )
     {
-        std::vector<std::string> tokens = Tokenize( line ); 
-        if( tokens.size() == 6 )
+        const char* lineEnd = (const char*)memchr( pos, '\n', end - pos );
+        if( lineEnd == nullptr )
+            lineEnd = end;
+
+        char* next = nullptr;
+        uint64_t start = strtoull( pos, &next, 16 );
+        uint64_t stop = (next < lineEnd && *next == '-') ? strtoull( next + 1, &next, 16 ) : 0;
+        const char* perms = SkipFields( next, lineEnd, 1 );
+        const char* name = SkipFields( perms, lineEnd, 4 );
+
+        if( stop > start && name < lineEnd )
         {
-            std::string& moduleName = tokens[5];
-            
-            auto addresses = Tokenize(tokens[0], "-");
-            if( addresses.size() == 2 )
-            {
-                auto iter = modules.find(moduleName);
-                std::shared_ptr<Module> module = 
-                    (iter == modules.end()) ? std::make_shared<Module>() : iter->second;
-
-                uint64_t start = std::stoull(addresses[0], nullptr, 16);
-                uint64_t end = std::stoull(addresses[1], nullptr, 16);
-                
-                if( module->m_AddressStart == 0 || start < module->m_AddressStart )
-                    module->m_AddressStart = start;
-                if( end > module->m_AddressEnd )
-                    module->m_AddressEnd = end;
-                
-                module->m_FullName = s2ws(moduleName);
-                module->m_Name = Path::GetFileName( module->m_FullName );;
-                module->m_Directory = Path::GetDirectory( module->m_FullName );
-                auto prettyName = module->GetPrettyName();
-                modules[moduleName] = module;
-            }
+            a_Callback( start, stop, perms, name, (size_t)( lineEnd - name ) );
         }
+
+        pos = lineEnd + 1;
     }
 
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void ListModules( uint32_t a_PID, std::map< DWORD64, std::shared_ptr<Module> > & o_ModuleMap )
+{
+    std::unordered_map<std::string, std::shared_ptr<Module>> modules;
+    std::string moduleName;
+
+    ForEachMapping( a_PID, [&]( uint64_t a_Start, uint64_t a_End, const char*, const char* a_Name, size_t a_NameLength )
+    {
+        moduleName.assign( a_Name, a_NameLength );
+        std::shared_ptr<Module> & module = modules[moduleName];
+        if( module == nullptr )
+        {
+            module = std::make_shared<Module>();
+            module->m_FullName = s2ws(moduleName);
+            module->m_Name = Path::GetFileName( module->m_FullName );
+            module->m_Directory = Path::GetDirectory( module->m_FullName );
+        }
+
+        if( module->m_AddressStart == 0 || a_Start < module->m_AddressStart )
+            module->m_AddressStart = a_Start;
+        if( a_End > module->m_AddressEnd )
+            module->m_AddressEnd = a_End;
+    } );
+
     for( auto& iter : modules )
     {
         auto module = iter.second;
+        module->GetPrettyName();
         o_ModuleMap[module->m_AddressStart] = module;
     }
 }
 
+//-----------------------------------------------------------------------------
+void ListExecutableMappings( uint32_t a_PID, std::vector<LinuxMapping> & o_Mappings )
+{
+    o_Mappings.clear();
+    ForEachMapping( a_PID, [&]( uint64_t a_Start, uint64_t a_End, const char* a_Perms, const char* a_Name, size_t a_NameLength )
+    {
+        if( a_Perms[2] == 'x' )
+        {
+            o_Mappings.push_back( { a_Start, a_End, std::string( a_Name, a_NameLength ) } );
+        }
+    } );
+}
+
+//-----------------------------------------------------------------------------
+template <class Callback>
+static void ForEachNumericEntry( const char* a_Directory, Callback a_Callback )
+{
+    DIR* dir = opendir( a_Directory );
+    if( dir == nullptr )
+        return;
+
+    while( struct dirent* entry = readdir( dir ) )
+    {
+        const char* name = entry->d_name;
+        if( *name < '0' || *name > '9' )
+            continue;
+
+        char* end = nullptr;
+        unsigned long id = strtoul( name, &end, 10 );
+        if( *end == 0 )
+            a_Callback( (uint32_t)id );
+    }
+
+    closedir( dir );
+}
+
 //-----------------------------------------------------------------------------
 uint32_t GetPID(const char* a_Name)
 {
-    std::string command = Format("ps -A | grep %s", a_Name);
-    std::string result = ExecuteCommand( command.c_str() );
-    auto tokens = Tokenize(result);
-    if( !tokens.empty() )
-        return (uint32_t)atoi(tokens[0].c_str());
-    std::cout << "Could not find process " << a_Name;
-    return 0;
+    uint32_t result = 0;
+    std::string buffer;
+    char path[64];
+
+    ForEachNumericEntry( "/proc", [&]( uint32_t a_PID )
+    {
+        if( result != 0 )
+            return;
+
+        snprintf( path, sizeof(path), "/proc/%u/comm", a_PID );
+        if( ReadProcFile( path, buffer ) )
+        {
+            RemoveTrailingNewLine( buffer );
+            if( buffer == a_Name )
+                result = a_PID;
+        }
+    } );
+
+    if( result == 0 )
+        std::cout << "Could not find process " << a_Name;
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint32_t> ListThreads( uint32_t a_PID )
+{
+    std::vector<uint32_t> threads;
+    char path[64];
+    snprintf( path, sizeof(path), "/proc/%u/task", a_PID );
+    ForEachNumericEntry( path, [&]( uint32_t a_TID ){ threads.push_back( a_TID ); } );
+    return threads;
+}
+
+//-----------------------------------------------------------------------------
+std::string GetThreadName( uint32_t a_PID, uint32_t a_TID )
+{
+    std::string name;
+    char path[96];
+    snprintf( path, sizeof(path), "/proc/%u/task/%u/comm", a_PID, a_TID );
+    ReadProcFile( path, name );
+    RemoveTrailingNewLine( name );
+    return name;
+}
+
+//-----------------------------------------------------------------------------
+// Reads utime+stime and starttime (in clock ticks) from /proc/<pid>/stat.
+static bool GetProcessTicks( const char* a_Path, std::string & a_Buffer, uint64_t & o_CpuTicks, uint64_t & o_StartTicks )
+{
+    if( !ReadProcFile( a_Path, a_Buffer ) )
+        return false;
+
+    // The command name can contain spaces and parentheses, fields start after the last ')'.
+    size_t commEnd = a_Buffer.rfind( ')' );
+    if( commEnd == std::string::npos )
+        return false;
+
+    const char* pos = a_Buffer.data() + commEnd + 2;
+    const char* end = a_Buffer.data() + a_Buffer.size();
+
+    // Fields 14 (utime), 15 (stime) and 22 (starttime), we start at field 3 (state).
+    pos = SkipFields( pos, end, 11 );
+    if( pos >= end ) return false;
+    char* next = nullptr;
+    uint64_t utime = strtoull( pos, &next, 10 );
+    uint64_t stime = strtoull( next, &next, 10 );
+    pos = SkipFields( next + 1, end, 6 );
+    if( pos >= end ) return false;
+    o_StartTicks = strtoull( pos, nullptr, 10 );
+    o_CpuTicks = utime + stime;
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 std::unordered_map<uint32_t, float> GetCpuUtilization()
 {
+    // Cpu usage is computed from the tick delta since the previous call.  For
+    // processes seen for the first time we fall back to their average usage
+    // since they started, which is what "top -b -n 1" reported.
+    static Mutex mutex;
+    static std::unordered_map<uint32_t, uint64_t> previousTicks;
+    static uint64_t previousTime = 0;
+    static thread_local std::string buffer;
+    ScopeLock lock( mutex );
+
+    const double ticksPerSecond = (double)sysconf( _SC_CLK_TCK );
+    double uptimeSeconds = 0;
+    if( ReadProcFile( "/proc/uptime", buffer ) )
+        uptimeSeconds = strtod( buffer.c_str(), nullptr );
+
+    uint64_t now = OrbitTicks( CLOCK_MONOTONIC );
+    double elapsedSeconds = previousTime ? 0.000000001*(double)( now - previousTime ) : 0.0;
+    previousTime = now;
+
     std::unordered_map<uint32_t, float> processMap;
-    std::string result = ExecuteCommand("top -b -n 1 | sed -n '8, 1000{s/^ *//;s/ *$//;s/  */,/gp;};1000q'");
-    std::stringstream ss(result);
-    std::string line;
+    std::unordered_map<uint32_t, uint64_t> currentTicks;
+    processMap.reserve( previousTicks.size() );
+    currentTicks.reserve( previousTicks.size() );
+    char path[64];
 
-    while (std::getline(ss, line, '\n'))
+    ForEachNumericEntry( "/proc", [&]( uint32_t a_PID )
     {
-        auto tokens = Tokenize(line, ",");
-        if( tokens.size() > 8)
+        snprintf( path, sizeof(path), "/proc/%u/stat", a_PID );
+        uint64_t cpuTicks = 0;
+        uint64_t startTicks = 0;
+        if( !GetProcessTicks( path, buffer, cpuTicks, startTicks ) )
+            return;
+
+        currentTicks[a_PID] = cpuTicks;
+
+        double seconds = 0;
+        uint64_t deltaTicks = 0;
+        auto it = previousTicks.find( a_PID );
+        if( it != previousTicks.end() && elapsedSeconds > 0 && cpuTicks >= it->second )
         {
-            uint32_t pid = atoi(tokens[0].c_str());
-            float cpu = atof(tokens[8].c_str());
-            processMap[pid] = cpu;
+            deltaTicks = cpuTicks - it->second;
+            seconds = elapsedSeconds;
+        }
+        else
+        {
+            deltaTicks = cpuTicks;
+            seconds = uptimeSeconds - (double)startTicks/ticksPerSecond;
         }
-    }
 
+        processMap[a_PID] = seconds > 0 ? (float)( 100.0*( (double)deltaTicks/ticksPerSecond )/seconds ) : 0.f;
+    } );
+
+    previousTicks.swap( currentTicks );
     return processMap;
 }
 
 //-----------------------------------------------------------------------------
 bool Is64Bit( uint32_t a_PID )
 {
-    std::string result = ExecuteCommand(Format("file -L /proc/%u/exe", a_PID).c_str());
-    return Contains(result, "64-bit");
+    char path[64];
+    snprintf( path, sizeof(path), "/proc/%u/exe", a_PID );
+    int fd = open( path, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 )
+        return false;
+
+    unsigned char ident[EI_NIDENT] = {};
+    ssize_t numRead = read( fd, ident, sizeof(ident) );
+    close( fd );
+
+    return numRead == (ssize_t)sizeof(ident) &&
+           memcmp( ident, ELFMAG, SELFMAG ) == 0 &&
+           ident[EI_CLASS] == ELFCLASS64;
 }
 
 //-----------------------------------------------------------------------------
@@ -214,6 +438,28 @@ void StreamCommandOutput(const char* a_Cmd, std::function<void(const std::string
     std::cout << "end stream" << std::endl;
 }
 
+//-----------------------------------------------------------------------------
+void StreamCommandOutputRaw(const char* a_Cmd, std::function<void(const char*, size_t)> a_Callback, bool* a_ExitRequested)
+{
+    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(a_Cmd, "r"), pclose);
+    if (!pipe)
+    {
+        ORBIT_LOG( Format( "Could not open pipe for %s", a_Cmd ) );
+        return;
+    }
+
+    // Hand over whatever is available, the callback deals with records
+    // straddling two reads.
+    std::vector<char> buffer(64*1024);
+    int fd = fileno(pipe.get());
+    ssize_t numBytes;
+    while ( !(*a_ExitRequested) &&
+            (numBytes = read(fd, buffer.data(), buffer.size())) > 0 )
+    {
+        a_Callback(buffer.data(), (size_t)numBytes);
+    }
+}
+
 }
 
 //-----------------------------------------------------------------------------
@@ -264,7 +510,7 @@ void LinuxPerf::Stop()
     m_IsRunning = false;
 
     //m_Thread = std::make_shared<std::thread>([this]{
-        std::string cmd = Format("perf script -i %s > %s", m_OutputFile.c_str(), m_ReportFile.c_str());
+        std::string cmd = Format("perf script --show-mmap-events -i %s > %s", m_OutputFile.c_str(), m_ReportFile.c_str());
         PRINT_VAR(cmd);
         LinuxUtils::ExecuteCommand(cmd.c_str());
         LoadPerfData(m_ReportFile);
@@ -294,8 +540,32 @@ void LinuxPerf::LoadPerfData( const std::string& a_FileName )
 
     CallStack CS;
 
+    ModuleTimeline & moduleTimeline = Capture::GTargetProcess->GetModuleTimeline();
+
     for (std::string line; std::getline(inFile, line); )
     {
+        // "comm tid time: PERF_RECORD_MMAP2 pid/tid: [0xstart(0xsize) @ ...]: r-xp /path"
+        size_t mmapPos = line.find("PERF_RECORD_MMAP2");
+        if( mmapPos != std::string::npos )
+        {
+            auto tokens = Tokenize(line.substr(0, mmapPos));
+            uint64_t mmapTime = tokens.size() > 0 ? GetMicros(tokens.back())*1000 : 0;
+            size_t rangePos = line.find("[0x", mmapPos);
+            size_t permsPos = line.find("]: ", mmapPos);
+            if( rangePos != std::string::npos && permsPos != std::string::npos && permsPos + 8 < line.size() )
+            {
+                char* next = nullptr;
+                uint64_t start = strtoull(line.c_str() + rangePos + 1, &next, 16);
+                uint64_t size = *next == '(' ? strtoull(next + 1, nullptr, 16) : 0;
+                const char* perms = line.c_str() + permsPos + 3;
+                if( size > 0 && perms[2] == 'x' )
+                {
+                    moduleTimeline.OnMap(mmapTime, start, start + size, s2ws(line.substr(permsPos + 8)));
+                }
+            }
+            continue;
+        }
+
         bool isHeader = !line.empty() && !StartsWith(line, "\t");
         bool isStackLine = !isHeader && !line.empty();
         bool isEndBlock = !isStackLine && line.empty() && !header.empty();
@@ -323,6 +593,11 @@ void LinuxPerf::LoadPerfData( const std::string& a_FileName )
                 {
                     address = moduleFromName->ValidateAddress(address);
                 }
+                else if( Module* module = Capture::GTargetProcess->FindModuleByAddress( address, time ) )
+                {
+                    // Module mapped during the capture, use the mapping live at sample time.
+                    moduleFullName = ws2s( module->m_FullName );
+                }
 
                 CS.m_Data.push_back(address);
 
@@ -347,8 +622,9 @@ void LinuxPerf::LoadPerfData( const std::string& a_FileName )
             {
                 CS.m_Depth = CS.m_Data.size();
                 CS.m_ThreadId = tid;
-                Capture::GSamplingProfiler->AddCallStack( CS );
+                Capture::GSamplingProfiler->AddCallStack( CS, time );
                 GEventTracer.GetEventBuffer().AddCallstackEvent( time, CS );
+                GCaptureStream.AddSample( time, CS );
                 ++numCallstacks;
             }
             
@@ -363,3 +639,82 @@ void LinuxPerf::LoadPerfData( const std::string& a_FileName )
     PRINT_FUNC;
 }
 
+
+//-----------------------------------------------------------------------------
+LinuxModuleTracker::LinuxModuleTracker( uint32_t a_PID, ModuleTimeline & a_Timeline, uint32_t a_PeriodMs )
+                                      : m_PID( a_PID )
+                                      , m_PeriodMs( a_PeriodMs )
+                                      , m_Timeline( a_Timeline )
+                                      , m_ExitRequested( true )
+{
+}
+
+//-----------------------------------------------------------------------------
+LinuxModuleTracker::~LinuxModuleTracker()
+{
+    Stop();
+}
+
+//-----------------------------------------------------------------------------
+void LinuxModuleTracker::Start()
+{
+    // Mappings present at start are attributed from the beginning of time.
+    LinuxUtils::ListExecutableMappings( m_PID, m_Mappings );
+    std::sort( m_Mappings.begin(), m_Mappings.end() );
+    for( const LinuxMapping & mapping : m_Mappings )
+    {
+        m_Timeline.OnMap( 0, mapping.m_Start, mapping.m_End, s2ws( mapping.m_Name ) );
+    }
+
+    m_ExitRequested = false;
+    m_Thread = std::make_shared<std::thread>( &LinuxModuleTracker::Run, this );
+}
+
+//-----------------------------------------------------------------------------
+void LinuxModuleTracker::Stop()
+{
+    m_ExitRequested = true;
+    if( m_Thread && m_Thread->joinable() )
+    {
+        m_Thread->join();
+    }
+    m_Thread = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void LinuxModuleTracker::Run()
+{
+    std::vector<LinuxMapping> mappings;
+
+    while( !m_ExitRequested )
+    {
+        Sleep( m_PeriodMs );
+        uint64_t time = OrbitTicks( CLOCK_MONOTONIC );
+        LinuxUtils::ListExecutableMappings( m_PID, mappings );
+        std::sort( mappings.begin(), mappings.end() );
+
+        // Both lists are sorted, walk them together to find the differences.
+        auto prev = m_Mappings.begin();
+        auto curr = mappings.begin();
+        while( prev != m_Mappings.end() || curr != mappings.end() )
+        {
+            if( curr == mappings.end() || ( prev != m_Mappings.end() && *prev < *curr ) )
+            {
+                m_Timeline.OnUnmap( time, prev->m_Start, prev->m_End );
+                ++prev;
+            }
+            else if( prev == m_Mappings.end() || *curr < *prev )
+            {
+                m_Timeline.OnMap( time, curr->m_Start, curr->m_End, s2ws( curr->m_Name ) );
+                ++curr;
+            }
+            else
+            {
+                ++prev;
+                ++curr;
+            }
+        }
+
+        m_Mappings.swap( mappings );
+    }
+}
@@ -11,16 +11,39 @@
 #include <thread>
 #include <unordered_map>
 #include <functional>
+#include <atomic>
 
 struct Module;
+class ModuleTimeline;
+
+//-----------------------------------------------------------------------------
+struct LinuxMapping
+{
+    uint64_t    m_Start;
+    uint64_t    m_End;
+    std::string m_Name;
+
+    bool operator<( const LinuxMapping & a_Other ) const
+    {
+        if( m_Start != a_Other.m_Start ) return m_Start < a_Other.m_Start;
+        if( m_End != a_Other.m_End ) return m_End < a_Other.m_End;
+        return m_Name < a_Other.m_Name;
+    }
+};
 
 //-----------------------------------------------------------------------------
 namespace LinuxUtils
 {
     std::string ExecuteCommand( const char* a_Cmd );
     void StreamCommandOutput(const char* a_Cmd, std::function<void(const std::string&)> a_Callback, bool* a_ExitRequested);
+    void StreamCommandOutputRaw(const char* a_Cmd, std::function<void(const char*, size_t)> a_Callback, bool* a_ExitRequested);
+    bool ReadProcFile( const char* a_Path, std::string & o_Buffer );
     std::vector<std::string> ListModules( uint32_t a_PID );
     void ListModules( uint32_t a_PID, std::map< DWORD64, std::shared_ptr<Module> > & o_ModuleMap );
+    void ListExecutableMappings( uint32_t a_PID, std::vector<LinuxMapping> & o_Mappings );
+    std::vector<uint32_t> ListThreads( uint32_t a_PID );
+    std::string GetThreadName( uint32_t a_PID, uint32_t a_TID );
+    uint32_t GetPID( const char* a_Name );
     std::unordered_map<uint32_t, float> GetCpuUtilization();
     bool Is64Bit(uint32_t a_PID);
     std::string Demangle( const char* a_Symbol );
@@ -47,6 +70,28 @@ private:
     std::string m_ReportFile;
 };
 
+//-----------------------------------------------------------------------------
+// Polls the executable mappings of a process during a capture and records
+// loads/unloads (dlopen, dlclose, jit code) in a ModuleTimeline.
+class LinuxModuleTracker
+{
+public:
+    LinuxModuleTracker( uint32_t a_PID, ModuleTimeline & a_Timeline, uint32_t a_PeriodMs = 100 );
+    ~LinuxModuleTracker();
+    void Start();
+    void Stop();
+
+private:
+    void Run();
+
+    uint32_t                     m_PID = 0;
+    uint32_t                     m_PeriodMs = 100;
+    ModuleTimeline &             m_Timeline;
+    std::vector<LinuxMapping>    m_Mappings;
+    std::shared_ptr<std::thread> m_Thread;
+    std::atomic<bool>            m_ExitRequested;
+};
+
 //-----------------------------------------------------------------------------
 struct LinuxSymbol
 {
@@ -0,0 +1,211 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "Lz4.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static const int    HashLog = 16;
+static const size_t MinMatch = 4;
+static const size_t LastLiterals = 5;   // the block always ends with literals
+static const size_t MatchFindLimit = 12; // no match may start past size - 12
+static const size_t MaxOffset = 65535;
+
+//-----------------------------------------------------------------------------
+static inline uint32_t Read32( const char* a_Ptr )
+{
+    uint32_t value;
+    memcpy( &value, a_Ptr, sizeof( value ) );
+    return value;
+}
+
+//-----------------------------------------------------------------------------
+static inline uint32_t Hash( uint32_t a_Value )
+{
+    return ( a_Value * 2654435761u ) >> ( 32 - HashLog );
+}
+
+//-----------------------------------------------------------------------------
+static inline char* WriteLength( char* a_Dest, size_t a_Length )
+{
+    for( ; a_Length >= 255; a_Length -= 255 )
+    {
+        *a_Dest++ = (char)255;
+    }
+    *a_Dest++ = (char)a_Length;
+    return a_Dest;
+}
+
+//-----------------------------------------------------------------------------
+static inline char* WriteSequence( char* a_Dest, const char* a_Literals, size_t a_NumLiterals, size_t a_Offset, size_t a_MatchLength )
+{
+    char* token = a_Dest++;
+    uint8_t literalBits = a_NumLiterals >= 15 ? 15 : (uint8_t)a_NumLiterals;
+    if( literalBits == 15 )
+    {
+        a_Dest = WriteLength( a_Dest, a_NumLiterals - 15 );
+    }
+
+    if( a_NumLiterals )
+    {
+        memcpy( a_Dest, a_Literals, a_NumLiterals );
+        a_Dest += a_NumLiterals;
+    }
+
+    uint8_t matchBits = 0;
+    if( a_MatchLength > 0 )
+    {
+        *a_Dest++ = (char)( a_Offset & 0xFF );
+        *a_Dest++ = (char)( a_Offset >> 8 );
+
+        size_t matchLength = a_MatchLength - MinMatch;
+        matchBits = matchLength >= 15 ? 15 : (uint8_t)matchLength;
+        if( matchBits == 15 )
+        {
+            a_Dest = WriteLength( a_Dest, matchLength - 15 );
+        }
+    }
+
+    *token = (char)( ( literalBits << 4 ) | matchBits );
+    return a_Dest;
+}
+
+//-----------------------------------------------------------------------------
+size_t Lz4::CompressBound( size_t a_Size )
+{
+    return a_Size + a_Size/255 + 16;
+}
+
+//-----------------------------------------------------------------------------
+size_t Lz4::Compress( const char* a_Source, size_t a_Size, char* a_Dest )
+{
+    char* dest = a_Dest;
+    size_t anchor = 0;
+
+    if( a_Size > MatchFindLimit )
+    {
+        // Positions are stored + 1, 0 is an empty slot.
+        thread_local std::vector<uint32_t> table;
+        table.assign( (size_t)1 << HashLog, 0 );
+
+        const size_t matchFindEnd = a_Size - MatchFindLimit;
+        const size_t matchEnd = a_Size - LastLiterals;
+        size_t pos = 0;
+
+        while( pos < matchFindEnd )
+        {
+            uint32_t value = Read32( a_Source + pos );
+            uint32_t & slot = table[Hash( value )];
+            size_t ref = slot;
+            slot = (uint32_t)( pos + 1 );
+
+            if( ref == 0 || pos + 1 - ref > MaxOffset || Read32( a_Source + ref - 1 ) != value )
+            {
+                // Skip faster through data that does not compress.
+                pos += 1 + ( ( pos - anchor ) >> 6 );
+                continue;
+            }
+
+            size_t match = ref - 1;
+            while( pos > anchor && match > 0 && a_Source[pos - 1] == a_Source[match - 1] )
+            {
+                --pos;
+                --match;
+            }
+
+            size_t length = MinMatch;
+            while( pos + length < matchEnd && a_Source[pos + length] == a_Source[match + length] )
+            {
+                ++length;
+            }
+
+            dest = WriteSequence( dest, a_Source + anchor, pos - anchor, pos - match, length );
+            pos += length;
+            anchor = pos;
+
+            if( pos - 2 < matchFindEnd )
+            {
+                table[Hash( Read32( a_Source + pos - 2 ) )] = (uint32_t)( pos - 1 );
+            }
+        }
+    }
+
+    dest = WriteSequence( dest, a_Source + anchor, a_Size - anchor, 0, 0 );
+    return (size_t)( dest - a_Dest );
+}
+
+//-----------------------------------------------------------------------------
+static inline bool ReadLength( const uint8_t* & a_Source, const uint8_t* a_End, size_t & o_Length )
+{
+    uint8_t byte;
+    do
+    {
+        if( a_Source >= a_End )
+            return false;
+        byte = *a_Source++;
+        o_Length += byte;
+    } while( byte == 255 );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool Lz4::Decompress( const char* a_Source, size_t a_Size, char* a_Dest, size_t a_DestSize )
+{
+    const uint8_t* source = (const uint8_t*)a_Source;
+    const uint8_t* sourceEnd = source + a_Size;
+    char* dest = a_Dest;
+    char* destEnd = a_Dest + a_DestSize;
+
+    while( source < sourceEnd )
+    {
+        uint8_t token = *source++;
+
+        size_t numLiterals = token >> 4;
+        if( numLiterals == 15 && !ReadLength( source, sourceEnd, numLiterals ) )
+            return false;
+        if( numLiterals > (size_t)( sourceEnd - source ) || numLiterals > (size_t)( destEnd - dest ) )
+            return false;
+
+        memcpy( dest, source, numLiterals );
+        source += numLiterals;
+        dest += numLiterals;
+
+        // The last sequence has no match.
+        if( source == sourceEnd )
+            break;
+
+        if( sourceEnd - source < 2 )
+            return false;
+        size_t offset = source[0] | ( source[1] << 8 );
+        source += 2;
+        if( offset == 0 || offset > (size_t)( dest - a_Dest ) )
+            return false;
+
+        size_t length = token & 15;
+        if( length == 15 && !ReadLength( source, sourceEnd, length ) )
+            return false;
+        length += MinMatch;
+        if( length > (size_t)( destEnd - dest ) )
+            return false;
+
+        const char* match = dest - offset;
+        if( offset >= length )
+        {
+            memcpy( dest, match, length );
+            dest += length;
+        }
+        else
+        {
+            // Overlapping copy repeats the last offset bytes.
+            for( size_t i = 0; i < length; ++i )
+            {
+                *dest++ = *match++;
+            }
+        }
+    }
+
+    return dest == destEnd;
+}
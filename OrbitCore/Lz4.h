@@ -0,0 +1,22 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include <cstddef>
+
+//-----------------------------------------------------------------------------
+// Single block compressor producing the LZ4 block format, used for capture
+// chunks.  Favors speed over ratio, input is expected to already be delta
+// encoded.
+//-----------------------------------------------------------------------------
+namespace Lz4
+{
+    size_t CompressBound( size_t a_Size );
+
+    // Returns the compressed size, a_Dest must hold CompressBound( a_Size ) bytes.
+    size_t Compress( const char* a_Source, size_t a_Size, char* a_Dest );
+
+    // Returns false if a_Source is not a valid block decompressing to exactly a_DestSize bytes.
+    bool Decompress( const char* a_Source, size_t a_Size, char* a_Dest, size_t a_DestSize );
+}
@@ -0,0 +1,113 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "MappedFile.h"
+#include "Utils.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+MappedFile::MappedFile()
+{
+}
+
+//-----------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+bool MappedFile::Open( const std::string & a_FileName )
+{
+    Close();
+
+#ifdef _WIN32
+    m_File = CreateFileA( a_FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if( m_File == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( m_File, &size ) || size.QuadPart == 0 )
+    {
+        Close();
+        return false;
+    }
+
+    m_Mapping = CreateFileMappingA( m_File, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    m_Data = m_Mapping ? (const char*)MapViewOfFile( m_Mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+    m_Size = (uint64_t)size.QuadPart;
+#else
+    m_File = open( a_FileName.c_str(), O_RDONLY );
+    if( m_File < 0 )
+        return false;
+
+    struct stat info;
+    if( fstat( m_File, &info ) != 0 || info.st_size == 0 )
+    {
+        Close();
+        return false;
+    }
+
+    void* data = mmap( nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_File, 0 );
+    m_Data = data != MAP_FAILED ? (const char*)data : nullptr;
+    m_Size = (uint64_t)info.st_size;
+#endif
+
+    if( m_Data == nullptr )
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if( m_Data )
+        UnmapViewOfFile( m_Data );
+    if( m_Mapping )
+        CloseHandle( m_Mapping );
+    if( m_File != INVALID_HANDLE_VALUE )
+        CloseHandle( m_File );
+    m_Mapping = nullptr;
+    m_File = INVALID_HANDLE_VALUE;
+#else
+    if( m_Data )
+        munmap( (void*)m_Data, (size_t)m_Size );
+    if( m_File >= 0 )
+        close( m_File );
+    m_File = -1;
+#endif
+
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+//-----------------------------------------------------------------------------
+void MappedFile::Release( uint64_t a_Offset, uint64_t a_Size ) const
+{
+#ifdef _WIN32
+    // Clean file backed pages are trimmed from the working set on demand.
+    UNUSED( a_Offset );
+    UNUSED( a_Size );
+#else
+    // Only whole pages inside the range can be dropped.
+    const uint64_t pageSize = (uint64_t)sysconf( _SC_PAGESIZE );
+    uint64_t begin = ( a_Offset + pageSize - 1 ) & ~( pageSize - 1 );
+    uint64_t end = ( a_Offset + a_Size ) & ~( pageSize - 1 );
+    if( m_Data && begin < end && end <= m_Size )
+    {
+        madvise( (void*)( m_Data + begin ), (size_t)( end - begin ), MADV_DONTNEED );
+    }
+#endif
+}
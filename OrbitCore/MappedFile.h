@@ -0,0 +1,42 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "Platform.h"
+
+#include <cstdint>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Read-only memory mapping of a whole file.
+//-----------------------------------------------------------------------------
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open( const std::string & a_FileName );
+    void Close();
+
+    bool        IsOpen() const  { return m_Data != nullptr; }
+    const char* GetData() const { return m_Data; }
+    uint64_t    GetSize() const { return m_Size; }
+
+    // Hint that a range won't be read again soon so its pages can be dropped.
+    void Release( uint64_t a_Offset, uint64_t a_Size ) const;
+
+private:
+    MappedFile( const MappedFile & );
+    MappedFile & operator=( const MappedFile & );
+
+#ifdef _WIN32
+    HANDLE      m_File = INVALID_HANDLE_VALUE;
+    HANDLE      m_Mapping = nullptr;
+#else
+    int         m_File = -1;
+#endif
+    const char* m_Data = nullptr;
+    uint64_t    m_Size = 0;
+};
@@ -7,13 +7,152 @@
 #include "Capture.h"
 #include "OrbitProcess.h"
 #include "Log.h"
+#include <algorithm>
 
 //-----------------------------------------------------------------------------
 MemoryTracker::MemoryTracker() : m_NumAllocatedBytes(0)
                                , m_NumFreedBytes(0)
                                , m_NumLiveBytes(0)
+                               , m_NumUnknownFrees(0)
+                               , m_PeakLiveBytes(0)
+                               , m_DirtyBegin(SIZE_MAX)
+                               , m_DirtyEnd(0)
+                               , m_FirstTime(0)
 {
+    m_BucketTicks = std::max<TickType>( TicksFromMicroseconds( 1000 ), 1 );
+    m_EpochTicks = std::max<TickType>( TicksFromMicroseconds( 100000 ), 1 );
+}
+
+//-----------------------------------------------------------------------------
+void MemoryTracker::UpdateEpoch( AllocationSite & a_Site, TickType a_Time )
+{
+    // Called before a_Site changes, its live bytes are still those of the
+    // end of its last epoch.  Epochs are absolute, they don't move when the
+    // graph origin does.
+    uint64_t epoch = a_Time / m_EpochTicks;
+    if( epoch <= a_Site.m_LastEpoch )
+        return;
 
+    if( a_Site.m_LiveBytes > a_Site.m_EpochBytes )
+        ++a_Site.m_NumIncreases;
+    else if( a_Site.m_LiveBytes < a_Site.m_EpochBytes )
+        ++a_Site.m_NumDecreases;
+
+    a_Site.m_EpochBytes = a_Site.m_LiveBytes;
+    a_Site.m_LastEpoch = epoch;
+}
+
+//-----------------------------------------------------------------------------
+MemoryTracker::LiveBytesDelta MemoryTracker::Combine( const LiveBytesDelta & a_First, const LiveBytesDelta & a_Second )
+{
+    LiveBytesDelta combined;
+    combined.m_Delta = a_First.m_Delta + a_Second.m_Delta;
+    combined.m_Min = std::min( a_First.m_Min, a_First.m_Delta + a_Second.m_Min );
+    combined.m_Max = std::max( a_First.m_Max, a_First.m_Delta + a_Second.m_Max );
+    combined.m_HasSamples = a_First.m_HasSamples || a_Second.m_HasSamples;
+    return combined;
+}
+
+//-----------------------------------------------------------------------------
+void MemoryTracker::AddSample( TickType a_Time, int64_t a_Delta )
+{
+    DWORD64 liveBytes = m_NumLiveBytes;
+    if( liveBytes > m_PeakLiveBytes )
+    {
+        m_PeakLiveBytes = liveBytes;
+    }
+
+    TickType topBucketTicks = m_BucketTicks << ( ( NumLevels - 1 ) * LevelShift );
+    if( m_Levels[0].empty() )
+    {
+        m_FirstTime = a_Time - a_Time % topBucketTicks;
+    }
+    else if( a_Time < m_FirstTime )
+    {
+        Rebase( a_Time );
+    }
+
+    size_t bucket = (size_t)( ( a_Time - m_FirstTime ) / m_BucketTicks );
+    std::vector<LiveBytesDelta> & samples = m_Levels[0];
+    if( samples.size() <= bucket )
+    {
+        samples.resize( bucket + 1 );
+    }
+
+    // Running change within the bucket, in arrival order.
+    LiveBytesDelta & sample = samples[bucket];
+    sample.m_Delta += a_Delta;
+    sample.m_Min = std::min( sample.m_Min, sample.m_Delta );
+    sample.m_Max = std::max( sample.m_Max, sample.m_Delta );
+    sample.m_HasSamples = true;
+
+    m_DirtyBegin = std::min( m_DirtyBegin, bucket );
+    m_DirtyEnd = std::max( m_DirtyEnd, bucket + 1 );
+}
+
+//-----------------------------------------------------------------------------
+void MemoryTracker::Rebase( TickType a_Time )
+{
+    // Moves the origin back by whole buckets of the coarsest level so that
+    // buckets of every level stay aligned.
+    TickType topBucketTicks = m_BucketTicks << ( ( NumLevels - 1 ) * LevelShift );
+    TickType firstTime = a_Time - a_Time % topBucketTicks;
+    size_t shift = (size_t)( ( m_FirstTime - firstTime ) / m_BucketTicks );
+    for( uint32_t level = 0; level < NumLevels; ++level )
+    {
+        std::vector<LiveBytesDelta> & samples = m_Levels[level];
+        samples.insert( samples.begin(), shift >> ( level * LevelShift ), LiveBytesDelta() );
+    }
+
+    if( m_DirtyBegin < m_DirtyEnd )
+    {
+        m_DirtyBegin += shift;
+        m_DirtyEnd += shift;
+    }
+    m_FirstTime = firstTime;
+}
+
+//-----------------------------------------------------------------------------
+void MemoryTracker::UpdateLevels() const
+{
+    if( m_DirtyBegin >= m_DirtyEnd )
+        return;
+
+    size_t begin = m_DirtyBegin;
+    size_t end = m_DirtyEnd;
+    for( uint32_t level = 1; level < NumLevels; ++level )
+    {
+        const std::vector<LiveBytesDelta> & children = m_Levels[level - 1];
+        std::vector<LiveBytesDelta> & parents = m_Levels[level];
+        size_t numChildren = (size_t)1 << LevelShift;
+        parents.resize( ( children.size() + numChildren - 1 ) >> LevelShift );
+
+        begin >>= LevelShift;
+        end = ( end + numChildren - 1 ) >> LevelShift;
+        for( size_t parent = begin; parent < end; ++parent )
+        {
+            LiveBytesDelta combined;
+            size_t childEnd = std::min( ( parent + 1 ) << LevelShift, children.size() );
+            for( size_t child = parent << LevelShift; child < childEnd; ++child )
+            {
+                combined = Combine( combined, children[child] );
+            }
+            parents[parent] = combined;
+        }
+    }
+
+    m_DirtyBegin = SIZE_MAX;
+    m_DirtyEnd = 0;
+
+    // The peak seen in arrival order can be off when samples come in late.
+    int64_t live = 0;
+    int64_t peak = 0;
+    for( const LiveBytesDelta & sample : m_Levels[NumLevels - 1] )
+    {
+        peak = std::max( peak, live + sample.m_Max );
+        live += sample.m_Delta;
+    }
+    m_PeakLiveBytes = (DWORD64)peak;
 }
 
 //-----------------------------------------------------------------------------
@@ -21,62 +160,224 @@ void MemoryTracker::ProcessAlloc( const Timer & a_Timer )
 {
     DWORD64 address = a_Timer.m_UserData[0];
     DWORD64 size = a_Timer.m_UserData[1];
-    
-    m_LiveAllocs[address] = a_Timer;
+    if( address == 0 )
+        return;
+
+    ScopeLock lock( m_Mutex );
+
+    // A live entry at the same address means its free was missed.
+    int64_t delta = (int64_t)size;
+    LiveAlloc & alloc = m_LiveAllocs[address];
+    if( alloc.m_Size )
+    {
+        AllocationSite & previousSite = m_Sites[alloc.m_Callstack];
+        UpdateEpoch( previousSite, a_Timer.m_Start );
+        previousSite.m_LiveBytes -= alloc.m_Size;
+        --previousSite.m_NumLiveAllocs;
+        m_NumLiveBytes -= alloc.m_Size;
+        delta -= (int64_t)alloc.m_Size;
+    }
+
+    alloc.m_Size = size;
+    alloc.m_Callstack = a_Timer.m_CallstackHash;
+    alloc.m_Time = a_Timer.m_Start;
+
+    AllocationSite & site = m_Sites[alloc.m_Callstack];
+    UpdateEpoch( site, a_Timer.m_Start );
+    site.m_Callstack = alloc.m_Callstack;
+    site.m_LiveBytes += size;
+    site.m_TotalBytes += size;
+    ++site.m_NumLiveAllocs;
+
     m_NumAllocatedBytes += size;
     m_NumLiveBytes += size;
-
-    /*PRINT_VAR((void*)address);
-    PRINT_VAR(size);*/
+    AddSample( a_Timer.m_Start, delta );
 }
 
 //-----------------------------------------------------------------------------
 void MemoryTracker::ProcessFree( const Timer & a_Timer )
 {
     DWORD64 address = a_Timer.m_UserData[0];
-    Timer & timer = m_LiveAllocs[address];
-    DWORD64 freedSize = timer.m_UserData[1];
+    if( address == 0 )
+        return;
 
-    m_LiveAllocs.erase(address);
+    ScopeLock lock( m_Mutex );
+    LiveAlloc* alloc = m_LiveAllocs.Find( address );
+    if( alloc == nullptr )
+    {
+        // Allocated before the capture started, or not tracked.
+        ++m_NumUnknownFrees;
+        return;
+    }
+
+    DWORD64 freedSize = alloc->m_Size;
+    if( AllocationSite* site = m_Sites.Find( alloc->m_Callstack ) )
+    {
+        UpdateEpoch( *site, a_Timer.m_Start );
+        site->m_LiveBytes -= freedSize;
+        --site->m_NumLiveAllocs;
+    }
+
+    m_LiveAllocs.Erase( address );
     m_NumFreedBytes += freedSize;
     m_NumLiveBytes -= freedSize;
+    AddSample( a_Timer.m_Start, -(int64_t)freedSize );
+}
+
+//-----------------------------------------------------------------------------
+std::vector<MemoryTracker::AllocationSite> MemoryTracker::GetTopAllocationSites( size_t a_MaxSites ) const
+{
+    std::vector<AllocationSite> sites;
+    {
+        ScopeLock lock( m_Mutex );
+        m_Sites.ForEach( [&]( CallstackID, const AllocationSite & a_Site )
+        {
+            if( a_Site.m_LiveBytes )
+                sites.push_back( a_Site );
+        } );
+    }
+
+    // Per site counters are kept up to date, only the top N need sorting.
+    auto byLiveBytes = []( const AllocationSite & a, const AllocationSite & b ){ return a.m_LiveBytes > b.m_LiveBytes; };
+    if( sites.size() > a_MaxSites )
+    {
+        std::nth_element( sites.begin(), sites.begin() + a_MaxSites, sites.end(), byLiveBytes );
+        sites.resize( a_MaxSites );
+    }
+    std::sort( sites.begin(), sites.end(), byLiveBytes );
+    return sites;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<MemoryTracker::LeakCandidate> MemoryTracker::GetLeakCandidates( size_t a_MaxCandidates ) const
+{
+    std::vector<LeakCandidate> candidates;
+    {
+        ScopeLock lock( m_Mutex );
+        m_Sites.ForEach( [&]( CallstackID, const AllocationSite & a_Site )
+        {
+            // The current epoch isn't closed yet but counts as well.
+            uint32_t increases = a_Site.m_NumIncreases + ( a_Site.m_LiveBytes > a_Site.m_EpochBytes ? 1 : 0 );
+            uint32_t decreases = a_Site.m_NumDecreases + ( a_Site.m_LiveBytes < a_Site.m_EpochBytes ? 1 : 0 );
+
+            // Growing over several epochs and almost never shrinking.
+            if( a_Site.m_LiveBytes == 0 || increases < 3 || decreases * 10 > increases )
+                return;
+
+            LeakCandidate candidate;
+            candidate.m_Site = a_Site;
+            candidate.m_NumIncreases = increases;
+            candidate.m_NumDecreases = decreases;
+            candidate.m_Score = (double)a_Site.m_LiveBytes * increases / ( increases + decreases );
+            candidates.push_back( candidate );
+        } );
+    }
+
+    auto byScore = []( const LeakCandidate & a, const LeakCandidate & b ){ return a.m_Score > b.m_Score; };
+    if( candidates.size() > a_MaxCandidates )
+    {
+        std::nth_element( candidates.begin(), candidates.begin() + a_MaxCandidates, candidates.end(), byScore );
+        candidates.resize( a_MaxCandidates );
+    }
+    std::sort( candidates.begin(), candidates.end(), byScore );
+    return candidates;
+}
 
-    //PRINT_VAR(freedSize);
+//-----------------------------------------------------------------------------
+int64_t MemoryTracker::GetLiveBytesBefore( uint32_t a_Level, size_t a_Bucket ) const
+{
+    // Adds up the siblings before a_Bucket, then those before its parent and
+    // so on, only a few buckets per level are looked at.
+    int64_t live = 0;
+    for( uint32_t level = a_Level; level < NumLevels; ++level, a_Bucket >>= LevelShift )
+    {
+        const std::vector<LiveBytesDelta> & samples = m_Levels[level];
+        size_t first = level + 1 == NumLevels ? 0 : ( a_Bucket >> LevelShift ) << LevelShift;
+        for( size_t bucket = first; bucket < std::min( a_Bucket, samples.size() ); ++bucket )
+        {
+            live += samples[bucket].m_Delta;
+        }
+    }
+
+    return live;
 }
 
 //-----------------------------------------------------------------------------
-void MemoryTracker::DumpReport()
+void MemoryTracker::GetLiveBytesGraph( TickType a_Min, TickType a_Max, uint32_t a_NumColumns, std::vector<LiveBytesSample> & o_Columns ) const
 {
-    DWORD64 NumLiveBytes = 0;
-    std::unordered_map< CallstackID, DWORD64 > callstackToBytes;
-    for( auto & pair : m_LiveAllocs )
+    o_Columns.assign( a_NumColumns, LiveBytesSample() );
+
+    ScopeLock lock( m_Mutex );
+    if( m_Levels[0].empty() || a_Max <= a_Min || a_NumColumns == 0 )
+        return;
+
+    UpdateLevels();
+
+    // Coarsest level with buckets still narrower than a column.
+    double columnTicks = (double)( a_Max - a_Min ) / a_NumColumns;
+    uint32_t level = 0;
+    while( level + 1 < NumLevels && (double)( m_BucketTicks << ( ( level + 1 ) * LevelShift ) ) <= columnTicks )
     {
-        Timer & timer = pair.second;
-        DWORD64 size = timer.m_UserData[1];
-        CallstackID id = timer.m_CallstackHash;
-        callstackToBytes[id] += size;
-        NumLiveBytes += size;
+        ++level;
     }
 
-    std::multimap< DWORD64, CallstackID > bytesToCallstack;
-    for( auto & pair : callstackToBytes )
+    const std::vector<LiveBytesDelta> & samples = m_Levels[level];
+    double bucketTicks = (double)( m_BucketTicks << ( level * LevelShift ) );
+    double firstTime = (double)m_FirstTime;
+
+    auto getBucket = [&]( double a_Time ){ return a_Time > firstTime ? (size_t)( ( a_Time - firstTime ) / bucketTicks ) : 0; };
+    auto toBytes = []( int64_t a_Bytes ){ return a_Bytes > 0 ? (DWORD64)a_Bytes : 0; };
+
+    size_t previousEnd = getBucket( (double)a_Min );
+    int64_t live = GetLiveBytesBefore( level, previousEnd );
+    for( uint32_t column = 0; column < a_NumColumns; ++column )
     {
-        bytesToCallstack.insert( std::make_pair( pair.second, pair.first ) );
+        double columnEnd = (double)a_Min + ( column + 1 ) * columnTicks;
+        if( columnEnd <= firstTime )
+            continue;  // before the first allocation
+
+        size_t begin = previousEnd;
+        size_t end = std::max( getBucket( columnEnd ), begin + 1 );
+        previousEnd = end;
+
+        if( begin >= samples.size() )
+            break;
+
+        // Live bytes at the column start are part of its range.
+        int64_t minLive = live;
+        int64_t maxLive = live;
+        for( size_t bucket = begin; bucket < end && bucket < samples.size(); ++bucket )
+        {
+            const LiveBytesDelta & sample = samples[bucket];
+            if( !sample.m_HasSamples )
+                continue;
+
+            minLive = std::min( minLive, live + sample.m_Min );
+            maxLive = std::max( maxLive, live + sample.m_Max );
+            live += sample.m_Delta;
+        }
+
+        LiveBytesSample & out = o_Columns[column];
+        out.m_Min = toBytes( minLive );
+        out.m_Max = toBytes( maxLive );
+        out.m_Last = toBytes( live );
     }
+}
 
+//-----------------------------------------------------------------------------
+void MemoryTracker::DumpReport( size_t a_MaxSites )
+{
     if( m_NumAllocatedBytes )
     {
-        ORBIT_VIZ( Format(L"NumLiveBytes: %llu\n", NumLiveBytes ) );
+        ORBIT_VIZ( Format(L"NumLiveBytes: %llu\n", (DWORD64)m_NumLiveBytes ) );
     }
 
-    for( auto rit = bytesToCallstack.rbegin(); rit != bytesToCallstack.rend(); ++rit )
+    for( const AllocationSite & site : GetTopAllocationSites( a_MaxSites ) )
     {
-        CallstackID id = rit->second;
-        std::shared_ptr<CallStack> callstack = Capture::GetCallstack( id );
+        std::shared_ptr<CallStack> callstack = Capture::GetCallstack( site.m_Callstack );
 
-        DWORD64 numBytes = rit->first;
-        DWORD64 cid = id;
-        std::wstring msg = Format( L"Callstack[%llu] allocated %llu bytes\n", cid, numBytes );
+        DWORD64 cid = site.m_Callstack;
+        std::wstring msg = Format( L"Callstack[%llu] allocated %llu bytes\n", cid, site.m_LiveBytes );
         ORBIT_VIZ(msg);
         if( callstack )
         {
@@ -84,13 +385,31 @@ void MemoryTracker::DumpReport()
         }
         ORBIT_VIZ(L"\n\n");
     }
+
+    for( const LeakCandidate & leak : GetLeakCandidates( a_MaxSites ) )
+    {
+        DWORD64 cid = leak.m_Site.m_Callstack;
+        ORBIT_VIZ( Format( L"Leak candidate Callstack[%llu]: %llu live bytes, grew %u times, shrank %u times\n"
+                 , cid, leak.m_Site.m_LiveBytes, leak.m_NumIncreases, leak.m_NumDecreases ) );
+    }
 }
 
 //-----------------------------------------------------------------------------
 void MemoryTracker::Clear()
 {
-    m_LiveAllocs.clear();
+    ScopeLock lock( m_Mutex );
+    m_LiveAllocs.Clear();
+    m_Sites.Clear();
     m_NumAllocatedBytes = 0;
     m_NumFreedBytes = 0;
     m_NumLiveBytes = 0;
-}
\ No newline at end of file
+    m_NumUnknownFrees = 0;
+    m_PeakLiveBytes = 0;
+    m_FirstTime = 0;
+    m_DirtyBegin = SIZE_MAX;
+    m_DirtyEnd = 0;
+    for( std::vector<LiveBytesDelta> & samples : m_Levels )
+    {
+        samples.clear();
+    }
+}
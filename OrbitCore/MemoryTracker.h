@@ -5,27 +5,118 @@
 
 #include "Core.h"
 #include "ScopeTimer.h"
+#include "CallstackTypes.h"
+#include "FlatHashMap.h"
 
-#include <unordered_map>
+#include <atomic>
+#include <vector>
 
 class Function;
 class MemoryTracker
 {
 public:
+    struct LiveAlloc
+    {
+        DWORD64     m_Size = 0;
+        CallstackID m_Callstack = 0;
+        TickType    m_Time = 0;
+    };
+
+    struct AllocationSite
+    {
+        CallstackID m_Callstack = 0;
+        DWORD64     m_LiveBytes = 0;
+        DWORD64     m_NumLiveAllocs = 0;
+        DWORD64     m_TotalBytes = 0;
+
+        // Live bytes trend, compared from one leak epoch to the next.
+        DWORD64     m_EpochBytes = 0;
+        uint64_t    m_LastEpoch = 0;
+        uint32_t    m_NumIncreases = 0;
+        uint32_t    m_NumDecreases = 0;
+    };
+
+    struct LeakCandidate
+    {
+        AllocationSite m_Site;
+        uint32_t       m_NumIncreases;
+        uint32_t       m_NumDecreases;
+        double         m_Score;
+    };
+
+    // Live bytes range of a time bucket, empty when m_Min > m_Max.
+    struct LiveBytesSample
+    {
+        DWORD64 m_Min = ~0ull;
+        DWORD64 m_Max = 0;
+        DWORD64 m_Last = 0;
+        bool IsEmpty() const { return m_Min > m_Max; }
+    };
+
+    static const uint32_t NumLevels = 6;
+    static const uint32_t LevelShift = 3;  // each level is 8 times coarser
+
     MemoryTracker();
     void ProcessAlloc( const Timer & a_Timer );
     void ProcessFree( const Timer & a_Timer );
-    void DumpReport();
+    void DumpReport( size_t a_MaxSites = 32 );
     void Clear();
 
+    // Allocation sites with the most live bytes, largest first.
+    std::vector<AllocationSite> GetTopAllocationSites( size_t a_MaxSites ) const;
+
+    // Sites whose live bytes kept growing across the capture, most likely leaks first.
+    std::vector<LeakCandidate> GetLeakCandidates( size_t a_MaxCandidates ) const;
+
+    // Min/max of live bytes for a_NumColumns equal slices of [a_Min, a_Max].
+    void GetLiveBytesGraph( TickType a_Min, TickType a_Max, uint32_t a_NumColumns, std::vector<LiveBytesSample> & o_Columns ) const;
+    DWORD64 PeakLiveBytes() const { return m_PeakLiveBytes; }
+
     DWORD64 NumAllocatedBytes() const { return m_NumAllocatedBytes; }
     DWORD64 NumFreedBytes() const { return m_NumFreedBytes; }
     DWORD64 NumLiveBytes() const { return m_NumLiveBytes; }
+    DWORD64 NumUnknownFrees() const { return m_NumUnknownFrees; }
+    size_t  NumLiveAllocs() const { ScopeLock lock( m_Mutex ); return m_LiveAllocs.Size(); }
 
 protected:
-    std::unordered_map< DWORD64, Timer > m_LiveAllocs;
-    DWORD64 m_NumAllocatedBytes;
-    DWORD64 m_NumFreedBytes;
-    DWORD64 m_NumLiveBytes;
-};
+    // Net change of live bytes over a bucket, with the lowest and highest
+    // running change inside of it.  Buckets combine in time order whatever
+    // order their samples arrived in.
+    struct LiveBytesDelta
+    {
+        int64_t m_Delta = 0;
+        int64_t m_Min = 0;
+        int64_t m_Max = 0;
+        bool    m_HasSamples = false;
+    };
 
+    static LiveBytesDelta Combine( const LiveBytesDelta & a_First, const LiveBytesDelta & a_Second );
+    void UpdateEpoch( AllocationSite & a_Site, TickType a_Time );
+    void AddSample( TickType a_Time, int64_t a_Delta );
+    void Rebase( TickType a_Time );
+    void UpdateLevels() const;
+    int64_t GetLiveBytesBefore( uint32_t a_Level, size_t a_Bucket ) const;
+
+protected:
+    mutable Mutex                                                   m_Mutex;
+    FlatHashMap< DWORD64, LiveAlloc >                               m_LiveAllocs;
+    FlatHashMap< CallstackID, AllocationSite, ~CallstackID(0) >     m_Sites;
+
+    // Read from the UI thread without the lock.
+    std::atomic<DWORD64> m_NumAllocatedBytes;
+    std::atomic<DWORD64> m_NumFreedBytes;
+    std::atomic<DWORD64> m_NumLiveBytes;
+    std::atomic<DWORD64> m_NumUnknownFrees;
+    mutable std::atomic<DWORD64> m_PeakLiveBytes;
+
+    // Pre-aggregated live bytes deltas, level 0 buckets are m_BucketTicks
+    // wide and start at m_FirstTime, the earliest sample rounded down to a
+    // bucket of the coarsest level.  Coarser levels are summarized from
+    // the dirty range of level 0 when queried.
+    mutable std::vector<LiveBytesDelta> m_Levels[NumLevels];
+    mutable size_t m_DirtyBegin;
+    mutable size_t m_DirtyEnd;
+    TickType m_FirstTime;
+    TickType m_BucketTicks;
+    TickType m_EpochTicks;
+};
@@ -7,6 +7,7 @@
 
 //-----------------------------------------------------------------------------
 uint32_t Message::GSessionID;
+uint32_t Message::GSourceId;
 
 //-----------------------------------------------------------------------------
 void Message::Dump()
@@ -16,6 +17,7 @@ void Message::Dump()
     PRINT_VAR(offsetof(Message, m_Size));
     PRINT_VAR(offsetof(Message, m_SessionID));
     PRINT_VAR(offsetof(Message, m_ThreadId));
+    PRINT_VAR(offsetof(Message, m_SourceId));
     PRINT_VAR(offsetof(Message, m_Data));
 
     PRINT_VAR(sizeof(m_Type));
@@ -23,6 +25,7 @@ void Message::Dump()
     PRINT_VAR(sizeof(m_Size));
     PRINT_VAR(sizeof(m_SessionID));
     PRINT_VAR(sizeof(m_ThreadId));
+    PRINT_VAR(sizeof(m_SourceId));
     PRINT_VAR(sizeof(m_Data));
     
     PRINT_VAR(sizeof(MessageGeneric));
@@ -49,6 +49,13 @@ enum MessageType : int16_t
     Msg_UserData,
     Msg_OrbitData,
     Msg_ThreadInfo,
+    Msg_TimerEncoding,
+    Msg_TimerCompact,
+    Msg_TimerQueuePolicy,
+    Msg_DroppedTimers,
+    Msg_SharedMemoryTransport,
+    Msg_FunctionUnhook,
+    Msg_FunctionUnhooked,
 };
 
 //-----------------------------------------------------------------------------
@@ -91,6 +98,7 @@ public:
             , m_Size(a_Size)
             , m_SessionID(GSessionID)
             , m_ThreadId(0)
+            , m_SourceId(GSourceId)
             , m_Data(a_Data)
     {}
 
@@ -115,6 +123,7 @@ public:
     uint32_t       m_Size;
     uint32_t       m_SessionID;
     uint32_t       m_ThreadId;
+    uint32_t       m_SourceId;  // process id of the sender, 0 for Orbit
     char*          m_Data;
 #ifdef WIN32
 #ifndef _WIN64
@@ -123,6 +132,29 @@ public:
 #endif
 
     static uint32_t GSessionID;
+    static uint32_t GSourceId;
+};
+
+//-----------------------------------------------------------------------------
+struct TimerQueuePolicy
+{
+    enum OverflowPolicy : uint32_t
+    {
+        DropNewest,
+        DropQueued, // drops any queued timer to make room, producers don't share a FIFO order
+        Sample      // keeps one timer in m_SampleRate per thread past half the capacity
+    };
+
+    uint32_t m_OverflowPolicy;
+    uint32_t m_MaxQueuedTimers;
+    uint32_t m_SampleRate;
+};
+
+//-----------------------------------------------------------------------------
+struct DroppedTimers
+{
+    uint32_t m_ThreadId;
+    uint32_t m_NumDropped;
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "ModuleRangeMap.h"
+#include "OrbitModule.h"
+#include "EpochReclaim.h"
+
+#include <algorithm>
+
+// Generations are unique across all maps so that the thread local cache
+// can never confuse snapshots of two different processes.
+static std::atomic<uint64_t> GModuleRangeGeneration( 0 );
+
+//-----------------------------------------------------------------------------
+struct ModuleRangeCache
+{
+    uint64_t    m_Generation = 0;
+    ModuleRange m_Range = { 0, 0, nullptr };
+};
+
+static thread_local ModuleRangeCache GModuleRangeCache;
+
+//-----------------------------------------------------------------------------
+ModuleRangeMap::ModuleRangeMap() : m_Current( nullptr )
+{
+}
+
+//-----------------------------------------------------------------------------
+ModuleRangeMap::~ModuleRangeMap()
+{
+}
+
+//-----------------------------------------------------------------------------
+void ModuleRangeMap::Publish( const std::map< DWORD64, std::shared_ptr<Module> > & a_Modules )
+{
+    std::unique_ptr<Snapshot> snapshot = std::make_unique<Snapshot>();
+    snapshot->m_Generation = ++GModuleRangeGeneration;
+    snapshot->m_Ranges.reserve( a_Modules.size() );
+    snapshot->m_Modules.reserve( a_Modules.size() );
+
+    // m_Modules is keyed by start address, ranges come out sorted.
+    for( auto & pair : a_Modules )
+    {
+        const std::shared_ptr<Module> & module = pair.second;
+        if( module == nullptr || module->m_AddressEnd <= module->m_AddressStart )
+            continue;
+
+        snapshot->m_Ranges.push_back( { module->m_AddressStart, module->m_AddressEnd, module.get() } );
+        snapshot->m_Modules.push_back( module );
+    }
+
+    ScopeLock lock( m_Mutex );
+    m_Current.store( snapshot.get() );
+    if( !m_Snapshots.empty() )
+    {
+        m_Snapshots.back()->m_RetireEpoch = EpochReclaim::Retire();
+    }
+    m_Snapshots.push_back( std::move( snapshot ) );
+    Reclaim();
+}
+
+//-----------------------------------------------------------------------------
+void ModuleRangeMap::Reclaim()
+{
+    // Snapshots are retired in order, free the oldest ones no reader in
+    // flight can still hold, but never the previous one.
+    uint64_t minEpoch = EpochReclaim::GetMinActiveEpoch();
+    size_t numFreed = 0;
+    while( numFreed + 2 < m_Snapshots.size() && m_Snapshots[numFreed]->m_RetireEpoch < minEpoch )
+    {
+        ++numFreed;
+    }
+    m_Snapshots.erase( m_Snapshots.begin(), m_Snapshots.begin() + numFreed );
+}
+
+//-----------------------------------------------------------------------------
+Module* ModuleRangeMap::Find( uint64_t a_Address ) const
+{
+    EpochReclaim::ReadScope readScope;
+
+    const Snapshot* snapshot = m_Current.load();
+    if( snapshot == nullptr )
+        return nullptr;
+
+    ModuleRangeCache & cache = GModuleRangeCache;
+    if( cache.m_Generation == snapshot->m_Generation &&
+        a_Address >= cache.m_Range.m_Start && a_Address < cache.m_Range.m_End )
+    {
+        return cache.m_Range.m_Module;
+    }
+
+    const std::vector<ModuleRange> & ranges = snapshot->m_Ranges;
+    auto it = std::upper_bound( ranges.begin(), ranges.end(), a_Address,
+        []( uint64_t a_Addr, const ModuleRange & a_Range ){ return a_Addr < a_Range.m_Start; } );
+
+    if( it == ranges.begin() )
+        return nullptr;
+
+    --it;
+    if( a_Address >= it->m_End )
+        return nullptr;
+
+    cache.m_Generation = snapshot->m_Generation;
+    cache.m_Range = *it;
+    return it->m_Module;
+}
+
+//-----------------------------------------------------------------------------
+size_t ModuleRangeMap::Size() const
+{
+    ScopeLock lock( m_Mutex );
+    return m_Snapshots.empty() ? 0 : m_Snapshots.back()->m_Ranges.size();
+}
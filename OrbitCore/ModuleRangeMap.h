@@ -0,0 +1,62 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "BaseTypes.h"
+#include "Threading.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct Module;
+
+//-----------------------------------------------------------------------------
+struct ModuleRange
+{
+    uint64_t m_Start;
+    uint64_t m_End;
+    Module*  m_Module;
+};
+
+//-----------------------------------------------------------------------------
+// Flattened, immutable view of a process' modules used for address lookups.
+// Writers publish a new sorted snapshot whenever the module list changes,
+// readers never lock nor touch shared_ptr reference counts.  A per-thread
+// last-hit entry is checked before the binary search since consecutive
+// addresses usually fall in the same module.  Replaced snapshots are freed
+// by a later Publish once no reader entered before they were replaced, see
+// EpochReclaim.
+//-----------------------------------------------------------------------------
+class ModuleRangeMap
+{
+public:
+    ModuleRangeMap();
+    ~ModuleRangeMap();
+
+    void    Publish( const std::map< DWORD64, std::shared_ptr<Module> > & a_Modules );
+    Module* Find( uint64_t a_Address ) const;
+    size_t  Size() const;
+
+private:
+    struct Snapshot
+    {
+        uint64_t                              m_Generation = 0;
+        uint64_t                              m_RetireEpoch = 0;
+        std::vector< ModuleRange >            m_Ranges;
+        std::vector< std::shared_ptr<Module> > m_Modules; // keeps m_Ranges valid
+    };
+
+    void Reclaim();
+
+    std::atomic< const Snapshot* >   m_Current;
+
+    // Owned snapshots, the last one is current.  Older ones wait for the
+    // readers that entered before they were retired.  The previous snapshot
+    // is always kept so that a module returned by Find right before a
+    // Publish stays valid a while longer.
+    std::vector< std::unique_ptr<Snapshot> > m_Snapshots;
+    mutable Mutex                            m_Mutex;
+};
@@ -0,0 +1,239 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "ModuleTimeline.h"
+#include "OrbitModule.h"
+#include "EpochReclaim.h"
+#include "Path.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+ModuleTimeline::ModuleTimeline() : m_Current( nullptr )
+{
+    Clear();
+}
+
+//-----------------------------------------------------------------------------
+void ModuleTimeline::Clear()
+{
+    // Modules of the previous session go away with the last index that
+    // refers to them, a reader may still hold one.
+    std::unique_ptr<Index> index = std::make_unique<Index>();
+    index->m_Storage = std::make_shared<Storage>();
+
+    ScopeLock lock( m_Mutex );
+    Publish( std::move( index ) );
+}
+
+//-----------------------------------------------------------------------------
+template<class Callback>
+void ModuleTimeline::ForEachOverlapping( const Index & a_Index, uint64_t a_Start, uint64_t a_End, Callback a_Callback )
+{
+    // Walk back over the mappings of each run starting before a_End, the
+    // running max end tells when none of the remaining ones reaches a_Start.
+    for( const std::shared_ptr<const Run> & run : a_Index.m_Runs )
+    {
+        const std::vector<Mapping*> & mappings = run->m_Mappings;
+        auto it = std::lower_bound( mappings.begin(), mappings.end(), a_End,
+            []( const Mapping* a_Mapping, uint64_t a_Addr ){ return a_Mapping->m_Range.m_Start < a_Addr; } );
+
+        for( size_t i = it - mappings.begin(); i > 0 && run->m_MaxEnd[i-1] > a_Start; --i )
+        {
+            Mapping & mapping = *mappings[i-1];
+            if( mapping.m_Range.m_End > a_Start )
+            {
+                a_Callback( mapping );
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<Module> ModuleTimeline::OnMap( uint64_t a_Time, uint64_t a_Start, uint64_t a_End, const std::wstring & a_FullName )
+{
+    {
+        // The same mapping can be reported by several sources, reuse the module.
+        ScopeLock lock( m_Mutex );
+        Storage & storage = *m_Indices.back()->m_Storage;
+        std::shared_ptr<Module> known;
+        ForEachOverlapping( *m_Indices.back(), a_Start, a_End, [&]( Mapping & a_Mapping )
+        {
+            const Module* module = a_Mapping.m_Range.m_Module;
+            if( known == nullptr && module && module->m_AddressStart == a_Start && module->m_AddressEnd == a_End && module->m_FullName == a_FullName )
+            {
+                known = storage.m_Modules[module];
+            }
+        } );
+
+        if( known )
+        {
+            Apply( a_Time, { a_Start, a_End, known.get() }, true );
+            return known;
+        }
+    }
+
+    std::shared_ptr<Module> module = std::make_shared<Module>();
+    module->m_FullName = a_FullName;
+    module->m_Name = Path::GetFileName( a_FullName );
+    module->m_Directory = Path::GetDirectory( a_FullName );
+    module->m_AddressStart = a_Start;
+    module->m_AddressEnd = a_End;
+    module->GetPrettyName();
+
+    OnMap( a_Time, module );
+    return module;
+}
+
+//-----------------------------------------------------------------------------
+void ModuleTimeline::OnMap( uint64_t a_Time, const std::shared_ptr<Module> & a_Module )
+{
+    ModuleRange range = { a_Module->m_AddressStart, a_Module->m_AddressEnd, a_Module.get() };
+    if( range.m_End <= range.m_Start )
+        return;
+
+    ScopeLock lock( m_Mutex );
+    m_Indices.back()->m_Storage->m_Modules.emplace( a_Module.get(), a_Module );
+    Apply( a_Time, range, true );
+}
+
+//-----------------------------------------------------------------------------
+void ModuleTimeline::OnUnmap( uint64_t a_Time, uint64_t a_Start, uint64_t a_End )
+{
+    ScopeLock lock( m_Mutex );
+    Apply( a_Time, { a_Start, a_End, nullptr }, false );
+}
+
+//-----------------------------------------------------------------------------
+void ModuleTimeline::Apply( uint64_t a_Time, const ModuleRange & a_Range, bool a_IsMap )
+{
+    const Index & current = *m_Indices.back();
+
+    if( a_IsMap )
+    {
+        // Already known, possibly from a source with a coarser time.
+        Mapping* known = nullptr;
+        ForEachOverlapping( current, a_Range.m_Start, a_Range.m_End, [&]( Mapping & a_Mapping )
+        {
+            if( a_Mapping.m_Range.m_Module == a_Range.m_Module && a_Mapping.m_Range.m_Start == a_Range.m_Start &&
+                a_Time < a_Mapping.m_UnmapTime )
+            {
+                known = &a_Mapping;
+            }
+        } );
+
+        if( known )
+        {
+            if( a_Time < known->m_MapTime )
+                known->m_MapTime = a_Time;
+            return;
+        }
+    }
+
+    // Events can arrive late (perf data is parsed after the capture), so the
+    // new lifetime only extends up to the next remap of the region.
+    // Everything overlapping the event at its own time is replaced.
+    uint64_t unmapTime = ~0ull;
+    ForEachOverlapping( current, a_Range.m_Start, a_Range.m_End, [&]( Mapping & a_Mapping )
+    {
+        uint64_t mapTime = a_Mapping.m_MapTime;
+        if( mapTime <= a_Time && a_Time < a_Mapping.m_UnmapTime )
+        {
+            a_Mapping.m_UnmapTime = a_Time;
+        }
+        else if( mapTime > a_Time )
+        {
+            unmapTime = std::min( unmapTime, mapTime );
+        }
+    } );
+
+    if( !a_IsMap )
+        return;
+
+    Storage & storage = *current.m_Storage;
+    storage.m_Mappings.emplace_back( a_Range, a_Time, unmapTime );
+
+    // Runs are merged like the digits of a binary counter, a mapping is
+    // copied O(log n) times over the life of the timeline.
+    std::shared_ptr<Run> run = std::make_shared<Run>();
+    run->m_Mappings.push_back( &storage.m_Mappings.back() );
+
+    std::unique_ptr<Index> index = std::make_unique<Index>();
+    index->m_Storage = current.m_Storage;
+    index->m_Runs = current.m_Runs;
+    while( !index->m_Runs.empty() && index->m_Runs.back()->m_Mappings.size() <= run->m_Mappings.size() )
+    {
+        const std::vector<Mapping*> & last = index->m_Runs.back()->m_Mappings;
+        std::shared_ptr<Run> merged = std::make_shared<Run>();
+        merged->m_Mappings.resize( last.size() + run->m_Mappings.size() );
+        std::merge( last.begin(), last.end(), run->m_Mappings.begin(), run->m_Mappings.end(), merged->m_Mappings.begin(),
+            []( const Mapping* a_A, const Mapping* a_B ){ return a_A->m_Range.m_Start < a_B->m_Range.m_Start; } );
+
+        run = merged;
+        index->m_Runs.pop_back();
+    }
+
+    uint64_t maxEnd = 0;
+    run->m_MaxEnd.reserve( run->m_Mappings.size() );
+    for( const Mapping* mapping : run->m_Mappings )
+    {
+        maxEnd = std::max( maxEnd, mapping->m_Range.m_End );
+        run->m_MaxEnd.push_back( maxEnd );
+    }
+
+    index->m_Runs.push_back( run );
+    Publish( std::move( index ) );
+}
+
+//-----------------------------------------------------------------------------
+void ModuleTimeline::Publish( std::unique_ptr<Index> a_Index )
+{
+    m_Current.store( a_Index.get() );
+    if( !m_Indices.empty() )
+    {
+        m_Indices.back()->m_RetireEpoch = EpochReclaim::Retire();
+    }
+    m_Indices.push_back( std::move( a_Index ) );
+
+    // Same scheme as ModuleRangeMap, the previous index is always kept so
+    // that a module returned by Find right before a change stays valid.
+    uint64_t minEpoch = EpochReclaim::GetMinActiveEpoch();
+    size_t numFreed = 0;
+    while( numFreed + 2 < m_Indices.size() && m_Indices[numFreed]->m_RetireEpoch < minEpoch )
+    {
+        ++numFreed;
+    }
+    m_Indices.erase( m_Indices.begin(), m_Indices.begin() + numFreed );
+}
+
+//-----------------------------------------------------------------------------
+Module* ModuleTimeline::Find( uint64_t a_Address, uint64_t a_Time ) const
+{
+    EpochReclaim::ReadScope readScope;
+    const Index* index = m_Current.load();
+    if( index == nullptr )
+        return nullptr;
+
+    const Mapping* best = nullptr;
+    uint64_t bestMapTime = 0;
+    ForEachOverlapping( *index, a_Address, a_Address + 1, [&]( const Mapping & a_Mapping )
+    {
+        uint64_t mapTime = a_Mapping.m_MapTime.load( std::memory_order_relaxed );
+        if( mapTime <= a_Time && a_Time < a_Mapping.m_UnmapTime.load( std::memory_order_relaxed ) &&
+            ( best == nullptr || mapTime > bestMapTime ) )
+        {
+            best = &a_Mapping;
+            bestMapTime = mapTime;
+        }
+    } );
+
+    return best ? best->m_Range.m_Module : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+size_t ModuleTimeline::GetNumMappings() const
+{
+    ScopeLock lock( m_Mutex );
+    return m_Indices.back()->m_Storage->m_Mappings.size();
+}
@@ -0,0 +1,80 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "BaseTypes.h"
+#include "Threading.h"
+#include "ModuleRangeMap.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Record of the executable mappings of a process during a capture.  Every
+// map/unmap event opens or closes a mapping lifetime stamped with the event
+// time so that an address can be attributed to the module that was mapped
+// when the sample or timer was taken, even if the region was reused
+// afterwards.  Readers never lock: lifetimes are updated in place and new
+// mappings are published in sorted runs of doubling size, so adding one
+// only merges the small runs.  Replaced indices are freed through
+// EpochReclaim, modules are released with the index that last refers to
+// them.
+//-----------------------------------------------------------------------------
+class ModuleTimeline
+{
+public:
+    ModuleTimeline();
+
+    void Clear();
+    std::shared_ptr<Module> OnMap( uint64_t a_Time, uint64_t a_Start, uint64_t a_End, const std::wstring & a_FullName );
+    void OnMap( uint64_t a_Time, const std::shared_ptr<Module> & a_Module );
+    void OnUnmap( uint64_t a_Time, uint64_t a_Start, uint64_t a_End );
+
+    Module* Find( uint64_t a_Address, uint64_t a_Time ) const;
+    size_t  GetNumMappings() const;
+
+private:
+    struct Mapping
+    {
+        Mapping( const ModuleRange & a_Range, uint64_t a_MapTime, uint64_t a_UnmapTime )
+            : m_Range( a_Range ), m_MapTime( a_MapTime ), m_UnmapTime( a_UnmapTime ) {}
+
+        ModuleRange           m_Range;
+        std::atomic<uint64_t> m_MapTime;
+        std::atomic<uint64_t> m_UnmapTime;
+    };
+
+    // Mappings and modules of a session, addresses are stable.
+    struct Storage
+    {
+        std::deque< Mapping >                                        m_Mappings;
+        std::unordered_map< const Module*, std::shared_ptr<Module> > m_Modules;
+    };
+
+    // Immutable once published.
+    struct Run
+    {
+        std::vector< Mapping* > m_Mappings; // sorted by start address
+        std::vector< uint64_t > m_MaxEnd;   // running max of m_Range.m_End
+    };
+
+    struct Index
+    {
+        std::shared_ptr<Storage>                  m_Storage;
+        std::vector< std::shared_ptr<const Run> > m_Runs; // largest first
+        uint64_t                                  m_RetireEpoch = 0;
+    };
+
+    template<class Callback> static void ForEachOverlapping( const Index & a_Index, uint64_t a_Start, uint64_t a_End, Callback a_Callback );
+    void Apply( uint64_t a_Time, const ModuleRange & a_Range, bool a_IsMap );
+    void Publish( std::unique_ptr<Index> a_Index );
+
+    mutable Mutex                          m_Mutex;
+    std::atomic< const Index* >            m_Current;
+    std::vector< std::unique_ptr<Index> >  m_Indices; // the last one is current
+};
@@ -0,0 +1,390 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "NameFilter.h"
+#include "TrigramIndex.h"
+#include "Threading.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ORBIT_SSE2_FIND 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Below this many entries per chunk, scheduling tasks costs more than it saves.
+static const size_t MinEntriesPerChunk = 32*1024;
+
+const uint32_t NameFilter::InvalidEntry;
+
+//-----------------------------------------------------------------------------
+template <class Container>
+static void AppendLowerUtf8( Container & a_Out, const std::wstring & a_String )
+{
+    for( wchar_t wc : a_String )
+    {
+        uint32_t c = (uint32_t)wc;
+        if( c >= 'A' && c <= 'Z' )
+        {
+            a_Out.push_back( (char)( c + ( 'a' - 'A' ) ) );
+        }
+        else if( c < 0x80 )
+        {
+            a_Out.push_back( (char)c );
+        }
+        else if( c < 0x800 )
+        {
+            a_Out.push_back( (char)( 0xC0 | ( c >> 6 ) ) );
+            a_Out.push_back( (char)( 0x80 | ( c & 0x3F ) ) );
+        }
+        else if( c < 0x10000 )
+        {
+            a_Out.push_back( (char)( 0xE0 | ( c >> 12 ) ) );
+            a_Out.push_back( (char)( 0x80 | ( ( c >> 6 ) & 0x3F ) ) );
+            a_Out.push_back( (char)( 0x80 | ( c & 0x3F ) ) );
+        }
+        else
+        {
+            a_Out.push_back( (char)( 0xF0 | ( c >> 18 ) ) );
+            a_Out.push_back( (char)( 0x80 | ( ( c >> 12 ) & 0x3F ) ) );
+            a_Out.push_back( (char)( 0x80 | ( ( c >> 6 ) & 0x3F ) ) );
+            a_Out.push_back( (char)( 0x80 | ( c & 0x3F ) ) );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::ToLowerUtf8( const std::wstring & a_String, std::string & o_Out )
+{
+    AppendLowerUtf8( o_Out, a_String );
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::Tokenize( const std::wstring & a_Filter, std::vector<std::string> & o_Tokens )
+{
+    o_Tokens.clear();
+    std::string token;
+    for( wchar_t c : a_Filter + L" " )
+    {
+        if( c == L' ' || c == L'\t' )
+        {
+            if( !token.empty() )
+                o_Tokens.push_back( token );
+            token.clear();
+        }
+        else
+        {
+            AppendLowerUtf8( token, std::wstring( 1, c ) );
+        }
+    }
+
+    // Longest first, it is the most selective.
+    std::sort( o_Tokens.begin(), o_Tokens.end(), []( const std::string & a, const std::string & b ){ return a.size() > b.size(); } );
+}
+
+//-----------------------------------------------------------------------------
+NameFilter::NameFilter()
+{
+    Clear();
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::Clear()
+{
+    m_Data.clear();
+    m_Offsets.assign( 1, 0 );
+    m_LastTokens.clear();
+    m_LastResult.clear();
+    m_LastSize = 0;
+    m_IndexedEntries.clear();
+    m_UnindexedEntries.clear();
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::Reserve( size_t a_NumEntries, size_t a_NumBytes )
+{
+    m_Offsets.reserve( a_NumEntries + 1 );
+    m_Data.reserve( a_NumBytes );
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::AddField( const std::wstring & a_Field )
+{
+    // Fields are zero terminated so that tokens never match across them.
+    AppendLowerUtf8( m_Data, a_Field );
+    m_Data.push_back( 0 );
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::EndEntry( const TrigramIndex* a_Index, uint32_t a_IndexEntry )
+{
+    uint32_t entry = (uint32_t)Size();
+    m_Offsets.push_back( (uint32_t)m_Data.size() );
+
+    // An index entry can only map to one filter entry, extra ones are scanned.
+    if( a_Index && a_IndexEntry < a_Index->GetNumEntries() )
+    {
+        std::vector<uint32_t> & entries = m_IndexedEntries[a_Index];
+        if( entries.empty() )
+        {
+            entries.resize( a_Index->GetNumEntries(), InvalidEntry );
+        }
+        if( entries[a_IndexEntry] == InvalidEntry )
+        {
+            entries[a_IndexEntry] = entry;
+            return;
+        }
+    }
+
+    m_UnindexedEntries.push_back( entry );
+}
+
+//-----------------------------------------------------------------------------
+const char* NameFilter::Find( const char* a_Begin, const char* a_End, const std::string & a_Token )
+{
+    const size_t m = a_Token.size();
+    const size_t n = (size_t)( a_End - a_Begin );
+    const char* token = a_Token.data();
+
+    if( m == 0 )
+        return a_Begin;
+    if( n < m )
+        return nullptr;
+    if( m == 1 )
+        return (const char*)memchr( a_Begin, token[0], n );
+
+    size_t i = 0;
+
+#ifdef ORBIT_SSE2_FIND
+    // Compare the first and last characters of the token against 16
+    // positions at once, only candidates passing both are memcmp'ed.
+    const __m128i first = _mm_set1_epi8( token[0] );
+    const __m128i last  = _mm_set1_epi8( token[m - 1] );
+
+    for( ; i + m - 1 + 16 <= n; i += 16 )
+    {
+        const __m128i blockFirst = _mm_loadu_si128( (const __m128i*)( a_Begin + i ) );
+        const __m128i blockLast  = _mm_loadu_si128( (const __m128i*)( a_Begin + i + m - 1 ) );
+        const __m128i eqFirst    = _mm_cmpeq_epi8( first, blockFirst );
+        const __m128i eqLast     = _mm_cmpeq_epi8( last, blockLast );
+        uint32_t mask = (uint32_t)_mm_movemask_epi8( _mm_and_si128( eqFirst, eqLast ) );
+
+        while( mask != 0 )
+        {
+#ifdef _MSC_VER
+            unsigned long bit;
+            _BitScanForward( &bit, mask );
+#else
+            uint32_t bit = (uint32_t)__builtin_ctz( mask );
+#endif
+            if( memcmp( a_Begin + i + bit + 1, token + 1, m - 2 ) == 0 )
+                return a_Begin + i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while( i + m <= n )
+    {
+        const char* candidate = (const char*)memchr( a_Begin + i, token[0], n - m + 1 - i );
+        if( candidate == nullptr )
+            return nullptr;
+        if( memcmp( candidate, token, m ) == 0 )
+            return candidate;
+        i = (size_t)( candidate - a_Begin ) + 1;
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool NameFilter::Matches( uint32_t a_Index, const std::vector<std::string> & a_Tokens, size_t a_Skip ) const
+{
+    const char* begin = m_Data.data() + m_Offsets[a_Index];
+    const char* end = m_Data.data() + m_Offsets[a_Index + 1];
+
+    for( size_t i = a_Skip; i < a_Tokens.size(); ++i )
+    {
+        if( Find( begin, end, a_Tokens[i] ) == nullptr )
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::FilterRange( uint32_t a_Begin, uint32_t a_End, const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Result ) const
+{
+    // Scan the whole range for the first (longest) token, then only verify
+    // the other tokens on the entries that contain it.
+    const char* data = m_Data.data();
+    const char* pos = data + m_Offsets[a_Begin];
+    const char* end = data + m_Offsets[a_End];
+    uint32_t index = a_Begin;
+
+    while( const char* hit = Find( pos, end, a_Tokens[0] ) )
+    {
+        uint32_t hitOffset = (uint32_t)( hit - data );
+        auto it = std::upper_bound( m_Offsets.begin() + index + 1, m_Offsets.begin() + a_End + 1, hitOffset );
+        index = (uint32_t)( it - m_Offsets.begin() ) - 1;
+
+        if( Matches( index, a_Tokens, 1 ) )
+        {
+            o_Result.push_back( index );
+        }
+
+        pos = data + m_Offsets[++index];
+    }
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::FilterCandidates( const uint32_t* a_Begin, const uint32_t* a_End, const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Result ) const
+{
+    for( const uint32_t* it = a_Begin; it != a_End; ++it )
+    {
+        if( Matches( *it, a_Tokens, 0 ) )
+        {
+            o_Result.push_back( *it );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool NameFilter::Narrows( const std::vector<std::string> & a_Tokens ) const
+{
+    if( m_LastTokens.empty() )
+        return false;
+
+    // Every previous token must be contained in one of the new tokens.
+    for( const std::string & lastToken : m_LastTokens )
+    {
+        bool found = false;
+        for( const std::string & token : a_Tokens )
+        {
+            if( token.find( lastToken ) != std::string::npos )
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if( !found )
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool NameFilter::GatherCandidates( const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Candidates ) const
+{
+    if( m_IndexedEntries.empty() || a_Tokens[0].size() < 3 )
+        return false;
+
+    o_Candidates = m_UnindexedEntries;
+
+    std::vector<uint32_t> indexEntries;
+    for( auto & pair : m_IndexedEntries )
+    {
+        const std::vector<uint32_t> & entries = pair.second;
+        if( pair.first->Query( a_Tokens, indexEntries ) )
+        {
+            for( uint32_t indexEntry : indexEntries )
+            {
+                if( entries[indexEntry] != InvalidEntry )
+                    o_Candidates.push_back( entries[indexEntry] );
+            }
+        }
+        else
+        {
+            for( uint32_t entry : entries )
+            {
+                if( entry != InvalidEntry )
+                    o_Candidates.push_back( entry );
+            }
+        }
+    }
+
+    std::sort( o_Candidates.begin(), o_Candidates.end() );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void NameFilter::Filter( const std::wstring & a_Filter, std::vector<uint32_t> & o_Indices )
+{
+    std::vector<std::string> tokens;
+    Tokenize( a_Filter, tokens );
+
+    const uint32_t numEntries = (uint32_t)Size();
+    o_Indices.clear();
+
+    if( tokens.empty() )
+    {
+        o_Indices.resize( numEntries );
+        for( uint32_t i = 0; i < numEntries; ++i )
+        {
+            o_Indices[i] = i;
+        }
+    }
+    else
+    {
+        // Verify the smallest candidate set available: the previous result
+        // if the query narrows it, the trigram postings otherwise.
+        std::vector<uint32_t> indexed;
+        const bool narrows = m_LastSize == numEntries && Narrows( tokens );
+        const std::vector<uint32_t>* candidates = narrows ? &m_LastResult : nullptr;
+        if( candidates == nullptr && GatherCandidates( tokens, indexed ) )
+        {
+            candidates = &indexed;
+        }
+
+        // Large sets are split in chunks for the task scheduler's workers.
+        const size_t work = candidates ? candidates->size() : numEntries;
+#ifdef _WIN32
+        size_t numWorkers = (size_t)oqpi_tk::scheduler().workersCount( oqpi::task_priority::normal );
+#else
+        size_t numWorkers = 1;
+#endif
+        size_t numChunks = std::max<size_t>( 1, std::min<size_t>( numWorkers, work / MinEntriesPerChunk ) );
+        std::vector< std::vector<uint32_t> > results( numChunks );
+
+        auto filterChunk = [&]( int32_t a_Chunk )
+        {
+            uint32_t begin = (uint32_t)( work*a_Chunk/numChunks );
+            uint32_t end = (uint32_t)( work*( a_Chunk + 1 )/numChunks );
+            if( candidates )
+                FilterCandidates( candidates->data() + begin, candidates->data() + end, tokens, results[a_Chunk] );
+            else
+                FilterRange( begin, end, tokens, results[a_Chunk] );
+        };
+
+        if( numChunks == 1 )
+        {
+            filterChunk( 0 );
+        }
+#ifdef _WIN32
+        else
+        {
+            oqpi_tk::parallel_for( "NameFilter", (int32_t)numChunks, [&]( int32_t a_BlockIndex, int32_t a_ElementIndex )
+            {
+                filterChunk( a_ElementIndex );
+            } );
+        }
+#endif
+
+        // Chunks are ordered, so is the concatenation.
+        for( std::vector<uint32_t> & result : results )
+        {
+            o_Indices.insert( o_Indices.end(), result.begin(), result.end() );
+        }
+    }
+
+    m_LastTokens = tokens;
+    m_LastResult = o_Indices;
+    m_LastSize = numEntries;
+}
@@ -0,0 +1,56 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TrigramIndex;
+
+//-----------------------------------------------------------------------------
+// Lower case UTF-8 copy of a list of names stored back to back in a single
+// buffer, filtered in parallel without allocating per entry.  An entry can
+// hold several fields (name, module, file...), a token matches an entry if
+// it is found in any of its fields.  When a query only narrows the previous
+// one, the previous result is used as the candidate set.  Entries can refer
+// to a TrigramIndex entry, the postings then provide the candidate set.
+//-----------------------------------------------------------------------------
+class NameFilter
+{
+public:
+    NameFilter();
+
+    void Clear();
+    void Reserve( size_t a_NumEntries, size_t a_NumBytes );
+    void AddField( const std::wstring & a_Field );
+    void EndEntry( const TrigramIndex* a_Index = nullptr, uint32_t a_IndexEntry = 0 );
+    size_t Size() const { return m_Offsets.size() - 1; }
+
+    void Filter( const std::wstring & a_Filter, std::vector<uint32_t> & o_Indices );
+
+    static const char* Find( const char* a_Begin, const char* a_End, const std::string & a_Token );
+    static void ToLowerUtf8( const std::wstring & a_String, std::string & o_Out );
+    static void Tokenize( const std::wstring & a_Filter, std::vector<std::string> & o_Tokens );
+
+protected:
+    void FilterRange( uint32_t a_Begin, uint32_t a_End, const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Result ) const;
+    void FilterCandidates( const uint32_t* a_Begin, const uint32_t* a_End, const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Result ) const;
+    bool Matches( uint32_t a_Index, const std::vector<std::string> & a_Tokens, size_t a_Skip ) const;
+    bool Narrows( const std::vector<std::string> & a_Tokens ) const;
+    bool GatherCandidates( const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Candidates ) const;
+
+    static const uint32_t InvalidEntry = 0xFFFFFFFF;
+
+    std::vector<char>        m_Data;
+    std::vector<uint32_t>    m_Offsets;     // entry i is [m_Offsets[i], m_Offsets[i+1])
+    std::vector<std::string> m_LastTokens;
+    std::vector<uint32_t>    m_LastResult;  // sorted
+    size_t                   m_LastSize = 0;
+
+    // TrigramIndex entry -> filter entry
+    std::unordered_map< const TrigramIndex*, std::vector<uint32_t> > m_IndexedEntries;
+    std::vector<uint32_t>    m_UnindexedEntries;
+};
@@ -124,6 +124,8 @@ void Process::ListModules()
         m_NameToModuleMap[name] = module;
         module->LoadDebugInfo();
     }
+
+    UpdateModuleRanges();
 }
 
 //-----------------------------------------------------------------------------
@@ -186,6 +188,15 @@ void Process::EnumerateThreads()
     {
         m_ThreadIds.insert(thread->m_TID);
     }
+#else
+    for( uint32_t tid : LinuxUtils::ListThreads( m_ID ) )
+    {
+        std::shared_ptr<Thread> thread = std::make_shared<Thread>();
+        thread->m_TID = tid;
+        m_ThreadNames[tid] = s2ws( LinuxUtils::GetThreadName( m_ID, tid ) );
+        m_Threads.push_back( thread );
+        m_ThreadIds.insert( tid );
+    }
 #endif
 }
 
@@ -264,31 +275,31 @@ std::shared_ptr<Module> Process::FindModule( const std::wstring & a_ModuleName )
 //-----------------------------------------------------------------------------
 Function* Process::GetFunctionFromAddress( DWORD64 a_Address, bool a_IsExact )
 {
-    DWORD64 address = (DWORD64)a_Address;
-    auto it = m_Modules.upper_bound( address );
-    if( !m_Modules.empty() && it != m_Modules.begin() )
+    Module* module = FindModuleByAddress( a_Address );
+    if( module && module->m_Pdb != nullptr )
     {
-        --it;
-        std::shared_ptr<Module> & module = it->second;
-        if( address < module->m_AddressEnd )
+        if( a_IsExact )
         {
-            if( module->m_Pdb != nullptr )
-            {
-                if( a_IsExact )
-                {
-                    return module->m_Pdb->GetFunctionFromExactAddress( a_Address );
-                }
-                else
-                {
-                    return module->m_Pdb->GetFunctionFromProgramCounter( a_Address );
-                }
-            }
+            return module->m_Pdb->GetFunctionFromExactAddress( a_Address );
+        }
+        else
+        {
+            return module->m_Pdb->GetFunctionFromProgramCounter( a_Address );
         }
     }
 
     return nullptr;
 }
 
+//-----------------------------------------------------------------------------
+Module* Process::FindModuleByAddress( DWORD64 a_Address, uint64_t a_Time ) const
+{
+    // Mappings seen during the capture take precedence, the address range
+    // might have been reused since modules were listed.
+    Module* module = m_ModuleTimeline.Find( a_Address, a_Time );
+    return module ? module : FindModuleByAddress( a_Address );
+}
+
 //-----------------------------------------------------------------------------
 std::shared_ptr<Module> Process::GetModuleFromAddress( DWORD64 a_Address )
 {
@@ -397,6 +408,7 @@ void Process::AddType(Type & a_Type)
 void Process::AddModule( std::shared_ptr<Module> & a_Module )
 {
     m_Modules[a_Module->m_AddressStart] = a_Module;
+    UpdateModuleRanges();
 }
 
 //-----------------------------------------------------------------------------
@@ -598,4 +610,9 @@ ORBIT_SERIALIZE( Process, 0 )
     ORBIT_NVP_VAL( 0, m_Modules );
     ORBIT_NVP_VAL( 0, m_NameToModuleMap );
     ORBIT_NVP_VAL( 0, m_ThreadIds );
+
+    if( Archive::is_loading::value )
+    {
+        UpdateModuleRanges();
+    }
 }
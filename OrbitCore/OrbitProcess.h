@@ -8,6 +8,8 @@
 #include "Threading.h"
 #include "DiaManager.h"
 #include "ScopeTimer.h"
+#include "ModuleRangeMap.h"
+#include "ModuleTimeline.h"
 
 #include <set>
 #include <unordered_set>
@@ -75,6 +77,10 @@ public:
 
     Function* GetFunctionFromAddress( DWORD64 a_Address, bool a_IsExact = true );
     std::shared_ptr<Module> GetModuleFromAddress( DWORD64 a_Address );
+    Module* FindModuleByAddress( DWORD64 a_Address ) const { return m_ModuleRanges.Find( a_Address ); }
+    Module* FindModuleByAddress( DWORD64 a_Address, uint64_t a_Time ) const;
+    ModuleTimeline & GetModuleTimeline() { return m_ModuleTimeline; }
+    void UpdateModuleRanges() { m_ModuleRanges.Publish( m_Modules ); }
     std::shared_ptr<Module> GetModuleFromName( const std::wstring& a_Name );
     
 #ifdef _WIN32
@@ -134,6 +140,8 @@ private:
 
     std::map< DWORD64, std::shared_ptr<Module> > m_Modules;
     std::map< std::wstring, std::shared_ptr<Module> > m_NameToModuleMap;
+    ModuleRangeMap                          m_ModuleRanges;
+    ModuleTimeline                          m_ModuleTimeline;
     std::vector<std::shared_ptr<Thread> >   m_Threads;
     std::unordered_set<DWORD>               m_ThreadIds;
     std::map<DWORD, std::wstring>           m_ThreadNames;
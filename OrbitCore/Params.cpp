@@ -27,7 +27,11 @@ Params::Params() : m_LoadTypeInfo( true )
                  , m_HookOutputDebugString(false)
                  , m_FindFileAndLineInfo(true)
                  , m_AutoReleasePdb(false)
+                 , m_StreamCaptureToDisk(false)
                  , m_MaxNumTimers( 1000000 )
+                 , m_TimerOverflowPolicy( 0 )
+                 , m_MaxQueuedTimers( 1024*1024 )
+                 , m_HookEventBudget( 0 )
                  , m_FontSize( 14.f )
                  , m_Port(1789)
                  , m_NumBytesAssembly(1024)
@@ -35,7 +39,7 @@ Params::Params() : m_LoadTypeInfo( true )
 {
 }
 
-ORBIT_SERIALIZE( Params, 13 )
+ORBIT_SERIALIZE( Params, 16 )
 {
     ORBIT_NVP_VAL( 0, m_LoadTypeInfo );
     ORBIT_NVP_VAL( 0, m_SendCallStacks );
@@ -59,6 +63,10 @@ ORBIT_SERIALIZE( Params, 13 )
     ORBIT_NVP_VAL( 11, m_FindFileAndLineInfo );
     ORBIT_NVP_VAL( 12, m_AutoReleasePdb );
     ORBIT_NVP_VAL( 13, m_ProcessFilter );
+    ORBIT_NVP_VAL( 14, m_StreamCaptureToDisk );
+    ORBIT_NVP_VAL( 15, m_TimerOverflowPolicy );
+    ORBIT_NVP_VAL( 15, m_MaxQueuedTimers );
+    ORBIT_NVP_VAL( 16, m_HookEventBudget );
 }
 
 //-----------------------------------------------------------------------------
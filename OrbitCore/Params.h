@@ -30,7 +30,11 @@ public:
     bool  m_HookOutputDebugString;
     bool  m_FindFileAndLineInfo;
     bool  m_AutoReleasePdb;
+    bool  m_StreamCaptureToDisk;
     int   m_MaxNumTimers;
+    int   m_TimerOverflowPolicy;    // TimerQueuePolicy::OverflowPolicy
+    int   m_MaxQueuedTimers;        // per target process
+    int   m_HookEventBudget;        // events/s per hooked function, 0 never unhooks
     float m_FontSize;
     int   m_Port;
     uint64_t m_NumBytesAssembly;
@@ -776,6 +776,13 @@ void Pdb::ProcessData()
         it.second.m_Pdb = this;
     }
 
+    // Loading from the symbol cache also restores the index.
+    if( !m_SymbolIndex.IsBuilt( m_Functions, m_Types, m_Globals ) )
+    {
+        SCOPE_TIMER_LOG( L"Build symbol index" );
+        m_SymbolIndex.Build( m_Name, m_Functions, m_Types, m_Globals );
+    }
+
     PopulateFunctionMap();
     PopulateStringFunctionMap();
     // TODO: parallelize: PopulateStringFunctionMap();
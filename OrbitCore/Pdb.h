@@ -6,6 +6,7 @@
 #include "OrbitDbgHelp.h"
 #include "OrbitType.h"
 #include "Variable.h"
+#include "TrigramIndex.h"
 
 #include <vector>
 #include <functional>
@@ -45,6 +46,7 @@ public:
     std::vector<Function>&    GetFunctions()         { return m_Functions; }
     std::vector<Type>&        GetTypes()             { return m_Types; }
     std::vector<Variable>&    GetGlobals()           { return m_Globals; }
+    const SymbolIndex &       GetSymbolIndex() const { return m_SymbolIndex; }
     HMODULE              GetHModule()                { return m_MainModule; }
     Type &               GetTypeFromId( ULONG a_Id ) { return m_TypeMap[a_Id]; }
     Type*                GetTypePtrFromId( ULONG a_ID );
@@ -87,7 +89,8 @@ public:
           , CEREAL_NVP(m_Types)
           , CEREAL_NVP(m_Globals)
           , CEREAL_NVP(m_ModuleInfo)
-          , CEREAL_NVP(m_TypeMap) );*/
+          , CEREAL_NVP(m_TypeMap)
+          , CEREAL_NVP(m_SymbolIndex) );*/
     }
 
     std::shared_ptr<OrbitDiaSymbol> GetDiaSymbolFromId(ULONG a_Id);
@@ -120,6 +123,7 @@ protected:
     std::unordered_map<ULONG, Type>     m_TypeMap;
     std::map<DWORD64, Function*>        m_FunctionMap;
     std::unordered_map<unsigned long long, Function*> m_StringFunctionMap;
+    SymbolIndex                         m_SymbolIndex;
     Timer*                              m_LoadTimer;
     
     // DIA
@@ -156,6 +160,7 @@ public:
     std::vector<Function>&    GetFunctions()         { return m_Functions; }
     std::vector<Type>&        GetTypes()             { return m_Types; }
     std::vector<Variable>&    GetGlobals()           { return m_Globals; }
+    const SymbolIndex &       GetSymbolIndex() const { return m_SymbolIndex; }
     HMODULE              GetHModule()                { return m_MainModule; }
     Type &               GetTypeFromId( ULONG a_Id ) { return m_TypeMap[a_Id]; }
     Type*                GetTypePtrFromId( ULONG a_ID );
@@ -222,6 +227,7 @@ protected:
     std::unordered_map<ULONG, Type>         m_TypeMap;
     std::map<DWORD64, Function*>            m_FunctionMap;
     std::unordered_map<unsigned long long, Function*> m_StringFunctionMap;
+    SymbolIndex                             m_SymbolIndex;
     Timer*                                  m_LoadTimer = nullptr;
 };
 #endif
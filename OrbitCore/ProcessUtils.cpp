@@ -175,6 +175,9 @@ void ProcessList::Refresh()
 
 #else
     m_Processes.clear();
+    std::unordered_map< DWORD, std::shared_ptr< Process > > previousProcessesMap;
+    previousProcessesMap.swap( m_ProcessesMap );
+
     struct dirent* de_DirEntity = NULL;
     DIR* dir_proc = NULL;
 
@@ -185,6 +188,9 @@ void ProcessList::Refresh()
         return;
     }
 
+    std::string processName;
+    char commandLinePath[64];
+
     while ( (de_DirEntity = readdir(dir_proc)) )
     {
         if (de_DirEntity->d_type == DT_DIR)
@@ -192,36 +198,28 @@ void ProcessList::Refresh()
             if (IsNumeric(de_DirEntity->d_name))
             {
                 int pid = atoi(de_DirEntity->d_name);
-                std::string commandLinePath = Format("%s%s/cmdline",PROC_DIRECTORY, de_DirEntity->d_name);
+                std::shared_ptr<Process> process = nullptr;
 
-                std::ifstream inFile(commandLinePath);
-                if(!inFile.fail())
+                // Only new processes need their command line read.
+                auto iter = previousProcessesMap.find(pid);
+                if( iter != previousProcessesMap.end() )
                 {
-                    std::stringstream buffer;
-                    buffer << inFile.rdbuf();
-                    inFile.close();
-                    const std::string& processName = buffer.str();
-
-                    if( processName.empty() )
+                    process = iter->second;
+                }
+                else
+                {
+                    snprintf( commandLinePath, sizeof(commandLinePath), "%s%s/cmdline", PROC_DIRECTORY, de_DirEntity->d_name );
+                    if( !LinuxUtils::ReadProcFile( commandLinePath, processName ) || processName.empty() )
                         continue;
-                        
-                    auto iter = m_ProcessesMap.find(pid);
-                    std::shared_ptr<Process> process = nullptr;
-                    if( iter == m_ProcessesMap.end() )
-                    {
-                        process = std::make_shared<Process>();
-                        process->m_FullName = s2ws( processName );
-                        process->m_Name = Path::GetFileName(process->m_FullName);
-                        process->SetID(pid);
-                        m_ProcessesMap[pid] = process;
-                    }
-                    else
-                    {
-                        process = iter->second;
-                    }
 
-                    m_Processes.push_back(process);
+                    process = std::make_shared<Process>();
+                    process->m_FullName = s2ws( processName.c_str() );
+                    process->m_Name = Path::GetFileName(process->m_FullName);
+                    process->SetID(pid);
                 }
+
+                m_ProcessesMap[pid] = process;
+                m_Processes.push_back(process);
             }
         }
     }
@@ -254,6 +254,7 @@ void SamplingProfiler::ProcessSamples()
     m_State = Processing;
 
     // Unique call stacks and per thread data
+    auto timeIt = m_CallstackTimes.begin();
     for( CallStack & callstack : m_Callstacks )
     {
         callstack.Hash();
@@ -263,6 +264,19 @@ void SamplingProfiler::ProcessSamples()
             m_UniqueCallstacks[callstack.m_Hash] = std::make_shared<CallStack>(callstack);
         }
 
+        // Attribute each frame to the module mapped when the sample was taken,
+        // a region can be reused by another module during the capture.
+        const uint64_t sampleTime = *timeIt;
+        ++timeIt;
+        for( int i = 0; i < callstack.m_Depth; ++i )
+        {
+            DWORD64 addr = callstack.m_Data[i];
+            if( Module* module = m_Process->FindModuleByAddress( addr, sampleTime ) )
+            {
+                m_AddressModules[addr][module]++;
+            }
+        }
+
         ThreadSampleData & threadSampleData = m_ThreadSampleData[callstack.m_ThreadId];
         threadSampleData.m_NumSamples++;
         threadSampleData.m_CallstackCount[callstack.m_Hash]++;
@@ -323,6 +337,7 @@ void SamplingProfiler::ProcessSamples()
 
     m_NumSamples = m_Callstacks.size();
     m_Callstacks.clear();
+    m_CallstackTimes.clear();
     m_State = DoneProcessing;
 }
 
@@ -397,6 +412,18 @@ void SamplingProfiler::ProcessAddresses()
 
         m_RawToResolvedMap[rawCallstackId] = resolvedCallstackId;
     }
+
+    // Reports are by function, fold the module hits of each exact address.
+    for( const auto & addrIt : m_AddressModules )
+    {
+        auto exactIt = m_ExactAddresses.find( addrIt.first );
+        DWORD64 functionAddr = exactIt != m_ExactAddresses.end() ? exactIt->second : addrIt.first;
+        for( const auto & moduleIt : addrIt.second )
+        {
+            m_FunctionModules[functionAddr][moduleIt.first] += moduleIt.second;
+        }
+    }
+    m_AddressModules.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -487,7 +514,21 @@ void SamplingProfiler::OutputStats()
             }
             function.m_Address = address;
 
-            std::shared_ptr<Module> module = m_Process->GetModuleFromAddress(address);
+            // Module mapped at the time of most of the samples hitting the function.
+            Module* module = nullptr;
+            uint32_t moduleCount = 0;
+            for( const auto & moduleIt : m_FunctionModules[address] )
+            {
+                if( moduleIt.second > moduleCount )
+                {
+                    module = moduleIt.first;
+                    moduleCount = moduleIt.second;
+                }
+            }
+            if( module == nullptr )
+            {
+                module = m_Process->FindModuleByAddress( address );
+            }
             function.m_Module = module ? module->m_Name : L"unknown module";
             
             const LineInfo & lineInfo = m_AddressToLineInfo[address];
@@ -525,6 +566,7 @@ void SamplingProfiler::GetThreadCallstack( Thread* a_Thread )
         frame.m_Callstack.m_Depth = depth;
         frame.m_Callstack.m_ThreadId = a_Thread->m_TID;
         m_Callstacks.push_back( frame.m_Callstack );
+        m_CallstackTimes.push_back( OrbitTicks() );
     }
 #endif
 }
@@ -11,6 +11,7 @@
 
 class Process;
 class Thread;
+struct Module;
 
 //-----------------------------------------------------------------------------
 struct SampledFunction
@@ -95,7 +96,7 @@ public:
     float GetSampleTimeTotal() const { return m_SampleTimeSeconds; }
     bool  ShouldStop();
     void FireDoneProcessingCallbacks();
-    void AddCallStack( CallStack & a_CallStack ) { if( m_State == Sampling ) m_Callstacks.push_back( a_CallStack ); }
+    void AddCallStack( CallStack & a_CallStack, uint64_t a_Time = 0 ) { if( m_State == Sampling ){ m_Callstacks.push_back( a_CallStack ); m_CallstackTimes.push_back( a_Time ); } }
     const std::shared_ptr<CallStack> GetCallStack( CallstackID a_ID ) { return m_UniqueCallstacks[a_ID]; }
     std::multimap<int, CallstackID> GetCallStacksFromAddress( DWORD64 a_Addr, ThreadID a_TID, int & o_NumCallstacks );
     std::shared_ptr< SortedCallstackReport > GetSortedCallstacksFromAddress( DWORD64 a_Addr, ThreadID a_TID );
@@ -138,6 +139,7 @@ protected:
     std::unique_ptr<std::thread>    m_SamplingThread;
     std::atomic<SamplingState>      m_State;
     BlockChain<CallStack, 16*1024 > m_Callstacks;
+    BlockChain<uint64_t, 16*1024 >  m_CallstackTimes;
     Timer                           m_SamplingTimer;
     Timer                           m_ThreadUsageTimer;
     int                             m_PeriodMs = 1;
@@ -154,6 +156,8 @@ protected:
     std::unordered_map<DWORD64, std::set<CallstackID>>          m_FunctionToCallstacks;
     std::unordered_map<DWORD64, DWORD64>                        m_ExactAddresses;
     std::unordered_map<DWORD64, std::wstring>                   m_AddressToSymbol;
+    std::unordered_map<DWORD64, std::unordered_map<Module*, uint32_t>> m_AddressModules;  // samples per module mapped at sample time
+    std::unordered_map<DWORD64, std::unordered_map<Module*, uint32_t>> m_FunctionModules; // same, folded by function address
     std::unordered_map<DWORD64, LineInfo>                       m_AddressToLineInfo;
     std::unordered_map<DWORD64, std::wstring>                   m_FileNames;
     std::vector< ProcessingDoneCallback >                       m_Callbacks;
@@ -0,0 +1,503 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "SharedMemoryRing.h"
+#include "PrintVar.h"
+#include "Profiling.h"
+#include "Utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// futex_waitv (Linux 5.16), declared here as older headers lack it.
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449
+#endif
+
+struct FutexWaitv
+{
+    uint64_t m_Value;
+    uint64_t m_Address;
+    uint32_t m_Flags;
+    uint32_t m_Reserved;
+};
+
+static const uint32_t FutexSize32 = 2;  // FUTEX_32, shared between processes
+#endif
+
+static const char RingMagic[8] = { 'O', 'R', 'B', 'S', 'H', 'M', '0', '2' };
+
+const uint64_t SharedMemoryRing::DefaultCapacity;
+const uint32_t SharedMemoryRing::ReaderTimeoutMs;
+
+//-----------------------------------------------------------------------------
+// Read and write positions only ever grow, the ring offset is the position
+// modulo the capacity.  They live on their own cache lines so that the
+// writer and the reader don't false share.  m_WakeSeq is the futex word the
+// reader blocks on, writers only bump it when m_ReaderWaiting is set.
+//-----------------------------------------------------------------------------
+struct SharedRingHeader
+{
+    char                  m_Magic[8];
+    uint64_t              m_Capacity;
+    alignas(64) std::atomic<uint64_t> m_WritePos;
+    alignas(64) std::atomic<uint64_t> m_ReadPos;
+    alignas(64) std::atomic<uint64_t> m_ReaderHeartbeat;
+    std::atomic<uint32_t> m_ReaderAlive;
+    std::atomic<uint32_t> m_ReaderWaiting;
+    std::atomic<uint32_t> m_WakeSeq;
+};
+
+//-----------------------------------------------------------------------------
+// Records are 8 byte aligned: RecordHeader, Message, padding, payload.  A
+// record never wraps, a padding record fills the end of the ring instead.
+//-----------------------------------------------------------------------------
+struct RecordHeader
+{
+    enum { Padding = 1 };
+    uint32_t m_Size;
+    uint32_t m_Flags;
+};
+
+static const uint64_t DataOffset = ( sizeof( SharedRingHeader ) + 63 ) & ~63ull;
+static const uint64_t PayloadOffset = ( sizeof( RecordHeader ) + sizeof( Message ) + 7 ) & ~7ull;
+
+//-----------------------------------------------------------------------------
+static inline uint64_t AlignRecord( uint64_t a_Size )
+{
+    return ( a_Size + 7 ) & ~7ull;
+}
+
+//-----------------------------------------------------------------------------
+SharedMemoryRing::SharedMemoryRing()
+{
+}
+
+//-----------------------------------------------------------------------------
+SharedMemoryRing::~SharedMemoryRing()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryRing::Create( const std::string & a_Name, uint64_t a_Capacity )
+{
+    ScopeLock lock( m_WriteMutex );
+    Close();
+
+    // Power of two so that offsets are a mask away from positions.
+    uint64_t capacity = 4096;
+    while( capacity < a_Capacity )
+        capacity <<= 1;
+
+    m_Name = a_Name;
+    m_IsOwner = true;
+    if( !Map( true, DataOffset + capacity ) )
+        return false;
+
+    m_Header->m_Capacity = capacity;
+    new( &m_Header->m_WritePos ) std::atomic<uint64_t>( 0 );
+    new( &m_Header->m_ReadPos ) std::atomic<uint64_t>( 0 );
+    new( &m_Header->m_ReaderHeartbeat ) std::atomic<uint64_t>( 0 );
+    new( &m_Header->m_ReaderAlive ) std::atomic<uint32_t>( 1 );
+    new( &m_Header->m_ReaderWaiting ) std::atomic<uint32_t>( 0 );
+    new( &m_Header->m_WakeSeq ) std::atomic<uint32_t>( 0 );
+    memcpy( m_Header->m_Magic, RingMagic, sizeof( RingMagic ) );
+    m_Capacity = capacity;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryRing::Open( const std::string & a_Name )
+{
+    ScopeLock lock( m_WriteMutex );
+    Close();
+
+    m_Name = a_Name;
+    m_IsOwner = false;
+    if( !Map( false, 0 ) )
+        return false;
+
+    uint64_t capacity = m_Header->m_Capacity;
+    if( memcmp( m_Header->m_Magic, RingMagic, sizeof( RingMagic ) ) != 0 ||
+        ( capacity & ( capacity - 1 ) ) != 0 ||
+        DataOffset + capacity > m_MappedSize )
+    {
+        Close();
+        return false;
+    }
+
+    m_Capacity = capacity;
+    m_LastHeartbeat = m_Header->m_ReaderHeartbeat;
+    m_LastHeartbeatTicks = OrbitTicks();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryRing::Map( bool a_Create, uint64_t a_Size )
+{
+    void* data = nullptr;
+
+#ifdef _WIN32
+    std::wstring name = s2ws( m_Name );
+    if( a_Create )
+    {
+        m_Mapping = CreateFileMappingW( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)( a_Size >> 32 ), (DWORD)a_Size, name.c_str() );
+    }
+    else
+    {
+        m_Mapping = OpenFileMappingW( FILE_MAP_ALL_ACCESS, FALSE, name.c_str() );
+    }
+
+    if( m_Mapping )
+    {
+        std::wstring eventName = name + L"_Wake";
+        m_WakeEvent = a_Create ? CreateEventW( nullptr, FALSE, FALSE, eventName.c_str() )
+                               : OpenEventW( EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, eventName.c_str() );
+        data = MapViewOfFile( m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+        MEMORY_BASIC_INFORMATION info;
+        if( data && VirtualQuery( data, &info, sizeof( info ) ) )
+        {
+            m_MappedSize = info.RegionSize;
+        }
+    }
+#else
+    std::string name = "/" + m_Name;
+    if( a_Create )
+    {
+        shm_unlink( name.c_str() );
+        m_File = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+        if( m_File >= 0 && ftruncate( m_File, (off_t)a_Size ) != 0 )
+        {
+            close( m_File );
+            m_File = -1;
+        }
+    }
+    else
+    {
+        m_File = shm_open( name.c_str(), O_RDWR, 0600 );
+        struct stat info;
+        if( m_File >= 0 && fstat( m_File, &info ) == 0 )
+        {
+            a_Size = (uint64_t)info.st_size;
+        }
+    }
+
+    if( m_File >= 0 && a_Size >= DataOffset )
+    {
+        data = mmap( nullptr, (size_t)a_Size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0 );
+        if( data == MAP_FAILED )
+            data = nullptr;
+        m_MappedSize = a_Size;
+    }
+#endif
+
+#ifdef _WIN32
+    if( m_WakeEvent == nullptr && data )
+    {
+        UnmapViewOfFile( data );
+        data = nullptr;
+    }
+#endif
+
+    if( data == nullptr || m_MappedSize < DataOffset )
+    {
+        m_Header = (SharedRingHeader*)data;
+        Close();
+        return false;
+    }
+
+    m_Header = (SharedRingHeader*)data;
+    m_Data = (char*)data + DataOffset;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryRing::Close()
+{
+    ScopeLock lock( m_WriteMutex );
+
+    // Writers still mapping the ring stop using it.
+    if( m_Header && m_IsOwner && m_Capacity > 0 )
+        m_Header->m_ReaderAlive = 0;
+
+#ifdef _WIN32
+    if( m_Header )
+        UnmapViewOfFile( m_Header );
+    if( m_Mapping )
+        CloseHandle( m_Mapping );
+    if( m_WakeEvent )
+        CloseHandle( m_WakeEvent );
+    m_Mapping = nullptr;
+    m_WakeEvent = nullptr;
+#else
+    if( m_Header )
+        munmap( m_Header, (size_t)m_MappedSize );
+    if( m_File >= 0 )
+        close( m_File );
+    if( m_File >= 0 && m_IsOwner )
+        shm_unlink( ( "/" + m_Name ).c_str() );
+    m_File = -1;
+#endif
+
+    m_Header = nullptr;
+    m_Data = nullptr;
+    m_Capacity = 0;
+    m_MappedSize = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryRing::Write( const Message & a_Message, const void* a_Payload )
+{
+    return Write( a_Message, a_Payload, a_Message.m_Size, nullptr, 0 );
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryRing::Write( const Message & a_Message, const void* a_Part0, size_t a_Size0, const void* a_Part1, size_t a_Size1 )
+{
+    // Cheap early out for the common case of a remote capture.
+    if( !IsOpen() )
+        return false;
+
+    ScopeLock lock( m_WriteMutex );
+
+    uint64_t recordSize = AlignRecord( PayloadOffset + a_Size0 + a_Size1 );
+    if( !IsOpen() || recordSize > m_Capacity/2 )
+        return false;
+
+    if( !IsReaderAlive() )
+    {
+        PRINT( "Shared memory reader is gone, using tcp\n" );
+        Close();
+        return false;
+    }
+
+    uint64_t writePos = m_Header->m_WritePos.load( std::memory_order_relaxed );
+    uint64_t readPos = m_Header->m_ReadPos.load( std::memory_order_acquire );
+    uint64_t offset = writePos & ( m_Capacity - 1 );
+    uint64_t contiguous = m_Capacity - offset;
+    uint64_t needed = recordSize + ( contiguous < recordSize ? contiguous : 0 );
+
+    if( m_Capacity - ( writePos - readPos ) < needed )
+        return false;
+
+    if( contiguous < recordSize )
+    {
+        RecordHeader* padding = (RecordHeader*)( m_Data + offset );
+        padding->m_Size = (uint32_t)contiguous;
+        padding->m_Flags = RecordHeader::Padding;
+        writePos += contiguous;
+        offset = 0;
+    }
+
+    char* record = m_Data + offset;
+    RecordHeader* header = (RecordHeader*)record;
+    header->m_Size = (uint32_t)recordSize;
+    header->m_Flags = 0;
+
+    memcpy( record + sizeof( RecordHeader ), &a_Message, sizeof( Message ) );
+    ( (Message*)( record + sizeof( RecordHeader ) ) )->m_Size = (uint32_t)( a_Size0 + a_Size1 );
+
+    if( a_Part0 )
+        memcpy( record + PayloadOffset, a_Part0, a_Size0 );
+    if( a_Part1 )
+        memcpy( record + PayloadOffset + a_Size0, a_Part1, a_Size1 );
+
+    // Sequentially consistent with the reader's m_ReaderWaiting store, either
+    // the reader sees the message before blocking or we see it waiting.
+    m_Header->m_WritePos.store( writePos + recordSize );
+    if( m_Header->m_ReaderWaiting.load() != 0 && m_Header->m_ReaderWaiting.exchange( 0 ) != 0 )
+    {
+        WakeReader();
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool SharedMemoryRing::IsReaderAlive()
+{
+    if( m_Header->m_ReaderAlive.load( std::memory_order_relaxed ) == 0 )
+        return false;
+
+    // The heartbeat is a counter, time is measured on the writer's clock.
+    uint64_t heartbeat = m_Header->m_ReaderHeartbeat.load( std::memory_order_relaxed );
+    TickType now = OrbitTicks();
+    if( heartbeat != m_LastHeartbeat )
+    {
+        m_LastHeartbeat = heartbeat;
+        m_LastHeartbeatTicks = now;
+        return true;
+    }
+
+    return MicroSecondsFromTicks( m_LastHeartbeatTicks, now ) < ReaderTimeoutMs*1000.0;
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryRing::WakeReader()
+{
+#ifdef _WIN32
+    SetEvent( m_WakeEvent );
+#else
+    m_Header->m_WakeSeq.fetch_add( 1 );
+    syscall( SYS_futex, (uint32_t*)&m_Header->m_WakeSeq, FUTEX_WAKE, 1, nullptr, nullptr, 0 );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryRing::Wait( uint32_t a_TimeoutMs )
+{
+    if( !IsOpen() )
+        return;
+
+    uint32_t wakeSeq = m_Header->m_WakeSeq.load();
+    m_Header->m_ReaderWaiting.store( 1 );
+
+    if( m_Header->m_WritePos.load() == m_Header->m_ReadPos.load( std::memory_order_relaxed ) )
+    {
+#ifdef _WIN32
+        UNUSED( wakeSeq );
+        WaitForSingleObject( m_WakeEvent, a_TimeoutMs );
+#else
+        // Not FUTEX_PRIVATE, the word is shared with the target process.
+        timespec timeout = { (time_t)( a_TimeoutMs/1000 ), (long)( a_TimeoutMs%1000 )*1000000 };
+        syscall( SYS_futex, (uint32_t*)&m_Header->m_WakeSeq, FUTEX_WAIT, wakeSeq, &timeout, nullptr, 0 );
+#endif
+    }
+
+    m_Header->m_ReaderWaiting.store( 0, std::memory_order_relaxed );
+}
+
+//-----------------------------------------------------------------------------
+void SharedMemoryRing::WaitAny( const std::vector< std::shared_ptr<SharedMemoryRing> > & a_Rings, uint32_t a_TimeoutMs )
+{
+    if( a_Rings.size() == 1 )
+    {
+        a_Rings[0]->Wait( a_TimeoutMs );
+        return;
+    }
+
+    // Every ring is told we are waiting before checking any of them, a write
+    // after its check wakes us like in Wait.
+    std::vector<SharedRingHeader*> headers;
+    std::vector<uint32_t> wakeSeqs;
+    for( const std::shared_ptr<SharedMemoryRing> & ring : a_Rings )
+    {
+        if( ring->IsOpen() )
+        {
+            headers.push_back( ring->m_Header );
+            wakeSeqs.push_back( ring->m_Header->m_WakeSeq.load() );
+            ring->m_Header->m_ReaderWaiting.store( 1 );
+        }
+    }
+
+    bool hasPending = false;
+    for( SharedRingHeader* header : headers )
+    {
+        hasPending |= header->m_WritePos.load() != header->m_ReadPos.load( std::memory_order_relaxed );
+    }
+
+    if( !hasPending && !headers.empty() )
+    {
+#ifdef _WIN32
+        std::vector<HANDLE> events;
+        for( const std::shared_ptr<SharedMemoryRing> & ring : a_Rings )
+        {
+            if( ring->IsOpen() && events.size() < MAXIMUM_WAIT_OBJECTS )
+                events.push_back( ring->m_WakeEvent );
+        }
+        WaitForMultipleObjects( (DWORD)events.size(), events.data(), FALSE, a_TimeoutMs );
+#else
+        std::vector<FutexWaitv> waiters( headers.size() );
+        for( size_t i = 0; i < headers.size(); ++i )
+        {
+            waiters[i].m_Value = wakeSeqs[i];
+            waiters[i].m_Address = (uint64_t)(uintptr_t)&headers[i]->m_WakeSeq;
+            waiters[i].m_Flags = FutexSize32;
+            waiters[i].m_Reserved = 0;
+        }
+
+        // The timeout is absolute.
+        timespec timeout;
+        clock_gettime( CLOCK_MONOTONIC, &timeout );
+        timeout.tv_sec += a_TimeoutMs/1000;
+        timeout.tv_nsec += (long)( a_TimeoutMs%1000 )*1000000;
+        if( timeout.tv_nsec >= 1000000000 )
+        {
+            timeout.tv_sec += 1;
+            timeout.tv_nsec -= 1000000000;
+        }
+
+        if( syscall( SYS_futex_waitv, waiters.data(), (unsigned)waiters.size(), 0, &timeout, CLOCK_MONOTONIC ) < 0 && errno == ENOSYS )
+        {
+            // Older kernels, block on the first ring and poll the others.
+            timespec shortTimeout = { 0, 1000000 };
+            syscall( SYS_futex, (uint32_t*)&headers[0]->m_WakeSeq, FUTEX_WAIT, wakeSeqs[0], &shortTimeout, nullptr, 0 );
+        }
+#endif
+    }
+
+    for( SharedRingHeader* header : headers )
+    {
+        header->m_ReaderWaiting.store( 0, std::memory_order_relaxed );
+    }
+}
+
+//-----------------------------------------------------------------------------
+size_t SharedMemoryRing::Read( const MessageCallback & a_Callback )
+{
+    if( !IsOpen() )
+        return 0;
+
+    uint64_t readPos = m_Header->m_ReadPos.load( std::memory_order_relaxed );
+    uint64_t writePos = m_Header->m_WritePos.load( std::memory_order_acquire );
+    size_t numMessages = 0;
+
+    while( readPos < writePos )
+    {
+        uint64_t offset = readPos & ( m_Capacity - 1 );
+        const char* record = m_Data + offset;
+        const RecordHeader* header = (const RecordHeader*)record;
+
+        // Don't trust the other process, resync on garbage.
+        uint64_t recordSize = header->m_Size;
+        if( recordSize < sizeof( RecordHeader ) || ( recordSize & 7 ) != 0 || recordSize > writePos - readPos || offset + recordSize > m_Capacity )
+        {
+            readPos = writePos;
+            break;
+        }
+
+        if( ( header->m_Flags & RecordHeader::Padding ) == 0 )
+        {
+            Message message;
+            memcpy( &message, record + sizeof( RecordHeader ), sizeof( Message ) );
+            if( PayloadOffset + message.m_Size > recordSize )
+            {
+                readPos = writePos;
+                break;
+            }
+
+            message.m_Data = message.m_Size > 0 ? (char*)record + PayloadOffset : nullptr;
+            a_Callback( message );
+            ++numMessages;
+        }
+
+        readPos += recordSize;
+    }
+
+    m_Header->m_ReadPos.store( readPos, std::memory_order_release );
+    m_Header->m_ReaderHeartbeat.fetch_add( 1, std::memory_order_relaxed );
+    return numMessages;
+}
@@ -0,0 +1,104 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "Platform.h"
+#include "Message.h"
+#include "Threading.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Message ring in shared memory, used instead of the socket when Orbit and
+// the target run on the same machine.  Orbit creates the region and sends
+// its name over TCP (Msg_SharedMemoryTransport), the target opens it.
+//
+// Writers copy a message straight into the ring and publish it with a single
+// atomic store, the reader hands messages out in place.  Neither side makes a
+// system call per message, writers only wake the reader when it is blocked
+// in Wait.  Writes fail when the ring is full, callers fall back to the
+// socket.
+//
+// Only timers and callstacks go through the ring, everything else and what
+// doesn't fit still goes over the socket, so the order between the two is
+// lost.  Nothing depends on it: timers carry their own time and session id,
+// callstacks are looked up by hash when they are displayed and the queue
+// and flush counts sent over TCP are only statistics.
+//
+// The reader bumps a heartbeat on every Read and clears an alive flag when it
+// closes the ring.  Writers close their side once the reader is gone or has
+// been silent for ReaderTimeoutMs, so a target never keeps filling a ring
+// nobody reads.
+//-----------------------------------------------------------------------------
+class SharedMemoryRing
+{
+public:
+    SharedMemoryRing();
+    ~SharedMemoryRing();
+
+    bool Create( const std::string & a_Name, uint64_t a_Capacity );
+    bool Open( const std::string & a_Name );
+    void Close();
+
+    bool IsOpen() const { return m_Header != nullptr; }
+    const std::string & GetName() const { return m_Name; }
+    uint64_t GetCapacity() const { return m_Capacity; }
+
+    // Thread safe, also against Open and Close.  The payload can be gathered
+    // from two parts.
+    bool Write( const Message & a_Message, const void* a_Payload );
+    bool Write( const Message & a_Message, const void* a_Part0, size_t a_Size0, const void* a_Part1, size_t a_Size1 );
+
+    // Single reader.  Messages are only valid during the callback, returns
+    // the number of messages read.
+    typedef std::function< void( const Message & ) > MessageCallback;
+    size_t Read( const MessageCallback & a_Callback );
+
+    // Reader side, blocks until a writer publishes a message or the timeout
+    // expires.  Returns immediately if messages are pending.
+    void Wait( uint32_t a_TimeoutMs );
+
+    // Same for several rings, returns when any of them has messages.
+    static void WaitAny( const std::vector< std::shared_ptr<SharedMemoryRing> > & a_Rings, uint32_t a_TimeoutMs );
+
+    static const uint64_t DefaultCapacity = 64*1024*1024;
+    static const uint32_t ReaderTimeoutMs = 5000;
+
+protected:
+    bool Map( bool a_Create, uint64_t a_Size );
+    bool IsReaderAlive();
+    void WakeReader();
+
+protected:
+    std::string              m_Name;
+    struct SharedRingHeader* m_Header = nullptr;
+    char*                    m_Data = nullptr;
+    uint64_t                 m_Capacity = 0;
+    uint64_t                 m_MappedSize = 0;
+    bool                     m_IsOwner = false;
+    Mutex                    m_WriteMutex;
+    uint64_t                 m_LastHeartbeat = 0;
+    uint64_t                 m_LastHeartbeatTicks = 0;
+#ifdef _WIN32
+    HANDLE                   m_Mapping = nullptr;
+    HANDLE                   m_WakeEvent = nullptr;
+#else
+    int                      m_File = -1;
+#endif
+};
+
+//-----------------------------------------------------------------------------
+#pragma pack(push, 1)
+struct SharedMemoryTransport
+{
+    enum { NameSize = 64 };
+    uint64_t m_Capacity;
+    char     m_Name[NameSize];
+};
+#pragma pack(pop)
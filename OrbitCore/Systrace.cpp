@@ -3,112 +3,169 @@
 #include "ScopeTimer.h"
 #include "Capture.h"
 #include "Profiling.h"
-#include "LinuxUtils.h"
-#include <fstream>
+#include "MappedFile.h"
+#include <algorithm>
+#include <thread>
 
 //-----------------------------------------------------------------------------
-bool ShouldIgnore(const std::string& line)
+// A B or E tracing_mark_write line, names point into the mapped file.
+struct SystraceEvent
 {
-    return StartsWith(line, "#") ||
-           Contains(line, "<script class=") ||
-           Contains(line, "</script>") ||
-           Contains(line, "<!-- ");
-}
+    uint64_t    m_Micros;
+    uint64_t    m_NameHash;
+    const char* m_Name;
+    const char* m_ThreadName;
+    uint32_t    m_NameSize;
+    uint32_t    m_ThreadNameSize;
+    uint32_t    m_ThreadId;
+    bool        m_IsBegin;
+};
 
 //-----------------------------------------------------------------------------
-bool IsBegin(const std::string& line)
+static const char* Find(const char* a_Begin, const char* a_End, const char* a_Text)
 {
-    return Contains(line, "tracing_mark_write: B");
+    const char* found = std::search(a_Begin, a_End, a_Text, a_Text + strlen(a_Text));
+    return found != a_End ? found : nullptr;
 }
 
 //-----------------------------------------------------------------------------
-bool IsEnd(const std::string& line)
+static inline bool IsDigit(char a_Char)
 {
-    return Contains(line, "tracing_mark_write: E");
+    return a_Char >= '0' && a_Char <= '9';
 }
 
 //-----------------------------------------------------------------------------
-bool IsTraceBegin(const std::string& line)
+// "  comm-tid  (tgid) [cpu] flags  seconds.micros: tracing_mark_write: B|pid|name"
+// The tgid and flags fields are missing from older traces.
+static bool ParseLine(const char* a_Begin, const char* a_End, SystraceEvent& o_Event)
 {
-    return Contains(line, "<!-- BEGIN TRACE -->");
-}
+    static const char marker[] = "tracing_mark_write: ";
+    const char* mark = Find(a_Begin, a_End, marker);
+    if (mark == nullptr)
+        return false;
 
-//-----------------------------------------------------------------------------
-bool IsTraceEnd(const std::string& line)
-{
-    return Contains(line, "<!-- END TRACE -->");
-}
+    const char* type = mark + sizeof(marker) - 1;
+    if (type >= a_End || (*type != 'B' && *type != 'E'))
+        return false;
+    o_Event.m_IsBegin = *type == 'B';
 
-//-----------------------------------------------------------------------------
-std::string GetThreadName(const std::string& a_Line)
-{
-    auto tokens = Tokenize(a_Line, "(");
-    return tokens.size() ? tokens[0] : "unknown-thread-name";
-}
+    // Timestamp, right before the marker.
+    const char* tsEnd = mark - 2;
+    if (tsEnd <= a_Begin || *tsEnd != ':')
+        return false;
+    const char* tsBegin = tsEnd;
+    while (tsBegin > a_Begin && (IsDigit(tsBegin[-1]) || tsBegin[-1] == '.'))
+        --tsBegin;
 
-//-----------------------------------------------------------------------------
-std::string GetTimeStamp(const std::string& a_Line)
-{
-    auto tokens = Tokenize(a_Line, "]");
-    if (tokens.size() > 1)
+    uint64_t seconds = 0;
+    uint64_t micros = 0;
+    uint64_t scale = 1000000;
+    bool fraction = false;
+    for (const char* c = tsBegin; c < tsEnd; ++c)
     {
-        tokens = Tokenize(tokens[1]);
-        if (tokens.size() > 1)
-            return tokens[1];
+        if (*c == '.')
+            fraction = true;
+        else if (!fraction)
+            seconds = seconds*10 + (*c - '0');
+        else if (scale > 1)
+            micros += (*c - '0')*(scale /= 10);
     }
-    return "0";
-}
+    o_Event.m_Micros = seconds*1000000 + micros;
 
-//-----------------------------------------------------------------------------
-std::string GetFunction(const std::string& a_Line)
-{
-    auto tokens = Tokenize(a_Line, "|");
-    return tokens.size() ? tokens.back() : "unknown-function";
+    // Thread, the comm-tid token before the optional tgid and the cpu.
+    const char* cpu = tsBegin;
+    while (cpu > a_Begin && *cpu != '[')
+        --cpu;
+    const char* threadEnd = cpu;
+    while (threadEnd > a_Begin && threadEnd[-1] == ' ')
+        --threadEnd;
+    if (threadEnd > a_Begin && threadEnd[-1] == ')')
+    {
+        while (threadEnd > a_Begin && threadEnd[-1] != '(')
+            --threadEnd;
+        if (threadEnd > a_Begin)
+            --threadEnd;
+        while (threadEnd > a_Begin && threadEnd[-1] == ' ')
+            --threadEnd;
+    }
+
+    const char* tidBegin = threadEnd;
+    while (tidBegin > a_Begin && IsDigit(tidBegin[-1]))
+        --tidBegin;
+    if (tidBegin == threadEnd || tidBegin == a_Begin || tidBegin[-1] != '-')
+        return false;
+
+    uint32_t tid = 0;
+    for (const char* c = tidBegin; c < threadEnd; ++c)
+        tid = tid*10 + (*c - '0');
+    o_Event.m_ThreadId = tid;
+
+    const char* threadBegin = a_Begin;
+    while (threadBegin < threadEnd && *threadBegin == ' ')
+        ++threadBegin;
+    o_Event.m_ThreadName = threadBegin;
+    o_Event.m_ThreadNameSize = (uint32_t)(threadEnd - threadBegin);
+
+    // Function, after the last '|'.
+    const char* nameEnd = a_End;
+    while (nameEnd > type && (nameEnd[-1] == '\r' || nameEnd[-1] == ' '))
+        --nameEnd;
+    const char* nameBegin = nameEnd;
+    while (nameBegin > type && nameBegin[-1] != '|')
+        --nameBegin;
+    o_Event.m_Name = nameBegin;
+    o_Event.m_NameSize = (uint32_t)(nameEnd - nameBegin);
+    o_Event.m_NameHash = o_Event.m_IsBegin ? StringHash(nameBegin, nameEnd - nameBegin) : 0;
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
-DWORD Systrace::GetThreadId(const std::string& a_ThreadName)
+static void ParseChunk(const char* a_Begin, const char* a_End, std::vector<SystraceEvent>& o_Events)
 {
-    auto it = m_ThreadIDs.find(a_ThreadName);
-    if (it == m_ThreadIDs.end())
+    SystraceEvent event;
+    for (const char* line = a_Begin; line < a_End;)
     {
-        auto tid = SystraceManager::Get().GetNewThreadID();
-        m_ThreadIDs[a_ThreadName] = tid;
-        m_ThreadNames[tid] = a_ThreadName;
+        const char* lineEnd = (const char*)memchr(line, '\n', a_End - line);
+        if (lineEnd == nullptr)
+            lineEnd = a_End;
+
+        if (ParseLine(line, lineEnd, event))
+            o_Events.push_back(event);
+
+        line = lineEnd + 1;
     }
-    return m_ThreadIDs[a_ThreadName];
 }
 
 //-----------------------------------------------------------------------------
-uint64_t Systrace::ProcessString(const std::string& a_String)
+DWORD Systrace::GetThreadId(uint32_t a_ThreadId, const char* a_ThreadName, size_t a_Size)
 {
-    auto hash = StringHash(a_String);
-    if (m_StringMap.find(hash) == m_StringMap.end())
+    auto it = m_ThreadIDs.find(a_ThreadId);
+    if (it == m_ThreadIDs.end())
     {
-        m_StringMap[hash] = a_String;
+        auto tid = SystraceManager::Get().GetNewThreadID();
+        it = m_ThreadIDs.emplace(a_ThreadId, tid).first;
+        m_ThreadNames[tid] = std::string(a_ThreadName, a_Size);
     }
-
-    return hash;
+    return it->second;
 }
 
 //-----------------------------------------------------------------------------
-uint64_t Systrace::ProcessFunctionName(const std::string& a_String)
+void Systrace::ProcessFunctionName(uint64_t a_Hash, const char* a_Name, size_t a_Size)
 {
-    std::vector<std::string> tokens = Tokenize(a_String, "|");
-    if (tokens.size())
-    {
-        const std::string& function = tokens.back();
-        uint64_t hash = ProcessString(function);
-        Function func;
-        func.m_Address = hash;
-        func.m_Name = func.m_PrettyName = s2ws(function);
-        func.m_PrettyNameStr = function;
-        func.m_PrettyNameLower = ToLower(func.m_Name);
-        m_Functions.push_back(func);
-        return hash;
-    }
+    // One Function per distinct name.
+    if (m_StringMap.find(a_Hash) != m_StringMap.end())
+        return;
 
-    return 0;
+    std::string function(a_Name, a_Size);
+    m_StringMap[a_Hash] = function;
+
+    Function func;
+    func.m_Address = a_Hash;
+    func.m_Name = func.m_PrettyName = s2ws(function);
+    func.m_PrettyNameStr = function;
+    func.m_PrettyNameLower = ToLower(func.m_Name);
+    m_Functions.push_back(func);
 }
 
 //-----------------------------------------------------------------------------
@@ -130,55 +187,94 @@ void Systrace::UpdateMinMax(const Timer& a_Timer)
         m_MaxTime = a_Timer.m_End;
 }
 
+//-----------------------------------------------------------------------------
+void Systrace::ProcessEvents(const std::vector<SystraceEvent>& a_Events)
+{
+    double offsetMicros = m_TimeOffsetNs*0.001;
+    for (const SystraceEvent& event : a_Events)
+    {
+        std::vector<Timer>& timers = m_TimerStacks[event.m_ThreadId];
+        if (event.m_IsBegin)
+        {
+            Timer timer;
+            timer.m_TID = GetThreadId(event.m_ThreadId, event.m_ThreadName, event.m_ThreadNameSize);
+            timer.m_Start = TicksFromMicroseconds(event.m_Micros + offsetMicros);
+            timer.m_Depth = (uint8_t)timers.size();
+            timer.m_FunctionAddress = event.m_NameHash;
+            ProcessFunctionName(event.m_NameHash, event.m_Name, event.m_NameSize);
+            timers.push_back(timer);
+        }
+        else if (timers.size())
+        {
+            Timer& timer = timers.back();
+            timer.m_End = TicksFromMicroseconds(event.m_Micros + offsetMicros);
+            m_Timers.push_back(timer);
+            UpdateMinMax(timer);
+            timers.pop_back();
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 Systrace::Systrace(const char* a_FilePath, uint64_t a_TimeOffsetNs)
 {
     SCOPE_TIMER_LOG(L"Systrace Parsing");
     m_Name = a_FilePath;
-    std::ifstream infile(a_FilePath);
-    std::string line;
     m_TimeOffsetNs = a_TimeOffsetNs;
-    bool foundBegin = false;
-    while (std::getline(infile, line))
+
+    MappedFile file;
+    if (!file.Open(a_FilePath))
+    {
+        PRINT_VAR(a_FilePath);
+        return;
+    }
+
+    // Html captures wrap the ftrace text, plain ftrace files are used whole.
+    const char* begin = file.GetData();
+    const char* end = begin + file.GetSize();
+    if (const char* traceBegin = Find(begin, end, "<!-- BEGIN TRACE -->"))
+    {
+        const char* lineEnd = (const char*)memchr(traceBegin, '\n', end - traceBegin);
+        begin = lineEnd ? lineEnd + 1 : end;
+    }
+    if (const char* traceEnd = Find(begin, end, "<!-- END TRACE -->"))
+    {
+        end = traceEnd;
+    }
+
+    // Workers parse line aligned chunks, events are then matched in file
+    // order on this thread.
+    size_t size = end - begin;
+    size_t numWorkers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), size/MinBytesPerWorker + 1);
+    std::vector<const char*> bounds(numWorkers + 1, end);
+    bounds[0] = begin;
+    for (size_t i = 1; i < numWorkers; ++i)
+    {
+        const char* split = std::max(bounds[i - 1], begin + size*i/numWorkers);
+        const char* lineEnd = (const char*)memchr(split, '\n', end - split);
+        bounds[i] = lineEnd ? lineEnd + 1 : end;
+    }
+
+    std::vector<std::vector<SystraceEvent>> events(numWorkers);
+    {
+        SCOPE_TIMER_LOG(L"Parse Lines");
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < numWorkers; ++i)
+        {
+            threads.emplace_back([&, i]() { ParseChunk(bounds[i], bounds[i + 1], events[i]); });
+        }
+        ParseChunk(bounds[0], bounds[1], events[0]);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
     {
-        if (IsTraceBegin(line))
-            foundBegin = true;
-        if (!foundBegin)
-            continue;
-        if (IsTraceEnd(line))
-            break;
-
-        bool isBegin = IsBegin(line);
-        bool isEnd = IsEnd(line);
-        if (isBegin || isEnd)
+        SCOPE_TIMER_LOG(L"Match Events");
+        for (const std::vector<SystraceEvent>& chunkEvents : events)
         {
-            const std::string& threadName = GetThreadName(line);
-            const std::string& timestamp = GetTimeStamp(line);
-
-            if (isBegin)
-            {
-                Timer timer;
-                timer.m_TID = GetThreadId(threadName);
-                timer.m_Start = TicksFromMicroseconds(GetMicros(timestamp) + m_TimeOffsetNs*0.001);
-
-                timer.m_Depth = (uint8_t)m_TimerStacks[threadName].size();
-                const std::string& function = GetFunction(line);
-                timer.m_FunctionAddress = ProcessFunctionName(function);
-                m_TimerStacks[threadName].push_back(timer);
-            }
-
-            if (isEnd)
-            {
-                std::vector<Timer>& timers = m_TimerStacks[threadName];
-                if (timers.size())
-                {
-                    Timer& timer = timers.back();
-                    timer.m_End = TicksFromMicroseconds(GetMicros(timestamp) + m_TimeOffsetNs*0.001);
-                    m_Timers.push_back(timer);
-                    UpdateMinMax(timer);
-                    timers.pop_back();
-                }
-            }
+            ProcessEvents(chunkEvents);
         }
     }
 
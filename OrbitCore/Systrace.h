@@ -6,6 +6,7 @@
 #include "Core.h"
 #include "ScopeTimer.h"
 #include "OrbitFunction.h"
+#include "FlatHashMap.h"
 #include <vector>
 #include <string>
 #include <map>
@@ -27,15 +28,18 @@ public:
 
 
 protected:
-    DWORD GetThreadId(const std::string& a_ThreadName);
-    uint64_t ProcessString(const std::string& a_String);
-    uint64_t ProcessFunctionName(const std::string& a_String);
+    DWORD GetThreadId(uint32_t a_ThreadId, const char* a_ThreadName, size_t a_Size);
+    void ProcessFunctionName(uint64_t a_Hash, const char* a_Name, size_t a_Size);
+    void ProcessEvents(const std::vector<struct SystraceEvent>& a_Events);
     void UpdateMinMax(const Timer& a_Timer);
 
+    // Below this size a file is parsed by a single thread.
+    static const size_t MinBytesPerWorker = 4*1024*1024;
+
 private:    
     std::vector<Timer>                          m_Timers;
-    std::map<std::string, std::vector<Timer>>   m_TimerStacks;
-    std::map<std::string, DWORD>                m_ThreadIDs;
+    FlatHashMap<uint32_t, std::vector<Timer>, 0xFFFFFFFF> m_TimerStacks;
+    std::unordered_map<uint32_t, DWORD>         m_ThreadIDs;
     std::unordered_map<DWORD, std::string>      m_ThreadNames;
     std::unordered_map<uint64_t, std::string>   m_StringMap;
     std::vector<Function>                       m_Functions;
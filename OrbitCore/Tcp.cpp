@@ -8,6 +8,8 @@
 #include "Capture.h"
 #include "PrintVar.h"
 
+#include <algorithm>
+
 /*
 #include "websocketpp/frame.hpp"
 #include "websocketpp/base64/base64.hpp"
@@ -34,6 +36,7 @@ tcp_server::tcp_server( asio::io_service & io_service, unsigned short port )
 void tcp_server::Disconnect()
 {
     PRINT_FUNC;
+    ScopeLock lock( m_Mutex );
     if( m_Connection )
     {
         Message msg( Msg_Unload, 0, nullptr );
@@ -42,17 +45,135 @@ void tcp_server::Disconnect()
     }
 }
 
+//-----------------------------------------------------------------------------
+bool tcp_server::HasConnection()
+{
+    ScopeLock lock( m_Mutex );
+    return m_Connection != nullptr;
+}
+
+//-----------------------------------------------------------------------------
+static std::shared_ptr<TcpSocket> GetConnectionSocket( const std::shared_ptr<TcpConnection> & a_Connection )
+{
+    // Shares ownership of the connection the socket belongs to.
+    return std::shared_ptr<TcpSocket>( a_Connection, &a_Connection->GetSocket() );
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<TcpSocket> tcp_server::GetSocket()
+{
+    ScopeLock lock( m_Mutex );
+    return m_Connection ? GetConnectionSocket( m_Connection ) : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void tcp_server::GetSockets( uint32_t a_Destination, std::vector< std::shared_ptr<TcpSocket> > & o_Sockets )
+{
+    ScopeLock lock( m_Mutex );
+
+    if( a_Destination == TcpPacket::Primary )
+    {
+        if( m_Connection && m_Connection->IsOpen() )
+            o_Sockets.push_back( GetConnectionSocket( m_Connection ) );
+        return;
+    }
+
+    for( const std::shared_ptr<TcpConnection> & connection : m_ConnectionsSet )
+    {
+        bool isDestination = a_Destination == TcpPacket::Broadcast || connection->GetSourceId() == a_Destination;
+        if( isDestination && connection->IsOpen() && !connection->IsWebsocket() )
+        {
+            o_Sockets.push_back( GetConnectionSocket( connection ) );
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 void tcp_server::RegisterConnection( std::shared_ptr<TcpConnection> a_Connection )
 {
+    ScopeLock lock( m_Mutex );
     m_Connection = a_Connection;
 }
 
+//-----------------------------------------------------------------------------
+void tcp_server::OnConnectionClosed( TcpConnection* a_Connection )
+{
+    {
+        ScopeLock lock( m_Mutex );
+
+        // The connection thread holds its own reference, erasing is safe here.
+        for( auto it = m_ConnectionsSet.begin(); it != m_ConnectionsSet.end(); ++it )
+        {
+            if( it->get() == a_Connection )
+            {
+                m_ConnectionsSet.erase( it );
+                break;
+            }
+        }
+
+        if( m_Connection.get() == a_Connection )
+        {
+            // Hand over to a target that is still connected, if any.
+            m_Connection = nullptr;
+            for( const std::shared_ptr<TcpConnection> & connection : m_ConnectionsSet )
+            {
+                if( connection->IsOpen() && !connection->IsWebsocket() )
+                {
+                    m_Connection = connection;
+                    break;
+                }
+            }
+        }
+    }
+
+    if( a_Connection->GetSourceId() != 0 )
+    {
+        GTcpServer->OnSourceClosed( a_Connection->GetSourceId() );
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint32_t> tcp_server::GetLocalSourceIds()
+{
+    ScopeLock lock( m_Mutex );
+    std::vector<uint32_t> sourceIds;
+    for( const std::shared_ptr<TcpConnection> & connection : m_ConnectionsSet )
+    {
+        if( connection->IsOpen() && connection->GetSourceId() != 0 && connection->IsLocal() )
+        {
+            sourceIds.push_back( connection->GetSourceId() );
+        }
+    }
+    return sourceIds;
+}
+
+//-----------------------------------------------------------------------------
+ULONG64 tcp_server::GetNumBytesReceived()
+{
+    ScopeLock lock( m_Mutex );
+    ULONG64 numBytes = 0;
+    for( const std::shared_ptr<TcpConnection> & connection : m_ConnectionsSet )
+    {
+        numBytes += connection->GetNumBytesReceived();
+    }
+    return numBytes;
+}
+
+//-----------------------------------------------------------------------------
+void tcp_server::ResetStats()
+{
+    ScopeLock lock( m_Mutex );
+    for( const std::shared_ptr<TcpConnection> & connection : m_ConnectionsSet )
+    {
+        connection->ResetStats();
+    }
+}
+
 //-----------------------------------------------------------------------------
 void tcp_server::start_accept()
 {
-    // creates a socket
-    TcpConnection::pointer new_connection = TcpConnection::create( m_Acceptor.get_io_service() );
+    // creates a socket, serviced by its own io_service once connected
+    TcpConnection::pointer new_connection = TcpConnection::create();
 
     // initiates an asynchronous accept operation 
     // to wait for a new connection. 
@@ -72,7 +193,11 @@ void tcp_server::handle_accept(TcpConnection::pointer new_connection, const asio
     if( !error )
     {
         PRINT_FUNC;
-        m_ConnectionsSet.insert( new_connection );
+        {
+            ScopeLock lock( m_Mutex );
+            m_ConnectionsSet.insert( new_connection );
+            m_Connection = new_connection;
+        }
         new_connection->start();
     }
 
@@ -85,28 +210,149 @@ TcpConnection::~TcpConnection()
     PRINT_VAR( "TcpConnection::~TcpConnection()" );
 }
 
+//-----------------------------------------------------------------------------
+void TcpConnection::start()
+{
+    ReadMessage();
+
+    // The thread keeps the connection alive until its socket is closed.
+    pointer self = shared_from_this();
+    std::thread thread( [self]()
+    {
+        SetCurrentThreadName( L"TcpConnection" );
+        self->m_IoService.run();
+    } );
+    thread.detach();
+}
+
+//-----------------------------------------------------------------------------
+void TcpConnection::Close()
+{
+    m_Socket.close();
+    GTcpServer->GetServer()->OnConnectionClosed( this );
+}
+
+//-----------------------------------------------------------------------------
+bool TcpConnection::IsLocal()
+{
+    asio::error_code error;
+    tcp::endpoint endPoint = m_Socket.remote_endpoint( error );
+    return !error && endPoint.address().is_loopback();
+}
+
+//-----------------------------------------------------------------------------
+bool IsWebSocketHandshakeMessage( Message& a_Message )
+{
+    char* a_String = reinterpret_cast<char*>( &a_Message );
+    return a_String[0] == 'G' &&
+           a_String[1] == 'E' &&
+           a_String[2] == 'T';
+}
+
 //-----------------------------------------------------------------------------
 void TcpConnection::ReadMessage()
 {
-    asio::async_read( m_Socket, asio::buffer( &m_Message, sizeof(Message) ), 
-        
-    [this]( asio::error_code ec, std::size_t /*length*/ )
+    // Move the partial message left over from the last read to the front.
+    if( m_ReceiveBegin > 0 )
     {
-        if(!ec)
+        size_t numLeft = m_ReceiveEnd - m_ReceiveBegin;
+        memmove( m_ReceiveBuffer.data(), m_ReceiveBuffer.data() + m_ReceiveBegin, numLeft );
+        m_ReceiveBegin = 0;
+        m_ReceiveEnd = numLeft;
+    }
+
+    size_t requiredSize = std::max( m_PendingMessageSize, m_ReceiveEnd + MinReadSize );
+    if( m_ReceiveBuffer.size() < requiredSize )
+    {
+        m_ReceiveBuffer.resize( std::max( requiredSize, ReceiveBufferSize ) );
+    }
+
+    m_Socket.async_read_some( asio::buffer( m_ReceiveBuffer.data() + m_ReceiveEnd, m_ReceiveBuffer.size() - m_ReceiveEnd ),
+
+    [this]( asio::error_code ec, std::size_t bytes_transferred )
+    {
+        if( !ec )
         {
-            m_NumBytesReceived += sizeof(Message);
-            ReadPayload();
+            m_NumBytesReceived += bytes_transferred;
+            m_ReceiveEnd += bytes_transferred;
+            if( DecodeReceiveBuffer() )
+            {
+                ReadMessage();
+            }
         }
         else
         {
             PRINT_VAR( ec.message() );
-            m_Socket.close();
+            Close();
         }
     }
-    
+
     );
 }
 
+//-----------------------------------------------------------------------------
+bool TcpConnection::DecodeReceiveBuffer()
+{
+    m_PendingMessageSize = 0;
+
+    while( m_ReceiveEnd - m_ReceiveBegin >= sizeof( Message ) )
+    {
+        char* data = m_ReceiveBuffer.data() + m_ReceiveBegin;
+        memcpy( &m_Message, data, sizeof( Message ) );
+
+        if( IsWebSocketHandshakeMessage( m_Message ) )
+        {
+            // Hand what was already read over to the line based reader.
+            size_t numLeft = m_ReceiveEnd - m_ReceiveBegin;
+            memcpy( asio::buffer_cast<char*>( m_StreamBuf.prepare( numLeft ) ), data, numLeft );
+            m_StreamBuf.commit( numLeft );
+            m_ReceiveBegin = m_ReceiveEnd = 0;
+
+            ReadWebsocketHandshake();
+            Message msg( Msg_WebSocketHandshake );
+            DecodeMessage( msg );
+            return false;
+        }
+
+        // The stream can't be trusted past a bad size or footer, there is no
+        // way to find the next message boundary.  Drop the connection.
+        if( m_Message.m_Size > MaxMessageSize )
+        {
+            PRINT_VAR( m_Message.m_Size );
+            Close();
+            return false;
+        }
+
+        size_t messageSize = sizeof( Message ) + m_Message.m_Size + 4;
+        if( m_ReceiveEnd - m_ReceiveBegin < messageSize )
+        {
+            m_PendingMessageSize = messageSize;
+            break;
+        }
+
+        unsigned int footer = 0;
+        memcpy( &footer, data + sizeof( Message ) + m_Message.m_Size, 4 );
+        if( footer != MAGIC_FOOT_MSG )
+        {
+            PRINT_VAR( footer );
+            Close();
+            return false;
+        }
+
+        if( m_SourceId == 0 )
+        {
+            m_SourceId = m_Message.m_SourceId;
+        }
+        m_Message.m_SourceId = m_SourceId;
+
+        m_Message.m_Data = m_Message.m_Size > 0 ? data + sizeof( Message ) : nullptr;
+        m_ReceiveBegin += messageSize;
+        GTcpServer->Receive( m_Message );
+    }
+
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 void TcpConnection::ReadWebsocketMessage()
 {
@@ -203,15 +449,6 @@ std::vector<std::string> TcpConnection::GetStats()
     return std::vector<std::string>();
 }
 
-//-----------------------------------------------------------------------------
-bool IsWebSocketHandshakeMessage( Message& a_Message )
-{
-    char* a_String = reinterpret_cast<char*>( &a_Message );
-    return a_String[0] == 'G' &&
-           a_String[1] == 'E' &&
-           a_String[2] == 'T';
-}
-
 //-----------------------------------------------------------------------------
 void process_handshake_key( std::string & key )
 {
@@ -286,56 +523,6 @@ void TcpConnection::ReadWebsocketHandshake()
     asio::async_read_until( m_Socket, m_StreamBuf, "\r\n", std::bind( &TcpConnection::handle_request_line, this, std::placeholders::_1, std::placeholders::_2));
 }
 
-//-----------------------------------------------------------------------------
-void TcpConnection::ReadPayload()
-{
-    if( IsWebSocketHandshakeMessage( m_Message ) )
-    {
-        ReadWebsocketHandshake();
-		Message msg(Msg_WebSocketHandshake);
-        DecodeMessage(msg);
-        return;
-    }
-
-    if( m_Message.m_Size == 0 )
-    {
-        m_Message.m_Data = nullptr;
-        ReadFooter();
-    }
-    else
-    {
-        m_Payload.resize(m_Message.m_Size);
-        asio::async_read( m_Socket, asio::buffer( m_Payload.data(), m_Message.m_Size ),
-
-        [this](asio::error_code ec, std::size_t bytes_transferred)
-        {
-            if (!ec)
-            {
-                m_NumBytesReceived += bytes_transferred;
-                m_Message.m_Data = m_Payload.data();
-				ReadFooter();
-            }
-            else
-            {
-                PRINT_VAR( ec.message() );
-                m_Socket.close();
-            }
-        }
-        );
-    }
-}
-
-//-----------------------------------------------------------------------------
-void TcpConnection::ReadFooter()
-{
-	unsigned int footer = 0;
-	asio::read(m_Socket, asio::buffer(&footer, 4));
-	assert(footer == MAGIC_FOOT_MSG);
-    m_NumBytesReceived += 4;
-	DecodeMessage(m_Message);
-	ReadMessage();
-}
-
 //-----------------------------------------------------------------------------
 void TcpConnection::DecodeMessage( Message & a_Message )
 {
@@ -29,9 +29,9 @@ public:
 
     ~TcpConnection();
 
-    static pointer create( asio::io_service& io_service )
+    static pointer create()
     {
-        return pointer( new TcpConnection( io_service ) );
+        return pointer( new TcpConnection() );
     }
 
     TcpSocket& GetSocket()
@@ -39,14 +39,19 @@ public:
         return m_WrappedSocket;
     }
 
-    void start()
-    {
-        ReadMessage();
-    }
+    // Each connection is serviced by its own io thread.
+    void start();
+
+    // Process id of the target, known once it has sent its first message.
+    uint32_t GetSourceId() const { return m_SourceId; }
+    bool IsLocal();
+    bool IsOpen() { return m_Socket.is_open(); }
 
+    // Reads as much as is available into m_ReceiveBuffer and decodes every
+    // complete message in it.  Payloads are handed out in place, they are
+    // only valid until the callback returns.
     void ReadMessage();
-    void ReadPayload();
-	void ReadFooter();
+    bool DecodeReceiveBuffer();
     void DecodeMessage( Message & a_Message );
 
     bool IsWebsocket() { return m_WebSocketKey != ""; }
@@ -60,12 +65,21 @@ public:
     void ResetStats();
     std::vector<std::string> GetStats();
 
+    static const size_t ReceiveBufferSize = 4*1024*1024;
+    static const size_t MinReadSize = 64*1024;
+    // Larger sizes can only come from a corrupt stream.
+    static const size_t MaxMessageSize = 256*1024*1024;
+
 private:
-    TcpConnection( asio::io_service& io_service )
-        : m_Socket( io_service )
+    TcpConnection()
+        : m_Socket( m_IoService )
         , m_WrappedSocket( &m_Socket )
     {
+        m_SourceId = 0;
         m_NumBytesReceived = 0;
+        m_ReceiveBegin = 0;
+        m_ReceiveEnd = 0;
+        m_PendingMessageSize = 0;
     }
     // handle_write() is responsible for any further actions 
     // for this client connection.
@@ -77,10 +91,18 @@ private:
     void handle_request_line( asio::error_code ec, std::size_t bytes_transferred );
     void SendWebsocketResponse();
 
+    void Close();
+
+    asio::io_service    m_IoService;
     tcp::socket         m_Socket;
     TcpSocket           m_WrappedSocket;
+    std::atomic<uint32_t> m_SourceId;
     Message             m_Message;
     std::vector<char>   m_Payload;
+    std::vector<char>   m_ReceiveBuffer;
+    size_t              m_ReceiveBegin;
+    size_t              m_ReceiveEnd;
+    size_t              m_PendingMessageSize;
     asio::streambuf     m_StreamBuf;
     std::string         m_WebSocketKey;
     char                m_WebSocketBuffer[MAX_WS_HEADER_LENGTH];
@@ -96,18 +118,27 @@ public:
     tcp_server( asio::io_service & io_service, unsigned short port );
     ~tcp_server();
 
+    // Several targets can be connected at once.  The primary connection, the
+    // last one accepted, receives everything that is not explicitly sent to
+    // another source or broadcast.
     void Disconnect();
-    bool HasConnection(){ return m_Connection != nullptr; }
-    TcpSocket* GetSocket(){ return m_Connection ? &m_Connection->GetSocket() : nullptr; }
+    bool HasConnection();
+    // Sockets are handed out with a reference on their connection, it stays
+    // alive until the caller is done writing even if it closes meanwhile.
+    std::shared_ptr<TcpSocket> GetSocket();
+    void GetSockets( uint32_t a_Destination, std::vector< std::shared_ptr<TcpSocket> > & o_Sockets );
     void RegisterConnection( std::shared_ptr<TcpConnection> a_Connection );
-    ULONG64 GetNumBytesReceived(){ return m_Connection ? m_Connection->GetNumBytesReceived() : 0; }
-    void ResetStats(){ if( m_Connection ) m_Connection->ResetStats(); }
+    void OnConnectionClosed( TcpConnection* a_Connection );
+    std::vector<uint32_t> GetLocalSourceIds();
+    ULONG64 GetNumBytesReceived();
+    void ResetStats();
 
 private:
     void start_accept();
     void handle_accept( TcpConnection::pointer new_connection, const asio::error_code& error );
 
     tcp::acceptor m_Acceptor;
+    Mutex         m_Mutex;
     std::shared_ptr<TcpConnection> m_Connection;
     std::unordered_set< std::shared_ptr<TcpConnection> > m_ConnectionsSet;
 };
@@ -136,12 +167,6 @@ public:
         buffer_ = asio::buffer(*data_);
     }
 
-    explicit shared_const_buffer( TcpPacket & a_Packet )
-    {
-        data_ = a_Packet.Data();
-        buffer_ = asio::buffer( *data_ );
-    }
-
     // Implement the ConstBufferSequence requirements.
     typedef asio::const_buffer value_type;
     typedef const asio::const_buffer* const_iterator;
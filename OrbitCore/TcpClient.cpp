@@ -10,11 +10,14 @@
 #include "Core.h"
 #include "OrbitType.h"
 #include "Log.h"
+#include "TimerManager.h"
+#include "TimerWireCodec.h"
 #include <thread>
 
 std::unique_ptr<TcpClient> GTcpClient;
 
 #ifdef __linux__
+#include <unistd.h>
 inline bool IsBadWritePtr( void* addr, int ){ return false; }
 inline bool IsBadReadPtr( void* addr, int ){ return false; }
 #endif
@@ -54,6 +57,13 @@ TcpClient::TcpClient( const std::string & a_Host )
     }
 
     m_IsValid = true;
+
+#ifdef _WIN32
+    // Lets Orbit tell targets apart when several are connected.
+    Message::GSourceId = GetCurrentProcessId();
+#elif defined(__linux__)
+    Message::GSourceId = getpid();
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -207,6 +217,25 @@ void TcpClient::DecodeMessage( Message & a_Message )
     case Msg_StartCapture:
         Orbit::Start();
         break;
+    case Msg_TimerEncoding:
+        // Sent by each Orbit instance at capture start, the decoder on the
+        // other side may be new.
+        GTimerManager->m_TimerEncoding = *( (uint32_t*)a_Message.GetData() );
+        GTimerManager->m_ResetTimerEncoder = true;
+        break;
+    case Msg_SharedMemoryTransport:
+    {
+        SharedMemoryTransport transport = *( (SharedMemoryTransport*)a_Message.GetData() );
+        transport.m_Name[SharedMemoryTransport::NameSize-1] = 0;
+        if( m_SharedMemory.GetName() != transport.m_Name || !m_SharedMemory.IsOpen() )
+        {
+            m_SharedMemory.Open( transport.m_Name );
+        }
+        break;
+    }
+    case Msg_TimerQueuePolicy:
+        GTimerManager->SetQueuePolicy( *( (TimerQueuePolicy*)a_Message.GetData() ) );
+        break;
     case Msg_StopCapture:
         Orbit::Stop();
         break;
@@ -227,6 +256,23 @@ void TcpClient::DecodeMessage( Message & a_Message )
 
         break;
     }
+    case Msg_FunctionUnhook:
+    {
+        // Orbit found these too costly, see HookOverhead.  It only counts
+        // them as unhooked once we confirm.
+        ULONG64* addresses = (ULONG64*)a_Message.GetData();
+        uint32_t numAddresses = (uint32_t)a_Message.m_Size/sizeof(ULONG64);
+        std::vector<ULONG64> unhooked;
+        for(uint32_t i = 0; i < numAddresses; ++i )
+        {
+            if( Hijacking::DisableHook( (void*)addresses[i] ) )
+            {
+                unhooked.push_back( addresses[i] );
+            }
+        }
+        GTcpClient->Send( Msg_FunctionUnhooked, unhooked );
+        break;
+    }
     case Msg_FunctionHookZoneStart:
     {
         ULONG64* addresses = (ULONG64*)a_Message.GetData();
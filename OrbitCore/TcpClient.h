@@ -4,6 +4,7 @@
 #pragma once
 
 #include "TcpEntity.h"
+#include "SharedMemoryRing.h"
 #include <vector>
 
 class TcpClient : public TcpEntity
@@ -15,6 +16,9 @@ public:
     bool IsValid() const { return m_IsValid; }
     void Start() override;
 
+    // Opened when Orbit runs on the same machine, see SharedMemoryRing.
+    SharedMemoryRing & GetSharedMemory() { return m_SharedMemory; }
+
 protected:
     void ClientThread();
     void ReadMessage();
@@ -28,6 +32,7 @@ private:
     Message           m_Message;
     std::vector<char> m_Payload;
     bool              m_IsValid;
+    SharedMemoryRing  m_SharedMemory;
 };
 
 extern std::unique_ptr<TcpClient> GTcpClient;
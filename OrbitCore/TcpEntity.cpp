@@ -8,8 +8,67 @@
 #include "Log.h"
 #include "OrbitAsio.h"
 
+//-----------------------------------------------------------------------------
+static LockFreeQueue< std::vector<char>* > & GetFreePacketBuffers( uint32_t a_Class )
+{
+    // Never destroyed, packets can outlive static destruction.
+    static LockFreeQueue< std::vector<char>* >* freeBuffers = new LockFreeQueue< std::vector<char>* >[TcpPacketPool::NumClasses];
+    return freeBuffers[a_Class];
+}
+
+static std::atomic<size_t> GNumPooledBytes( 0 );
+
+//-----------------------------------------------------------------------------
+uint32_t TcpPacketPool::GetClass( size_t a_Size )
+{
+    if( a_Size <= ( 1ull << MinClassShift ) )
+        return 0;
+
+    uint32_t shift = 64 - CountLeadingZeros( a_Size - 1 );
+    return shift - MinClassShift;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<char>* TcpPacketPool::Get( size_t a_Size )
+{
+    uint32_t sizeClass = GetClass( a_Size );
+    if( sizeClass >= NumClasses )
+    {
+        return new std::vector<char>( a_Size );
+    }
+
+    std::vector<char>* buffer = nullptr;
+    if( GetFreePacketBuffers( sizeClass ).try_dequeue( buffer ) )
+    {
+        GNumPooledBytes -= buffer->size();
+        return buffer;
+    }
+
+    return new std::vector<char>( 1ull << ( sizeClass + MinClassShift ) );
+}
+
+//-----------------------------------------------------------------------------
+void TcpPacketPool::Release( std::vector<char>* a_Buffer )
+{
+    // Only buffers handed out by Get for a pooled class have a class size.
+    size_t size = a_Buffer->size();
+    uint32_t sizeClass = GetClass( size );
+    bool isClassSize = sizeClass < NumClasses && size == ( 1ull << ( sizeClass + MinClassShift ) );
+
+    if( !isClassSize || GNumPooledBytes.fetch_add( size ) + size > MaxPooledBytes )
+    {
+        if( isClassSize )
+            GNumPooledBytes -= size;
+        delete a_Buffer;
+        return;
+    }
+
+    GetFreePacketBuffers( sizeClass ).enqueue( a_Buffer );
+}
+
 //-----------------------------------------------------------------------------
 TcpEntity::TcpEntity() : m_NumQueuedEntries(0)
+                       , m_NumQueuedBytes(0)
                        , m_ExitRequested(false)
                        , m_FlushRequested(false)
                        , m_NumFlushedItems(0)
@@ -57,10 +116,25 @@ void TcpEntity::Stop()
 }
 
 //-----------------------------------------------------------------------------
-void TcpEntity::SendMsg( Message & a_Message, const void* a_Payload )
+void TcpEntity::SendMsg( Message & a_Message, const void* a_Payload, uint32_t a_Destination )
+{
+    TcpPacket packet( a_Message, a_Payload );
+    packet.SetDestination( a_Destination );
+    Enqueue( std::move( packet ) );
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::SendMsg( Message & a_Message, const void* a_Part0, size_t a_Size0, const void* a_Part1, size_t a_Size1 )
+{
+    a_Message.m_Size = (uint32_t)( a_Size0 + a_Size1 );
+    Enqueue( TcpPacket( a_Message, a_Part0, a_Size0, a_Part1, a_Size1 ) );
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::Enqueue( TcpPacket && a_Packet )
 {
-    TcpPacket buffer( a_Message, a_Payload );
-    m_SendQueue.enqueue( buffer );
+    m_NumQueuedBytes += (int64_t)a_Packet.GetSize();
+    m_SendQueue.enqueue( std::move( a_Packet ) );
     ++m_NumQueuedEntries;
     m_ConditionVariable.signal();
 }
@@ -83,17 +157,39 @@ void TcpEntity::FlushSendQueue()
 
         m_NumQueuedEntries -= (int)numDequeued;
         m_NumFlushedItems += (int)numDequeued;
+        for( size_t i = 0; i < numDequeued; ++i )
+        {
+            m_NumQueuedBytes -= (int64_t)Timers[i].GetSize();
+        }
     }
 
     m_FlushRequested = false;
     m_ConditionVariable.signal();
 }
 
+//-----------------------------------------------------------------------------
+void TcpEntity::GetSockets( uint32_t a_Destination, std::vector< std::shared_ptr<TcpSocket> > & o_Sockets )
+{
+    // The socket lives as long as this entity, it is not owned.
+    TcpSocket* socket = GetSocket();
+    if( socket && socket->m_Socket && socket->m_Socket->is_open() )
+    {
+        o_Sockets.push_back( std::shared_ptr<TcpSocket>( std::shared_ptr<TcpSocket>(), socket ) );
+    }
+}
+
 //-----------------------------------------------------------------------------
 void TcpEntity::SendData()
 {
     SetCurrentThreadName( L"TcpSender" );
 
+    // Everything queued is sent with a single gather write.
+    const size_t maxPackets = 256;
+    std::vector< TcpPacket > packets( maxPackets );
+    std::vector< asio::const_buffer > buffers;
+    buffers.reserve( maxPackets );
+    std::vector< std::shared_ptr<TcpSocket> > sockets;
+
     while( !m_ExitRequested )
     {
         // Wait for non-empty queue
@@ -103,18 +199,44 @@ void TcpEntity::SendData()
         }
 
         // Send messages
-        TcpPacket buffer;
-        while( !m_ExitRequested && !m_FlushRequested && m_SendQueue.try_dequeue( buffer ) )
+        size_t numDequeued = 0;
+        while( !m_ExitRequested && !m_FlushRequested && ( numDequeued = m_SendQueue.try_dequeue_bulk( packets.data(), maxPackets ) ) > 0 )
         {
-            --m_NumQueuedEntries;
-            TcpSocket* socket = GetSocket();
-            if( socket && socket->m_Socket && socket->m_Socket->is_open() )
+            m_NumQueuedEntries -= (int)numDequeued;
+
+            // One write per run of packets going to the same destination.
+            size_t begin = 0;
+            while( begin < numDequeued )
             {
-                asio::write( *socket->m_Socket, shared_const_buffer( buffer ) );
+                uint32_t destination = packets[begin].GetDestination();
+                buffers.clear();
+                size_t end = begin;
+                for( ; end < numDequeued && packets[end].GetDestination() == destination; ++end )
+                {
+                    buffers.push_back( asio::buffer( packets[end].GetData(), packets[end].GetSize() ) );
+                }
+
+                sockets.clear();
+                GetSockets( destination, sockets );
+                if( sockets.empty() )
+                {
+                    ORBIT_ERROR;
+                }
+
+                for( const std::shared_ptr<TcpSocket> & socket : sockets )
+                {
+                    asio::error_code error;
+                    asio::write( *socket->m_Socket, buffers, error );
+                }
+                sockets.clear();
+
+                begin = end;
             }
-            else
+
+            for( size_t i = 0; i < numDequeued; ++i )
             {
-                ORBIT_ERROR;
+                m_NumQueuedBytes -= (int64_t)packets[i].GetSize();
+                packets[i].Clear();
             }
         }
     }
@@ -12,39 +12,132 @@
 #include <type_traits>
 #include <vector>
 #include <atomic>
+#include <memory>
 
+//-----------------------------------------------------------------------------
+// Send buffers are recycled instead of being allocated for every message.
+// Buffers are pooled by power of two size class so that a small message
+// never pins a large buffer, and the pool keeps at most MaxPooledBytes, it
+// lives in the profiled process.
+//-----------------------------------------------------------------------------
+class TcpPacketPool
+{
+public:
+    static std::vector<char>* Get( size_t a_Size );
+    static void Release( std::vector<char>* a_Buffer );
+
+    static const uint32_t MinClassShift = 8;   // 256 bytes
+    static const uint32_t MaxClassShift = 22;  // 4 MB, larger buffers are not pooled
+    static const uint32_t NumClasses = MaxClassShift - MinClassShift + 1;
+    static const size_t   MaxPooledBytes = 16*1024*1024;
+
+protected:
+    static uint32_t GetClass( size_t a_Size );
+};
+
+//-----------------------------------------------------------------------------
+// Header, payload and footer of a message in one pooled buffer.  The payload
+// can be gathered from two parts so that callers don't have to assemble it.
 //-----------------------------------------------------------------------------
 class TcpPacket
 {
 public:
+    // Destinations other than these are source ids, see Message::m_SourceId.
+    enum : uint32_t
+    {
+        Primary   = 0,
+        Broadcast = 0xFFFFFFFF
+    };
+
     TcpPacket(){}
-    explicit TcpPacket( const Message & a_Message
-                      , const void* a_Payload )
-                      : m_Data( new std::vector<char>() )
+    TcpPacket( const Message & a_Message, const void* a_Payload )
+    {
+        Init( a_Message, a_Payload, a_Message.m_Size, nullptr, 0 );
+    }
+
+    TcpPacket( const Message & a_Message, const void* a_Part0, size_t a_Size0, const void* a_Part1, size_t a_Size1 )
     {
-        m_Data->resize( sizeof( Message ) + a_Message.m_Size + 4 );
-        memcpy( m_Data->data(), &a_Message, sizeof( Message ) );
+        Init( a_Message, a_Part0, a_Size0, a_Part1, a_Size1 );
+    }
+
+    TcpPacket( TcpPacket && a_Other ) : m_Data( a_Other.m_Data ), m_Size( a_Other.m_Size ), m_Destination( a_Other.m_Destination )
+    {
+        a_Other.m_Data = nullptr;
+        a_Other.m_Size = 0;
+    }
 
-        if( a_Payload )
+    TcpPacket & operator=( TcpPacket && a_Other )
+    {
+        if( this != &a_Other )
         {
-            memcpy( m_Data->data() + sizeof( Message ), a_Payload, a_Message.m_Size );
+            Clear();
+            m_Data = a_Other.m_Data;
+            m_Size = a_Other.m_Size;
+            m_Destination = a_Other.m_Destination;
+            a_Other.m_Data = nullptr;
+            a_Other.m_Size = 0;
         }
+        return *this;
+    }
 
-        // Footer
-        const unsigned int footer = MAGIC_FOOT_MSG;
-        memcpy( m_Data->data() + sizeof( Message ) + a_Message.m_Size, &footer, 4 );
+    TcpPacket( const TcpPacket & ) = delete;
+    TcpPacket & operator=( const TcpPacket & ) = delete;
+
+    ~TcpPacket() { Clear(); }
+
+    void Clear()
+    {
+        if( m_Data )
+        {
+            TcpPacketPool::Release( m_Data );
+            m_Data = nullptr;
+            m_Size = 0;
+        }
     }
 
+    const char* GetData() const { return m_Data ? m_Data->data() : nullptr; }
+    size_t      GetSize() const { return m_Size; }
+    uint32_t    GetDestination() const { return m_Destination; }
+    void        SetDestination( uint32_t a_Destination ) { m_Destination = a_Destination; }
+
     void Dump() const
     {
-        std::cout << "TcpPacket [" << std::dec << (int)m_Data->size() << " bytes]" << std::endl;
-        PrintBuffer(m_Data->data(), (uint32_t)m_Data->size());
+        std::cout << "TcpPacket [" << std::dec << (int)m_Size << " bytes]" << std::endl;
+        PrintBuffer( GetData(), (uint32_t)m_Size );
     }
 
-    std::shared_ptr< std::vector<char> > Data() { return m_Data; };
-
 private:
-    std::shared_ptr< std::vector<char> > m_Data;
+    void Init( const Message & a_Message, const void* a_Part0, size_t a_Size0, const void* a_Part1, size_t a_Size1 )
+    {
+        size_t payloadSize = a_Size0 + a_Size1;
+        m_Size = sizeof( Message ) + payloadSize + 4;
+        m_Data = TcpPacketPool::Get( m_Size );
+
+        char* data = m_Data->data();
+        memcpy( data, &a_Message, sizeof( Message ) );
+        ( (Message*)data )->m_Size = (uint32_t)payloadSize;
+        data += sizeof( Message );
+
+        if( a_Part0 )
+        {
+            memcpy( data, a_Part0, a_Size0 );
+        }
+        data += a_Size0;
+
+        if( a_Part1 )
+        {
+            memcpy( data, a_Part1, a_Size1 );
+        }
+        data += a_Size1;
+
+        // Footer
+        const unsigned int footer = MAGIC_FOOT_MSG;
+        memcpy( data, &footer, 4 );
+    }
+
+    std::vector<char>* m_Data = nullptr;
+    size_t             m_Size = 0;
+    uint32_t           m_Destination = Primary;
 };
 
 //-----------------------------------------------------------------------------
@@ -58,6 +151,11 @@ public:
     void Stop();
     void FlushSendQueue();
 
+    // Bytes waiting to be written to the socket, producers that can drop data
+    // should hold off past MaxQueuedBytes.
+    int64_t GetNumQueuedBytes() const { return m_NumQueuedBytes; }
+    static const int64_t MaxQueuedBytes = 64*1024*1024;
+
     // Note: All Send methods can be called concurrently from multiple threads
     inline void Send(MessageType a_Type) { Message msg(a_Type); SendMsg(msg, nullptr); }
     inline void Send(Message & a_Message, void* a_Data);
@@ -72,9 +170,17 @@ public:
     template<class T> void Send( Message & a_Message, const T& a_Item );
     template<class T> void Send( MessageType a_Type , const T& a_Item );
 
+    // Sends to one connection in particular or to all of them, a_Destination
+    // is a source id or TcpPacket::Broadcast.
+    inline void SendTo( uint32_t a_Destination, MessageType a_Type );
+    template<class T> void SendTo( uint32_t a_Destination, MessageType a_Type, const T& a_Item );
+
 protected:
-    void SendMsg( Message & a_Message, const void* a_Payload );
+    void SendMsg( Message & a_Message, const void* a_Payload, uint32_t a_Destination = TcpPacket::Primary );
+    void SendMsg( Message & a_Message, const void* a_Part0, size_t a_Size0, const void* a_Part1, size_t a_Size1 );
+    void Enqueue( TcpPacket && a_Packet );
     virtual TcpSocket* GetSocket() = 0;
+    virtual void GetSockets( uint32_t a_Destination, std::vector< std::shared_ptr<TcpSocket> > & o_Sockets );
     void SendData();
 
 protected:
@@ -84,6 +190,7 @@ protected:
     AutoResetEvent             m_ConditionVariable;
     LockFreeQueue< TcpPacket > m_SendQueue;
     std::atomic<int>           m_NumQueuedEntries;
+    std::atomic<int64_t>       m_NumQueuedBytes;
     std::atomic<bool>          m_ExitRequested;
     std::atomic<bool>          m_FlushRequested;
     std::atomic<int>           m_NumFlushedItems;
@@ -111,42 +218,15 @@ void TcpEntity::Send( std::string& a_String )
 //-----------------------------------------------------------------------------
 void TcpEntity::Send( OrbitLogEntry& a_Entry )
 {
-    char stackBuffer[1024];
-    int entrySize = (int)a_Entry.GetBufferSize();
-    bool needsAlloc = entrySize > 1024;
-    char* buffer = !needsAlloc ? stackBuffer : new char[entrySize];
-    
-    memcpy( buffer, &a_Entry, a_Entry.GetSizeWithoutString() );
-    memcpy( buffer + a_Entry.GetSizeWithoutString(), a_Entry.m_Text.c_str(), a_Entry.GetStringSize() );
-
-    Message msg( Msg_OrbitLog, entrySize );
-    Send( msg, (void*)buffer );
-
-    if( needsAlloc )
-    {
-        delete buffer;
-    }
+    Message msg( Msg_OrbitLog );
+    SendMsg( msg, &a_Entry, a_Entry.GetSizeWithoutString(), a_Entry.m_Text.c_str(), a_Entry.GetStringSize() );
 }
 
 //-----------------------------------------------------------------------------
 void TcpEntity::Send( Orbit::UserData& a_UserData )
 {
     Message msg( Msg_UserData );
-    msg.m_Size = sizeof(Orbit::UserData) + a_UserData.m_NumBytes;
-    
-    char stackBuffer[1024];
-    bool needsAlloc = msg.m_Size > 1024;
-    char* buffer = !needsAlloc ? stackBuffer : new char[msg.m_Size];
-
-    memcpy( buffer, &a_UserData, sizeof(Orbit::UserData) );
-    memcpy( buffer + sizeof(Orbit::UserData), a_UserData.m_Data, a_UserData.m_NumBytes );
-
-    Send( msg, (void*)buffer );
-
-    if( needsAlloc )
-    {
-        delete buffer;
-    }
+    SendMsg( msg, &a_UserData, sizeof(Orbit::UserData), a_UserData.m_Data, a_UserData.m_NumBytes );
 }
 
 //-----------------------------------------------------------------------------
@@ -177,6 +257,21 @@ template<class T> void TcpEntity::Send( MessageType a_Type, const T& a_Item )
     Send( msg, a_Item );
 }
 
+//-----------------------------------------------------------------------------
+void TcpEntity::SendTo( uint32_t a_Destination, MessageType a_Type )
+{
+    Message msg( a_Type );
+    SendMsg( msg, nullptr, a_Destination );
+}
+
+//-----------------------------------------------------------------------------
+template<class T> void TcpEntity::SendTo( uint32_t a_Destination, MessageType a_Type, const T& a_Item )
+{
+    Message msg( a_Type );
+    msg.m_Size = (int)sizeof(T);
+    SendMsg( msg, (void*)&a_Item, a_Destination );
+}
+
 //-----------------------------------------------------------------------------
 void TcpEntity::Send( MessageType a_Type , void* a_Data, size_t a_Size )
 {
@@ -9,6 +9,7 @@
 #include "Log.h"
 #include "Context.h"
 #include "Capture.h"
+#include "HookOverhead.h"
 #include "OrbitAsio.h"
 #include "Callstack.h"
 #include "SamplingProfiler.h"
@@ -16,12 +17,19 @@
 #include "OrbitUnreal.h"
 #include "OrbitProcess.h"
 
+#include <algorithm>
 #include <thread>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 TcpServer* GTcpServer;
 
 //-----------------------------------------------------------------------------
 TcpServer::TcpServer() : m_TcpServer(nullptr)
+                       , m_SharedMemoryThread(nullptr)
+                       , m_SharedMemoryExitRequested(false)
 {
     m_LastNumMessages = 0;
     m_LastNumBytes = 0;
@@ -39,6 +47,13 @@ TcpServer::TcpServer() : m_TcpServer(nullptr)
 //-----------------------------------------------------------------------------
 TcpServer::~TcpServer()
 {
+    if( m_SharedMemoryThread )
+    {
+        m_SharedMemoryExitRequested = true;
+        m_SharedMemoryThread->join();
+        delete m_SharedMemoryThread;
+    }
+
     delete m_TcpServer;
 }
 
@@ -65,6 +80,21 @@ void TcpServer::ResetStats()
     m_NumReceivedMessages = 0;
     if(m_TcpServer)
         m_TcpServer->ResetStats();
+
+    ScopeLock lock( m_DroppedTimersMutex );
+    m_DroppedTimers.clear();
+}
+
+//-----------------------------------------------------------------------------
+uint64_t TcpServer::GetNumDroppedTimers()
+{
+    ScopeLock lock( m_DroppedTimersMutex );
+    uint64_t numDropped = 0;
+    for( auto & pair : m_DroppedTimers )
+    {
+        numDropped += pair.second;
+    }
+    return numDropped;
 }
 
 //-----------------------------------------------------------------------------
@@ -82,13 +112,126 @@ std::vector<std::string> TcpServer::GetStats()
             + " ( " + GetPrettyBitRate( (ULONG64)m_BytesPerSecond ) + " )\n";
     
     stats.push_back( bitRate );
+
+    // Timers the target dropped because Orbit couldn't keep up, worst threads first.
+    std::vector< std::pair< uint32_t, uint32_t > > dropped;
+    {
+        ScopeLock lock( m_DroppedTimersMutex );
+        dropped.assign( m_DroppedTimers.begin(), m_DroppedTimers.end() );
+    }
+
+    uint64_t numDroppedTimers = 0;
+    for( auto & pair : dropped )
+    {
+        numDroppedTimers += pair.second;
+    }
+    stats.push_back( VAR_TO_ANSI( numDroppedTimers ) );
+
+    std::sort( dropped.begin(), dropped.end(), []( const std::pair< uint32_t, uint32_t > & a, const std::pair< uint32_t, uint32_t > & b ){ return a.second > b.second; } );
+    const size_t maxThreads = 8;
+    for( size_t i = 0; i < dropped.size() && i < maxThreads; ++i )
+    {
+        stats.push_back( Format( "  thread %u dropped %u timers", dropped[i].first, dropped[i].second ) );
+    }
+
     return stats;
 }
 
 //-----------------------------------------------------------------------------
 TcpSocket* TcpServer::GetSocket()
 {
-    return m_TcpServer->GetSocket();
+    return m_TcpServer->GetSocket().get();
+}
+
+//-----------------------------------------------------------------------------
+void TcpServer::GetSockets( uint32_t a_Destination, std::vector< std::shared_ptr<TcpSocket> > & o_Sockets )
+{
+    if( m_TcpServer )
+    {
+        m_TcpServer->GetSockets( a_Destination, o_Sockets );
+    }
+}
+
+//-----------------------------------------------------------------------------
+uint32_t TcpServer::GetThreadSource( ThreadID a_ThreadId )
+{
+    ScopeLock lock( m_SourcesMutex );
+    auto it = m_ThreadSources.find( a_ThreadId );
+    return it != m_ThreadSources.end() ? it->second : 0;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint32_t> TcpServer::GetLocalSourceIds()
+{
+    return m_TcpServer ? m_TcpServer->GetLocalSourceIds() : std::vector<uint32_t>();
+}
+
+//-----------------------------------------------------------------------------
+size_t TcpServer::GetNumSources()
+{
+    ScopeLock lock( m_SourcesMutex );
+    return m_Sources.size();
+}
+
+//-----------------------------------------------------------------------------
+void TcpServer::ReceiveTimers( const Message & a_Message )
+{
+    Source* source = nullptr;
+    {
+        ScopeLock lock( m_SourcesMutex );
+        std::unique_ptr<Source> & entry = m_Sources[a_Message.m_SourceId];
+        if( !entry )
+        {
+            entry.reset( new Source() );
+        }
+        source = entry.get();
+    }
+
+    const Timer* timers = (const Timer*)a_Message.GetData();
+    uint32_t numTimers = (uint32_t)a_Message.m_Size/sizeof(Timer);
+
+    // Compact timers only ever come from the source's own connection.
+    if( a_Message.GetType() == Msg_TimerCompact )
+    {
+        source->m_DecodedTimers.clear();
+        if( !source->m_TimerDecoder.Decode( a_Message.GetData(), a_Message.m_Size, a_Message.m_SessionID, source->m_DecodedTimers ) )
+        {
+            ORBIT_LOG( "Malformed compact timer message" );
+            return;
+        }
+
+        timers = source->m_DecodedTimers.data();
+        numTimers = (uint32_t)source->m_DecodedTimers.size();
+    }
+
+    // Remember which target each thread belongs to, timers mostly come in
+    // runs of the same thread.  One lock per message.
+    static thread_local std::vector<ThreadID> threadIds;
+    threadIds.clear();
+    for( uint32_t i = 0; i < numTimers; ++i )
+    {
+        if( i == 0 || timers[i].m_TID != timers[i-1].m_TID )
+        {
+            threadIds.push_back( timers[i].m_TID );
+        }
+    }
+
+    if( !threadIds.empty() )
+    {
+        ScopeLock lock( m_SourcesMutex );
+        for( ThreadID threadId : threadIds )
+        {
+            m_ThreadSources[threadId] = a_Message.m_SourceId;
+        }
+    }
+
+    GTimerManager->Add( timers, numTimers );
+
+    uint32_t maxTimers = m_MaxTimersAtOnce;
+    while( numTimers > maxTimers && !m_MaxTimersAtOnce.compare_exchange_weak( maxTimers, numTimers ) )
+    {
+    }
+    m_NumTimersAtOnce = numTimers;
 }
 
 //-----------------------------------------------------------------------------
@@ -104,6 +247,16 @@ void TcpServer::Receive( const Message & a_Message )
         return;
     }
 
+    // Timers of all targets are received in parallel, anything else one
+    // message at a time.
+    if( a_Message.GetType() == Msg_Timer || a_Message.GetType() == Msg_TimerCompact )
+    {
+        ReceiveTimers( a_Message );
+        return;
+    }
+
+    ScopeLock lock( m_ReceiveMutex );
+
     switch (a_Message.GetType())
     {
     case Msg_String:
@@ -113,21 +266,16 @@ void TcpServer::Receive( const Message & a_Message )
         PRINT_VAR(msg);
         break;
     }
-    case Msg_Timer:
+    case Msg_DroppedTimers:
     {
-        uint32_t numTimers = (uint32_t)a_Message.m_Size/sizeof(Timer);
-        Timer* timers = (Timer*)a_Message.GetData();
-        for (uint32_t i = 0; i < numTimers; ++i)
-        {
-            GTimerManager->Add(timers[i]);
-        }
-        
-        if( numTimers > m_MaxTimersAtOnce )
+        // Counts are totals since the start of the capture.
+        const DroppedTimers* dropped = (const DroppedTimers*)a_Message.GetData();
+        uint32_t numThreads = a_Message.m_Size/sizeof(DroppedTimers);
+        ScopeLock lock( m_DroppedTimersMutex );
+        for( uint32_t i = 0; i < numThreads; ++i )
         {
-            m_MaxTimersAtOnce = numTimers;
+            m_DroppedTimers[dropped[i].m_ThreadId] = dropped[i].m_NumDropped;
         }
-        m_NumTimersAtOnce = numTimers;
-
         break;
     }
     case Msg_NumQueuedEntries:
@@ -142,6 +290,13 @@ void TcpServer::Receive( const Message & a_Message )
     case Msg_NumInstalledHooks:
         Capture::GNumInstalledHooks = *((uint32_t*)a_Message.GetData());
         break;
+    case Msg_FunctionUnhooked:
+    {
+        const ULONG64* addresses = (const ULONG64*)a_Message.GetData();
+        uint32_t numAddresses = a_Message.m_Size/sizeof(ULONG64);
+        GHookOverhead.OnUnhooked( std::vector<ULONG64>( addresses, addresses + numAddresses ) );
+        break;
+    }
     case Msg_Callstack:
     {
         CallStackPOD* callstackPOD = (CallStackPOD*)a_Message.GetData();
@@ -233,7 +388,7 @@ void TcpServer::MainThreadTick()
 
     if( Capture::GInjected && Capture::IsCapturing() )
     {
-        TcpSocket* socket = GetSocket();
+        std::shared_ptr<TcpSocket> socket = m_TcpServer->GetSocket();
         if( socket == nullptr || !socket->m_Socket || !socket->m_Socket->is_open() )
         {
             Capture::StopCapture();
@@ -244,7 +399,7 @@ void TcpServer::MainThreadTick()
 //-----------------------------------------------------------------------------
 bool TcpServer::IsLocalConnection()
 {
-    TcpSocket* socket = GetSocket();
+    std::shared_ptr<TcpSocket> socket = m_TcpServer->GetSocket();
     if( socket != nullptr && socket->m_Socket )
     {
         std::string endPoint = socket->m_Socket->remote_endpoint().address().to_string();
@@ -257,6 +412,94 @@ bool TcpServer::IsLocalConnection()
     return false;
 }
 
+//-----------------------------------------------------------------------------
+void TcpServer::StartSharedMemoryTransport( uint32_t a_SourceId )
+{
+    std::shared_ptr<SharedMemoryRing> ring;
+    {
+        ScopeLock lock( m_SharedMemoryMutex );
+        std::shared_ptr<SharedMemoryRing> & entry = m_SharedMemories[a_SourceId];
+        if( !entry )
+        {
+#ifdef _WIN32
+            uint32_t pid = GetCurrentProcessId();
+#else
+            uint32_t pid = getpid();
+#endif
+            std::string name = Format( "OrbitShm_%u_%u", pid, a_SourceId );
+            entry = std::make_shared<SharedMemoryRing>();
+            if( !entry->Create( name, SharedMemoryRing::DefaultCapacity ) )
+            {
+                ORBIT_LOG( Format( "Could not create shared memory %s, using tcp", name.c_str() ) );
+                m_SharedMemories.erase( a_SourceId );
+                return;
+            }
+        }
+
+        if( !m_SharedMemoryThread )
+        {
+            m_SharedMemoryThread = new std::thread( [&](){ SharedMemoryThread(); } );
+        }
+
+        ring = entry;
+    }
+
+    SharedMemoryTransport transport = {};
+    transport.m_Capacity = ring->GetCapacity();
+    strncpy( transport.m_Name, ring->GetName().c_str(), SharedMemoryTransport::NameSize - 1 );
+    SendTo( a_SourceId, Msg_SharedMemoryTransport, transport );
+}
+
+//-----------------------------------------------------------------------------
+void TcpServer::OnSourceClosed( uint32_t a_SourceId )
+{
+    // The reader thread may still hold the ring for its current pass, it is
+    // closed once that reference goes away.
+    ScopeLock lock( m_SharedMemoryMutex );
+    m_SharedMemories.erase( a_SourceId );
+}
+
+//-----------------------------------------------------------------------------
+void TcpServer::SharedMemoryThread()
+{
+    SetCurrentThreadName( L"SharedMemory" );
+
+    // Only timers and callstacks come through here, the rest of Receive
+    // still runs on the connection threads.  Their order against socket
+    // messages is not kept, see SharedMemoryRing.
+    auto callback = [this]( const Message & a_Message ){ Receive( a_Message ); };
+    std::vector< std::shared_ptr<SharedMemoryRing> > rings;
+    while( !m_SharedMemoryExitRequested )
+    {
+        rings.clear();
+        {
+            ScopeLock lock( m_SharedMemoryMutex );
+            for( auto & pair : m_SharedMemories )
+            {
+                rings.push_back( pair.second );
+            }
+        }
+
+        size_t numRead = 0;
+        for( auto & ring : rings )
+        {
+            numRead += ring->Read( callback );
+        }
+
+        // Block on the rings until a target writes to one of them.  Waits
+        // are short so that exit requests, new rings and the heartbeat go
+        // through.
+        if( numRead == 0 && !rings.empty() )
+        {
+            SharedMemoryRing::WaitAny( rings, 100 );
+        }
+        else if( numRead == 0 )
+        {
+            Sleep( 100 );
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 void TcpServer::Disconnect()
 { 
@@ -4,9 +4,13 @@
 #pragma once
 
 #include "Core.h"
+#include "CallstackTypes.h"
 #include "ScopeTimer.h"
 #include "TcpEntity.h"
+#include "TimerWireCodec.h"
+#include "SharedMemoryRing.h"
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
 class TcpServer : public TcpEntity
@@ -17,6 +21,7 @@ public:
     
     void Start( unsigned short a_Port );
 
+    // Called concurrently by the io thread of every connection.
     void Receive( const Message & a_Message );
 
     void SendToUiAsync( const std::wstring & a_Message );
@@ -36,14 +41,30 @@ public:
     
     bool IsLocalConnection();
 
+    // Creates a shared memory ring for the target on first use and tells it
+    // to send timers and callstacks through it.
+    void StartSharedMemoryTransport( uint32_t a_SourceId );
+
+    // Called when the connection of a target closes, releases its ring.
+    void OnSourceClosed( uint32_t a_SourceId );
+
+    // Targets are told apart by process id, see Message::m_SourceId.
+    uint32_t GetThreadSource( ThreadID a_ThreadId );
+    std::vector<uint32_t> GetLocalSourceIds();
+    size_t GetNumSources();
+
     class tcp_server* GetServer(){ return m_TcpServer; }
 
     void ResetStats();
     std::vector< std::string > GetStats();
+    uint64_t GetNumDroppedTimers();
 
 protected:
     class TcpSocket* GetSocket() override final;
+    void GetSockets( uint32_t a_Destination, std::vector< std::shared_ptr<class TcpSocket> > & o_Sockets ) override final;
+    void ReceiveTimers( const Message & a_Message );
     void ServerThread();
+    void SharedMemoryThread();
 
 private:
     class tcp_server*                         m_TcpServer;
@@ -54,15 +75,35 @@ private:
     Timer    m_StatTimer;
     ULONG64  m_LastNumMessages;
     ULONG64  m_LastNumBytes;
-    ULONG64  m_NumReceivedMessages;
+    std::atomic<ULONG64> m_NumReceivedMessages;
     double   m_NumMessagesPerSecond;
     double   m_BytesPerSecond;
-    uint32_t m_MaxTimersAtOnce;
-    uint32_t m_NumTimersAtOnce;
+    std::atomic<uint32_t> m_MaxTimersAtOnce;
+    std::atomic<uint32_t> m_NumTimersAtOnce;
     uint32_t m_NumTargetQueuedEntries;
     uint32_t m_NumTargetFlushedEntries;
     uint32_t m_NumTargetFlushedTcpPackets;
     ULONG64  m_NumMessagesFromPreviousSession;
+
+    // Timer stream state of each connected target.
+    struct Source
+    {
+        TimerWireDecoder   m_TimerDecoder;
+        std::vector<Timer> m_DecodedTimers;
+    };
+
+    Mutex                                                    m_ReceiveMutex;
+    Mutex                                                    m_SourcesMutex;
+    std::unordered_map< uint32_t, std::unique_ptr<Source> >  m_Sources;
+    std::unordered_map< ThreadID, uint32_t >                 m_ThreadSources;
+
+    Mutex                                                              m_SharedMemoryMutex;
+    std::unordered_map< uint32_t, std::shared_ptr<SharedMemoryRing> >  m_SharedMemories;
+    std::thread*                                                       m_SharedMemoryThread;
+    std::atomic<bool>                                                  m_SharedMemoryExitRequested;
+
+    Mutex                                    m_DroppedTimersMutex;
+    std::unordered_map< uint32_t, uint32_t > m_DroppedTimers;
 };
 
 extern TcpServer* GTcpServer;
@@ -9,6 +9,10 @@
 #include "TcpClient.h"
 #include "Params.h"
 #include "OrbitLib.h"
+#include "CaptureStream.h"
+#include "TimerWireCodec.h"
+
+#include <algorithm>
 
 #ifdef _WIN32
 #include <direct.h>
@@ -16,6 +20,8 @@
 
 std::unique_ptr<TimerManager> GTimerManager;
 
+const int TimerManager::DefaultMaxQueuedTimers;
+
 //-----------------------------------------------------------------------------
 TimerManager::TimerManager( bool a_IsClient ) : m_LockFreeQueue(65534), m_IsClient(a_IsClient)
 {
@@ -30,6 +36,17 @@ TimerManager::TimerManager( bool a_IsClient ) : m_LockFreeQueue(65534), m_IsClie
     m_TimerIndex = 0;
     m_NumTimersFromPreviousSession = 0;
     m_NumFlushedTimers = 0;
+    m_TimerEncoding = TimerEncoding_Raw;
+    m_ResetTimerEncoder = false;
+    m_MaxQueuedTimers = a_IsClient ? DefaultMaxQueuedTimers : 0;
+    m_OverflowPolicy = TimerQueuePolicy::DropNewest;
+    m_SampleRate = 8;
+    m_NumSentDroppedTimers = 0;
+    for( DroppedTimerSlot & slot : m_DroppedTimers )
+    {
+        slot.m_ThreadId = 0;
+    }
+    ClearDroppedTimers();
     
     InitProfiling();
 
@@ -71,6 +88,8 @@ void TimerManager::StopRecording()
 //-----------------------------------------------------------------------------
 void TimerManager::StartClient()
 {
+    ClearDroppedTimers();
+    m_NumSentDroppedTimers = 0;
     m_IsRecording = true;
 }
 
@@ -137,27 +156,35 @@ void TimerManager::ConsumeTimers()
     SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL );
 #endif
 
-    Timer Timer;
+    const size_t numTimers = 4096;
+    std::vector<Timer> Timers( numTimers );
 
     while( !m_ExitRequested )
     {
         m_ConditionVariable.wait();
 
-        while( !m_ExitRequested && !m_FlushRequested && m_LockFreeQueue.try_dequeue( Timer ) )
+        size_t numDequeued = 0;
+        while( !m_ExitRequested && !m_FlushRequested && ( numDequeued = m_LockFreeQueue.try_dequeue_bulk( Timers.data(), numTimers ) ) > 0 )
         {
-            --m_NumQueuedEntries;
-            --m_NumQueuedTimers;
-            
-            if( Timer.m_SessionID == Message::GSessionID )
+            m_NumQueuedEntries -= (int)numDequeued;
+            m_NumQueuedTimers -= (int)numDequeued;
+
+            for( size_t i = 0; i < numDequeued; ++i )
             {
-                for (TimerAddedCallback & Callback : m_TimerAddedCallbacks)
+                Timer & Timer = Timers[i];
+                if( Timer.m_SessionID == Message::GSessionID )
                 {
-                    Callback(Timer);
+                    for (TimerAddedCallback & Callback : m_TimerAddedCallbacks)
+                    {
+                        Callback(Timer);
+                    }
+
+                    GCaptureStream.AddTimer( Timer );
+                }
+                else
+                {
+                    ++m_NumTimersFromPreviousSession;
                 }
-            }
-            else
-            {
-                ++m_NumTimersFromPreviousSession;
             }
         }
     }
@@ -170,6 +197,8 @@ void TimerManager::SendTimers()
 
     const size_t numTimers = 4096;
     Timer Timers[numTimers];
+    TimerWireEncoder encoder;
+    std::string encoded;
 
     while( !m_ExitRequested )
     {
@@ -181,16 +210,42 @@ void TimerManager::SendTimers()
             m_ConditionVariable.wait();
         }
 
+        // Don't pile up packets the socket can't keep up with, the bounded
+        // timer queue is where the overflow policy applies.
+        while( GTcpClient->GetNumQueuedBytes() > TcpEntity::MaxQueuedBytes && !m_ExitRequested )
+        {
+            Sleep( 1 );
+        }
+
         size_t numDequeued = m_LockFreeQueue.try_dequeue_bulk(Timers, numTimers);
         m_NumQueuedEntries -= (int)numDequeued;
         m_NumQueuedTimers  -= (int)numDequeued;
         Msg.m_Size = (int)numDequeued*sizeof(Timer);
-
-		GTcpClient->Send(Msg, (void*)Timers);
+        if( GTcpClient->GetSharedMemory().Write( Msg, Timers ) )
+        {
+            // Same machine, the socket is not involved.
+        }
+        else if( m_TimerEncoding == TimerEncoding_Compact )
+        {
+            if( m_ResetTimerEncoder.exchange( false ) )
+            {
+                encoder.Reset();
+            }
+            encoder.Encode( Timers, numDequeued, Msg.m_SessionID, encoded );
+            Msg.m_Type = Msg_TimerCompact;
+            Msg.m_Size = (uint32_t)encoded.size();
+            GTcpClient->Send( Msg, (void*)encoded.data() );
+        }
+        else
+        {
+            GTcpClient->Send(Msg, (void*)Timers);
+        }
 
         int numEntries = m_NumQueuedEntries;
         GTcpClient->Send( Msg_NumQueuedEntries, numEntries );
 
+        SendDroppedTimers();
+
         while (m_LockFreeMessageQueue.try_dequeue(Msg) && !m_ExitRequested)
         {
             --m_NumQueuedEntries;
@@ -200,11 +255,143 @@ void TimerManager::SendTimers()
     }
 }
 
+//-----------------------------------------------------------------------------
+void TimerManager::SendDroppedTimers()
+{
+    uint64_t numDropped = m_OtherDroppedTimers.m_NumDropped;
+    for( DroppedTimerSlot & slot : m_DroppedTimers )
+    {
+        numDropped += slot.m_NumDropped;
+    }
+
+    if( numDropped == m_NumSentDroppedTimers )
+    {
+        return;
+    }
+
+    m_NumSentDroppedTimers = numDropped;
+
+    std::vector< DroppedTimers > droppedTimers;
+    auto collect = [&]( const DroppedTimerSlot & a_Slot )
+    {
+        DroppedTimers dropped;
+        dropped.m_ThreadId = a_Slot.m_ThreadId;
+        dropped.m_NumDropped = a_Slot.m_NumDropped;
+        if( dropped.m_NumDropped > 0 )
+        {
+            droppedTimers.push_back( dropped );
+        }
+    };
+
+    for( DroppedTimerSlot & slot : m_DroppedTimers )
+    {
+        collect( slot );
+    }
+    collect( m_OtherDroppedTimers );
+
+    GTcpClient->Send( Msg_DroppedTimers, droppedTimers );
+}
+
+//-----------------------------------------------------------------------------
+void TimerManager::ClearDroppedTimers()
+{
+    // Slots keep their thread id, only the counts are reset.
+    for( DroppedTimerSlot & slot : m_DroppedTimers )
+    {
+        slot.m_NumDropped = 0;
+    }
+    m_OtherDroppedTimers.m_ThreadId = 0;
+    m_OtherDroppedTimers.m_NumDropped = 0;
+}
+
+//-----------------------------------------------------------------------------
+void TimerManager::SetQueuePolicy( const TimerQueuePolicy & a_Policy )
+{
+    m_OverflowPolicy = a_Policy.m_OverflowPolicy;
+    m_MaxQueuedTimers = (int)a_Policy.m_MaxQueuedTimers;
+    m_SampleRate = std::max( a_Policy.m_SampleRate, 1u );
+}
+
+//-----------------------------------------------------------------------------
+void TimerManager::AddDroppedTimer( uint32_t a_ThreadId )
+{
+    if( a_ThreadId != 0 )
+    {
+        uint32_t index = ( a_ThreadId * 0x9E3779B1u ) >> 24;
+        for( uint32_t i = 0; i < NumDroppedTimerSlots; ++i )
+        {
+            DroppedTimerSlot & slot = m_DroppedTimers[( index + i ) % NumDroppedTimerSlots];
+            uint32_t threadId = slot.m_ThreadId.load( std::memory_order_relaxed );
+            if( threadId == 0 && slot.m_ThreadId.compare_exchange_strong( threadId, a_ThreadId ) )
+            {
+                threadId = a_ThreadId;
+            }
+
+            if( threadId == a_ThreadId )
+            {
+                slot.m_NumDropped.fetch_add( 1, std::memory_order_relaxed );
+                return;
+            }
+        }
+    }
+
+    m_OtherDroppedTimers.m_NumDropped.fetch_add( 1, std::memory_order_relaxed );
+}
+
+//-----------------------------------------------------------------------------
+bool TimerManager::MakeRoom( const Timer & a_Timer, int a_MaxQueuedTimers )
+{
+    int numQueued = m_NumQueuedTimers;
+
+    switch( m_OverflowPolicy )
+    {
+    case TimerQueuePolicy::DropQueued:
+        if( numQueued >= a_MaxQueuedTimers )
+        {
+            // The queue has one sub-queue per producer, this is the front of
+            // one of them and not necessarily the oldest timer overall.
+            Timer queued;
+            if( m_LockFreeQueue.try_dequeue( queued ) )
+            {
+                --m_NumQueuedEntries;
+                --m_NumQueuedTimers;
+                AddDroppedTimer( queued.m_TID );
+            }
+        }
+        return true;
+    case TimerQueuePolicy::Sample:
+    {
+        // Per thread, app threads don't contend on a shared counter.
+        static thread_local uint32_t sampleCounter = 0;
+        if( numQueued >= a_MaxQueuedTimers ||
+          ( numQueued >= a_MaxQueuedTimers/2 && ( sampleCounter++ % m_SampleRate ) != 0 ) )
+        {
+            AddDroppedTimer( a_Timer.m_TID );
+            return false;
+        }
+        return true;
+    }
+    default:
+        if( numQueued >= a_MaxQueuedTimers )
+        {
+            AddDroppedTimer( a_Timer.m_TID );
+            return false;
+        }
+        return true;
+    }
+}
+
 //-----------------------------------------------------------------------------
 void TimerManager::Add( const Timer& a_Timer )
 {
     if( m_IsRecording )
     {
+        int maxQueuedTimers = m_MaxQueuedTimers;
+        if( maxQueuedTimers > 0 && !MakeRoom( a_Timer, maxQueuedTimers ) )
+        {
+            return;
+        }
+
         m_LockFreeQueue.enqueue(a_Timer);
         m_ConditionVariable.signal();
         ++m_NumQueuedEntries;
@@ -212,6 +399,18 @@ void TimerManager::Add( const Timer& a_Timer )
     }
 }
 
+//-----------------------------------------------------------------------------
+void TimerManager::Add( const Timer* a_Timers, size_t a_NumTimers )
+{
+    if( m_IsRecording && a_NumTimers > 0 )
+    {
+        m_LockFreeQueue.enqueue_bulk( a_Timers, a_NumTimers );
+        m_NumQueuedEntries += (int)a_NumTimers;
+        m_NumQueuedTimers += (int)a_NumTimers;
+        m_ConditionVariable.signal();
+    }
+}
+
 //-----------------------------------------------------------------------------
 void TimerManager::Add( const Message& a_Message )
 {
@@ -33,14 +33,34 @@ public:
 	void StopClient();
 
     void Add( const Timer & a_Timer );
+    void Add( const Timer* a_Timers, size_t a_NumTimers );
     void Add( const Message & a_Message );
     void Add( const ContextSwitch & a_CS );
 
     void ConsumeTimers();
     void SendTimers();
+    void SetQueuePolicy( const TimerQueuePolicy & a_Policy );
     bool HasQueuedEntries() const { return m_NumQueuedEntries > 0; }
 	void FlushQueue();
 
+    static const int DefaultMaxQueuedTimers = 1024*1024;
+
+protected:
+    bool MakeRoom( const Timer & a_Timer, int a_MaxQueuedTimers );
+    void AddDroppedTimer( uint32_t a_ThreadId );
+    void SendDroppedTimers();
+    void ClearDroppedTimers();
+
+    // Dropped timer counts live in a fixed open addressed table so that app
+    // threads only touch their own slot, the sender thread collects them.
+    // Threads that don't find a slot are counted under thread id 0.
+    struct alignas(64) DroppedTimerSlot
+    {
+        std::atomic<uint32_t> m_ThreadId;
+        std::atomic<uint32_t> m_NumDropped;
+    };
+    static const uint32_t NumDroppedTimerSlots = 256;
+
 public:
     AutoResetEvent          m_ConditionVariable;
 
@@ -55,6 +75,16 @@ public:
     std::atomic<int>        m_TimerIndex;
     std::atomic<int>        m_NumTimersFromPreviousSession;
 	std::atomic<int>		m_NumFlushedTimers;
+    std::atomic<uint32_t>   m_TimerEncoding;
+    std::atomic<bool>       m_ResetTimerEncoder;  // set on every encoding handshake
+
+    // Queued timers are bounded in the target, 0 means unbounded.
+    std::atomic<int>        m_MaxQueuedTimers;
+    std::atomic<uint32_t>   m_OverflowPolicy;
+    std::atomic<uint32_t>   m_SampleRate;
+    DroppedTimerSlot        m_DroppedTimers[NumDroppedTimerSlots];
+    DroppedTimerSlot        m_OtherDroppedTimers;
+    std::atomic<uint64_t>   m_NumSentDroppedTimers;  // reset by StartClient
 
     int                     m_ThreadCounter;
     LockFreeQueue<Timer>    m_LockFreeQueue;
@@ -0,0 +1,236 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "TimerWireCodec.h"
+#include "Varint.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// Layout, all integers are varints:
+//
+//   numGroups << 1 | reset       reset: the decoder drops its dictionary
+//   per group:  threadId numTimers
+//   per timer:  flags depth functionId [address] startDelta duration
+//               [type processor] [callstackHash] [userData0] [userData1] [sessionId]
+//
+// A function id equal to the dictionary size introduces a new address.
+//-----------------------------------------------------------------------------
+enum TimerWireFlags
+{
+    WIRE_TYPE         = 1 << 0,
+    WIRE_CALLSTACK    = 1 << 1,
+    WIRE_USER_DATA_0  = 1 << 2,
+    WIRE_USER_DATA_1  = 1 << 3,
+    WIRE_SESSION      = 1 << 4
+};
+
+//-----------------------------------------------------------------------------
+void TimerWireEncoder::Encode( const Timer* a_Timers, size_t a_NumTimers, uint32_t a_SessionID, std::string & o_Data )
+{
+    if( a_SessionID != m_SessionID )
+    {
+        m_FunctionIds.clear();
+        m_SessionID = a_SessionID;
+        m_SendReset = true;
+    }
+
+    // Group per thread, keeping the order of the timers of each thread.
+    m_Order.resize( a_NumTimers );
+    for( uint32_t i = 0; i < a_NumTimers; ++i )
+    {
+        m_Order[i] = i;
+    }
+    std::stable_sort( m_Order.begin(), m_Order.end(), [a_Timers]( uint32_t a, uint32_t b ){ return a_Timers[a].m_TID < a_Timers[b].m_TID; } );
+
+    o_Data.clear();
+    o_Data.reserve( a_NumTimers*16 );
+
+    uint64_t numGroups = 0;
+    for( size_t i = 0; i < a_NumTimers; ++i )
+    {
+        if( i == 0 || a_Timers[m_Order[i]].m_TID != a_Timers[m_Order[i-1]].m_TID )
+            ++numGroups;
+    }
+    WriteVarint( o_Data, numGroups << 1 | ( m_SendReset ? 1 : 0 ) );
+    m_SendReset = false;
+
+    const uint8_t sessionID = (uint8_t)a_SessionID;
+    size_t begin = 0;
+    while( begin < a_NumTimers )
+    {
+        uint32_t tid = a_Timers[m_Order[begin]].m_TID;
+        size_t end = begin;
+        while( end < a_NumTimers && a_Timers[m_Order[end]].m_TID == tid )
+            ++end;
+
+        WriteVarint( o_Data, tid );
+        WriteVarint( o_Data, end - begin );
+
+        TickType lastStart = 0;
+        for( size_t i = begin; i < end; ++i )
+        {
+            const Timer & timer = a_Timers[m_Order[i]];
+
+            uint8_t flags = 0;
+            if( timer.m_Type != Timer::NONE || timer.m_Processor != 0xFF ) flags |= WIRE_TYPE;
+            if( timer.m_CallstackHash != 0 )                              flags |= WIRE_CALLSTACK;
+            if( timer.m_UserData[0] != 0 )                                flags |= WIRE_USER_DATA_0;
+            if( timer.m_UserData[1] != 0 )                                flags |= WIRE_USER_DATA_1;
+            if( timer.m_SessionID != sessionID )                          flags |= WIRE_SESSION;
+
+            o_Data.push_back( (char)flags );
+            o_Data.push_back( (char)timer.m_Depth );
+
+            auto result = m_FunctionIds.emplace( timer.m_FunctionAddress, (uint32_t)m_FunctionIds.size() );
+            WriteVarint( o_Data, result.first->second );
+            if( result.second )
+            {
+                WriteVarint( o_Data, timer.m_FunctionAddress );
+            }
+
+            WriteVarint( o_Data, ZigZag( (int64_t)( timer.m_Start - lastStart ) ) );
+            WriteVarint( o_Data, ZigZag( (int64_t)( timer.m_End - timer.m_Start ) ) );
+            lastStart = timer.m_Start;
+
+            if( flags & WIRE_TYPE )
+            {
+                o_Data.push_back( (char)timer.m_Type );
+                o_Data.push_back( (char)timer.m_Processor );
+            }
+            if( flags & WIRE_CALLSTACK )
+            {
+                o_Data.append( (const char*)&timer.m_CallstackHash, sizeof( uint64_t ) );
+            }
+            if( flags & WIRE_USER_DATA_0 )
+            {
+                WriteVarint( o_Data, timer.m_UserData[0] );
+            }
+            if( flags & WIRE_USER_DATA_1 )
+            {
+                WriteVarint( o_Data, timer.m_UserData[1] );
+            }
+            if( flags & WIRE_SESSION )
+            {
+                o_Data.push_back( (char)timer.m_SessionID );
+            }
+        }
+
+        begin = end;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TimerWireEncoder::Reset()
+{
+    m_FunctionIds.clear();
+    m_SessionID = 0xFFFFFFFF;
+    m_SendReset = true;
+}
+
+//-----------------------------------------------------------------------------
+bool TimerWireDecoder::Decode( const char* a_Data, size_t a_Size, uint32_t a_SessionID, std::vector<Timer> & o_Timers )
+{
+    if( a_SessionID != m_SessionID )
+    {
+        m_Functions.clear();
+        m_SessionID = a_SessionID;
+    }
+
+    const uint8_t* data = (const uint8_t*)a_Data;
+    const uint8_t* dataEnd = data + a_Size;
+
+    uint64_t numGroups = 0;
+    if( !ReadVarint( data, dataEnd, numGroups ) )
+        return false;
+
+    if( numGroups & 1 )
+    {
+        m_Functions.clear();
+    }
+    numGroups >>= 1;
+
+    for( uint64_t group = 0; group < numGroups; ++group )
+    {
+        uint64_t tid = 0;
+        uint64_t numTimers = 0;
+        if( !ReadVarint( data, dataEnd, tid ) || !ReadVarint( data, dataEnd, numTimers ) )
+            return false;
+
+        // Every timer takes at least 5 bytes.
+        if( numTimers > (uint64_t)( dataEnd - data )/5 )
+            return false;
+
+        Timer timer;
+        timer.m_TID = (uint32_t)tid;
+        TickType lastStart = 0;
+
+        for( uint64_t i = 0; i < numTimers; ++i )
+        {
+            if( dataEnd - data < 2 )
+                return false;
+
+            uint8_t flags = *data++;
+            timer.m_Depth = *data++;
+            timer.m_SessionID = (uint8_t)a_SessionID;
+            timer.m_Type = Timer::NONE;
+            timer.m_Processor = 0xFF;
+            timer.m_CallstackHash = 0;
+            timer.m_UserData[0] = 0;
+            timer.m_UserData[1] = 0;
+
+            uint64_t value = 0;
+            if( !ReadVarint( data, dataEnd, value ) || value > m_Functions.size() )
+                return false;
+            if( value == m_Functions.size() )
+            {
+                uint64_t address = 0;
+                if( !ReadVarint( data, dataEnd, address ) )
+                    return false;
+                m_Functions.push_back( address );
+            }
+            timer.m_FunctionAddress = m_Functions[value];
+
+            if( !ReadVarint( data, dataEnd, value ) )
+                return false;
+            timer.m_Start = lastStart + UnZigZag( value );
+            lastStart = timer.m_Start;
+
+            if( !ReadVarint( data, dataEnd, value ) )
+                return false;
+            timer.m_End = timer.m_Start + UnZigZag( value );
+
+            if( flags & WIRE_TYPE )
+            {
+                if( dataEnd - data < 2 )
+                    return false;
+                timer.m_Type = (Timer::Type)*data++;
+                timer.m_Processor = *data++;
+            }
+            if( flags & WIRE_CALLSTACK )
+            {
+                if( dataEnd - data < (ptrdiff_t)sizeof( uint64_t ) )
+                    return false;
+                memcpy( &timer.m_CallstackHash, data, sizeof( uint64_t ) );
+                data += sizeof( uint64_t );
+            }
+            if( ( flags & WIRE_USER_DATA_0 ) && !ReadVarint( data, dataEnd, timer.m_UserData[0] ) )
+                return false;
+            if( ( flags & WIRE_USER_DATA_1 ) && !ReadVarint( data, dataEnd, timer.m_UserData[1] ) )
+                return false;
+            if( flags & WIRE_SESSION )
+            {
+                if( data >= dataEnd )
+                    return false;
+                timer.m_SessionID = *data++;
+            }
+
+            o_Timers.push_back( timer );
+        }
+    }
+
+    return data == dataEnd;
+}
@@ -0,0 +1,55 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "ScopeTimer.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Compact encoding of the timers sent from the target to Orbit, used once the
+// target has accepted Msg_TimerEncoding.  Timers are grouped per thread, start
+// times are delta encoded against the previous timer of the thread, function
+// addresses are replaced by ids from a dictionary built over the session and
+// fields that are zero or default are omitted.
+//
+// Both dictionaries are reset when the session id of the message changes, the
+// decoder must see every message of a session in order.  The encoder is also
+// reset on every Msg_TimerEncoding handshake, its next message tells the
+// decoder to drop its dictionary, so a target that outlives Orbit stays in
+// sync with a new decoder even if the session id happens to match.
+//-----------------------------------------------------------------------------
+enum TimerEncoding : uint32_t
+{
+    TimerEncoding_Raw,
+    TimerEncoding_Compact
+};
+
+//-----------------------------------------------------------------------------
+class TimerWireEncoder
+{
+public:
+    void Encode( const Timer* a_Timers, size_t a_NumTimers, uint32_t a_SessionID, std::string & o_Data );
+    void Reset();
+
+protected:
+    std::unordered_map< uint64_t, uint32_t > m_FunctionIds;
+    std::vector< uint32_t >                  m_Order;
+    uint32_t                                 m_SessionID = 0xFFFFFFFF;
+    bool                                     m_SendReset = true;
+};
+
+//-----------------------------------------------------------------------------
+class TimerWireDecoder
+{
+public:
+    // Appends to o_Timers, returns false if a_Data is malformed.
+    bool Decode( const char* a_Data, size_t a_Size, uint32_t a_SessionID, std::vector<Timer> & o_Timers );
+
+protected:
+    std::vector< uint64_t > m_Functions;
+    uint32_t                m_SessionID = 0xFFFFFFFF;
+};
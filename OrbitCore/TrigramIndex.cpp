@@ -0,0 +1,244 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "Core.h"
+#include "TrigramIndex.h"
+#include "NameFilter.h"
+#include "OrbitFunction.h"
+#include "OrbitType.h"
+#include "Variable.h"
+#include "Serialization.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+void TrigramIndex::Clear()
+{
+    m_SharedField.clear();
+    m_Keys.clear();
+    m_Offsets.clear();
+    m_Postings.clear();
+    m_NumEntries = 0;
+    m_Pending.clear();
+    m_EntryKeys.clear();
+}
+
+//-----------------------------------------------------------------------------
+void TrigramIndex::Reserve( size_t a_NumEntries )
+{
+    // Symbol names average a few dozen trigrams.
+    m_Pending.reserve( m_Pending.size() + a_NumEntries*32 );
+}
+
+//-----------------------------------------------------------------------------
+void TrigramIndex::SetSharedField( const std::wstring & a_Field )
+{
+    m_SharedField.clear();
+    NameFilter::ToLowerUtf8( a_Field, m_SharedField );
+}
+
+//-----------------------------------------------------------------------------
+void TrigramIndex::AddField( const std::wstring & a_Field )
+{
+    m_Field.clear();
+    NameFilter::ToLowerUtf8( a_Field, m_Field );
+
+    for( size_t i = 0; i + 3 <= m_Field.size(); ++i )
+    {
+        m_EntryKeys.push_back( Key( m_Field.data() + i ) );
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TrigramIndex::EndEntry()
+{
+    std::sort( m_EntryKeys.begin(), m_EntryKeys.end() );
+    m_EntryKeys.erase( std::unique( m_EntryKeys.begin(), m_EntryKeys.end() ), m_EntryKeys.end() );
+
+    for( uint32_t key : m_EntryKeys )
+    {
+        m_Pending.push_back( ( (uint64_t)key << 32 ) | m_NumEntries );
+    }
+
+    m_EntryKeys.clear();
+    ++m_NumEntries;
+}
+
+//-----------------------------------------------------------------------------
+void TrigramIndex::Finalize()
+{
+    if( m_Pending.empty() )
+        return;
+
+    // Sorting the pairs groups them by key, entries ascending within a key.
+    std::sort( m_Pending.begin(), m_Pending.end() );
+
+    // Merge with what was already built, pending entries all come after it.
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> postings;
+    keys.reserve( m_Keys.size() + 1024 );
+    offsets.reserve( m_Offsets.size() + 1024 );
+    postings.reserve( m_Postings.size() + m_Pending.size() );
+
+    size_t oldIndex = 0;
+    size_t newIndex = 0;
+    while( oldIndex < m_Keys.size() || newIndex < m_Pending.size() )
+    {
+        uint32_t oldKey = oldIndex < m_Keys.size() ? m_Keys[oldIndex] : 0xFFFFFFFF;
+        uint32_t newKey = newIndex < m_Pending.size() ? (uint32_t)( m_Pending[newIndex] >> 32 ) : 0xFFFFFFFF;
+        uint32_t key = std::min( oldKey, newKey );
+
+        keys.push_back( key );
+        offsets.push_back( (uint32_t)postings.size() );
+
+        if( oldKey == key )
+        {
+            postings.insert( postings.end(), m_Postings.begin() + m_Offsets[oldIndex], m_Postings.begin() + m_Offsets[oldIndex + 1] );
+            ++oldIndex;
+        }
+
+        for( ; newIndex < m_Pending.size() && (uint32_t)( m_Pending[newIndex] >> 32 ) == key; ++newIndex )
+        {
+            postings.push_back( (uint32_t)m_Pending[newIndex] );
+        }
+    }
+
+    offsets.push_back( (uint32_t)postings.size() );
+
+    m_Keys.swap( keys );
+    m_Offsets.swap( offsets );
+    m_Postings.swap( postings );
+
+    m_Pending.clear();
+    m_Pending.shrink_to_fit();
+}
+
+//-----------------------------------------------------------------------------
+bool TrigramIndex::GetPostings( uint32_t a_Key, const uint32_t* & o_Begin, const uint32_t* & o_End ) const
+{
+    auto it = std::lower_bound( m_Keys.begin(), m_Keys.end(), a_Key );
+    if( it == m_Keys.end() || *it != a_Key )
+        return false;
+
+    size_t index = it - m_Keys.begin();
+    o_Begin = m_Postings.data() + m_Offsets[index];
+    o_End = m_Postings.data() + m_Offsets[index + 1];
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool TrigramIndex::Query( const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Entries ) const
+{
+    typedef std::pair< const uint32_t*, const uint32_t* > Postings;
+    std::vector< Postings > lists;
+    std::vector< uint32_t > keys;
+
+    for( const std::string & token : a_Tokens )
+    {
+        if( token.size() < 3 || m_SharedField.find( token ) != std::string::npos )
+            continue;
+
+        keys.clear();
+        for( size_t i = 0; i + 3 <= token.size(); ++i )
+        {
+            keys.push_back( Key( token.data() + i ) );
+        }
+        std::sort( keys.begin(), keys.end() );
+        keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+
+        for( uint32_t key : keys )
+        {
+            Postings postings;
+            if( !GetPostings( key, postings.first, postings.second ) )
+            {
+                o_Entries.clear();
+                return true;
+            }
+            lists.push_back( postings );
+        }
+    }
+
+    if( lists.empty() )
+        return false;
+
+    // Intersect starting from the shortest list, the result only shrinks.
+    std::sort( lists.begin(), lists.end(), []( const Postings & a, const Postings & b ){ return a.second - a.first < b.second - b.first; } );
+
+    o_Entries.assign( lists[0].first, lists[0].second );
+    std::vector<uint32_t> intersection;
+    for( size_t i = 1; i < lists.size() && !o_Entries.empty(); ++i )
+    {
+        intersection.clear();
+        std::set_intersection( o_Entries.begin(), o_Entries.end(), lists[i].first, lists[i].second, std::back_inserter( intersection ) );
+        o_Entries.swap( intersection );
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+ORBIT_SERIALIZE( TrigramIndex, 0 )
+{
+    ORBIT_NVP_VAL( 0, m_SharedField );
+    ORBIT_NVP_VAL( 0, m_Keys );
+    ORBIT_NVP_VAL( 0, m_Offsets );
+    ORBIT_NVP_VAL( 0, m_Postings );
+    ORBIT_NVP_VAL( 0, m_NumEntries );
+}
+
+//-----------------------------------------------------------------------------
+void SymbolIndex::Build( const std::wstring & a_ModuleName, const std::vector<Function> & a_Functions, const std::vector<Type> & a_Types, const std::vector<Variable> & a_Globals )
+{
+    // Fields match what FunctionsDataView, TypesDataView and GlobalsDataView filter on.
+    m_Functions.Clear();
+    m_Functions.SetSharedField( a_ModuleName );
+    m_Functions.Reserve( a_Functions.size() );
+    for( const Function & function : a_Functions )
+    {
+        m_Functions.AddField( function.m_PrettyName );
+        m_Functions.AddField( function.m_File );
+        m_Functions.EndEntry();
+    }
+    m_Functions.Finalize();
+
+    m_Types.Clear();
+    m_Types.Reserve( a_Types.size() );
+    for( const Type & type : a_Types )
+    {
+        m_Types.AddField( type.GetName() );
+        m_Types.EndEntry();
+    }
+    m_Types.Finalize();
+
+    m_Globals.Clear();
+    m_Globals.Reserve( a_Globals.size() );
+    for( const Variable & global : a_Globals )
+    {
+        m_Globals.AddField( global.m_Name );
+        m_Globals.AddField( global.m_File );
+        m_Globals.AddField( global.m_Type );
+        m_Globals.EndEntry();
+    }
+    m_Globals.Finalize();
+
+    m_Built = true;
+}
+
+//-----------------------------------------------------------------------------
+bool SymbolIndex::IsBuilt( const std::vector<Function> & a_Functions, const std::vector<Type> & a_Types, const std::vector<Variable> & a_Globals ) const
+{
+    return m_Built && m_Functions.GetNumEntries() == a_Functions.size()
+                   && m_Types.GetNumEntries() == a_Types.size()
+                   && m_Globals.GetNumEntries() == a_Globals.size();
+}
+
+//-----------------------------------------------------------------------------
+ORBIT_SERIALIZE( SymbolIndex, 0 )
+{
+    ORBIT_NVP_VAL( 0, m_Functions );
+    ORBIT_NVP_VAL( 0, m_Types );
+    ORBIT_NVP_VAL( 0, m_Globals );
+    ORBIT_NVP_VAL( 0, m_Built );
+}
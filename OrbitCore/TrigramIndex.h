@@ -0,0 +1,89 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "SerializationMacros.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Function;
+class Type;
+class Variable;
+
+//-----------------------------------------------------------------------------
+// Posting lists of every 3 byte sequence found in a list of entries, stored in
+// lower case UTF-8 like NameFilter.  Querying intersects the postings of all
+// the trigrams of the query tokens and returns a superset of the matching
+// entries, which then only need to be verified.  A shared field (the module
+// name) is common to all entries and not indexed, a token found in it does
+// not restrict the result.
+//-----------------------------------------------------------------------------
+class TrigramIndex
+{
+public:
+    void Clear();
+    void Reserve( size_t a_NumEntries );
+    void SetSharedField( const std::wstring & a_Field );
+    void AddField( const std::wstring & a_Field );
+    void EndEntry();
+    void Finalize();
+
+    uint32_t GetNumEntries() const { return m_NumEntries; }
+    size_t   GetNumTrigrams() const { return m_Keys.size(); }
+
+    // Returns false when no token is long enough to narrow down the entries.
+    bool Query( const std::vector<std::string> & a_Tokens, std::vector<uint32_t> & o_Entries ) const;
+
+    ORBIT_SERIALIZABLE;
+
+protected:
+    static uint32_t Key( const char* a_Text ) { return ( (uint32_t)(uint8_t)a_Text[0] << 16 ) | ( (uint32_t)(uint8_t)a_Text[1] << 8 ) | (uint8_t)a_Text[2]; }
+    bool GetPostings( uint32_t a_Key, const uint32_t* & o_Begin, const uint32_t* & o_End ) const;
+
+    // Built
+    std::string               m_SharedField;
+    std::vector<uint32_t>     m_Keys;      // sorted trigrams
+    std::vector<uint32_t>     m_Offsets;   // postings of m_Keys[i] are [m_Offsets[i], m_Offsets[i+1])
+    std::vector<uint32_t>     m_Postings;  // sorted entry indices
+    uint32_t                  m_NumEntries = 0;
+
+    // Building, (key << 32 | entry) pairs of the entries added since the last Finalize
+    std::vector<uint64_t>     m_Pending;
+    std::vector<uint32_t>     m_EntryKeys;
+    std::string               m_Field;
+};
+
+//-----------------------------------------------------------------------------
+// Indices of the symbols of a single module, built once the module's Pdb has
+// been processed and stored along with it in the symbol cache.  Entries are
+// the positions in the Pdb's own function, type and global vectors and hold
+// the fields the corresponding data views filter on.
+//-----------------------------------------------------------------------------
+struct SymbolIndex
+{
+    void Build( const std::wstring & a_ModuleName, const std::vector<Function> & a_Functions, const std::vector<Type> & a_Types, const std::vector<Variable> & a_Globals );
+    bool IsBuilt( const std::vector<Function> & a_Functions, const std::vector<Type> & a_Types, const std::vector<Variable> & a_Globals ) const;
+
+    const TrigramIndex* GetFunctionIndex() const { return m_Built ? &m_Functions : nullptr; }
+    const TrigramIndex* GetTypeIndex() const     { return m_Built ? &m_Types : nullptr; }
+    const TrigramIndex* GetGlobalIndex() const   { return m_Built ? &m_Globals : nullptr; }
+
+    // Entry of a symbol stored in a_Symbols, 0xFFFFFFFF if it is not part of it.
+    template <class T>
+    static uint32_t GetEntry( const std::vector<T> & a_Symbols, const T* a_Symbol )
+    {
+        if( a_Symbols.empty() || a_Symbol < a_Symbols.data() || a_Symbol >= a_Symbols.data() + a_Symbols.size() )
+            return 0xFFFFFFFF;
+        return (uint32_t)( a_Symbol - a_Symbols.data() );
+    }
+
+    TrigramIndex m_Functions;
+    TrigramIndex m_Types;
+    TrigramIndex m_Globals;
+    bool         m_Built = false;
+
+    ORBIT_SERIALIZABLE;
+};
@@ -0,0 +1,625 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "UprobeTracer.h"
+#include "CoreApp.h"
+#include "Capture.h"
+#include "OrbitProcess.h"
+#include "OrbitFunction.h"
+#include "Pdb.h"
+#include "Log.h"
+#include "LinuxUtils.h"
+#include "Profiling.h"
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <elf.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+//-----------------------------------------------------------------------------
+// Layout of our samples, see sample_type in OpenProbe.
+struct UprobeSample
+{
+    perf_event_header m_Header;
+    uint64_t          m_Id;
+    uint32_t          m_Pid;
+    uint32_t          m_Tid;
+    uint64_t          m_Time;
+};
+
+//-----------------------------------------------------------------------------
+static bool ReadSysFile( const char* a_Path, std::string & o_Content )
+{
+    std::ifstream file( a_Path );
+    if( !file.good() )
+        return false;
+    std::getline( file, o_Content );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+static bool ReadLoadSegments( const std::string & a_Path, std::vector<Elf64_Phdr> & o_Segments )
+{
+    std::ifstream file( a_Path, std::ios::binary );
+    Elf64_Ehdr header;
+    if( !file.read( (char*)&header, sizeof(header) ) ||
+        memcmp( header.e_ident, ELFMAG, SELFMAG ) != 0 ||
+        header.e_ident[EI_CLASS] != ELFCLASS64 )
+    {
+        return false;
+    }
+
+    file.seekg( header.e_phoff );
+    for( uint32_t i = 0; i < header.e_phnum; ++i )
+    {
+        Elf64_Phdr segment;
+        if( !file.read( (char*)&segment, sizeof(segment) ) )
+            return false;
+        if( segment.p_type == PT_LOAD )
+            o_Segments.push_back( segment );
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+UprobeTracer::UprobeTracer( uint32_t a_PID ) : m_PID( a_PID )
+                                             , m_PmuType( -1 )
+                                             , m_RetProbeBit( 0 )
+                                             , m_NumLostEvents( 0 )
+                                             , m_LastRefresh( 0 )
+                                             , m_HasPendingDisabled( false )
+                                             , m_ExitRequested( true )
+{
+}
+
+//-----------------------------------------------------------------------------
+UprobeTracer::~UprobeTracer()
+{
+    Stop();
+}
+
+//-----------------------------------------------------------------------------
+bool UprobeTracer::Start()
+{
+    SCOPE_TIMER_LOG( L"UprobeTracer::Start" );
+
+    // Dynamic pmu, its type and the bit selecting return probes are
+    // published in sysfs ("config:0").
+    std::string content;
+    if( !ReadSysFile( "/sys/bus/event_source/devices/uprobe/type", content ) )
+    {
+        ORBIT_LOG( "Uprobe pmu not available" );
+        return false;
+    }
+    m_PmuType = atoi( content.c_str() );
+
+    if( ReadSysFile( "/sys/bus/event_source/devices/uprobe/format/retprobe", content ) )
+    {
+        size_t pos = content.find( ':' );
+        m_RetProbeBit = pos != std::string::npos ? atoi( content.c_str() + pos + 1 ) : 0;
+    }
+
+    // There is one fd per probe and thread, thousands of hooks need more
+    // than the default soft limit.
+    rlimit limit;
+    if( getrlimit( RLIMIT_NOFILE, &limit ) == 0 && limit.rlim_cur < limit.rlim_max )
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &limit );
+    }
+
+    m_FunctionProbes.clear();
+    m_FunctionAddresses.clear();
+    m_TimerStacks.Clear();
+    m_Events.clear();
+    m_PendingDisabled.clear();
+    m_HasPendingDisabled = false;
+    m_NumLostEvents = 0;
+
+    std::unordered_map< std::string, std::vector<Elf64_Phdr> > segmentsByPath;
+    for( Function* func : Capture::GTargetProcess->GetFunctions() )
+    {
+        if( !func->IsSelected() || func->m_Pdb == nullptr )
+            continue;
+
+        Capture::GSelectedFunctionsMap[func->m_Address] = func;
+
+        // Probes are placed at a file offset, not at a virtual address.
+        std::string path = ws2s( func->m_Pdb->GetFileName() );
+        auto it = segmentsByPath.find( path );
+        if( it == segmentsByPath.end() )
+        {
+            it = segmentsByPath.emplace( path, std::vector<Elf64_Phdr>() ).first;
+            ReadLoadSegments( path, it->second );
+        }
+
+        uint64_t offset = 0;
+        bool found = false;
+        for( const Elf64_Phdr & segment : it->second )
+        {
+            if( func->m_Address >= segment.p_vaddr && func->m_Address < segment.p_vaddr + segment.p_memsz )
+            {
+                offset = func->m_Address - segment.p_vaddr + segment.p_offset;
+                found = true;
+                break;
+            }
+        }
+
+        if( !found )
+        {
+            ORBIT_LOG( Format( "No file offset for %s", func->PrettyNameStr().c_str() ) );
+            continue;
+        }
+
+        m_FunctionAddresses.push_back( (uint64_t)func->GetVirtualAddress() );
+        m_FunctionProbes.push_back( FunctionProbe{ path, offset } );
+    }
+
+    if( m_FunctionProbes.empty() )
+        return false;
+
+    m_DisabledFunctions.assign( m_FunctionProbes.size(), false );
+    m_UnhookedFunctions.assign( m_FunctionProbes.size(), false );
+
+    for( uint32_t threadId : LinuxUtils::ListThreads( m_PID ) )
+    {
+        if( !OpenThread( threadId ) )
+        {
+            Close();
+            return false;
+        }
+    }
+
+    if( m_Rings.empty() )
+    {
+        Close();
+        return false;
+    }
+
+    m_LastRefresh = OrbitTicks( CLOCK_MONOTONIC );
+    m_ExitRequested = false;
+    m_Thread = std::make_shared<std::thread>( &UprobeTracer::Run, this );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::Stop()
+{
+    m_ExitRequested = true;
+    if( m_Thread && m_Thread->joinable() )
+    {
+        m_Thread->join();
+    }
+    m_Thread = nullptr;
+
+    if( m_NumLostEvents )
+    {
+        ORBIT_LOG( Format( "Uprobe rings lost %llu events", (unsigned long long)m_NumLostEvents ) );
+    }
+
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint64_t> UprobeTracer::DisableFunctions( const std::vector<uint64_t> & a_Addresses )
+{
+    std::vector<uint64_t> disabled;
+
+    // Threads opened from now on skip these functions.
+    ScopeLock lock( m_RingsMutex );
+    for( uint64_t address : a_Addresses )
+    {
+        for( size_t i = 0; i < m_FunctionAddresses.size() && i < m_UnhookedFunctions.size(); ++i )
+        {
+            if( m_FunctionAddresses[i] != address || m_UnhookedFunctions[i] )
+                continue;
+
+            m_UnhookedFunctions[i] = true;
+            bool isDisabled = true;
+            for( auto & ring : m_Rings )
+            {
+                for( uint32_t probe = 2*(uint32_t)i; probe <= 2*(uint32_t)i + 1; ++probe )
+                {
+                    int fd = ring->m_Fds[probe];
+                    if( fd >= 0 )
+                    {
+                        isDisabled &= ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 ) == 0;
+                    }
+                }
+            }
+
+            if( isDisabled )
+            {
+                disabled.push_back( address );
+            }
+
+            ScopeLock disableLock( m_DisableMutex );
+            m_PendingDisabled.push_back( (uint32_t)i );
+            m_HasPendingDisabled = true;
+        }
+    }
+
+    return disabled;
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::ApplyDisabledFunctions()
+{
+    std::vector<uint32_t> disabled;
+    {
+        ScopeLock lock( m_DisableMutex );
+        disabled.swap( m_PendingDisabled );
+        m_HasPendingDisabled = false;
+    }
+
+    std::vector<uint64_t> addresses;
+    for( uint32_t index : disabled )
+    {
+        m_DisabledFunctions[index] = true;
+        addresses.push_back( m_FunctionAddresses[index] );
+    }
+
+    // Their returns will never come, left on the stack they would be closed
+    // by the return of the caller.
+    m_TimerStacks.ForEach( [&]( uint32_t, std::vector<Timer> & a_Timers )
+    {
+        a_Timers.erase( std::remove_if( a_Timers.begin(), a_Timers.end(), [&]( const Timer & a_Timer )
+        {
+            return std::find( addresses.begin(), addresses.end(), a_Timer.m_FunctionAddress ) != addresses.end();
+        } ), a_Timers.end() );
+
+        for( size_t i = 0; i < a_Timers.size(); ++i )
+        {
+            a_Timers[i].m_Depth = (uint8_t)i;
+        }
+    } );
+}
+
+//-----------------------------------------------------------------------------
+bool UprobeTracer::OpenThread( uint32_t a_ThreadId )
+{
+    // Returns false only on errors, a thread that exits meanwhile is skipped.
+    ScopeLock lock( m_RingsMutex );
+    std::unique_ptr<Ring> ring( new Ring() );
+    ring->m_ThreadId = a_ThreadId;
+    ring->m_Fds.assign( 2*m_FunctionProbes.size(), -1 );
+
+    for( uint32_t i = 0; i < (uint32_t)m_FunctionProbes.size(); ++i )
+    {
+        if( m_UnhookedFunctions[i] )
+            continue;
+
+        int error = OpenProbe( *ring, 2*i );
+        if( error == 0 )
+        {
+            error = OpenProbe( *ring, 2*i + 1 );
+        }
+
+        if( error != 0 )
+        {
+            CloseRing( *ring );
+            return error == ESRCH;
+        }
+    }
+
+    if( ring->m_Fd < 0 )
+        return true;
+
+    for( int fd : ring->m_Fds )
+    {
+        if( fd >= 0 )
+        {
+            ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+        }
+    }
+
+    m_Rings.push_back( std::move( ring ) );
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+int UprobeTracer::OpenProbe( Ring & a_Ring, uint32_t a_Probe )
+{
+    const FunctionProbe & function = m_FunctionProbes[a_Probe/2];
+    bool isReturn = ( a_Probe & 1 ) != 0;
+
+    perf_event_attr attr;
+    memset( &attr, 0, sizeof(attr) );
+    attr.size = sizeof(attr);
+    attr.type = m_PmuType;
+    attr.config = isReturn ? ( 1ull << m_RetProbeBit ) : 0;
+    attr.config1 = (uint64_t)function.m_Path.c_str();   // uprobe_path
+    attr.config2 = function.m_Offset;                    // probe_offset
+    attr.sample_period = 1;
+    attr.sample_type = PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+    attr.disabled = 1;
+    attr.use_clockid = 1;
+    attr.clockid = CLOCK_MONOTONIC;
+
+    // Bound to the thread on any cpu, other processes mapping the same file
+    // don't get the breakpoint.
+    int fd = (int)syscall( __NR_perf_event_open, &attr, (pid_t)a_Ring.m_ThreadId, -1, -1, PERF_FLAG_FD_CLOEXEC );
+    if( fd < 0 )
+    {
+        int error = errno;
+        if( error != ESRCH )
+        {
+            ORBIT_LOG( Format( "perf_event_open failed for %s+0x%llx: %s", function.m_Path.c_str(), (unsigned long long)function.m_Offset, strerror( error ) ) );
+        }
+        return error;
+    }
+    a_Ring.m_Fds[a_Probe] = fd;
+
+    uint64_t id = 0;
+    if( ioctl( fd, PERF_EVENT_IOC_ID, &id ) != 0 )
+    {
+        return errno;
+    }
+    m_Probes[id] = a_Probe;
+
+    // The first event of a thread owns its ring, all the others write to it.
+    if( a_Ring.m_Fd < 0 )
+    {
+        size_t size = ( 1 + RingPages ) * getpagesize();
+        void* mmapped = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        if( mmapped == MAP_FAILED )
+        {
+            int error = errno;
+            ORBIT_LOG( Format( "Could not map uprobe ring: %s", strerror( error ) ) );
+            return error;
+        }
+
+        a_Ring.m_Fd = fd;
+        a_Ring.m_Mmap = mmapped;
+        a_Ring.m_Size = size;
+    }
+    else if( ioctl( fd, PERF_EVENT_IOC_SET_OUTPUT, a_Ring.m_Fd ) != 0 )
+    {
+        return errno;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::CloseRing( Ring & a_Ring )
+{
+    for( int fd : a_Ring.m_Fds )
+    {
+        if( fd >= 0 )
+        {
+            ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+        }
+    }
+
+    if( a_Ring.m_Mmap )
+    {
+        munmap( a_Ring.m_Mmap, a_Ring.m_Size );
+        a_Ring.m_Mmap = nullptr;
+    }
+
+    for( int & fd : a_Ring.m_Fds )
+    {
+        if( fd >= 0 )
+        {
+            close( fd );
+            fd = -1;
+        }
+    }
+
+    a_Ring.m_Fd = -1;
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::Close()
+{
+    ScopeLock lock( m_RingsMutex );
+    for( auto & ring : m_Rings )
+    {
+        CloseRing( *ring );
+    }
+
+    m_Rings.clear();
+    m_Probes.Clear();
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::RefreshThreads()
+{
+    // Threads created since the last refresh get their probes, rings of
+    // threads that exited are closed once read.
+    std::vector<uint32_t> threads = LinuxUtils::ListThreads( m_PID );
+    std::unordered_set<uint32_t> alive( threads.begin(), threads.end() );
+    std::unordered_set<uint32_t> opened;
+    for( auto & ring : m_Rings )
+    {
+        ring->m_Exited = alive.find( ring->m_ThreadId ) == alive.end();
+        opened.insert( ring->m_ThreadId );
+    }
+
+    for( uint32_t threadId : threads )
+    {
+        if( opened.find( threadId ) == opened.end() )
+        {
+            OpenThread( threadId );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::ReadRing( Ring & a_Ring, uint64_t a_Now )
+{
+    if( a_Ring.m_Mmap == nullptr )
+        return;
+
+    perf_event_mmap_page* meta = (perf_event_mmap_page*)a_Ring.m_Mmap;
+    char* data = (char*)a_Ring.m_Mmap + getpagesize();
+    uint64_t dataSize = a_Ring.m_Size - getpagesize();
+
+    // Nothing buffered, whatever comes next is newer than a_Now.
+    a_Ring.m_Watermark = a_Now;
+
+    uint64_t head = __atomic_load_n( &meta->data_head, __ATOMIC_ACQUIRE );
+    uint64_t tail = meta->data_tail;
+    while( tail < head )
+    {
+        // Records are 8 byte aligned so a header never wraps, the record
+        // itself can.
+        uint64_t offset = tail % dataSize;
+        const perf_event_header* header = (const perf_event_header*)( data + offset );
+        const char* record = data + offset;
+        if( offset + header->size > dataSize )
+        {
+            m_WrapBuffer.resize( header->size );
+            uint64_t firstPart = dataSize - offset;
+            memcpy( m_WrapBuffer.data(), data + offset, firstPart );
+            memcpy( m_WrapBuffer.data() + firstPart, data, header->size - firstPart );
+            record = m_WrapBuffer.data();
+        }
+
+        if( header->type == PERF_RECORD_SAMPLE )
+        {
+            const UprobeSample* sample = (const UprobeSample*)record;
+            uint32_t* probe = m_Probes.Find( sample->m_Id );
+            if( probe && sample->m_Pid == m_PID )
+            {
+                Event event;
+                event.m_Time = sample->m_Time;
+                event.m_ThreadId = sample->m_Tid;
+                event.m_Probe = *probe;
+                m_Events.push_back( event );
+                a_Ring.m_Watermark = sample->m_Time;
+            }
+        }
+        else if( header->type == PERF_RECORD_LOST )
+        {
+            // id, lost
+            m_NumLostEvents += ((const uint64_t*)( record + sizeof(perf_event_header) ))[1];
+        }
+
+        tail += header->size;
+    }
+
+    __atomic_store_n( &meta->data_tail, tail, __ATOMIC_RELEASE );
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::ProcessEvent( const Event & a_Event )
+{
+    uint32_t functionIndex = a_Event.m_Probe / 2;
+    bool isReturn = ( a_Event.m_Probe & 1 ) != 0;
+
+    // Events recorded before the probe was disabled, the stacks no longer
+    // hold entries of this function.
+    if( m_DisabledFunctions[functionIndex] )
+        return;
+
+    std::vector<Timer>& timers = m_TimerStacks[a_Event.m_ThreadId];
+    uint64_t address = m_FunctionAddresses[functionIndex];
+    if( !isReturn )
+    {
+        Timer timer;
+        timer.m_TID = a_Event.m_ThreadId;
+        timer.m_Start = a_Event.m_Time;
+        timer.m_Depth = (uint8_t)timers.size();
+        timer.m_FunctionAddress = address;
+        timers.push_back( timer );
+        return;
+    }
+
+    // Entries above the matching one lost their return, a return without a
+    // matching entry lost its entry (ring overflow, thread opened late).
+    size_t index = timers.size();
+    while( index > 0 && timers[index-1].m_FunctionAddress != address )
+    {
+        --index;
+    }
+
+    if( index == 0 )
+        return;
+
+    static const std::string emptyName;
+    timers.resize( index );
+    Timer& timer = timers.back();
+    timer.m_End = a_Event.m_Time;
+    GCoreApp->ProcessTimer( &timer, emptyName );
+    timers.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+void UprobeTracer::Run()
+{
+    SetCurrentThreadName( L"UprobeTracer" );
+
+    bool exiting = false;
+    while( !exiting )
+    {
+        exiting = m_ExitRequested;
+
+        uint64_t now = OrbitTicks( CLOCK_MONOTONIC );
+        if( !exiting && now - m_LastRefresh > RefreshThreadsNs )
+        {
+            RefreshThreads();
+            m_LastRefresh = now;
+        }
+
+        // Each ring is ordered, events up to the oldest watermark can be
+        // merged and processed, the others wait for the next pass.  Flush
+        // all on exit.
+        size_t numPending = m_Events.size();
+        uint64_t watermark = exiting ? ~0ull : now;
+        for( auto & ring : m_Rings )
+        {
+            ReadRing( *ring, OrbitTicks( CLOCK_MONOTONIC ) );
+            watermark = std::min( watermark, ring->m_Watermark );
+        }
+
+        bool hasNewEvents = m_Events.size() > numPending;
+        std::sort( m_Events.begin() + numPending, m_Events.end() );
+        std::inplace_merge( m_Events.begin(), m_Events.begin() + numPending, m_Events.end() );
+
+        if( m_HasPendingDisabled )
+        {
+            ApplyDisabledFunctions();
+        }
+
+        Event last = { watermark, 0, 0 };
+        auto end = std::upper_bound( m_Events.begin(), m_Events.end(), last );
+        for( auto it = m_Events.begin(); it != end; ++it )
+        {
+            ProcessEvent( *it );
+        }
+        m_Events.erase( m_Events.begin(), end );
+
+        // Rings of exited threads were read one last time above.
+        {
+            ScopeLock lock( m_RingsMutex );
+            for( size_t i = 0; i < m_Rings.size(); )
+            {
+                if( m_Rings[i]->m_Exited )
+                {
+                    CloseRing( *m_Rings[i] );
+                    m_Rings.erase( m_Rings.begin() + i );
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+        }
+
+        if( !hasNewEvents && !exiting )
+        {
+            Sleep( 1 );
+        }
+    }
+}
@@ -0,0 +1,101 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "Core.h"
+#include "ScopeTimer.h"
+#include "FlatHashMap.h"
+#include "Threading.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Function;
+
+//-----------------------------------------------------------------------------
+// Hooks the selected functions of the target with uprobes and uretprobes
+// created through perf_event_open and the uprobe pmu, no bpftrace involved.
+// Probes are opened for each thread of the target, so the breakpoints are
+// only installed in its address space.  Events of all probes of a thread
+// share one mmap ring, rings are polled, merged in time order and turned
+// into timers for GCoreApp->ProcessTimer.
+class UprobeTracer
+{
+public:
+    UprobeTracer( uint32_t a_PID );
+    ~UprobeTracer();
+
+    // Returns false when uprobes can't be created, the caller can then fall
+    // back to bpftrace.
+    bool Start();
+    void Stop();
+    bool IsRunning() const { return !m_ExitRequested; }
+    // Can be called from any thread, pending entries of these functions are
+    // dropped by the tracer thread before it processes more events.  Returns
+    // the addresses whose probes were all disabled.
+    std::vector<uint64_t> DisableFunctions( const std::vector<uint64_t> & a_Addresses );
+
+    static const uint32_t RingPages = 64;
+    static const uint64_t RefreshThreadsNs = 500000000;
+
+protected:
+    struct FunctionProbe
+    {
+        std::string m_Path;
+        uint64_t    m_Offset;
+    };
+
+    struct Ring
+    {
+        uint32_t         m_ThreadId = 0;
+        int              m_Fd = -1;
+        void*            m_Mmap = nullptr;
+        size_t           m_Size = 0;
+        std::vector<int> m_Fds;            // by probe, -1 if not opened
+        uint64_t         m_Watermark = 0;  // later events are newer
+        bool             m_Exited = false;
+    };
+
+    struct Event
+    {
+        uint64_t m_Time;
+        uint32_t m_ThreadId;
+        uint32_t m_Probe;
+        bool operator<( const Event & a_Other ) const { return m_Time < a_Other.m_Time; }
+    };
+
+    bool OpenThread( uint32_t a_ThreadId );
+    int  OpenProbe( Ring & a_Ring, uint32_t a_Probe );
+    void CloseRing( Ring & a_Ring );
+    void RefreshThreads();
+    void ReadRing( Ring & a_Ring, uint64_t a_Now );
+    void ProcessEvent( const Event & a_Event );
+    void ApplyDisabledFunctions();
+    void Run();
+    void Close();
+
+private:
+    uint32_t                                  m_PID;
+    int                                       m_PmuType;
+    int                                       m_RetProbeBit;
+    Mutex                                     m_RingsMutex;
+    std::vector< std::unique_ptr<Ring> >      m_Rings;
+    std::vector<bool>                         m_UnhookedFunctions;
+    FlatHashMap<uint64_t, uint32_t>           m_Probes;
+    std::vector<FunctionProbe>                m_FunctionProbes;
+    std::vector<uint64_t>                     m_FunctionAddresses;
+    FlatHashMap<uint32_t, std::vector<Timer>> m_TimerStacks;
+    std::vector<bool>                         m_DisabledFunctions;
+    Mutex                                     m_DisableMutex;
+    std::vector<uint32_t>                     m_PendingDisabled;
+    std::atomic<bool>                         m_HasPendingDisabled;
+    std::vector<Event>                        m_Events;
+    std::vector<char>                         m_WrapBuffer;
+    uint64_t                                  m_NumLostEvents;
+    uint64_t                                  m_LastRefresh;
+    std::shared_ptr<std::thread>              m_Thread;
+    std::atomic<bool>                         m_ExitRequested;
+};
@@ -75,6 +75,12 @@ inline unsigned long long StringHash( const std::string & a_String )
     return XXH64( a_String.data(), a_String.size(), 0xBADDCAFEDEAD10CC );
 }
 
+//-----------------------------------------------------------------------------
+inline unsigned long long StringHash( const char* a_Data, size_t a_Size )
+{
+    return XXH64( a_Data, a_Size, 0xBADDCAFEDEAD10CC );
+}
+
 //-----------------------------------------------------------------------------
 inline unsigned long long StringHash( const std::wstring & a_String )
 {
@@ -86,6 +92,20 @@ inline unsigned long long StringHash( const std::wstring & a_String )
 #define Log( Msg, ... ) OrbitPrintf( Msg, __VA_ARGS__ )
 #endif
 
+//-----------------------------------------------------------------------------
+inline uint32_t CountLeadingZeros( uint64_t a_Value )
+{
+    if( a_Value == 0 )
+        return 64;
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanReverse64( &index, a_Value );
+    return 63 - index;
+#else
+    return (uint32_t)__builtin_clzll( a_Value );
+#endif
+}
+
 //-----------------------------------------------------------------------------
 template <typename T, size_t N>
 inline size_t SizeOfArray(const T(&)[N])
@@ -0,0 +1,46 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//-----------------------------------------------------------------------------
+inline uint64_t ZigZag( int64_t a_Value )
+{
+    return ( (uint64_t)a_Value << 1 ) ^ (uint64_t)( a_Value >> 63 );
+}
+
+//-----------------------------------------------------------------------------
+inline int64_t UnZigZag( uint64_t a_Value )
+{
+    return (int64_t)( a_Value >> 1 ) ^ -(int64_t)( a_Value & 1 );
+}
+
+//-----------------------------------------------------------------------------
+inline void WriteVarint( std::string & a_Out, uint64_t a_Value )
+{
+    while( a_Value >= 0x80 )
+    {
+        a_Out.push_back( (char)( a_Value | 0x80 ) );
+        a_Value >>= 7;
+    }
+    a_Out.push_back( (char)a_Value );
+}
+
+//-----------------------------------------------------------------------------
+inline bool ReadVarint( const uint8_t* & a_Data, const uint8_t* a_End, uint64_t & o_Value )
+{
+    o_Value = 0;
+    for( int shift = 0; shift < 64; shift += 7 )
+    {
+        if( a_Data >= a_End )
+            return false;
+        uint8_t byte = *a_Data++;
+        o_Value |= (uint64_t)( byte & 0x7F ) << shift;
+        if( ( byte & 0x80 ) == 0 )
+            return true;
+    }
+    return false;
+}
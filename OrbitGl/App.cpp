@@ -5,6 +5,7 @@
 #include "TextRenderer.h"
 #include "GlCanvas.h"
 #include "Capture.h"
+#include "HookOverhead.h"
 #include "ImGuiOrbit.h"
 #include "Params.h"
 #include "Log.h"
@@ -26,6 +27,7 @@
 #include "DiaManager.h"
 #include "MiniDump.h"
 #include "CaptureSerializer.h"
+#include "CaptureStream.h"
 #include "PluginManager.h"
 #include "RuleEditor.h"
 
@@ -59,6 +61,8 @@
 #else
 #include "LinuxUtils.h"
 #include "BpfTrace.h"
+#include "UprobeTracer.h"
+#include "FtraceReader.h"
 #endif
 
 class OrbitApp* GOrbitApp;
@@ -135,6 +139,10 @@ void OrbitApp::SetCommandLineArguments(const std::vector< std::string > & a_Args
         {
             m_PostInitArguments.push_back(arg);               
         }
+        else if (Contains(arg, "tracedat:"))
+        {
+            m_PostInitArguments.push_back(arg);
+        }
     }
 }
 
@@ -246,6 +254,7 @@ bool OrbitApp::Init()
     GModuleManager.Init();
     Capture::Init();
     Capture::GSamplingDoneCallback = &OrbitApp::AddSamplingReport;
+    Capture::GUnhookFunctionsFunc = &OrbitApp::UnhookFunctions;
     Capture::SetLoadPdbAsyncFunc( GLoadPdbAsync );
 
     #ifdef _WIN32
@@ -299,7 +308,36 @@ void OrbitApp::PostInit()
             }
             SystraceManager::Get().Dump();
         }
+        else if (Contains(arg, "tracedat:"))
+        {
+            GoToCapture();
+            LoadTraceDat(Replace(arg, "tracedat:", ""));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::LoadTraceDat(const std::string& a_FileName)
+{
+#ifdef __linux__
+    FtraceReader reader;
+    std::vector<ContextSwitch> contextSwitches;
+    if (!reader.LoadTraceDat(a_FileName, contextSwitches))
+    {
+        return;
+    }
+
+    for (const ContextSwitch& cs : contextSwitches)
+    {
+        ++Capture::GNumContextSwitches;
+        GTimerManager->Add(cs);
     }
+
+    FireRefreshCallbacks();
+    DoZoom = true; //TODO: remove global, review logic
+#else
+    UNUSED(a_FileName);
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -514,6 +552,10 @@ void OrbitApp::MainTick()
 
     GMainTimer.Reset();
     Capture::Update();
+    if( GCurrentTimeGraph )
+    {
+        GCurrentTimeGraph->GetDurationIndex().Update();
+    }
 #ifdef WIN32
     GTcpServer->MainThreadTick();
 #endif
@@ -893,13 +935,38 @@ void OrbitApp::AddUiMessageCallback( std::function< void( const std::wstring & )
 //-----------------------------------------------------------------------------
 void OrbitApp::StartCapture()
 {
+    // Streamed timers already on disk are dropped from memory and drawn
+    // from the file, like a lazily loaded capture.
+    GCaptureStream.SetCheckpointCallback( []( const std::shared_ptr<CaptureFileReader> & a_Reader )
+    {
+        if( GCurrentTimeGraph )
+        {
+            GCurrentTimeGraph->OnStreamCheckpoint( a_Reader );
+        }
+    } );
+
 #ifdef WIN32
     Capture::StartCapture();
 #else
     if( Capture::StartCapture() )
     {
-        m_BpfTrace = std::make_shared<BpfTrace>();
-        m_BpfTrace->Start();
+        // Native uprobes first, bpftrace when the uprobe pmu isn't usable.
+        m_UprobeTracer = std::make_shared<UprobeTracer>( Capture::GTargetProcess->GetID() );
+        if( !m_UprobeTracer->Start() )
+        {
+            m_UprobeTracer = nullptr;
+            m_BpfTrace = std::make_shared<BpfTrace>();
+            m_BpfTrace->Start();
+        }
+
+        if( GParams.m_TrackContextSwitches )
+        {
+            m_FtraceReader = std::make_shared<FtraceReader>( Capture::GTargetProcess->GetID() );
+            if( !m_FtraceReader->Start() )
+            {
+                m_FtraceReader = nullptr;
+            }
+        }
     }
 #endif
 
@@ -912,16 +979,55 @@ void OrbitApp::StartCapture()
     }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::UnhookFunctions( const std::vector<ULONG64> & a_Addresses )
+{
+#ifdef __linux__
+    if( GOrbitApp->m_UprobeTracer )
+    {
+        std::vector<uint64_t> addresses( a_Addresses.begin(), a_Addresses.end() );
+        std::vector<uint64_t> disabled = GOrbitApp->m_UprobeTracer->DisableFunctions( addresses );
+        GHookOverhead.OnUnhooked( std::vector<ULONG64>( disabled.begin(), disabled.end() ) );
+    }
+    else if( GOrbitApp->m_BpfTrace )
+    {
+        // The script probes every selected function until it is restarted.
+        ORBIT_LOG( Format( "bpftrace can't unhook %u functions, the hook event budget is not enforced", (uint32_t)a_Addresses.size() ) );
+    }
+#else
+    UNUSED( a_Addresses );
+#endif
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::StopCapture()
 {
     Capture::StopCapture();
 
+    if( GCaptureStream.IsOpen() )
+    {
+        // Makes the streamed file a complete capture.
+        CaptureSerializer ar;
+        ar.m_TimeGraph = GCurrentTimeGraph;
+        GCaptureStream.Close( ar.SaveMetadata() );
+    }
+
 #ifdef __linux__
+    if( m_UprobeTracer )
+    {
+        m_UprobeTracer->Stop();
+    }
+
     if( m_BpfTrace )
     {
         m_BpfTrace->Stop();
     }
+
+    if( m_FtraceReader )
+    {
+        m_FtraceReader->Stop();
+        m_FtraceReader = nullptr;
+    }
 #endif
 
     FireRefreshCallbacks();
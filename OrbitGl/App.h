@@ -58,6 +58,7 @@ public:
     void LoadSymbolsFile();
     void LoadSystrace(const std::string& a_FileName);
     void AppendSystrace(const std::string& a_FileName, uint64_t a_TimeOffset);
+    void LoadTraceDat(const std::string& a_FileName);
     void ListSessions();
     void SetRemoteProcess( std::shared_ptr<Process> a_Process );
     void AddWatchedVariable( Variable* a_Variable );
@@ -87,6 +88,7 @@ public:
     bool Inject( unsigned long a_ProcessId );
     static void AddSamplingReport( std::shared_ptr< class SamplingProfiler> & a_SamplingProfiler );
     static void AddSelectionReport( std::shared_ptr<SamplingProfiler> & a_SamplingProfiler );
+    static void UnhookFunctions( const std::vector<ULONG64> & a_Addresses );
     void GoToCode( DWORD64 a_Address );
     void GoToCallstack();
     void GoToCapture();
@@ -191,6 +193,8 @@ private:
     CrashHandler       m_CrashHandler;
 #else
     std::shared_ptr<class BpfTrace> m_BpfTrace;
+    std::shared_ptr<class UprobeTracer> m_UprobeTracer;
+    std::shared_ptr<class FtraceReader> m_FtraceReader;
 #endif
 };
 
@@ -14,14 +14,23 @@
 #include "App.h"
 #include "OrbitProcess.h"
 #include "OrbitModule.h"
+#include "CaptureFile.h"
+#include "TimerChunkCache.h"
+#include "CaptureStream.h"
+#include "Log.h"
+#include "FunctionStats.h"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 //-----------------------------------------------------------------------------
 CaptureSerializer::CaptureSerializer()
 {
-    m_Version = 2;
+    m_Version = 3;
     m_TimerVersion = Timer::Version;
     m_SizeOfTimer = sizeof(Timer);
 }
@@ -31,23 +40,34 @@ void CaptureSerializer::Save( const std::wstring a_FileName )
 {
     Capture::PreSave();
 
-    std::basic_ostream<char> Stream( &GStreamCounter );
-    cereal::BinaryOutputArchive CountingArchive( Stream );
-    GStreamCounter.Reset();
-    Save( CountingArchive );
-    PRINT_VAR( GStreamCounter.Size() );
-    GStreamCounter.Reset();
-
-    // Binary
     m_CaptureName = ws2s(a_FileName);
-    std::ofstream myfile( m_CaptureName, std::ios::binary );
-    if( !myfile.fail() )
+    CaptureFileWriter writer;
+    if( writer.Open( m_CaptureName ) )
     {
         SCOPE_TIMER_LOG( Format( L"Saving capture in %s", a_FileName.c_str() ) );
-        cereal::BinaryOutputArchive archive( myfile );
+
+        // Metadata is serialized before the timers, the globals it reads are
+        // not safe to walk while the timer chunks are being compressed.  The
+        // chunk index makes the order of chunks in the file irrelevant.
+        writer.WriteMetadata( SaveMetadata() );
+        SaveTimers( writer );
+
+        if( writer.Close() )
+        {
+            PRINT_VAR( writer.GetSize() );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::string CaptureSerializer::SaveMetadata()
+{
+    std::ostringstream metadata;
+    {
+        cereal::BinaryOutputArchive archive( metadata );
         Save( archive );
-        myfile.close();
     }
+    return metadata.str();
 }
 
 //-----------------------------------------------------------------------------
@@ -60,7 +80,6 @@ template <class T> void CaptureSerializer::Save( T & a_Archive )
 
     // Functions
     {
-        ORBIT_SIZE_SCOPE( "Functions" );
         std::vector<Function> functions;
         for( auto & pair : Capture::GSelectedFunctionsMap )
         {
@@ -79,43 +98,51 @@ template <class T> void CaptureSerializer::Save( T & a_Archive )
     a_Archive( Capture::GFunctionCountMap );
 
     // Process
-    {
-        ORBIT_SIZE_SCOPE( "Capture::GTargetProcess" );
-        a_Archive( Capture::GTargetProcess );
-    }
+    a_Archive( Capture::GTargetProcess );
 
     // Callstacks
-    {
-        ORBIT_SIZE_SCOPE( "Capture::GCallstacks" );
-        a_Archive( Capture::GCallstacks );
-    }
+    a_Archive( Capture::GCallstacks );
 
     // Sampling profiler
-    {
-        ORBIT_SIZE_SCOPE( "SamplingProfiler" );
-        a_Archive( Capture::GSamplingProfiler );
-    }
+    a_Archive( Capture::GSamplingProfiler );
 
     // Event buffer
-    {
-        ORBIT_SIZE_SCOPE( "Event Buffer" );
-        a_Archive( GEventTracer.GetEventBuffer() );
-    }
+    a_Archive( GEventTracer.GetEventBuffer() );
+}
 
-    // Timers
-    int numWrites = 0;
-    std::vector< std::shared_ptr<TimerChain> > chains = m_TimeGraph->GetAllTimerChains();
-    for( const std::shared_ptr<TimerChain>& chain : chains )
+//-----------------------------------------------------------------------------
+void CaptureSerializer::SaveTimers( CaptureFileWriter & a_Writer )
+{
+    // Timers added since the header was serialized are not saved, the
+    // header count stays exact.
+    size_t numTimersLeft = (size_t)std::max( m_NumTimers, 0 );
+    std::vector<Timer> timers;
+    std::shared_ptr<TimerChunkCache> chunkCache = m_TimeGraph->GetTimerChunkCache();
+    for( auto & pair : m_TimeGraph->GetThreadTracksCopy() )
     {
-        for (const TextBox& box : *chain)
+        timers.clear();
+        for( const std::shared_ptr<TimerChain> & chain : pair.second->GetAllChains() )
         {
-            a_Archive(cereal::binary_data((char*)&box.GetTimer(), sizeof(Timer)));
+            for( const TextBox & box : *chain )
+            {
+                timers.push_back( box.GetTimer() );
+            }
+        }
 
-            if (++numWrites > m_NumTimers)
+        // Timers of a lazily loaded capture still live in the source file.
+        if( chunkCache )
+        {
+            for( uint32_t chunkIndex : pair.second->GetTimerChunks() )
             {
-                return;
+                chunkCache->GetReader().ReadTimers( chunkCache->GetChunk( chunkIndex ), timers );
             }
         }
+
+        // Each depth has its own chain, chunks are time ordered.
+        std::stable_sort( timers.begin(), timers.end(), []( const Timer & a, const Timer & b ){ return a.m_Start < b.m_Start; } );
+        size_t numTimers = std::min( timers.size(), numTimersLeft );
+        numTimersLeft -= numTimers;
+        a_Writer.WriteTimers( pair.first, timers.data(), numTimers );
     }
 }
 
@@ -124,48 +151,79 @@ void CaptureSerializer::Load( const std::wstring a_FileName )
 {
     SCOPE_TIMER_LOG( Format( L"Loading capture %s", a_FileName.c_str() ) );
 
-#ifdef _WIN32
-    // Binary
-    std::ifstream file( ws2s(a_FileName), std::ios::binary );
-    if( !file.fail() )
+    std::string fileName = ws2s( a_FileName );
+    if( CaptureFileReader::IsCaptureFile( fileName ) )
     {
-        // header
-        cereal::BinaryInputArchive archive( file );
-        archive( *this );
-
-        // functions
-        std::shared_ptr<Module> module = std::make_shared<Module>();
-        Capture::GTargetProcess->AddModule(module);
-        module->m_Pdb = std::make_shared<Pdb>( a_FileName.c_str() );
-        archive( module->m_Pdb->GetFunctions() );
-        module->m_Pdb->ProcessData();
-        GPdbDbg = module->m_Pdb;
-        Capture::GSelectedFunctionsMap.clear();
-        for( Function & func : module->m_Pdb->GetFunctions() )
+        std::shared_ptr<CaptureFileReader> reader = std::make_shared<CaptureFileReader>();
+        if( !reader->Open( fileName ) )
         {
-            Capture::GSelectedFunctionsMap[func.m_Address] = &func;
+            ORBIT_ERROR;
+            return;
         }
-        Capture::GVisibleFunctionsMap = Capture::GSelectedFunctionsMap;
 
-        // Function count
-        archive( Capture::GFunctionCountMap );
+        // Streamed captures that were interrupted have no metadata, their
+        // callstacks and samples are in separate chunks.
+        std::string metadata;
+        const CaptureChunk* metadataChunk = reader->FindChunk( CaptureChunk::METADATA );
+        if( metadataChunk && reader->ReadChunk( *metadataChunk, metadata ) )
+        {
+            std::istringstream stream( metadata );
+            cereal::BinaryInputArchive archive( stream );
+            Load( archive, a_FileName );
+        }
+        else
+        {
+            ORBIT_LOG( Format( "No metadata in %s, capture was interrupted", fileName.c_str() ) );
+            LoadStreamedData( *reader );
+        }
 
-        // Process
-        archive( Capture::GTargetProcess );
+        const std::vector<CaptureChunk> & chunks = reader->GetChunks();
+        uint64_t timerDataSize = 0;
+        for( const CaptureChunk & chunk : chunks )
+        {
+            if( chunk.m_Type == CaptureChunk::TIMERS )
+                timerDataSize += chunk.m_NumItems*sizeof( Timer );
+        }
 
-        // Callstacks
-        archive( Capture::GCallstacks );
+        // Version 1 chunks don't record their max depth, those captures are
+        // always loaded in memory.
+        if( timerDataSize > TimerChunkCache::LazyLoadThreshold && reader->GetVersion() >= 2 )
+        {
+            // Only the chunk index is loaded, the time graph decodes the
+            // chunks it needs to draw straight from the mapped file.  Function
+            // stats are recomputed by the background indexing pass.
+            m_TimeGraph->SetTimerChunkCache( std::make_shared<TimerChunkCache>( reader, m_TimeGraph->GetTextRenderer(), TimerChunkCache::DefaultMaxBytes ) );
+            for( uint32_t i = 0; i < (uint32_t)chunks.size(); ++i )
+            {
+                if( chunks[i].m_Type == CaptureChunk::TIMERS )
+                {
+                    m_TimeGraph->ProcessTimerChunk( i, chunks[i] );
+                }
+            }
+            m_TimeGraph->GetDurationIndex().AddChunks( reader, []( std::unordered_map<DWORD64, FunctionStats> & a_Stats )
+            {
+                std::vector< std::unordered_map<DWORD64, FunctionStats> > stats( 1 );
+                stats[0].swap( a_Stats );
+                SetFunctionStats( stats );
+                GOrbitApp->FireRefreshCallbacks();
+            } );
+        }
+        else
+        {
+            LoadTimers( *reader );
+        }
 
-        // Sampling profiler
-        archive( Capture::GSamplingProfiler );
-        Capture::GSamplingProfiler->SortByThreadUsage();
-        GOrbitApp->AddSamplingReport( Capture::GSamplingProfiler );
-        Capture::GSamplingProfiler->SetLoadedFromFile( true );
+        GOrbitApp->FireRefreshCallbacks();
+        return;
+    }
 
-        // Event buffer
-        archive( GEventTracer.GetEventBuffer() );
+    // Captures saved before the chunked format: metadata followed by raw timers.
+    std::ifstream file( fileName, std::ios::binary );
+    if( !file.fail() )
+    {
+        cereal::BinaryInputArchive archive( file );
+        Load( archive, a_FileName );
 
-        // Timers
         Timer timer;
         while( file.read( (char*)&timer, sizeof(Timer) ) )
         {
@@ -174,7 +232,132 @@ void CaptureSerializer::Load( const std::wstring a_FileName )
 
         GOrbitApp->FireRefreshCallbacks();
     }
-#endif
+}
+
+//-----------------------------------------------------------------------------
+void CaptureSerializer::LoadTimers( const CaptureFileReader & a_Reader )
+{
+    // Thread tracks are independent, they are rebuilt in parallel.  Function
+    // stats are accumulated per worker and merged once all timers are in.
+    uint32_t numWorkers = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector< std::unordered_map<DWORD64, FunctionStats> > workerStats( numWorkers );
+
+    bool success = a_Reader.ReadTimersParallel( [this, &workerStats]( const CaptureChunk & a_Chunk, const std::vector<Timer> & a_Timers, uint32_t a_Worker )
+    {
+        m_TimeGraph->ProcessThreadTimers( a_Chunk.m_ThreadId, a_Timers, workerStats[a_Worker] );
+    }, numWorkers );
+
+    if( !success )
+    {
+        ORBIT_ERROR;
+    }
+
+    SetFunctionStats( workerStats );
+}
+
+//-----------------------------------------------------------------------------
+void CaptureSerializer::SetFunctionStats( const std::vector< std::unordered_map<DWORD64, FunctionStats> > & a_Stats )
+{
+    // Stats and counts saved with the functions are recomputed from the timers.
+    Capture::GFunctionCountMap.clear();
+    for( auto & pair : Capture::GSelectedFunctionsMap )
+    {
+        if( pair.second && pair.second->m_Stats )
+        {
+            pair.second->m_Stats->Reset();
+        }
+    }
+
+    for( const std::unordered_map<DWORD64, FunctionStats> & stats : a_Stats )
+    {
+        for( auto & pair : stats )
+        {
+            Function* func = Capture::GTargetProcess->GetFunctionFromAddress( pair.first );
+            if( func )
+            {
+                Capture::GFunctionCountMap[pair.first] += pair.second.m_Count;
+                if( func->m_Stats )
+                {
+                    func->m_Stats->Merge( pair.second );
+                }
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void CaptureSerializer::LoadStreamedData( const CaptureFileReader & a_Reader )
+{
+    std::string data;
+    std::vector<CallStack> callstacks;
+    std::vector<CallstackEvent> samples;
+
+    for( const CaptureChunk & chunk : a_Reader.GetChunks() )
+    {
+        if( chunk.m_Type == CaptureChunk::CALLSTACKS && a_Reader.ReadChunk( chunk, data ) )
+        {
+            CaptureStream::DecodeCallstacks( data, callstacks );
+        }
+        else if( chunk.m_Type == CaptureChunk::SAMPLES && a_Reader.ReadChunk( chunk, data ) )
+        {
+            CaptureStream::DecodeSamples( data, samples );
+        }
+    }
+
+    for( CallStack & callstack : callstacks )
+    {
+        Capture::AddCallstack( callstack );
+    }
+
+    for( const CallstackEvent & sample : samples )
+    {
+        std::shared_ptr<CallStack> callstack = Capture::GetCallstack( sample.m_Id );
+        if( callstack )
+        {
+            CallStack event = *callstack;
+            event.m_ThreadId = sample.m_TID;
+            GEventTracer.GetEventBuffer().AddCallstackEvent( sample.m_Time, event );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+template <class T> void CaptureSerializer::Load( T & a_Archive, const std::wstring & a_FileName )
+{
+    // header
+    a_Archive( *this );
+
+    // functions
+    std::shared_ptr<Module> module = std::make_shared<Module>();
+    Capture::GTargetProcess->AddModule(module);
+    module->m_Pdb = std::make_shared<Pdb>( a_FileName.c_str() );
+    a_Archive( module->m_Pdb->GetFunctions() );
+    module->m_Pdb->ProcessData();
+    GPdbDbg = module->m_Pdb;
+    Capture::GSelectedFunctionsMap.clear();
+    for( Function & func : module->m_Pdb->GetFunctions() )
+    {
+        Capture::GSelectedFunctionsMap[func.m_Address] = &func;
+    }
+    Capture::GVisibleFunctionsMap = Capture::GSelectedFunctionsMap;
+
+    // Function count
+    a_Archive( Capture::GFunctionCountMap );
+
+    // Process
+    a_Archive( Capture::GTargetProcess );
+
+    // Callstacks
+    a_Archive( Capture::GCallstacks );
+
+    // Sampling profiler
+    a_Archive( Capture::GSamplingProfiler );
+    Capture::GSamplingProfiler->SortByThreadUsage();
+    GOrbitApp->AddSamplingReport( Capture::GSamplingProfiler );
+    Capture::GSamplingProfiler->SetLoadedFromFile( true );
+
+    // Event buffer
+    a_Archive( GEventTracer.GetEventBuffer() );
 }
 
 //-----------------------------------------------------------------------------
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "OrbitType.h"
 #include "SerializationMacros.h"
 
@@ -17,6 +18,12 @@ public:
     void Load( const std::wstring a_FileName );
 
     template <class T> void Save( T & a_Archive );
+    template <class T> void Load( T & a_Archive, const std::wstring & a_FileName );
+    std::string SaveMetadata();
+    void SaveTimers( class CaptureFileWriter & a_Writer );
+    void LoadStreamedData( const class CaptureFileReader & a_Reader );
+    void LoadTimers( const class CaptureFileReader & a_Reader );
+    static void SetFunctionStats( const std::vector< std::unordered_map<DWORD64, struct FunctionStats> > & a_Stats );
 
     class  TimeGraph*        m_TimeGraph;
     class  SamplingProfiler* m_SamplingProfiler;
@@ -214,7 +214,8 @@ void CaptureWindow::Pick( PickingID a_PickingID, int a_X, int a_Y  )
     case PickingID::BOX:
     {
         void** textBoxPtr = m_TimeGraph.GetBatcher().GetBoxBuffer().m_UserData.SlowAt( id );
-        if( textBoxPtr )
+        // Placeholders of chunks not loaded yet carry no text box.
+        if( textBoxPtr && *textBoxPtr )
         {
             TextBox* textBox = (TextBox*)*textBoxPtr;
             SelectTextBox( textBox );
@@ -224,7 +225,7 @@ void CaptureWindow::Pick( PickingID a_PickingID, int a_X, int a_Y  )
     case PickingID::LINE:
     {
         void** textBoxPtr = m_TimeGraph.GetBatcher().GetLineBuffer().m_UserData.SlowAt( id );
-        if( textBoxPtr )
+        if( textBoxPtr && *textBoxPtr )
         {
             TextBox* textBox = (TextBox*)*textBoxPtr;
             SelectTextBox( textBox );
@@ -593,11 +594,12 @@ void CaptureWindow::KeyPressed( unsigned int a_KeyCode, bool a_Ctrl, bool a_Shif
 //-----------------------------------------------------------------------------
 std::wstring GOTO_CALLSTACK = L"Go to Callstack";
 std::wstring GOTO_SOURCE    = L"Go to Source";
+std::wstring SHOW_DURATIONS = L"Duration Histogram";
 
 //-----------------------------------------------------------------------------
 std::vector<std::wstring> CaptureWindow::GetContextMenu()
 {
-    static std::vector< std::wstring > menu = { GOTO_CALLSTACK, GOTO_SOURCE };
+    static std::vector< std::wstring > menu = { GOTO_CALLSTACK, GOTO_SOURCE, SHOW_DURATIONS };
     static std::vector< std::wstring > emptyMenu;
     TextBox* selection = Capture::GSelectedTextBox;
     return selection && !selection->GetTimer().IsCoreActivity() ? menu : emptyMenu;
@@ -616,6 +618,11 @@ void CaptureWindow::OnContextMenu( const std::wstring & a_Action, int a_MenuInde
         {
             GOrbitApp->GoToCallstack();
         }
+        else if( a_Action == SHOW_DURATIONS )
+        {
+            m_TimeGraph.SetHistogramFunction( Capture::GSelectedTextBox->GetTimer().m_FunctionAddress );
+            NeedsRedraw();
+        }
     }    
 }
 
@@ -897,6 +904,11 @@ void CaptureWindow::RenderUI()
         RenderMemTracker();
     }
 
+    if( m_TimeGraph.GetHistogramFunction() )
+    {
+        RenderDurationHistogram();
+    }
+
     // Rendering
     glViewport(0, 0, getWidth(), getHeight());
     ImGui::Render();
@@ -1034,6 +1046,25 @@ void CaptureWindow::RenderMemTracker()
         ImGui::Text( "%s", VAR_TO_ANSI( memTracker.NumAllocatedBytes() ) );
         ImGui::Text( "%s", VAR_TO_ANSI( memTracker.NumFreedBytes() ) );
         ImGui::Text( "%s", VAR_TO_ANSI( memTracker.NumLiveBytes() ) );
+        ImGui::Text( "%s", VAR_TO_ANSI( memTracker.NumLiveAllocs() ) );
+        ImGui::Text( "%s", VAR_TO_ANSI( memTracker.NumUnknownFrees() ) );
+        ImGui::Text( "%s", VAR_TO_ANSI( memTracker.PeakLiveBytes() ) );
+
+        std::vector<MemoryTracker::LeakCandidate> leaks = memTracker.GetLeakCandidates( 8 );
+        if( !leaks.empty() )
+        {
+            ImGui::Separator();
+            ImGui::Text( "=== Leak Candidates ===" );
+        }
+
+        for( const MemoryTracker::LeakCandidate & leak : leaks )
+        {
+            ImGui::Text( "Callstack[%llu] %llu live bytes, grew %u times, shrank %u times"
+                       , (unsigned long long)leak.m_Site.m_Callstack
+                       , (unsigned long long)leak.m_Site.m_LiveBytes
+                       , leak.m_NumIncreases
+                       , leak.m_NumDecreases );
+        }
     }
 
     ImGui::End();
@@ -1041,6 +1072,86 @@ void CaptureWindow::RenderMemTracker()
     ImGui::PopStyleColor();
 }
 
+//-----------------------------------------------------------------------------
+void CaptureWindow::RenderDurationHistogram()
+{
+    DWORD64 address = m_TimeGraph.GetHistogramFunction();
+    auto funcIt = Capture::GSelectedFunctionsMap.find( address );
+    Function* func = funcIt != Capture::GSelectedFunctionsMap.end() ? funcIt->second : nullptr;
+    std::string name = func ? func->PrettyNameStr() : Format( "0x%llx", address );
+
+    ImGui::SetNextWindowSize( ImVec2( 500, 400 ), ImGuiSetCond_FirstUseEver );
+    bool open = true;
+    if( !ImGui::Begin( "Duration Histogram", &open ) )
+    {
+        ImGui::End();
+        return;
+    }
+
+    // Instances starting in the visible time range.
+    TickType minTime = m_TimeGraph.GetTickFromUs( m_TimeGraph.GetMinTimeUs() );
+    TickType maxTime = m_TimeGraph.GetTickFromUs( m_TimeGraph.GetMaxTimeUs() );
+    FunctionDurationIndex & index = m_TimeGraph.GetDurationIndex();
+    FunctionDurationIndex::Histogram histogram;
+    index.GetHistogram( address, minTime, maxTime, histogram );
+
+    ImGui::Text( "%s", name.c_str() );
+    ImGui::Text( "%llu instances in visible range", (unsigned long long)histogram.m_Total );
+
+    FunctionDurationIndex::Instance instance;
+    if( ImGui::Button( "Jump to slowest" ) && index.GetSlowest( address, minTime, maxTime, instance ) )
+    {
+        m_TimeGraph.Zoom( instance.m_Start, instance.m_End );
+    }
+
+    int highlightedBin = m_TimeGraph.GetHighlightedBin();
+    if( highlightedBin >= 0 )
+    {
+        ImGui::SameLine();
+        if( ImGui::Button( "Jump to slowest in bucket" ) && index.GetSlowestInBin( address, minTime, maxTime, highlightedBin, instance ) )
+        {
+            m_TimeGraph.Zoom( instance.m_Start, instance.m_End );
+        }
+    }
+
+    ImGui::Separator();
+
+    uint64_t maxCount = 1;
+    for( uint64_t count : histogram.m_Counts )
+    {
+        maxCount = std::max( maxCount, count );
+    }
+
+    // Clicking a bucket highlights its instances on the timeline.
+    for( uint32_t bin = 0; bin < FunctionDurationIndex::NumBins; ++bin )
+    {
+        uint64_t count = histogram.m_Counts[bin];
+        if( count == 0 )
+            continue;
+
+        double binMinMs = FunctionDurationIndex::GetBinMinNs( bin ) * 0.000001;
+        double binMaxMs = FunctionDurationIndex::GetBinMinNs( bin + 1 ) * 0.000001;
+        std::string label = Format( "%s - %s", GetPrettyTime( binMinMs ).c_str(), GetPrettyTime( binMaxMs ).c_str() );
+        if( ImGui::Selectable( label.c_str(), (int)bin == highlightedBin, 0, ImVec2( 180, 0 ) ) )
+        {
+            m_TimeGraph.SetHighlightedBin( (int)bin == highlightedBin ? -1 : (int)bin );
+            NeedsUpdate();
+        }
+
+        ImGui::SameLine();
+        std::string countText = Format( "%llu", (unsigned long long)count );
+        ImGui::ProgressBar( (float)count / (float)maxCount, ImVec2( -1.f, 0.f ), countText.c_str() );
+    }
+
+    ImGui::End();
+
+    if( !open )
+    {
+        m_TimeGraph.SetHistogramFunction( 0 );
+        NeedsUpdate();
+    }
+}
+
 //-----------------------------------------------------------------------------
 void DrawTexturedSquare( GLuint a_TextureId, float a_Size, float a_X, float a_Y )
 {
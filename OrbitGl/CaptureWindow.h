@@ -46,6 +46,7 @@ public:
     void RenderHelpUi();
     void RenderThreadFilterUi();
     void RenderMemTracker();
+    void RenderDurationHistogram();
     void RenderBar();
     void RenderTimeBar();
     void OnTimerAdded( Timer & a_Timer );
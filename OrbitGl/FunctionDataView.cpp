@@ -220,90 +220,52 @@ void FunctionsDataView::OnContextMenu( const std::wstring& a_Action, int a_MenuI
 //-----------------------------------------------------------------------------
 void FunctionsDataView::OnFilter( const std::wstring & a_Filter )
 {
-    m_FilterTokens = Tokenize( ToLower( a_Filter ) );
-
-#ifdef WIN32
     ParallelFilter();
-#else
-    // TODO: port parallel filtering
-    std::vector<uint32_t> indices;
-    std::vector< std::wstring > tokens = Tokenize( ToLower( a_Filter ) );
-    std::vector<Function*> & functions = Capture::GTargetProcess->GetFunctions();
-    for (int i = 0; i < (int)functions.size(); ++i)
-    {
-        Function* function = functions[i];
-        std::wstring name = function->Lower() + function->m_Pdb->GetName();
-
-        bool match = true;
-
-        for( std::wstring & filterToken : tokens )
-        {
-            if ( name.find(filterToken) == std::string::npos )
-            {
-                match = false;
-                break;
-            }
-        }
-
-        if (match)
-        {
-            indices.push_back(i);
-        }
-    }
 
-    m_Indices = indices;
-    
     if( m_LastSortedColumn != -1 )
     {
         OnSort(m_LastSortedColumn, false);
     }
-#endif
 }
 
 //-----------------------------------------------------------------------------
-void FunctionsDataView::ParallelFilter()
+void FunctionsDataView::UpdateNameFilter()
 {
-#ifdef _WIN32
     std::vector<Function*> & functions = Capture::GTargetProcess->GetFunctions();
-    const auto prio = oqpi::task_priority::normal;
-    auto numWorkers = oqpi_tk::scheduler().workersCount( prio );
-    //int numWorkers = oqpi::thread::hardware_concurrency();
-    std::vector< std::vector<int> > indicesArray;
-    indicesArray.resize( numWorkers );
 
-    oqpi_tk::parallel_for( "FunctionsDataViewParallelFor", (int)functions.size(), [&]( int32_t a_BlockIndex, int32_t a_ElementIndex )
+    // Functions are only appended while modules load, anything else is a new list.
+    Function* firstFunction = functions.empty() ? nullptr : functions[0];
+    if( functions.size() < m_NameFilter.Size() || firstFunction != m_FirstFilteredFunction )
     {
-        std::vector<int> & result = indicesArray[a_BlockIndex];
-        const std::wstring & name = functions[a_ElementIndex]->Lower();
-        const std::wstring & file = functions[a_ElementIndex]->m_File;
+        m_NameFilter.Clear();
+        m_FirstFilteredFunction = firstFunction;
+    }
 
-        for( std::wstring & filterToken : m_FilterTokens )
+    m_NameFilter.Reserve( functions.size(), 0 );
+    for( size_t i = m_NameFilter.Size(); i < functions.size(); ++i )
+    {
+        Function* function = functions[i];
+        Pdb* pdb = function->m_Pdb;
+        m_NameFilter.AddField( function->m_PrettyName );
+        m_NameFilter.AddField( function->m_File );
+        if( pdb )
         {
-            if( name.find( filterToken ) == std::wstring::npos &&
-                file.find( filterToken ) == std::wstring::npos )
-            {
-                return;
-            }
+            m_NameFilter.AddField( pdb->GetName() );
+            m_NameFilter.EndEntry( pdb->GetSymbolIndex().GetFunctionIndex(), SymbolIndex::GetEntry( pdb->GetFunctions(), function ) );
         }
-        
-        result.push_back( a_ElementIndex );
-    } );
-    
-    std::set< int > indicesSet;
-    for( std::vector<int> & results : indicesArray )
-    {
-        for( int index : results )
+        else
         {
-            indicesSet.insert( index );
+            m_NameFilter.EndEntry();
         }
     }
+}
 
-    m_Indices.clear();
-    for( int i : indicesSet )
-    {
-        m_Indices.push_back( i );
-    }
-#endif
+//-----------------------------------------------------------------------------
+void FunctionsDataView::ParallelFilter()
+{
+    ScopeLock lock( Capture::GTargetProcess->GetDataMutex() );
+    UpdateNameFilter();
+    m_NameFilter.Filter( m_Filter, m_Indices );
 }
 
 //-----------------------------------------------------------------------------
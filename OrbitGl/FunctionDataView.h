@@ -5,6 +5,7 @@
 
 #include "OrbitType.h"
 #include "DataView.h"
+#include "NameFilter.h"
 
 class FunctionsDataView : public DataView
 {
@@ -26,8 +27,10 @@ public:
 
 protected:
     virtual Function & GetFunction( unsigned int a_Row );
+    void UpdateNameFilter();
 
-    std::vector< std::wstring > m_FilterTokens;
+    NameFilter                  m_NameFilter;
+    Function*                   m_FirstFilteredFunction = nullptr;
     static std::vector<int>     s_HeaderMap;
     static std::vector<float>   s_HeaderRatios;
 };
@@ -173,8 +173,6 @@ void GlobalsDataView::OnAddToWatch( std::vector<int> & a_Items )
 //-----------------------------------------------------------------------------
 void GlobalsDataView::OnFilter( const std::wstring & a_Filter )
 {
-    m_FilterTokens = Tokenize( ToLower( a_Filter ) );
-
     ParallelFilter();
 
     if( m_LastSortedColumn != -1 )
@@ -184,46 +182,43 @@ void GlobalsDataView::OnFilter( const std::wstring & a_Filter )
 }
 
 //-----------------------------------------------------------------------------
-void GlobalsDataView::ParallelFilter()
+void GlobalsDataView::UpdateNameFilter()
 {
-#ifdef _WIN32
-    const std::vector<Variable*> & globals = Capture::GTargetProcess->GetGlobals();
-    const auto prio = oqpi::task_priority::normal;
-    auto numWorkers = oqpi_tk::scheduler().workersCount( prio );
-    std::vector< std::vector<int> > indicesArray;
-    indicesArray.resize( numWorkers );
-
-    oqpi_tk::parallel_for( "FunctionsDataViewParallelFor", (int)globals.size(), [&]( int32_t a_BlockIndex, int32_t a_ElementIndex )
+    std::vector<Variable*> & globals = Capture::GTargetProcess->GetGlobals();
+
+    // Globals are only appended while modules load, anything else is a new list.
+    Variable* firstGlobal = globals.empty() ? nullptr : globals[0];
+    if( globals.size() < m_NameFilter.Size() || firstGlobal != m_FirstFilteredGlobal )
     {
-        std::vector<int> & result = indicesArray[a_BlockIndex];
-        const std::wstring & name = globals[a_ElementIndex]->FilterString();
+        m_NameFilter.Clear();
+        m_FirstFilteredGlobal = firstGlobal;
+    }
 
-        for( std::wstring & filterToken : m_FilterTokens )
+    m_NameFilter.Reserve( globals.size(), 0 );
+    for( size_t i = m_NameFilter.Size(); i < globals.size(); ++i )
+    {
+        Variable* global = globals[i];
+        Pdb* pdb = global->m_Pdb;
+        m_NameFilter.AddField( global->m_Name );
+        m_NameFilter.AddField( global->m_File );
+        m_NameFilter.AddField( global->m_Type );
+        if( pdb )
         {
-            if( name.find( filterToken ) == std::wstring::npos )
-            {
-                return;
-            }
+            m_NameFilter.EndEntry( pdb->GetSymbolIndex().GetGlobalIndex(), SymbolIndex::GetEntry( pdb->GetGlobals(), global ) );
         }
-
-        result.push_back( a_ElementIndex );
-    } );
-
-    std::set< int > indicesSet;
-    for( std::vector<int> & results : indicesArray )
-    {
-        for( int index : results )
+        else
         {
-            indicesSet.insert( index );
+            m_NameFilter.EndEntry();
         }
     }
+}
 
-    m_Indices.clear();
-    for( int i : indicesSet )
-    {
-        m_Indices.push_back( i );
-    }
-#endif
+//-----------------------------------------------------------------------------
+void GlobalsDataView::ParallelFilter()
+{
+    ScopeLock lock( Capture::GTargetProcess->GetDataMutex() );
+    UpdateNameFilter();
+    m_NameFilter.Filter( m_Filter, m_Indices );
 }
 
 //-----------------------------------------------------------------------------
@@ -5,6 +5,7 @@
 
 #include "OrbitType.h"
 #include "DataView.h"
+#include "NameFilter.h"
 
 class GlobalsDataView : public DataView
 {
@@ -25,7 +26,10 @@ public:
 
 protected:
     Variable & GetVariable(unsigned int a_Row) const;
-    std::vector< std::wstring > m_FilterTokens;
+    void UpdateNameFilter();
+
+    NameFilter                  m_NameFilter;
+    Variable*                   m_FirstFilteredGlobal = nullptr;
     static std::vector<int>     s_HeaderMap;
     static std::vector<float>   s_HeaderRatios;
 };
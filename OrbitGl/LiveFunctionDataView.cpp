@@ -10,6 +10,8 @@
 #include "App.h"
 #include "Pdb.h"
 #include "FunctionStats.h"
+#include "HookOverhead.h"
+#include "TimeGraph.h"
 
 //-----------------------------------------------------------------------------
 namespace LiveFunction
@@ -23,6 +25,12 @@ namespace LiveFunction
         TIME_AVG,
         TIME_MIN,
         TIME_MAX,
+        TIME_P50,
+        TIME_P90,
+        TIME_P99,
+        TIME_P999,
+        EVENT_RATE,
+        OVERHEAD,
         ADDRESS,
         MODULE,
         INDEX,
@@ -30,6 +38,19 @@ namespace LiveFunction
     };
 }
 
+//-----------------------------------------------------------------------------
+static double GetColumnPercentile( int a_Column )
+{
+    switch( a_Column )
+    {
+    case LiveFunction::TIME_P50:  return 50.0;
+    case LiveFunction::TIME_P90:  return 90.0;
+    case LiveFunction::TIME_P99:  return 99.0;
+    case LiveFunction::TIME_P999: return 99.9;
+    default:                      return 0;
+    }
+}
+
 //-----------------------------------------------------------------------------
 LiveFunctionsDataView::LiveFunctionsDataView()
 {
@@ -60,6 +81,12 @@ const std::vector<std::wstring>& LiveFunctionsDataView::GetColumnHeaders()
         Columns.push_back(L"Avg");      s_HeaderMap.push_back(LiveFunction::TIME_AVG);  s_HeaderRatios.push_back(0);
         Columns.push_back(L"Min");      s_HeaderMap.push_back(LiveFunction::TIME_MIN);  s_HeaderRatios.push_back(0);
         Columns.push_back(L"Max");      s_HeaderMap.push_back(LiveFunction::TIME_MAX);  s_HeaderRatios.push_back(0);
+        Columns.push_back(L"P50");      s_HeaderMap.push_back(LiveFunction::TIME_P50);  s_HeaderRatios.push_back(0);
+        Columns.push_back(L"P90");      s_HeaderMap.push_back(LiveFunction::TIME_P90);  s_HeaderRatios.push_back(0);
+        Columns.push_back(L"P99");      s_HeaderMap.push_back(LiveFunction::TIME_P99);  s_HeaderRatios.push_back(0);
+        Columns.push_back(L"P99.9");    s_HeaderMap.push_back(LiveFunction::TIME_P999); s_HeaderRatios.push_back(0);
+        Columns.push_back(L"Events/s"); s_HeaderMap.push_back(LiveFunction::EVENT_RATE);s_HeaderRatios.push_back(0);
+        Columns.push_back(L"Est. Overhead"); s_HeaderMap.push_back(LiveFunction::OVERHEAD);  s_HeaderRatios.push_back(0);
         Columns.push_back(L"Module");   s_HeaderMap.push_back(LiveFunction::MODULE);    s_HeaderRatios.push_back(0);
         Columns.push_back(L"Address");  s_HeaderMap.push_back(LiveFunction::ADDRESS);   s_HeaderRatios.push_back(0);
     }
@@ -83,6 +110,7 @@ std::wstring LiveFunctionsDataView::GetValue( int a_Row, int a_Column )
 
     Function & function = GetFunction( a_Row );
     std::shared_ptr<FunctionStats> stats = function.m_Stats;
+    const HookOverhead::Rate* rate = GHookOverhead.GetRate( function.GetVirtualAddress() );
 
     std::wstring value;
     
@@ -99,11 +127,22 @@ std::wstring LiveFunctionsDataView::GetValue( int a_Row, int a_Column )
     case LiveFunction::TIME_TOTAL:
         value = GetPrettyTimeW(stats->m_TotalTimeMs); break;
     case LiveFunction::TIME_AVG:
-        value = GetPrettyTimeW(stats->m_AverageTimeMs); break;
+        value = GetPrettyTimeW(stats->GetAverageTimeMs()); break;
     case LiveFunction::TIME_MIN:
         value = GetPrettyTimeW(stats->m_MinMs); break;
     case LiveFunction::TIME_MAX:
         value = GetPrettyTimeW(stats->m_MaxMs); break;
+    case LiveFunction::TIME_P50:
+    case LiveFunction::TIME_P90:
+    case LiveFunction::TIME_P99:
+    case LiveFunction::TIME_P999:
+        value = GetPrettyTimeW(stats->GetPercentileMs(GetColumnPercentile(s_HeaderMap[a_Column]))); break;
+    case LiveFunction::EVENT_RATE:
+        value = rate ? Format( L"%.0f", rate->m_EventsPerSecond ) : L""; break;
+    case LiveFunction::OVERHEAD:
+        if( rate )
+            value = rate->m_Unhooked ? L"unhooked" : Format( L"~%.1f%%", rate->m_OverheadPercent );
+        break;
     case LiveFunction::ADDRESS:
         value = function.m_Pdb ? Format(L"0x%llx", function.m_Address + (DWORD64)function.m_Pdb->GetHModule()) : L""; break;
     case LiveFunction::MODULE:
@@ -131,15 +170,40 @@ void LiveFunctionsDataView::OnSort( int a_Column, bool a_Toggle )
 
     bool ascending = m_SortingToggles[MemberID];
     std::function<bool(int a, int b)> sorter = nullptr;
+    std::vector<double> percentiles;
 
     switch (MemberID)
     {
     case LiveFunction::NAME:     sorter = ORBIT_FUNC_SORT( m_PrettyName );     break;
     case LiveFunction::COUNT: ascending = false; sorter = ORBIT_STAT_SORT( m_Count ); break;
     case LiveFunction::TIME_TOTAL: sorter = ORBIT_STAT_SORT( m_TotalTimeMs );  break;
-    case LiveFunction::TIME_AVG: sorter = ORBIT_STAT_SORT( m_AverageTimeMs );  break;
+    case LiveFunction::TIME_AVG: sorter = ORBIT_STAT_SORT( GetAverageTimeMs() ); break;
     case LiveFunction::TIME_MIN: sorter = ORBIT_STAT_SORT( m_MinMs );          break;
     case LiveFunction::TIME_MAX: sorter = ORBIT_STAT_SORT( m_MaxMs );          break;
+    case LiveFunction::TIME_P50:
+    case LiveFunction::TIME_P90:
+    case LiveFunction::TIME_P99:
+    case LiveFunction::TIME_P999:
+    {
+        // Percentiles walk the histogram, compute them once per sort.
+        double percentile = GetColumnPercentile( MemberID );
+        percentiles.resize( functions.size() );
+        for( size_t i = 0; i < functions.size(); ++i )
+        {
+            percentiles[i] = functions[i] ? functions[i]->m_Stats->GetPercentileMs( percentile ) : 0;
+        }
+        sorter = [&](int a, int b) { return OrbitUtils::Compare( percentiles[a], percentiles[b], ascending ); };
+        break;
+    }
+    case LiveFunction::EVENT_RATE:
+    case LiveFunction::OVERHEAD:
+        sorter = [&](int a, int b)
+        {
+            const HookOverhead::Rate* rateA = GHookOverhead.GetRate( functions[a]->GetVirtualAddress() );
+            const HookOverhead::Rate* rateB = GHookOverhead.GetRate( functions[b]->GetVirtualAddress() );
+            return OrbitUtils::Compare( rateA ? rateA->m_EventsPerSecond : 0, rateB ? rateB->m_EventsPerSecond : 0, ascending );
+        };
+        break;
     case LiveFunction::ADDRESS:  sorter = ORBIT_FUNC_SORT( m_Address );        break;
     case LiveFunction::MODULE:   sorter = ORBIT_FUNC_SORT( m_Pdb->GetName() ); break;
     case LiveFunction::SELECTED: sorter = ORBIT_FUNC_SORT( IsSelected() );     break;
@@ -156,11 +220,12 @@ void LiveFunctionsDataView::OnSort( int a_Column, bool a_Toggle )
 
 //-----------------------------------------------------------------------------
 std::wstring TOGGLE_SELECT = L"Toggle Select";
+std::wstring SHOW_DURATION_HISTOGRAM = L"Duration Histogram";
 
 //-----------------------------------------------------------------------------
 std::vector<std::wstring> LiveFunctionsDataView::GetContextMenu(int a_Index)
 {
-    std::vector<std::wstring> menu = { TOGGLE_SELECT };
+    std::vector<std::wstring> menu = { TOGGLE_SELECT, SHOW_DURATION_HISTOGRAM };
     Append( menu, DataView::GetContextMenu(a_Index) );
     return menu;
 }
@@ -176,6 +241,14 @@ void LiveFunctionsDataView::OnContextMenu( const std::wstring & a_Action, int a_
             func.ToggleSelect();
         }
     }
+    else if( a_Action == SHOW_DURATION_HISTOGRAM )
+    {
+        if( a_ItemIndices.size() && GCurrentTimeGraph )
+        {
+            GCurrentTimeGraph->SetHistogramFunction( GetFunction( a_ItemIndices[0] ).GetVirtualAddress() );
+            GOrbitApp->NeedsRedraw();
+        }
+    }
     else
     {
         DataView::OnContextMenu( a_Action, a_MenuIndex, a_ItemIndices );
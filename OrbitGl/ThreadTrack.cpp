@@ -2,6 +2,8 @@
 #include "TimeGraph.h"
 #include "EventTrack.h"
 #include "GlCanvas.h"
+#include "Capture.h"
+#include "CaptureFile.h"
 #include <limits>
 
 //-----------------------------------------------------------------------------
@@ -52,13 +54,14 @@ void ThreadTrack::OnTimer( const Timer& a_Timer )
     TextBox textBox( Vec2(0, 0), Vec2(0, 0), "", m_TextRenderer, Color( 255, 0, 0, 255) );
     textBox.SetTimer( a_Timer );
 
-    std::shared_ptr<TimerChain> timerChain = m_Timers[a_Timer.m_Depth];
+    ScopeLock lock( m_Mutex );
+    std::shared_ptr<TimerChain> & timerChain = m_Timers[a_Timer.m_Depth];
     if (timerChain == nullptr) 
     {
         timerChain = std::make_shared<TimerChain>();
-        m_Timers[a_Timer.m_Depth] = timerChain;
     }
     timerChain->push_back(textBox);
+
     ++m_NumTimers;
     if (a_Timer.m_Start < m_MinTime)
         m_MinTime = a_Timer.m_Start;
@@ -66,6 +69,73 @@ void ThreadTrack::OnTimer( const Timer& a_Timer )
         m_MaxTime = a_Timer.m_End;
 }
 
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnTimerChunk( uint32_t a_ChunkIndex, const CaptureChunk & a_Chunk )
+{
+    UpdateDepth( a_Chunk.m_MaxDepth + 1 );
+
+    ScopeLock lock( m_Mutex );
+    m_TimerChunks.push_back( a_ChunkIndex );
+
+    m_NumTimers += (uint32_t)a_Chunk.m_NumItems;
+    if( a_Chunk.m_MinTime < m_MinTime )
+        m_MinTime = a_Chunk.m_MinTime;
+    if( a_Chunk.m_MaxTime > m_MaxTime )
+        m_MaxTime = a_Chunk.m_MaxTime;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint32_t> ThreadTrack::GetTimerChunks() const
+{
+    ScopeLock lock( m_Mutex );
+    return m_TimerChunks;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t ThreadTrack::EvictTimers( TickType a_MaxEnd )
+{
+    uint32_t numEvicted = 0;
+
+    ScopeLock lock( m_Mutex );
+    for( auto & pair : m_Timers )
+    {
+        std::shared_ptr<TimerChain> & timerChain = pair.second;
+
+        // Chains are rebuilt rather than modified in place, a copy handed
+        // out by GetTimers stays valid.  The selection follows its box into
+        // the new chain.
+        std::shared_ptr<TimerChain> kept = std::make_shared<TimerChain>();
+        uint32_t numEvictedFromChain = 0;
+        TextBox* selected = nullptr;
+        for( TextBox & textBox : *timerChain )
+        {
+            if( textBox.GetTimer().m_End > a_MaxEnd )
+            {
+                kept->push_back( textBox );
+                if( Capture::GSelectedTextBox == &textBox )
+                    selected = &kept->m_Current->m_Data[kept->m_Current->m_Size - 1];
+            }
+            else
+            {
+                if( Capture::GSelectedTextBox == &textBox )
+                    Capture::GSelectedTextBox = nullptr;
+                ++numEvictedFromChain;
+            }
+        }
+
+        if( numEvictedFromChain > 0 )
+        {
+            if( selected )
+                Capture::GSelectedTextBox = selected;
+            timerChain = kept;
+            numEvicted += numEvictedFromChain;
+        }
+    }
+
+    m_NumTimers -= numEvicted;
+    return numEvicted;
+}
+
 //-----------------------------------------------------------------------------
 float ThreadTrack::GetHeight() const
 {
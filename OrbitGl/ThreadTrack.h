@@ -27,6 +27,7 @@ public:
     void Draw( GlCanvas* a_Canvas, bool a_Picking ) override;
     void OnDrag( int a_X, int a_Y ) override;
     void OnTimer( const Timer& a_Timer );
+    void OnTimerChunk( uint32_t a_ChunkIndex, const struct CaptureChunk & a_Chunk );
 
     // Track
     float GetHeight() const override;
@@ -51,6 +52,13 @@ public:
 
     std::vector< std::shared_ptr<TimerChain> > GetAllChains() const;
 
+    // Timer chunks of a lazily loaded capture, see TimerChunkCache.
+    std::vector<uint32_t> GetTimerChunks() const;
+
+    // Drops in memory timers ending at or before a_MaxEnd, once they are
+    // available from timer chunks.  Returns the number of timers dropped.
+    uint32_t EvictTimers( TickType a_MaxEnd );
+
 protected:
     inline void UpdateDepth( uint32_t a_Depth ) { if(a_Depth > m_Depth) m_Depth = a_Depth; }
     std::shared_ptr<TimerChain> GetTimers(uint32_t a_Depth) const;
@@ -67,4 +75,5 @@ protected:
     mutable Mutex               m_Mutex;
 
     std::map<int, std::shared_ptr<TimerChain>> m_Timers;
+    std::vector<uint32_t>                      m_TimerChunks;
 };
\ No newline at end of file
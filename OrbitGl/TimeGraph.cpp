@@ -20,7 +20,10 @@
 #include "App.h"
 #include "OrbitUnreal.h"
 #include "TimerManager.h"
+#include "TcpServer.h"
 #include "ThreadTrack.h"
+#include "TimerChunkCache.h"
+#include "CaptureFile.h"
 #include "OrbitCore/Systrace.h"
 #include <algorithm>
 
@@ -60,9 +63,15 @@ void TimeGraph::Clear()
     m_ThreadCountMap.clear();
     GEventTracer.GetEventBuffer().Reset();
     m_MemTracker.Clear();
+    m_CoreUtilization.Clear();
+    m_DurationIndex.Clear();
     m_Layout.Reset();
+    m_TimerChunkCache = nullptr;
+    m_NumStreamedChunks = 0;
+    m_StreamedUntil.clear();
 
     ScopeLock lock(m_Mutex);
+    m_PendingStreamReader = nullptr;
     m_ThreadTracks.clear();
 }
 
@@ -89,6 +98,11 @@ bool TimeGraph::UpdateSessionMinMaxCounter()
     }
     m_Mutex.unlock();
 
+    if( !m_CoreUtilization.IsEmpty() )
+    {
+        m_SessionMinCounter = std::min( m_SessionMinCounter, m_CoreUtilization.GetMinTime() );
+    }
+
     if( GEventTracer.GetEventBuffer().HasEvent() )
     {
         m_SessionMinCounter = std::min( (long long)m_SessionMinCounter, GEventTracer.GetEventBuffer().GetMinTime() );
@@ -117,9 +131,14 @@ void TimeGraph::ZoomAll()
 void TimeGraph::Zoom( const TextBox* a_TextBox )
 {
     const Timer& timer = a_TextBox->GetTimer();
+    Zoom( timer.m_Start, timer.m_End );
+}
 
-    double start = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_Start);
-    double end   = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_End);
+//-----------------------------------------------------------------------------
+void TimeGraph::Zoom( TickType a_Start, TickType a_End )
+{
+    double start = MicroSecondsFromTicks(m_SessionMinCounter, a_Start);
+    double end   = MicroSecondsFromTicks(m_SessionMinCounter, a_End);
 
     double mid = start+((end-start)/2.0);
     double extent = 1.1*(end-start)/2.0;
@@ -225,20 +244,8 @@ void TimeGraph::ProcessTimer( const Timer & a_Timer )
         m_SessionMaxCounter = a_Timer.m_End;
     }
 
-    switch( a_Timer.m_Type )
-    {
-    case Timer::ALLOC:
-        m_MemTracker.ProcessAlloc( a_Timer );
+    if( ProcessUntrackedTimer( a_Timer ) )
         return;
-    case Timer::FREE:
-        m_MemTracker.ProcessFree( a_Timer );
-        return;
-    case Timer::CORE_ACTIVITY:
-        Capture::GHasContextSwitches = true;
-        break;
-    default:
-        break;
-    }
 
     if( a_Timer.m_FunctionAddress > 0 )
     {
@@ -253,10 +260,175 @@ void TimeGraph::ProcessTimer( const Timer & a_Timer )
         }
     }
 
-    if( !a_Timer.IsType( Timer::THREAD_ACTIVITY ) && !a_Timer.IsType( Timer::CORE_ACTIVITY ) )
+    if( !a_Timer.IsType( Timer::THREAD_ACTIVITY ) )
     {
         GetThreadTrack(a_Timer.m_TID)->OnTimer(a_Timer);
         ++m_ThreadCountMap[a_Timer.m_TID];
+        m_DurationIndex.Add( a_Timer );
+    }
+}
+
+//-----------------------------------------------------------------------------
+static bool IsUntrackedTimer( const Timer & a_Timer )
+{
+    return a_Timer.IsType( Timer::ALLOC ) || a_Timer.IsType( Timer::FREE ) || a_Timer.IsType( Timer::CORE_ACTIVITY );
+}
+
+//-----------------------------------------------------------------------------
+bool TimeGraph::ProcessUntrackedTimer( const Timer & a_Timer )
+{
+    // Memory events and core activity are not drawn on thread tracks.
+    switch( a_Timer.m_Type )
+    {
+    case Timer::ALLOC:
+        Capture::GHasMemoryEvents = true;
+        m_MemTracker.ProcessAlloc( a_Timer );
+        return true;
+    case Timer::FREE:
+        m_MemTracker.ProcessFree( a_Timer );
+        return true;
+    case Timer::CORE_ACTIVITY:
+        Capture::GHasContextSwitches = true;
+        m_CoreUtilization.AddInterval( (uint8_t)a_Timer.m_Processor, a_Timer.m_Start, a_Timer.m_End, a_Timer.m_TID );
+        return true;
+    default:
+        return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ProcessTimerChunk( uint32_t a_ChunkIndex, const CaptureChunk & a_Chunk )
+{
+    GetThreadTrack( a_Chunk.m_ThreadId )->OnTimerChunk( a_ChunkIndex, a_Chunk );
+
+    ScopeLock lock( m_Mutex );
+    m_ThreadCountMap[a_Chunk.m_ThreadId] += (uint32_t)a_Chunk.m_NumItems;
+    if( a_Chunk.m_MaxTime > m_SessionMaxCounter )
+    {
+        m_SessionMaxCounter = a_Chunk.m_MaxTime;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::OnStreamCheckpoint( const std::shared_ptr<CaptureFileReader> & a_Reader )
+{
+    // Called from the capture stream writer thread, applied between frames.
+    ScopeLock lock( m_Mutex );
+    m_PendingStreamReader = a_Reader;
+    NeedsUpdate();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ApplyStreamCheckpoint()
+{
+    std::shared_ptr<CaptureFileReader> reader;
+    {
+        ScopeLock lock( m_Mutex );
+        reader.swap( m_PendingStreamReader );
+    }
+
+    if( reader == nullptr )
+        return;
+
+    const std::vector<CaptureChunk> & chunks = reader->GetChunks();
+    if( !m_TimerChunkCache )
+    {
+        // Captures that would load in memory stay in memory.
+        uint64_t timerDataSize = 0;
+        for( const CaptureChunk & chunk : chunks )
+        {
+            if( chunk.m_Type == CaptureChunk::TIMERS )
+                timerDataSize += chunk.m_NumItems*sizeof( Timer );
+        }
+
+        if( timerDataSize <= TimerChunkCache::LazyLoadThreshold )
+            return;
+
+        m_TimerChunkCache = std::make_shared<TimerChunkCache>( reader, m_TextRenderer, TimerChunkCache::DefaultMaxBytes );
+        m_NumStreamedChunks = 0;
+    }
+    else
+    {
+        m_TimerChunkCache->SetReader( reader );
+    }
+
+    // Timers of a thread arrive and are streamed in the order they end, the
+    // ones ending before the last streamed chunk of their thread are on disk.
+    std::unordered_map<ThreadID, TickType> streamedUntil;
+    for( uint32_t i = m_NumStreamedChunks; i < (uint32_t)chunks.size(); ++i )
+    {
+        const CaptureChunk & chunk = chunks[i];
+        if( chunk.m_Type != CaptureChunk::TIMERS )
+            continue;
+
+        ProcessTimerChunk( i, chunk );
+        TickType & maxEnd = streamedUntil[chunk.m_ThreadId];
+        maxEnd = std::max( maxEnd, chunk.m_MaxTime );
+    }
+    m_NumStreamedChunks = (uint32_t)chunks.size();
+
+    for( auto & pair : streamedUntil )
+    {
+        uint32_t numEvicted = GetThreadTrack( pair.first )->EvictTimers( pair.second );
+        m_StreamedUntil[pair.first] = pair.second;
+
+        ScopeLock lock( m_Mutex );
+        m_ThreadCountMap[pair.first] -= numEvicted;
+    }
+
+    // Instances that ended before every streamed thread's horizon have been
+    // evicted, the histogram can't jump to them anymore.
+    TickType horizon = ~TickType( 0 );
+    for( auto & pair : m_StreamedUntil )
+    {
+        horizon = std::min( horizon, pair.second );
+    }
+    if( !m_StreamedUntil.empty() )
+    {
+        m_DurationIndex.RemoveEndingBefore( horizon );
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ProcessThreadTimers( ThreadID a_TID, const std::vector<Timer> & a_Timers, std::unordered_map<DWORD64, FunctionStats> & o_FunctionStats )
+{
+    // Timers of a single thread, as saved in capture files, routed like in
+    // ProcessTimer.  Can be called concurrently for different threads, only
+    // the few timers that are not on the thread track take the lock.  Stats
+    // go to the caller's map, they are merged into the functions once all
+    // threads are done.
+    std::shared_ptr<ThreadTrack> track = GetThreadTrack( a_TID );
+    TickType maxTime = 0;
+    uint32_t numTrackTimers = 0;
+    for( const Timer & timer : a_Timers )
+    {
+        maxTime = std::max( maxTime, timer.m_End );
+
+        if( IsUntrackedTimer( timer ) )
+        {
+            ScopeLock lock( m_Mutex );
+            ProcessUntrackedTimer( timer );
+            continue;
+        }
+
+        if( timer.m_FunctionAddress > 0 )
+        {
+            o_FunctionStats[timer.m_FunctionAddress].Update( timer );
+        }
+
+        if( !timer.IsType( Timer::THREAD_ACTIVITY ) )
+        {
+            track->OnTimer( timer );
+            m_DurationIndex.Add( timer );
+            ++numTrackTimers;
+        }
+    }
+
+    ScopeLock lock( m_Mutex );
+    m_ThreadCountMap[a_TID] += numTrackTimers;
+    if( maxTime > m_SessionMaxCounter )
+    {
+        m_SessionMaxCounter = maxTime;
     }
 }
 
@@ -288,61 +460,11 @@ std::vector< std::shared_ptr<TimerChain> > TimeGraph::GetAllTimerChains() const
 //-----------------------------------------------------------------------------
 void TimeGraph::AddContextSwitch( const ContextSwitch & a_CS )
 {
-    auto pair = std::make_pair(a_CS.m_Time, a_CS);
-
-    if( a_CS.m_Type == ContextSwitch::Out )
-    {
-
-        if( true )
-        {
-            // Processor time line
-            std::map< long long, ContextSwitch > & csMap = m_CoreUtilizationMap[a_CS.m_ProcessorIndex];
-
-            if( csMap.rbegin() != csMap.rend() )
-            {
-                ContextSwitch & lastCS = csMap.rbegin()->second;
-                if( lastCS.m_Type == ContextSwitch::In )
-                {
-                    Timer timer;
-                    timer.m_Start = lastCS.m_Time;
-                    timer.m_End = a_CS.m_Time;
-                    timer.m_TID = a_CS.m_ThreadId;
-                    timer.m_Processor = (int8_t)a_CS.m_ProcessorIndex;
-                    timer.m_SessionID = Message::GSessionID;
-                    timer.SetType(Timer::CORE_ACTIVITY);
-                
-                    GTimerManager->Add(timer);
-                }
-            }
-        }
-
-        if( false )
-        {
-            // Thread time line
-            std::map< long long, ContextSwitch > & csMap = m_ContextSwitchesMap[a_CS.m_ThreadId];
-
-            if( csMap.rbegin() != csMap.rend() )
-            {
-                ContextSwitch & lastCS = csMap.rbegin()->second;
-                if( lastCS.m_Type == ContextSwitch::In )
-                {
-                    Timer timer;
-                    timer.m_Start = lastCS.m_Time;
-                    timer.m_End = a_CS.m_Time;
-                    timer.m_TID = a_CS.m_ThreadId;
-                    timer.m_SessionID = Message::GSessionID;
-                    timer.SetType(Timer::THREAD_ACTIVITY);
-
-                    GTimerManager->Add( timer );
-                }
-            }
-        }
-    }
-
-    // TODO: if events are already sorted by timestamp, then
-    //       we don't need to use maps. To investigate...
-    m_ContextSwitchesMap[a_CS.m_ThreadId].insert( pair );
-    m_CoreUtilizationMap[a_CS.m_ProcessorIndex].insert( pair );
+    // Core activity is built in place, at high switch rates going through
+    // the timer pipeline would cost more than the switches themselves.
+    Capture::GHasContextSwitches = true;
+    m_CoreUtilization.Add( a_CS );
+    UpdateMaxTimeStamp( a_CS.m_Time );
 }
 
 //-----------------------------------------------------------------------------
@@ -489,6 +611,8 @@ inline std::string GetExtraInfo( const Timer & a_Timer )
 //-----------------------------------------------------------------------------
 void TimeGraph::UpdatePrimitives( bool a_Picking )
 {
+    ApplyStreamCheckpoint();
+
     m_Batcher.Reset();
     m_VisibleTextBoxes.clear();
     m_TextRendererStatic.Clear();
@@ -513,167 +637,344 @@ void TimeGraph::UpdatePrimitives( bool a_Picking )
 
     unsigned int TextBoxID = 0;
 
-    for (auto& pair : GetThreadTracksCopy())
+    auto updateTextBox = [&]( TextBox & textBox )
     {
-        std::shared_ptr<ThreadTrack>& threadTrack = pair.second;
-        
-        if (!m_Layout.IsThreadVisible(threadTrack->GetID()))
-            continue;
+        const Timer & timer = textBox.GetTimer();
 
-        std::vector<std::shared_ptr<TimerChain>> depthChain = threadTrack->GetTimers();
-        for (auto& textBoxes : depthChain)
+        if (!(rawStart > timer.m_End || rawStop < timer.m_Start))
         {
-            if (textBoxes == nullptr)
-                break;
+            double start = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_Start) - m_MinTimeUs;
+            double end = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_End) - m_MinTimeUs;
+            double elapsed = end - start;
 
-            for (TextBox & textBox : *textBoxes)
-            {
-                const Timer & timer = textBox.GetTimer();
+            double NormalizedStart = start * invTimeWindow;
+            double NormalizedLength = elapsed * invTimeWindow;
 
-                if (!(rawStart > timer.m_End || rawStop < timer.m_Start))
-                {
-                    double start = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_Start) - m_MinTimeUs;
-                    double end = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_End) - m_MinTimeUs;
-                    double elapsed = end - start;
+            bool isCore = timer.IsType(Timer::CORE_ACTIVITY);
 
-                    double NormalizedStart = start * invTimeWindow;
-                    double NormalizedLength = elapsed * invTimeWindow;
+            float threadOffset = !isCore ? m_Layout.GetThreadOffset(timer.m_TID, timer.m_Depth)
+                : m_Layout.GetCoreOffset(timer.m_Processor);
 
-                    bool isCore = timer.IsType(Timer::CORE_ACTIVITY);
+            float boxHeight = !isCore ? m_Layout.GetTextBoxHeight() : m_Layout.GetTextCoresHeight();
 
-                    float threadOffset = !isCore ? m_Layout.GetThreadOffset(timer.m_TID, timer.m_Depth)
-                        : m_Layout.GetCoreOffset(timer.m_Processor);
+            float WorldTimerStartX = float(m_WorldStartX + NormalizedStart * m_WorldWidth);
+            float WorldTimerWidth = float(NormalizedLength * m_WorldWidth);
 
-                    float boxHeight = !isCore ? m_Layout.GetTextBoxHeight() : m_Layout.GetTextCoresHeight();
+            Vec2 pos(WorldTimerStartX, threadOffset);
+            Vec2 size(WorldTimerWidth, boxHeight);
+
+            textBox.SetPos(pos);
+            textBox.SetSize(size);
+
+            if (!timer.IsType(Timer::CORE_ACTIVITY))
+            {
+                UpdateThreadDepth(timer.m_TID, timer.m_Depth + 1);
+            }
 
-                    float WorldTimerStartX = float(m_WorldStartX + NormalizedStart * m_WorldWidth);
-                    float WorldTimerWidth = float(NormalizedLength * m_WorldWidth);
+            bool isContextSwitch = timer.IsType(Timer::THREAD_ACTIVITY);
+            bool isCoreActivity = timer.IsType(Timer::CORE_ACTIVITY);
+            bool isVisibleWidth = NormalizedLength * m_Canvas->getWidth() > 1;
+            bool isSameThreadIdAsSelected = isCoreActivity && (timer.m_TID == Capture::GSelectedThreadId);
+            bool isInactive = (!isContextSwitch && timer.m_FunctionAddress && (Capture::GVisibleFunctionsMap.size() && Capture::GVisibleFunctionsMap[timer.m_FunctionAddress] == nullptr)) ||
+                (Capture::GSelectedThreadId != 0 && isCoreActivity && !isSameThreadIdAsSelected);
+            bool isSelected = &textBox == Capture::GSelectedTextBox;
+            bool isHighlighted = m_HighlightedBin >= 0 && timer.m_FunctionAddress == m_HistogramFunction &&
+                (int)FunctionDurationIndex::GetBin( (uint64_t)( elapsed * 1000.0 ) ) == m_HighlightedBin;
+
+
+            const unsigned char g = 100;
+            Color grey(g, g, g, 255);
+            static Color selectionColor(0, 128, 255, 255);
+            static Color highlightColor(255, 160, 0, 255);
+            Color col = GetThreadColor(timer.m_TID);
+            col = isSelected ? selectionColor : isHighlighted ? highlightColor : isSameThreadIdAsSelected ? col : isInactive ? grey : col;
+            textBox.SetColor(col[0], col[1], col[2]);
+            static int oddAlpha = 210;
+            if (!(timer.m_Depth & 0x1))
+            {
+                col[3] = oddAlpha;
+            }
 
-                    Vec2 pos(WorldTimerStartX, threadOffset);
-                    Vec2 size(WorldTimerWidth, boxHeight);
+            float z = isInactive ? GlCanvas::Z_VALUE_BOX_INACTIVE : GlCanvas::Z_VALUE_BOX_ACTIVE;
 
-                    textBox.SetPos(pos);
-                    textBox.SetSize(size);
+            if (isVisibleWidth)
+            {
+                Box box;
+                box.m_Vertices[0] = Vec3(pos[0], pos[1], z);
+                box.m_Vertices[1] = Vec3(pos[0], pos[1] + size[1], z);
+                box.m_Vertices[2] = Vec3(pos[0] + size[0], pos[1] + size[1], z);
+                box.m_Vertices[3] = Vec3(pos[0] + size[0], pos[1], z);
+                Color colors[4];
+                Fill(colors, col);
+
+                static float coeff = 0.94f;
+                Vec3 dark = Vec3(col[0], col[1], col[2]) * coeff;
+                colors[1] = Color((unsigned char)dark[0], (unsigned char)dark[1], (unsigned char)dark[2], (unsigned char)col[3]);
+                colors[0] = colors[1];
+                m_Batcher.AddBox(box, colors, PickingID::BOX, &textBox);
+
+                if (!isContextSwitch && textBox.GetText().size() == 0)
+                {
+                    double elapsedMillis = ((double)elapsed) * 0.001;
+                    std::string time = GetPrettyTime(elapsedMillis);
+                    Function* func = Capture::GSelectedFunctionsMap[timer.m_FunctionAddress];
 
-                    if (!timer.IsType(Timer::CORE_ACTIVITY))
+                    const char* name = nullptr;
+                    if (func)
                     {
-                        UpdateThreadDepth(timer.m_TID, timer.m_Depth + 1);
-                    }
+                        std::string extraInfo = GetExtraInfo(timer);
+                        name = func->PrettyNameStr().c_str();
+                        std::string text = Format("%s %s %s", name, extraInfo.c_str(), time.c_str());
 
-                    bool isContextSwitch = timer.IsType(Timer::THREAD_ACTIVITY);
-                    bool isCoreActivity = timer.IsType(Timer::CORE_ACTIVITY);
-                    bool isVisibleWidth = NormalizedLength * m_Canvas->getWidth() > 1;
-                    bool isSameThreadIdAsSelected = isCoreActivity && (timer.m_TID == Capture::GSelectedThreadId);
-                    bool isInactive = (!isContextSwitch && timer.m_FunctionAddress && (Capture::GVisibleFunctionsMap.size() && Capture::GVisibleFunctionsMap[timer.m_FunctionAddress] == nullptr)) ||
-                        (Capture::GSelectedThreadId != 0 && isCoreActivity && !isSameThreadIdAsSelected);
-                    bool isSelected = &textBox == Capture::GSelectedTextBox;
-
-
-                    const unsigned char g = 100;
-                    Color grey(g, g, g, 255);
-                    static Color selectionColor(0, 128, 255, 255);
-                    Color col = GetThreadColor(timer.m_TID);
-                    col = isSelected ? selectionColor : isSameThreadIdAsSelected ? col : isInactive ? grey : col;
-                    textBox.SetColor(col[0], col[1], col[2]);
-                    static int oddAlpha = 210;
-                    if (!(timer.m_Depth & 0x1))
+                        textBox.SetText(text);
+                    }
+                    else if (!SystraceManager::Get().IsEmpty())
                     {
-                        col[3] = oddAlpha;
+                        textBox.SetText(SystraceManager::Get().GetFunctionName(timer.m_FunctionAddress));
                     }
-
-                    float z = isInactive ? GlCanvas::Z_VALUE_BOX_INACTIVE : GlCanvas::Z_VALUE_BOX_ACTIVE;
-
-                    if (isVisibleWidth)
+                    else if (!Capture::IsCapturing())
                     {
-                        Box box;
-                        box.m_Vertices[0] = Vec3(pos[0], pos[1], z);
-                        box.m_Vertices[1] = Vec3(pos[0], pos[1] + size[1], z);
-                        box.m_Vertices[2] = Vec3(pos[0] + size[0], pos[1] + size[1], z);
-                        box.m_Vertices[3] = Vec3(pos[0] + size[0], pos[1], z);
-                        Color colors[4];
-                        Fill(colors, col);
-
-                        static float coeff = 0.94f;
-                        Vec3 dark = Vec3(col[0], col[1], col[2]) * coeff;
-                        colors[1] = Color((unsigned char)dark[0], (unsigned char)dark[1], (unsigned char)dark[2], (unsigned char)col[3]);
-                        colors[0] = colors[1];
-                        m_Batcher.AddBox(box, colors, PickingID::BOX, &textBox);
-
-                        if (!isContextSwitch && textBox.GetText().size() == 0)
+                        // GZoneNames is populated when capturing, prevent race
+                        // by accessing it only when not capturing.
+                        auto it = Capture::GZoneNames.find(timer.m_FunctionAddress);
+                        if (it != Capture::GZoneNames.end())
                         {
-                            double elapsedMillis = ((double)elapsed) * 0.001;
-                            std::string time = GetPrettyTime(elapsedMillis);
-                            Function* func = Capture::GSelectedFunctionsMap[timer.m_FunctionAddress];
-
-                            const char* name = nullptr;
-                            if (func)
-                            {
-                                std::string extraInfo = GetExtraInfo(timer);
-                                name = func->PrettyNameStr().c_str();
-                                std::string text = Format("%s %s %s", name, extraInfo.c_str(), time.c_str());
-
-                                textBox.SetText(text);
-                            }
-                            else if (!SystraceManager::Get().IsEmpty())
-                            {
-                                textBox.SetText(SystraceManager::Get().GetFunctionName(timer.m_FunctionAddress));
-                            }
-                            else if (!Capture::IsCapturing())
-                            {
-                                // GZoneNames is populated when capturing, prevent race
-                                // by accessing it only when not capturing.
-                                auto it = Capture::GZoneNames.find(timer.m_FunctionAddress);
-                                if (it != Capture::GZoneNames.end())
-                                {
-                                    name = it->second.c_str();
-                                    std::string text = Format("%s %s", name, time.c_str());
-                                    textBox.SetText(text);
-                                }
-                            }
-                        }
-
-                        if (!isCoreActivity)
-                        {
-                            //m_VisibleTextBoxes.push_back(&textBox);
-                            static Color s_Color(255, 255, 255, 255);
-
-                            const Vec2 & boxPos = textBox.GetPos();
-                            const Vec2 & boxSize = textBox.GetSize();
-                            float posX = std::max(boxPos[0], minX);
-                            float maxSize = boxPos[0] + boxSize[0] - posX;
-                            m_TextRendererStatic.AddText(textBox.GetText().c_str()
-                                , posX
-                                , textBox.GetPosY() + 1.f
-                                , GlCanvas::Z_VALUE_TEXT
-                                , s_Color
-                                , maxSize);
+                            name = it->second.c_str();
+                            std::string text = Format("%s %s", name, time.c_str());
+                            textBox.SetText(text);
                         }
                     }
-                    else
+                }
+
+                if (!isCoreActivity)
+                {
+                    //m_VisibleTextBoxes.push_back(&textBox);
+                    static Color s_Color(255, 255, 255, 255);
+
+                    const Vec2 & boxPos = textBox.GetPos();
+                    const Vec2 & boxSize = textBox.GetSize();
+                    float posX = std::max(boxPos[0], minX);
+                    float maxSize = boxPos[0] + boxSize[0] - posX;
+                    m_TextRendererStatic.AddText(textBox.GetText().c_str()
+                        , posX
+                        , textBox.GetPosY() + 1.f
+                        , GlCanvas::Z_VALUE_TEXT
+                        , s_Color
+                        , maxSize);
+                }
+            }
+            else
+            {
+                Line line;
+                line.m_Beg = Vec3(pos[0], pos[1], z);
+                line.m_End = Vec3(pos[0], pos[1] + size[1], z);
+                Color colors[2];
+                Fill(colors, col);
+                m_Batcher.AddLine(line, colors, PickingID::LINE, &textBox);
+            }
+        }
+
+        ++TextBoxID;
+    };
+
+    // Chunks of a lazily loaded capture are decoded progressively, a few per
+    // frame, and drawn as summary boxes until then.  When the visible chunks
+    // can't all fit in the cache, only the resident ones are drawn in detail
+    // and nothing more is decoded until the view changes.
+    const uint32_t maxChunksDecodedPerFrame = 8;
+    uint32_t numChunksDecoded = 0;
+    bool hasPendingChunks = false;
+    bool decodeChunks = false;
+    ThreadTrackMap threadTracks = GetThreadTracksCopy();
+    if( m_TimerChunkCache )
+    {
+        m_TimerChunkCache->Trim( Capture::GSelectedTextBox );
+
+        size_t visibleBytes = 0;
+        for( auto& pair : threadTracks )
+        {
+            if( !m_Layout.IsThreadVisible( pair.first ) )
+                continue;
+
+            for( uint32_t chunkIndex : pair.second->GetTimerChunks() )
+            {
+                const CaptureChunk & chunk = m_TimerChunkCache->GetChunk( chunkIndex );
+                if( rawStart <= chunk.m_MaxTime && rawStop >= chunk.m_MinTime )
+                    visibleBytes += chunk.m_NumItems*sizeof( TextBox );
+            }
+        }
+
+        decodeChunks = visibleBytes <= m_TimerChunkCache->GetMaxBytes();
+    }
+
+    for (auto& pair : threadTracks)
+    {
+        std::shared_ptr<ThreadTrack>& threadTrack = pair.second;
+        
+        if (!m_Layout.IsThreadVisible(threadTrack->GetID()))
+            continue;
+
+        std::vector<std::shared_ptr<TimerChain>> depthChain = threadTrack->GetTimers();
+        for (auto& textBoxes : depthChain)
+        {
+            if (textBoxes == nullptr)
+                break;
+
+            for (TextBox & textBox : *textBoxes)
+            {
+                updateTextBox( textBox );
+            }
+        }
+
+        if( !m_TimerChunkCache )
+            continue;
+
+        for( uint32_t chunkIndex : threadTrack->GetTimerChunks() )
+        {
+            const CaptureChunk & chunk = m_TimerChunkCache->GetChunk( chunkIndex );
+            if( rawStart > chunk.m_MaxTime || rawStop < chunk.m_MinTime )
+                continue;
+
+            bool canDecode = decodeChunks && !m_TimerChunkCache->IsFull() && numChunksDecoded < maxChunksDecodedPerFrame;
+            if( m_TimerChunkCache->IsResident( chunkIndex ) || canDecode )
+            {
+                numChunksDecoded += m_TimerChunkCache->IsResident( chunkIndex ) ? 0 : 1;
+                if( std::vector<TextBox>* chunkBoxes = m_TimerChunkCache->Get( chunkIndex ) )
+                {
+                    for( TextBox & textBox : *chunkBoxes )
                     {
-                        Line line;
-                        line.m_Beg = Vec3(pos[0], pos[1], z);
-                        line.m_End = Vec3(pos[0], pos[1] + size[1], z);
-                        Color colors[2];
-                        Fill(colors, col);
-                        m_Batcher.AddLine(line, colors, PickingID::LINE, &textBox);
+                        updateTextBox( textBox );
                     }
                 }
-
-                ++TextBoxID;
+                continue;
             }
+
+            // Only ask for another pass if the chunk can be decoded then.
+            hasPendingChunks |= decodeChunks && !m_TimerChunkCache->IsFull();
+
+            double start = MicroSecondsFromTicks( m_SessionMinCounter, chunk.m_MinTime ) - m_MinTimeUs;
+            double end = MicroSecondsFromTicks( m_SessionMinCounter, chunk.m_MaxTime ) - m_MinTimeUs;
+            float posX = float( m_WorldStartX + start * invTimeWindow * m_WorldWidth );
+            float width = float( ( end - start ) * invTimeWindow * m_WorldWidth );
+            float posY = m_Layout.GetThreadOffset( chunk.m_ThreadId, 0 );
+            float height = m_Layout.GetTextBoxHeight();
+            float z = GlCanvas::Z_VALUE_BOX_INACTIVE;
+
+            Box box;
+            box.m_Vertices[0] = Vec3( posX, posY, z );
+            box.m_Vertices[1] = Vec3( posX, posY + height, z );
+            box.m_Vertices[2] = Vec3( posX + width, posY + height, z );
+            box.m_Vertices[3] = Vec3( posX + width, posY, z );
+            Color colors[4];
+            Color placeholderColor( 60, 60, 60, 255 );
+            Fill( colors, placeholderColor );
+            m_Batcher.AddBox( box, colors, PickingID::BOX );
         }
     }
 
+    UpdateCorePrimitives( rawStart, rawStop );
+    UpdateMemoryPrimitives( GetTickFromUs( m_MinTimeUs ), rawStop );
+
     if( !a_Picking )
     {
         UpdateEvents();
     }
 
-    m_NeedsUpdatePrimitives = false;
+    m_NeedsUpdatePrimitives = hasPendingChunks;
     m_NeedsRedraw = true;
 }
 
+//-----------------------------------------------------------------------------
+void TimeGraph::UpdateCorePrimitives( TickType a_Min, TickType a_Max )
+{
+    if( m_CoreUtilization.IsEmpty() || m_TimeWindowUs <= 0 )
+        return;
+
+    double invTimeWindow = 1.0 / m_TimeWindowUs;
+    float pixelWidth = m_WorldWidth / std::max( m_Canvas->getWidth(), 1 );
+    float boxHeight = m_Layout.GetTextCoresHeight();
+    const unsigned char g = 100;
+    Color grey( g, g, g, 255 );
+
+    for( uint32_t core = 0; core < m_CoreUtilization.GetNumCores(); ++core )
+    {
+        float posY = m_Layout.GetCoreOffset( core );
+
+        // Same level of detail as thread tracks: boxes wider than a pixel are
+        // drawn, smaller ones only produce one line per pixel column.
+        float lastLineX = -FLT_MAX;
+        m_CoreUtilization.ForEachInterval( core, a_Min, a_Max, [&]( const CoreUtilization::Interval & a_Interval )
+        {
+            double start = MicroSecondsFromTicks( m_SessionMinCounter, a_Interval.m_Start ) - m_MinTimeUs;
+            double end = MicroSecondsFromTicks( m_SessionMinCounter, a_Interval.m_End ) - m_MinTimeUs;
+            float posX = float( m_WorldStartX + start * invTimeWindow * m_WorldWidth );
+            float width = float( ( end - start ) * invTimeWindow * m_WorldWidth );
+
+            bool isInactive = Capture::GSelectedThreadId != 0 && a_Interval.m_TID != Capture::GSelectedThreadId;
+            Color col = isInactive ? grey : GetThreadColor( a_Interval.m_TID );
+            float z = isInactive ? GlCanvas::Z_VALUE_BOX_INACTIVE : GlCanvas::Z_VALUE_BOX_ACTIVE;
+
+            if( width > pixelWidth )
+            {
+                Box box;
+                box.m_Vertices[0] = Vec3( posX, posY, z );
+                box.m_Vertices[1] = Vec3( posX, posY + boxHeight, z );
+                box.m_Vertices[2] = Vec3( posX + width, posY + boxHeight, z );
+                box.m_Vertices[3] = Vec3( posX + width, posY, z );
+                Color colors[4];
+                Fill( colors, col );
+                m_Batcher.AddBox( box, colors, PickingID::BOX );
+            }
+            else if( posX - lastLineX >= pixelWidth )
+            {
+                Line line;
+                line.m_Beg = Vec3( posX, posY, z );
+                line.m_End = Vec3( posX, posY + boxHeight, z );
+                Color colors[2];
+                Fill( colors, col );
+                m_Batcher.AddLine( line, colors, PickingID::LINE );
+                lastLineX = posX;
+            }
+        } );
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::UpdateMemoryPrimitives( TickType a_Min, TickType a_Max )
+{
+    DWORD64 peak = m_MemTracker.PeakLiveBytes();
+    if( !Capture::GHasMemoryEvents || peak == 0 || m_TimeWindowUs <= 0 )
+        return;
+
+    // One min/max line per pixel column, from the pre-aggregated live bytes.
+    uint32_t numColumns = (uint32_t)std::max( m_Canvas->getWidth(), 1 );
+    std::vector<MemoryTracker::LiveBytesSample> columns;
+    m_MemTracker.GetLiveBytesGraph( a_Min, a_Max, numColumns, columns );
+
+    float posY = m_Layout.GetMemoryTrackOffset() - m_Layout.GetMemoryTrackHeight();
+    float height = m_Layout.GetMemoryTrackHeight();
+    float startX = GetWorldFromTick( a_Min );
+    float columnWidth = ( GetWorldFromTick( a_Max ) - startX ) / numColumns;
+    float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
+    float scale = height / (float)peak;
+
+    Color memoryColor( 0, 180, 120, 255 );
+    Color colors[2];
+    Fill( colors, memoryColor );
+    for( uint32_t column = 0; column < numColumns; ++column )
+    {
+        const MemoryTracker::LiveBytesSample & sample = columns[column];
+        if( sample.IsEmpty() )
+            continue;
+
+        float x = startX + column * columnWidth;
+        Line line;
+        line.m_Beg = Vec3( x, posY + sample.m_Min * scale, z );
+        line.m_End = Vec3( x, posY + std::max( sample.m_Max * scale, sample.m_Min * scale + 1.f ), z );
+        m_Batcher.AddLine( line, colors, PickingID::LINE );
+    }
+}
+
 //-----------------------------------------------------------------------------
 void TimeGraph::UpdateEvents()
 {
@@ -752,7 +1053,7 @@ void TimeGraph::SelectEvents( float a_WorldStart, float a_WorldEnd, ThreadID a_T
         if( callstack )
         {
             callstack->m_ThreadId = event.m_TID;
-            samplingProfiler->AddCallStack( *callstack );
+            samplingProfiler->AddCallStack( *callstack, event.m_Time );
         }
     }
     samplingProfiler->ProcessSamples();
@@ -795,6 +1096,13 @@ void TimeGraph::DrawThreadTracks( bool a_Picking )
         if( track->GetName().empty() )
         {
             std::string threadName = ws2s(Capture::GTargetProcess->GetThreadNameFromTID(threadId));
+
+            // Tell threads of different targets apart.
+            if( GTcpServer && GTcpServer->GetNumSources() > 1 )
+            {
+                threadName = Format( "[%u] ", GTcpServer->GetThreadSource( threadId ) ) + threadName;
+            }
+
             track->SetName(threadName);
         }
 
@@ -12,12 +12,17 @@
 #include "Batcher.h"
 #include "TextRenderer.h"
 #include "MemoryTracker.h"
+#include "CoreUtilization.h"
+#include "FunctionDurationIndex.h"
 #include "EventBuffer.h"
 #include "ThreadTrack.h"
 #include "ThreadTrackMap.h"
 #include <unordered_map>
 
 class Systrace;
+class TimerChunkCache;
+struct CaptureChunk;
+struct FunctionStats;
 
 class TimeGraph
 {
@@ -33,6 +38,9 @@ public:
     void DrawBoxBuffer( bool a_Picking );
     void DrawBuffered( bool a_Picking );
     void DrawText();
+    void UpdateCorePrimitives( TickType a_Min, TickType a_Max );
+    void UpdateMemoryPrimitives( TickType a_Min, TickType a_Max );
+    void ApplyStreamCheckpoint();
 
     void NeedsUpdate();
     void UpdatePrimitives( bool a_Picking );
@@ -42,6 +50,8 @@ public:
     void SelectEvents( float a_WorldStart, float a_WorldEnd, ThreadID a_TID );
 
     void ProcessTimer( const Timer & a_Timer );
+    void ProcessTimerChunk( uint32_t a_ChunkIndex, const CaptureChunk & a_Chunk );
+    void ProcessThreadTimers( ThreadID a_TID, const std::vector<Timer> & a_Timers, std::unordered_map<DWORD64, FunctionStats> & o_FunctionStats );
     void UpdateThreadDepth( int a_ThreadId, int a_Depth );
     void UpdateMaxTimeStamp( TickType a_Time );
     void AddContextSwitch();
@@ -59,6 +69,7 @@ public:
     void Clear();
     void ZoomAll();
     void Zoom( const TextBox* a_TextBox );
+    void Zoom( TickType a_Start, TickType a_End );
     void ZoomTime( float a_ZoomValue, double a_MouseRatio );
     void SetMinMax( double a_MinTimeUs, double a_MaxTimeUs );
     void PanTime( int a_InitialX, int a_CurrentX, int a_Width, double a_InitialTime );
@@ -84,15 +95,28 @@ public:
     void SetCanvas( GlCanvas* a_Canvas );
 	void SetFontSize( int a_FontSize );
     void SetSystrace(std::shared_ptr<Systrace> a_Systrace) { m_Systrace = a_Systrace; }
+    void SetTimerChunkCache( std::shared_ptr<TimerChunkCache> a_Cache ) { m_TimerChunkCache = a_Cache; }
+    // Streamed captures, see CaptureStream::SetCheckpointCallback.
+    void OnStreamCheckpoint( const std::shared_ptr<class CaptureFileReader> & a_Reader );
+    const std::shared_ptr<TimerChunkCache> & GetTimerChunkCache() const { return m_TimerChunkCache; }
     Batcher& GetBatcher() { return m_Batcher; }
     uint32_t GetNumTimers() const;
     std::vector< std::shared_ptr<TimerChain> > GetAllTimerChains() const;
+    ThreadTrackMap GetThreadTracksCopy() const;
     double GetMarginRatio() const { return m_MarginRatio; }
 
     void OnDrag( float a_Ratio );
     double GetMinTimeUs() const { return m_MinTimeUs; }
     double GetMaxTimeUs() const { return m_MaxTimeUs; }
     const MemoryTracker& GetMemoryTracker() const { return m_MemTracker; }
+    const CoreUtilization& GetCoreUtilization() const { return m_CoreUtilization; }
+    FunctionDurationIndex& GetDurationIndex() { return m_DurationIndex; }
+
+    // Duration histogram panel, a_Bin is highlighted on the timeline.
+    void SetHistogramFunction( DWORD64 a_Function ) { m_HistogramFunction = a_Function; m_HighlightedBin = -1; NeedsUpdate(); }
+    DWORD64 GetHistogramFunction() const { return m_HistogramFunction; }
+    void SetHighlightedBin( int a_Bin ) { m_HighlightedBin = a_Bin; NeedsUpdate(); }
+    int GetHighlightedBin() const { return m_HighlightedBin; }
     const TimeGraphLayout& GetLayout() const { return m_Layout; }
     TimeGraphLayout& GetLayout() { return m_Layout; }
     Color GetThreadColor(ThreadID a_TID) const;
@@ -104,7 +128,7 @@ public:
 
 protected:
     std::shared_ptr<ThreadTrack> GetThreadTrack(ThreadID a_TID);
-    ThreadTrackMap GetThreadTracksCopy() const;
+    bool ProcessUntrackedTimer( const Timer & a_Timer );
     
 private:
     TextRenderer                    m_TextRendererStatic;
@@ -133,8 +157,10 @@ private:
     TimeGraphLayout                 m_Layout;
     std::map< ThreadID, class EventTrack* > m_EventTracks; // TODO: put in ThreadTrack
 
-    std::map< DWORD/*ThreadId*/, std::map< long long, ContextSwitch > > m_ContextSwitchesMap;
-    std::map< DWORD/*CoreId*/, std::map< long long, ContextSwitch > >   m_CoreUtilizationMap;
+    CoreUtilization                 m_CoreUtilization;
+    FunctionDurationIndex           m_DurationIndex;
+    DWORD64                         m_HistogramFunction = 0;
+    int                             m_HighlightedBin = -1;
 
     std::map< ThreadID, uint32_t >  m_ThreadCountMap;
 
@@ -148,6 +174,10 @@ private:
     Timer                           m_LastThreadReorder;
     MemoryTracker                   m_MemTracker;
     std::shared_ptr<Systrace>       m_Systrace;
+    std::shared_ptr<TimerChunkCache> m_TimerChunkCache;
+    std::shared_ptr<class CaptureFileReader> m_PendingStreamReader;
+    uint32_t                        m_NumStreamedChunks = 0;
+    std::unordered_map<ThreadID, TickType> m_StreamedUntil;
     
     mutable Mutex                   m_Mutex;
     ThreadTrackMap                  m_ThreadTracks;
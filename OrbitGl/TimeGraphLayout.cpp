@@ -13,6 +13,7 @@ TimeGraphLayout::TimeGraphLayout()
     m_WorldY = 0.f;
     m_TextBoxHeight = 20.f;
     m_CoresHeight = 5.f;
+    m_MemoryTrackHeight = 40.f;
     m_EventTrackHeight = 10.f;
     m_SpaceBetweenCores = 2.f;
     m_SpaceBetweenCoresAndThread = 10.f;
@@ -21,15 +22,27 @@ TimeGraphLayout::TimeGraphLayout()
     m_SpaceBetweenThreadBlocks = 10.f;
 };
 
+//-----------------------------------------------------------------------------
+float TimeGraphLayout::GetCoresStart()
+{
+    // The memory track, when there is one, is the topmost.
+    if( Capture::GHasMemoryEvents )
+    {
+        return m_WorldY - m_MemoryTrackHeight - m_SpaceBetweenCoresAndThread;
+    }
+
+    return m_WorldY;
+}
+
 //-----------------------------------------------------------------------------
 float TimeGraphLayout::GetThreadStart()
 {
     if( Capture::GHasContextSwitches )
     {
-        return m_WorldY - m_NumCores*m_CoresHeight - std::max( m_NumCores - 1, 0 )*m_SpaceBetweenCores - m_SpaceBetweenCoresAndThread;
+        return GetCoresStart() - m_NumCores*m_CoresHeight - std::max( m_NumCores - 1, 0 )*m_SpaceBetweenCores - m_SpaceBetweenCoresAndThread;
     }
 
-    return m_WorldY;
+    return GetCoresStart();
 }
 
 //-----------------------------------------------------------------------------
@@ -109,7 +122,7 @@ float TimeGraphLayout::GetCoreOffset( int a_CoreId )
 {
     if( Capture::GHasContextSwitches )
     {
-        float coreOffset = m_WorldY - m_CoresHeight - a_CoreId * ( m_CoresHeight + m_SpaceBetweenCores );
+        float coreOffset = GetCoresStart() - m_CoresHeight - a_CoreId * ( m_CoresHeight + m_SpaceBetweenCores );
         return coreOffset;
     }
 
@@ -16,6 +16,8 @@ class TimeGraphLayout
 public:
     TimeGraphLayout();
 
+    float GetMemoryTrackOffset() const { return m_WorldY; }
+    float GetMemoryTrackHeight() const { return m_MemoryTrackHeight; }
     float GetCoreOffset( int a_CoreId );
     float GetThreadStart();
     float GetThreadBlockStart( ThreadID a_TID );
@@ -36,6 +38,7 @@ public:
     const std::vector< ThreadID >& GetSortedThreadIds() const { return m_SortedThreadIds; }
 
 protected:
+    float GetCoresStart();
     void SortTracksByPosition( const ThreadTrackMap& a_ThreadTracks );
 
 
@@ -49,6 +52,7 @@ protected:
 
     float m_TextBoxHeight;
     float m_CoresHeight;
+    float m_MemoryTrackHeight;
     float m_EventTrackHeight;
 
     float m_SpaceBetweenCores;
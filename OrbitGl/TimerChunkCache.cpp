@@ -0,0 +1,78 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+
+#include "TimerChunkCache.h"
+
+const uint64_t TimerChunkCache::LazyLoadThreshold;
+const size_t   TimerChunkCache::DefaultMaxBytes;
+
+//-----------------------------------------------------------------------------
+TimerChunkCache::TimerChunkCache( std::shared_ptr<CaptureFileReader> a_Reader, TextRenderer* a_TextRenderer, size_t a_MaxBytes )
+    : m_Reader( a_Reader )
+    , m_TextRenderer( a_TextRenderer )
+    , m_MaxBytes( a_MaxBytes )
+{
+}
+
+//-----------------------------------------------------------------------------
+std::vector<TextBox>* TimerChunkCache::Get( uint32_t a_ChunkIndex )
+{
+    auto it = m_Entries.find( a_ChunkIndex );
+    if( it != m_Entries.end() )
+    {
+        Entry & entry = it->second;
+        m_Lru.splice( m_Lru.begin(), m_Lru, entry.m_LruIt );
+        entry.m_Frame = m_Frame;
+        return &entry.m_TextBoxes;
+    }
+
+    const CaptureChunk & chunk = GetChunk( a_ChunkIndex );
+    m_Timers.clear();
+    if( !m_Reader->ReadTimers( chunk, m_Timers ) )
+        return nullptr;
+
+    // Compressed pages are not needed anymore, keep them out of the RSS.
+    m_Reader->ReleaseChunk( chunk );
+
+    Entry & entry = m_Entries[a_ChunkIndex];
+    entry.m_TextBoxes.reserve( m_Timers.size() );
+    for( const Timer & timer : m_Timers )
+    {
+        entry.m_TextBoxes.emplace_back( Vec2( 0, 0 ), Vec2( 0, 0 ), "", m_TextRenderer, Color( 255, 0, 0, 255 ) );
+        entry.m_TextBoxes.back().SetTimer( timer );
+    }
+
+    m_Lru.push_front( a_ChunkIndex );
+    entry.m_LruIt = m_Lru.begin();
+    entry.m_Frame = m_Frame;
+    m_Bytes += entry.m_TextBoxes.capacity()*sizeof( TextBox );
+
+    return &entry.m_TextBoxes;
+}
+
+//-----------------------------------------------------------------------------
+void TimerChunkCache::Trim( const TextBox* a_Pinned )
+{
+    auto it = m_Lru.end();
+    while( m_Bytes > m_MaxBytes && it != m_Lru.begin() )
+    {
+        --it;
+        Entry & entry = m_Entries[*it];
+        const std::vector<TextBox> & boxes = entry.m_TextBoxes;
+
+        // Still visible, everything more recent is too.
+        if( entry.m_Frame == m_Frame )
+            break;
+
+        bool pinned = a_Pinned && !boxes.empty() && a_Pinned >= boxes.data() && a_Pinned < boxes.data() + boxes.size();
+        if( pinned )
+            continue;
+
+        m_Bytes -= boxes.capacity()*sizeof( TextBox );
+        m_Entries.erase( *it );
+        it = m_Lru.erase( it );
+    }
+
+    ++m_Frame;
+}
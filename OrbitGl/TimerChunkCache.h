@@ -0,0 +1,66 @@
+//-----------------------------------
+// Copyright Pierric Gimmig 2013-2017
+//-----------------------------------
+#pragma once
+
+#include "TextBox.h"
+#include "CaptureFile.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class TextRenderer;
+
+//-----------------------------------------------------------------------------
+// Timer chunks of a lazily loaded capture, decoded into text boxes when the
+// time graph needs them.  Entries are only evicted by Trim, between frames,
+// so text boxes handed out during a frame stay valid until the next one.
+//-----------------------------------------------------------------------------
+class TimerChunkCache
+{
+public:
+    TimerChunkCache( std::shared_ptr<CaptureFileReader> a_Reader, TextRenderer* a_TextRenderer, size_t a_MaxBytes );
+
+    // Captures with more timer data than this are decoded on demand.
+    static const uint64_t LazyLoadThreshold = 512ull*1024*1024;
+    static const size_t   DefaultMaxBytes = 256*1024*1024;
+
+    const CaptureFileReader & GetReader() const { return *m_Reader; }
+    // Streamed captures hand over a newer view of the same file, chunk
+    // indices stay valid.
+    void SetReader( std::shared_ptr<CaptureFileReader> a_Reader ) { m_Reader = a_Reader; }
+    const CaptureChunk & GetChunk( uint32_t a_ChunkIndex ) const { return m_Reader->GetChunks()[a_ChunkIndex]; }
+
+    bool IsResident( uint32_t a_ChunkIndex ) const { return m_Entries.find( a_ChunkIndex ) != m_Entries.end(); }
+    bool IsFull() const { return m_Bytes >= m_MaxBytes; }
+
+    // Decodes the chunk if needed, returns nullptr if it can't be decoded.
+    std::vector<TextBox>* Get( uint32_t a_ChunkIndex );
+
+    // Called before a new frame, evicts least recently used chunks not used
+    // during the last frame until the cache is under budget.  The chunk
+    // holding a_Pinned is never evicted.
+    void Trim( const TextBox* a_Pinned );
+
+    size_t GetResidentBytes() const { return m_Bytes; }
+    size_t GetMaxBytes() const { return m_MaxBytes; }
+
+protected:
+    struct Entry
+    {
+        std::vector<TextBox>           m_TextBoxes;
+        std::list<uint32_t>::iterator  m_LruIt;
+        uint32_t                       m_Frame = 0;
+    };
+
+    std::shared_ptr<CaptureFileReader>   m_Reader;
+    TextRenderer*                        m_TextRenderer;
+    std::unordered_map<uint32_t, Entry>  m_Entries;
+    std::list<uint32_t>                  m_Lru;   // most recently used first
+    std::vector<Timer>                   m_Timers;
+    size_t                               m_Bytes = 0;
+    size_t                               m_MaxBytes;
+    uint32_t                             m_Frame = 1;
+};
@@ -116,47 +116,41 @@ void TypesDataView::OnFilter( const std::wstring & a_Filter )
 }
 
 //-----------------------------------------------------------------------------
-void TypesDataView::ParallelFilter( const std::wstring & a_Filter )
+void TypesDataView::UpdateNameFilter()
 {
-#ifdef _WIN32
-    m_FilterTokens = Tokenize( ToLower( a_Filter ) );
     std::vector<Type*> & types = Capture::GTargetProcess->GetTypes();
-    const auto prio = oqpi::task_priority::normal;
-    auto numWorkers = oqpi_tk::scheduler().workersCount( prio );
-    std::vector< std::vector<int> > indicesArray;
-    indicesArray.resize( numWorkers );
 
-    oqpi_tk::parallel_for( "TypesDataViewParallelFor", (int)types.size(), [&]( int32_t a_BlockIndex, int32_t a_ElementIndex )
+    // Types are only appended while modules load, anything else is a new list.
+    Type* firstType = types.empty() ? nullptr : types[0];
+    if( types.size() < m_NameFilter.Size() || firstType != m_FirstFilteredType )
     {
-        std::vector<int> & result = indicesArray[a_BlockIndex];
-        const std::wstring & name = types[a_ElementIndex]->GetNameLower();
+        m_NameFilter.Clear();
+        m_FirstFilteredType = firstType;
+    }
 
-        for( std::wstring & filterToken : m_FilterTokens )
+    m_NameFilter.Reserve( types.size(), 0 );
+    for( size_t i = m_NameFilter.Size(); i < types.size(); ++i )
+    {
+        Type* type = types[i];
+        Pdb* pdb = type->GetPdb();
+        m_NameFilter.AddField( type->GetName() );
+        if( pdb )
         {
-            if( name.find( filterToken ) == std::wstring::npos )
-            {
-                return;
-            }
+            m_NameFilter.EndEntry( pdb->GetSymbolIndex().GetTypeIndex(), SymbolIndex::GetEntry( pdb->GetTypes(), type ) );
         }
-
-        result.push_back( a_ElementIndex );
-    } );
-
-    std::set< int > indicesSet;
-    for( std::vector<int> & results : indicesArray )
-    {
-        for( int index : results )
+        else
         {
-            indicesSet.insert( index );
+            m_NameFilter.EndEntry();
         }
     }
+}
 
-    m_Indices.clear();
-    for( int i : indicesSet )
-    {
-        m_Indices.push_back( i );
-    }
-#endif
+//-----------------------------------------------------------------------------
+void TypesDataView::ParallelFilter( const std::wstring & a_Filter )
+{
+    ScopeLock lock( Capture::GTargetProcess->GetDataMutex() );
+    UpdateNameFilter();
+    m_NameFilter.Filter( a_Filter, m_Indices );
 }
 
 //-----------------------------------------------------------------------------
@@ -5,6 +5,7 @@
 
 #include "DataView.h"
 #include "OrbitType.h"
+#include "NameFilter.h"
 #include <vector>
 
 class TypesDataView : public DataView
@@ -25,12 +26,14 @@ public:
 
 protected:
     Type & GetType(unsigned int a_Row) const;
+    void UpdateNameFilter();
 
     void OnProp(std::vector<int> & a_Items);
     void OnView(std::vector<int> & a_Items);
     void OnClip(std::vector<int> & a_Items);
 
-    std::vector< std::wstring > m_FilterTokens;
+    NameFilter                  m_NameFilter;
+    Type*                       m_FirstFilteredType = nullptr;
     static std::vector<int>     s_HeaderMap;
     static std::vector<float>   s_HeaderRatios;
 };